@@ -0,0 +1,681 @@
+/* Copyright (C) 2026 Red Hat, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.  */
+
+#include <config.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <locale.h>
+#include <error.h>
+#include <argp.h>
+#include <stdlib.h>
+
+#include "prelink.h"
+
+#ifndef EM_AARCH64
+#define EM_AARCH64		183
+#endif
+
+#ifndef R_AARCH64_IRELATIVE
+#define R_AARCH64_NONE		0
+#define R_AARCH64_ABS64		257
+#define R_AARCH64_ABS32		258
+#define R_AARCH64_ABS16		259
+#define R_AARCH64_PREL64	260
+#define R_AARCH64_PREL32	261
+#define R_AARCH64_COPY		1024
+#define R_AARCH64_GLOB_DAT	1025
+#define R_AARCH64_JUMP_SLOT	1026
+#define R_AARCH64_RELATIVE	1027
+#define R_AARCH64_TLSDESC	1031
+#define R_AARCH64_IRELATIVE	1032
+#endif
+
+/* Older headers use the names with the 64 suffix.  */
+#ifndef R_AARCH64_TLS_DTPMOD
+#define R_AARCH64_TLS_DTPMOD	1028
+#define R_AARCH64_TLS_DTPREL	1029
+#define R_AARCH64_TLS_TPREL	1030
+#endif
+
+static int
+aarch64_adjust_dyn (DSO *dso, int n, GElf_Dyn *dyn, GElf_Addr start,
+		    GElf_Addr adjust)
+{
+  if (dyn->d_tag == DT_PLTGOT)
+    {
+      int sec = addr_to_sec (dso, dyn->d_un.d_ptr);
+      Elf64_Addr data;
+      int i;
+
+      if (sec == -1)
+	return 0;
+
+      /* If .got[0] points to _DYNAMIC, it needs to be adjusted.  */
+      for (i = 1; i < dso->ehdr.e_shnum; i++)
+	if (dso->shdr[i].sh_type == SHT_PROGBITS
+	    && dso->shdr[i].sh_size >= 8
+	    && strcmp (strptr (dso, dso->ehdr.e_shstrndx,
+			       dso->shdr[i].sh_name), ".got") == 0)
+	  {
+	    data = read_une64 (dso, dso->shdr[i].sh_addr);
+	    if (data == dso->shdr[n].sh_addr && data >= start)
+	      write_ne64 (dso, dso->shdr[i].sh_addr, data + adjust);
+	    break;
+	  }
+
+      data = read_une64 (dso, dyn->d_un.d_ptr + 8);
+      /* If .got.plt[1] points to .plt, it needs to be adjusted.  */
+      if (data && data >= start)
+	for (i = 1; i < dso->ehdr.e_shnum; i++)
+	  if (data == dso->shdr[i].sh_addr
+	      && dso->shdr[i].sh_type == SHT_PROGBITS
+	      && strcmp (strptr (dso, dso->ehdr.e_shstrndx,
+				 dso->shdr[i].sh_name), ".plt") == 0)
+	    {
+	      write_ne64 (dso, dyn->d_un.d_ptr + 8, data + adjust);
+	      break;
+	    }
+    }
+  return 0;
+}
+
+static int
+aarch64_adjust_rel (DSO *dso, GElf_Rel *rel, GElf_Addr start,
+		    GElf_Addr adjust)
+{
+  error (0, 0, "%s: AArch64 doesn't support REL relocs", dso->filename);
+  return 1;
+}
+
+static int
+aarch64_adjust_rela (DSO *dso, GElf_Rela *rela, GElf_Addr start,
+		     GElf_Addr adjust)
+{
+  Elf64_Addr addr;
+
+  switch (GELF_R_TYPE (rela->r_info))
+    {
+    case R_AARCH64_RELATIVE:
+      if ((GElf_Addr) rela->r_addend >= start)
+	{
+	  if (read_une64 (dso, rela->r_offset) == (GElf_Addr) rela->r_addend)
+	    write_ne64 (dso, rela->r_offset, rela->r_addend + adjust);
+	  rela->r_addend += adjust;
+	}
+      break;
+    case R_AARCH64_IRELATIVE:
+      if ((GElf_Addr) rela->r_addend >= start)
+	rela->r_addend += adjust;
+      /* FALLTHROUGH */
+    case R_AARCH64_JUMP_SLOT:
+      addr = read_une64 (dso, rela->r_offset);
+      if (addr >= start)
+	write_ne64 (dso, rela->r_offset, addr + adjust);
+      break;
+    case R_AARCH64_TLSDESC:
+      /* In prelinked objects the descriptor entry points to the
+	 DT_TLSDESC_PLT trampoline.  */
+      addr = read_une64 (dso, rela->r_offset);
+      if (addr && addr >= start)
+	write_ne64 (dso, rela->r_offset, addr + adjust);
+      break;
+    }
+  return 0;
+}
+
+/* Adjust a whole run of R_AARCH64_RELATIVE or R_AARCH64_JUMP_SLOT
+   relocations at once.  */
+static int
+aarch64_adjust_reloc_batch (struct reloc_view *view, struct reloc_run *run,
+			    GElf_Addr start, GElf_Addr adjust)
+{
+  if (!view->rela)
+    return 0;
+
+  switch (run->type)
+    {
+    case R_AARCH64_RELATIVE:
+      adjust_relative_relocs (view, run, start, adjust);
+      return 1;
+    case R_AARCH64_JUMP_SLOT:
+      adjust_reloc_words (view, run, 8, start, adjust);
+      return 1;
+    }
+  return 0;
+}
+
+static int
+aarch64_prelink_rel (struct prelink_info *info, GElf_Rel *rel,
+		     GElf_Addr reladdr)
+{
+  error (0, 0, "%s: AArch64 doesn't support REL relocs", info->dso->filename);
+  return 1;
+}
+
+static int
+aarch64_prelink_rela (struct prelink_info *info, GElf_Rela *rela,
+		      GElf_Addr relaaddr)
+{
+  DSO *dso;
+  GElf_Addr value;
+  Elf64_Addr val;
+
+  dso = info->dso;
+  if (GELF_R_TYPE (rela->r_info) == R_AARCH64_NONE
+      || GELF_R_TYPE (rela->r_info) == R_AARCH64_IRELATIVE)
+    /* Fast path: nothing to do.  */
+    return 0;
+  else if (GELF_R_TYPE (rela->r_info) == R_AARCH64_RELATIVE)
+    {
+      write_ne64 (dso, rela->r_offset, rela->r_addend);
+      return 0;
+    }
+  value = info->resolve (info, GELF_R_SYM (rela->r_info),
+			 GELF_R_TYPE (rela->r_info));
+  switch (GELF_R_TYPE (rela->r_info))
+    {
+    case R_AARCH64_GLOB_DAT:
+    case R_AARCH64_JUMP_SLOT:
+    case R_AARCH64_ABS64:
+      write_ne64 (dso, rela->r_offset, value + rela->r_addend);
+      break;
+    case R_AARCH64_ABS32:
+      write_ne32 (dso, rela->r_offset, value + rela->r_addend);
+      break;
+    case R_AARCH64_PREL64:
+      write_ne64 (dso, rela->r_offset,
+		  value + rela->r_addend - rela->r_offset);
+      break;
+    case R_AARCH64_PREL32:
+      write_ne32 (dso, rela->r_offset,
+		  value + rela->r_addend - rela->r_offset);
+      break;
+    case R_AARCH64_TLS_DTPREL:
+      write_ne64 (dso, rela->r_offset, value + rela->r_addend);
+      break;
+    /* DTPMOD and TPREL are impossible to predict in shared libraries
+       unless prelink sets the rules.  */
+    case R_AARCH64_TLS_DTPMOD:
+      if (dso->ehdr.e_type == ET_EXEC)
+	{
+	  error (0, 0, "%s: R_AARCH64_TLS_DTPMOD reloc in executable?",
+		 dso->filename);
+	  return 1;
+	}
+      break;
+    case R_AARCH64_TLS_TPREL:
+      if (dso->ehdr.e_type == ET_EXEC && info->resolvetls)
+	write_ne64 (dso, rela->r_offset,
+		    value + rela->r_addend + info->resolvetls->offset);
+      break;
+    case R_AARCH64_TLSDESC:
+      /* The descriptor is resolved lazily through the DT_TLSDESC_PLT
+	 trampoline, store its address into the entry word the way
+	 the dynamic linker would.  */
+      if (!dso->info_DT_TLSDESC_PLT)
+	{
+	  error (0, 0,
+		 "%s: Unsupported R_AARCH64_TLSDESC relocation in non-lazily bound object.",
+		 dso->filename);
+	  return 1;
+	}
+      val = read_une64 (dso, rela->r_offset);
+      if (val != 0 && !dynamic_info_is_set (dso, DT_GNU_PRELINKED_BIT))
+	{
+	  error (0, 0,
+		 "%s: Unexpected non-zero value (0x%llx) in R_AARCH64_TLSDESC?",
+		 dso->filename, (unsigned long long) val);
+	  return 1;
+	}
+      write_ne64 (dso, rela->r_offset, dso->info_DT_TLSDESC_PLT);
+      break;
+    case R_AARCH64_COPY:
+      if (dso->ehdr.e_type == ET_EXEC)
+	/* COPY relocs are handled specially in generic code.  */
+	return 0;
+      error (0, 0, "%s: R_AARCH64_COPY reloc in shared library?",
+	     dso->filename);
+      return 1;
+    default:
+      error (0, 0, "%s: Unknown AArch64 relocation type %d", dso->filename,
+	     (int) GELF_R_TYPE (rela->r_info));
+      return 1;
+    }
+  return 0;
+}
+
+static int
+aarch64_apply_conflict_rela (struct prelink_info *info, GElf_Rela *rela,
+			     char *buf, GElf_Addr dest_addr)
+{
+  GElf_Rela *ret;
+
+  switch (GELF_R_TYPE (rela->r_info))
+    {
+    case R_AARCH64_GLOB_DAT:
+    case R_AARCH64_JUMP_SLOT:
+    case R_AARCH64_ABS64:
+      buf_write_ne64 (info->dso, buf, rela->r_addend);
+      break;
+    case R_AARCH64_ABS32:
+      buf_write_ne32 (info->dso, buf, rela->r_addend);
+      break;
+    case R_AARCH64_IRELATIVE:
+      if (dest_addr == 0)
+	return 5;
+      ret = prelink_conflict_add_rela (info);
+      if (ret == NULL)
+	return 1;
+      ret->r_offset = dest_addr;
+      ret->r_info = GELF_R_INFO (0, R_AARCH64_IRELATIVE);
+      ret->r_addend = rela->r_addend;
+      break;
+    default:
+      abort ();
+    }
+  return 0;
+}
+
+static int
+aarch64_apply_rel (struct prelink_info *info, GElf_Rel *rel, char *buf)
+{
+  error (0, 0, "%s: AArch64 doesn't support REL relocs", info->dso->filename);
+  return 1;
+}
+
+static int
+aarch64_apply_rela (struct prelink_info *info, GElf_Rela *rela, char *buf)
+{
+  GElf_Addr value;
+
+  value = info->resolve (info, GELF_R_SYM (rela->r_info),
+			 GELF_R_TYPE (rela->r_info));
+  switch (GELF_R_TYPE (rela->r_info))
+    {
+    case R_AARCH64_NONE:
+      break;
+    case R_AARCH64_GLOB_DAT:
+    case R_AARCH64_JUMP_SLOT:
+    case R_AARCH64_ABS64:
+      buf_write_ne64 (info->dso, buf, value + rela->r_addend);
+      break;
+    case R_AARCH64_ABS32:
+      buf_write_ne32 (info->dso, buf, value + rela->r_addend);
+      break;
+    case R_AARCH64_ABS16:
+      buf_write_ne16 (info->dso, buf, value + rela->r_addend);
+      break;
+    case R_AARCH64_PREL64:
+      buf_write_ne64 (info->dso, buf, value + rela->r_addend - rela->r_offset);
+      break;
+    case R_AARCH64_PREL32:
+      buf_write_ne32 (info->dso, buf, value + rela->r_addend - rela->r_offset);
+      break;
+    case R_AARCH64_COPY:
+      abort ();
+    case R_AARCH64_RELATIVE:
+      error (0, 0, "%s: R_AARCH64_RELATIVE in ET_EXEC object?",
+	     info->dso->filename);
+      return 1;
+    default:
+      return 1;
+    }
+  return 0;
+}
+
+static int
+aarch64_prelink_conflict_rel (DSO *dso, struct prelink_info *info,
+			      GElf_Rel *rel, GElf_Addr reladdr)
+{
+  error (0, 0, "%s: AArch64 doesn't support REL relocs", dso->filename);
+  return 1;
+}
+
+static int
+aarch64_prelink_conflict_rela (DSO *dso, struct prelink_info *info,
+			       GElf_Rela *rela, GElf_Addr relaaddr)
+{
+  GElf_Addr value;
+  struct prelink_conflict *conflict;
+  struct prelink_tls *tls;
+  GElf_Rela *ret;
+
+  if (GELF_R_TYPE (rela->r_info) == R_AARCH64_RELATIVE
+      || GELF_R_TYPE (rela->r_info) == R_AARCH64_NONE)
+    /* Fast path: nothing to do.  */
+    return 0;
+  if (GELF_R_TYPE (rela->r_info) == R_AARCH64_TLSDESC)
+    {
+      /* A conflict can't describe a TLS descriptor: the dynamic
+	 linker applies a TLSDESC conflict, which has no symbol, as
+	 a reference to an undefined weak symbol, so the variable
+	 would resolve to 0.  Leave such programs unprelinked.  */
+      error (0, 0, "%s: R_AARCH64_TLSDESC relocations can't be prelinked into programs",
+	     dso->filename);
+      return 1;
+    }
+  conflict = prelink_conflict (info, GELF_R_SYM (rela->r_info),
+			       GELF_R_TYPE (rela->r_info));
+  if (conflict == NULL)
+    {
+      switch (GELF_R_TYPE (rela->r_info))
+	{
+	/* Even local DTPMOD and TPREL relocs need conflicts.  */
+	case R_AARCH64_TLS_DTPMOD:
+	case R_AARCH64_TLS_TPREL:
+	  if (info->curtls == NULL || info->dso == dso)
+	    return 0;
+	  break;
+	/* Similarly IRELATIVE relocations always need conflicts.  */
+	case R_AARCH64_IRELATIVE:
+	  break;
+	default:
+	  return 0;
+	}
+      value = 0;
+    }
+  else if (info->dso == dso && !conflict->ifunc)
+    return 0;
+  else
+    {
+      /* DTPREL wants to see only real conflicts, not lookups
+	 with reloc_class RTYPE_CLASS_TLS.  */
+      if (GELF_R_TYPE (rela->r_info) == R_AARCH64_TLS_DTPREL
+	  && conflict->lookup.tls == conflict->conflict.tls
+	  && conflict->lookupval == conflict->conflictval)
+	return 0;
+
+      value = conflict_lookup_value (conflict);
+    }
+  ret = prelink_conflict_add_rela (info);
+  if (ret == NULL)
+    return 1;
+  ret->r_offset = rela->r_offset;
+  ret->r_info = GELF_R_INFO (0, GELF_R_TYPE (rela->r_info));
+  switch (GELF_R_TYPE (rela->r_info))
+    {
+    case R_AARCH64_GLOB_DAT:
+      ret->r_info = GELF_R_INFO (0, R_AARCH64_ABS64);
+      /* FALLTHROUGH */
+    case R_AARCH64_JUMP_SLOT:
+    case R_AARCH64_ABS64:
+    case R_AARCH64_ABS32:
+    case R_AARCH64_IRELATIVE:
+      ret->r_addend = value + rela->r_addend;
+      if (conflict != NULL && conflict->ifunc)
+	ret->r_info = GELF_R_INFO (0, R_AARCH64_IRELATIVE);
+      break;
+    case R_AARCH64_PREL64:
+      ret->r_addend = value + rela->r_addend - rela->r_offset;
+      ret->r_info = GELF_R_INFO (0, R_AARCH64_ABS64);
+      break;
+    case R_AARCH64_PREL32:
+      ret->r_addend = value + rela->r_addend - rela->r_offset;
+      ret->r_info = GELF_R_INFO (0, R_AARCH64_ABS32);
+      break;
+    case R_AARCH64_COPY:
+      error (0, 0, "R_AARCH64_COPY should not be present in shared libraries");
+      return 1;
+    case R_AARCH64_TLS_DTPMOD:
+    case R_AARCH64_TLS_DTPREL:
+    case R_AARCH64_TLS_TPREL:
+      if (conflict != NULL
+	  && (conflict->reloc_class != RTYPE_CLASS_TLS
+	      || conflict->lookup.tls == NULL))
+	{
+	  error (0, 0, "%s: TLS reloc not resolving to STT_TLS symbol",
+		 dso->filename);
+	  return 1;
+	}
+      tls = conflict ? conflict->lookup.tls : info->curtls;
+      ret->r_info = GELF_R_INFO (0, R_AARCH64_ABS64);
+      switch (GELF_R_TYPE (rela->r_info))
+	{
+	case R_AARCH64_TLS_DTPMOD:
+	  ret->r_addend = tls->modid;
+	  break;
+	case R_AARCH64_TLS_DTPREL:
+	  ret->r_addend = value + rela->r_addend;
+	  break;
+	case R_AARCH64_TLS_TPREL:
+	  ret->r_addend = value + rela->r_addend + tls->offset;
+	  break;
+	}
+      break;
+    default:
+      error (0, 0, "%s: Unknown AArch64 relocation type %d", dso->filename,
+	     (int) GELF_R_TYPE (rela->r_info));
+      return 1;
+    }
+  return 0;
+}
+
+static int
+aarch64_rel_to_rela (DSO *dso, GElf_Rel *rel, GElf_Rela *rela)
+{
+  error (0, 0, "%s: AArch64 doesn't support REL relocs", dso->filename);
+  return 1;
+}
+
+static int
+aarch64_need_rel_to_rela (DSO *dso, int first, int last)
+{
+  return 0;
+}
+
+/* Return the section index of .plt, or -1 if there is none.  */
+static int
+aarch64_plt_sec (DSO *dso)
+{
+  int i;
+
+  for (i = 1; i < dso->ehdr.e_shnum; i++)
+    if (dso->shdr[i].sh_type == SHT_PROGBITS
+	&& ! strcmp (strptr (dso, dso->ehdr.e_shstrndx,
+			     dso->shdr[i].sh_name),
+		     ".plt"))
+      return i;
+  return -1;
+}
+
+static int
+aarch64_arch_prelink (struct prelink_info *info)
+{
+  DSO *dso;
+  int i;
+
+  dso = info->dso;
+  if (dso->info[DT_PLTGOT])
+    {
+      /* Write address of .plt into got[1].
+	 .plt is what the lazy JUMP_SLOT entries contain unless
+	 prelinking, the dynamic linker restores them from got[1].  */
+      int sec = addr_to_sec (dso, dso->info[DT_PLTGOT]);
+
+      if (sec == -1)
+	return 1;
+
+      i = aarch64_plt_sec (dso);
+      if (i == -1)
+	return 0;
+      write_ne64 (dso, dso->info[DT_PLTGOT] + 8, dso->shdr[i].sh_addr);
+    }
+
+  return 0;
+}
+
+static int
+aarch64_arch_undo_prelink (DSO *dso)
+{
+  int i;
+
+  if (dso->info[DT_PLTGOT])
+    {
+      /* Clear got[1] if it contains address of .plt.  */
+      int sec = addr_to_sec (dso, dso->info[DT_PLTGOT]);
+
+      if (sec == -1)
+	return 1;
+
+      i = aarch64_plt_sec (dso);
+      if (i == -1)
+	return 0;
+      if (read_une64 (dso, dso->info[DT_PLTGOT] + 8) == dso->shdr[i].sh_addr)
+	write_ne64 (dso, dso->info[DT_PLTGOT] + 8, 0);
+    }
+
+  return 0;
+}
+
+static int
+aarch64_undo_prelink_rela (DSO *dso, GElf_Rela *rela, GElf_Addr relaaddr)
+{
+  int sec;
+  const char *name;
+
+  switch (GELF_R_TYPE (rela->r_info))
+    {
+    case R_AARCH64_NONE:
+    case R_AARCH64_RELATIVE:
+    case R_AARCH64_IRELATIVE:
+      break;
+    case R_AARCH64_JUMP_SLOT:
+      sec = addr_to_sec (dso, rela->r_offset);
+      if (sec != -1)
+	name = strptr (dso, dso->ehdr.e_shstrndx, dso->shdr[sec].sh_name);
+      if (sec == -1 || (strcmp (name, ".got") && strcmp (name, ".got.plt")))
+	{
+	  error (0, 0, "%s: R_AARCH64_JUMP_SLOT not pointing into .got section",
+		 dso->filename);
+	  return 1;
+	}
+      else
+	{
+	  /* Lazy JUMP_SLOT entries point to the start of .plt.  */
+	  int plt = aarch64_plt_sec (dso);
+
+	  assert (rela->r_offset >= dso->shdr[sec].sh_addr + 24);
+	  assert (((rela->r_offset - dso->shdr[sec].sh_addr) & 7) == 0);
+	  if (plt == -1)
+	    {
+	      error (0, 0, "%s: R_AARCH64_JUMP_SLOT without .plt section",
+		     dso->filename);
+	      return 1;
+	    }
+	  write_ne64 (dso, rela->r_offset, dso->shdr[plt].sh_addr);
+	}
+      break;
+    case R_AARCH64_GLOB_DAT:
+    case R_AARCH64_ABS64:
+    case R_AARCH64_PREL64:
+    case R_AARCH64_TLS_DTPMOD:
+    case R_AARCH64_TLS_DTPREL:
+    case R_AARCH64_TLS_TPREL:
+    case R_AARCH64_TLSDESC:
+      write_ne64 (dso, rela->r_offset, 0);
+      break;
+    case R_AARCH64_ABS32:
+    case R_AARCH64_PREL32:
+      write_ne32 (dso, rela->r_offset, 0);
+      break;
+    case R_AARCH64_COPY:
+      if (dso->ehdr.e_type == ET_EXEC)
+	/* COPY relocs are handled specially in generic code.  */
+	return 0;
+      error (0, 0, "%s: R_AARCH64_COPY reloc in shared library?",
+	     dso->filename);
+      return 1;
+    default:
+      error (0, 0, "%s: Unknown AArch64 relocation type %d", dso->filename,
+	     (int) GELF_R_TYPE (rela->r_info));
+      return 1;
+    }
+  return 0;
+}
+
+static int
+aarch64_reloc_size (int reloc_type)
+{
+  switch (reloc_type)
+    {
+    case R_AARCH64_ABS32:
+    case R_AARCH64_PREL32:
+      return 4;
+    case R_AARCH64_ABS16:
+      return 2;
+    default:
+      return 8;
+    }
+}
+
+static int
+aarch64_reloc_class (int reloc_type)
+{
+  switch (reloc_type)
+    {
+    case R_AARCH64_COPY: return RTYPE_CLASS_COPY;
+    case R_AARCH64_JUMP_SLOT: return RTYPE_CLASS_PLT;
+    case R_AARCH64_TLS_DTPMOD:
+    case R_AARCH64_TLS_DTPREL:
+    case R_AARCH64_TLS_TPREL:
+    case R_AARCH64_TLSDESC:
+      return RTYPE_CLASS_TLS;
+    default: return RTYPE_CLASS_VALID;
+    }
+}
+
+PL_ARCH(aarch64) = {
+  .name = "AArch64",
+  .class = ELFCLASS64,
+  .machine = EM_AARCH64,
+  .alternate_machine = { EM_NONE },
+  .R_JMP_SLOT = R_AARCH64_JUMP_SLOT,
+  .R_COPY = R_AARCH64_COPY,
+  .R_RELATIVE = R_AARCH64_RELATIVE,
+  .rtype_class_valid = RTYPE_CLASS_VALID,
+  .dynamic_linker = "/lib/ld-linux-aarch64.so.1",
+  .dynamic_linker_alt = "/lib/ld-linux-aarch64_be.so.1",
+  .adjust_dyn = aarch64_adjust_dyn,
+  .adjust_rel = aarch64_adjust_rel,
+  .adjust_rela = aarch64_adjust_rela,
+  .prelink_rel = aarch64_prelink_rel,
+  .prelink_rela = aarch64_prelink_rela,
+  .prelink_conflict_rel = aarch64_prelink_conflict_rel,
+  .prelink_conflict_rela = aarch64_prelink_conflict_rela,
+  .apply_conflict_rela = aarch64_apply_conflict_rela,
+  .apply_rel = aarch64_apply_rel,
+  .apply_rela = aarch64_apply_rela,
+  .rel_to_rela = aarch64_rel_to_rela,
+  .need_rel_to_rela = aarch64_need_rel_to_rela,
+  .reloc_size = aarch64_reloc_size,
+  .reloc_class = aarch64_reloc_class,
+  .max_reloc_size = 8,
+  .arch_prelink = aarch64_arch_prelink,
+  .arch_undo_prelink = aarch64_arch_undo_prelink,
+  .undo_prelink_rela = aarch64_undo_prelink_rela,
+  .adjust_reloc_batch = aarch64_adjust_reloc_batch,
+  /* Kernels with 39-bit virtual address space have TASK_SIZE
+     0x8000000000, leave the upper half of it to mmap and the stack.
+     Kernels can use 4K, 16K or 64K pages, so libraries are laid out
+     at 64K boundaries.  */
+  .mmap_base = 0x2000000000LL,
+  .mmap_end =  0x4000000000LL,
+  .max_page_size = 0x10000,
+  .page_size = 0x1000
+};
@@ -112,6 +112,26 @@ i386_adjust_rela (DSO *dso, GElf_Rela *rela, GElf_Addr start,
   return 0;
 }
 
+/* Adjust a whole run of R_386_RELATIVE, R_386_JMP_SLOT or
+   R_386_IRELATIVE REL relocations at once.  */
+static int
+i386_adjust_reloc_batch (struct reloc_view *view, struct reloc_run *run,
+			 GElf_Addr start, GElf_Addr adjust)
+{
+  if (view->rela)
+    return 0;
+
+  switch (run->type)
+    {
+    case R_386_RELATIVE:
+    case R_386_JMP_SLOT:
+    case R_386_IRELATIVE:
+      adjust_reloc_words (view, run, 4, start, adjust);
+      return 1;
+    }
+  return 0;
+}
+
 static int
 i386_prelink_rel (struct prelink_info *info, GElf_Rel *rel, GElf_Addr reladdr)
 {
@@ -182,6 +202,46 @@ i386_prelink_rel (struct prelink_info *info, GElf_Rel *rel, GElf_Addr reladdr)
   return 0;
 }
 
+/* Prelink a whole run of REL relocations which don't need anything
+   but the resolved symbol value.  */
+static int
+i386_prelink_reloc_batch (struct prelink_info *info,
+			  struct reloc_view *view, struct reloc_run *run)
+{
+  DSO *dso = info->dso;
+  unsigned char *p;
+  GElf_Addr value;
+  int i;
+
+  if (view->rela)
+    return 0;
+
+  switch (run->type)
+    {
+    case R_386_RELATIVE:
+    case R_386_IRELATIVE:
+    case R_386_NONE:
+      /* Fast path: nothing to do.  */
+      return 1;
+    case R_386_GLOB_DAT:
+    case R_386_JMP_SLOT:
+      for (i = run->first; i < run->first + run->count; ++i)
+	{
+	  p = reloc_target (view, view->offset[i], 4);
+	  if (p == NULL && reloc_view_sec (view, view->offset[i]) == -1)
+	    continue;
+
+	  value = info->resolve (info, GELF_R_SYM (view->info[i]), run->type);
+	  if (p != NULL)
+	    buf_write_le32 (p, value);
+	  else
+	    write_le32 (dso, view->offset[i], value);
+	}
+      return 1;
+    }
+  return 0;
+}
+
 static int
 i386_prelink_rela (struct prelink_info *info, GElf_Rela *rela,
 		   GElf_Addr relaaddr)
@@ -1118,6 +1178,8 @@ PL_ARCH(i386) = {
   .arch_prelink = i386_arch_prelink,
   .arch_undo_prelink = i386_arch_undo_prelink,
   .undo_prelink_rel = i386_undo_prelink_rel,
+  .adjust_reloc_batch = i386_adjust_reloc_batch,
+  .prelink_reloc_batch = i386_prelink_reloc_batch,
   .layout_libs_init = i386_layout_libs_init,
   .layout_libs_pre = i386_layout_libs_pre,
   .layout_libs_post = i386_layout_libs_post,
@@ -101,6 +101,25 @@ ppc64_adjust_rela (DSO *dso, GElf_Rela *rela, GElf_Addr start,
   return 0;
 }
 
+/* Adjust a whole run of R_PPC64_RELATIVE or R_PPC64_IRELATIVE
+   relocations at once.  */
+static int
+ppc64_adjust_reloc_batch (struct reloc_view *view, struct reloc_run *run,
+			  GElf_Addr start, GElf_Addr adjust)
+{
+  if (!view->rela)
+    return 0;
+
+  switch (run->type)
+    {
+    case R_PPC64_RELATIVE:
+    case R_PPC64_IRELATIVE:
+      adjust_relative_relocs (view, run, start, adjust);
+      return 1;
+    }
+  return 0;
+}
+
 static int
 ppc64_prelink_rel (struct prelink_info *info, GElf_Rel *rel,
 		   GElf_Addr reladdr)
@@ -873,6 +892,7 @@ PL_ARCH(ppc64) = {
   .adjust_dyn = ppc64_adjust_dyn,
   .adjust_rel = ppc64_adjust_rel,
   .adjust_rela = ppc64_adjust_rela,
+  .adjust_reloc_batch = ppc64_adjust_reloc_batch,
   .prelink_rel = ppc64_prelink_rel,
   .prelink_rela = ppc64_prelink_rela,
   .prelink_conflict_rel = ppc64_prelink_conflict_rel,
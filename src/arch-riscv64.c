@@ -0,0 +1,588 @@
+/* Copyright (C) 2026 Red Hat, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.  */
+
+#include <config.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <locale.h>
+#include <error.h>
+#include <argp.h>
+#include <stdlib.h>
+
+#include "prelink.h"
+
+#ifndef EM_RISCV
+#define EM_RISCV		243
+#endif
+
+#ifndef R_RISCV_IRELATIVE
+#define R_RISCV_NONE		0
+#define R_RISCV_32		1
+#define R_RISCV_64		2
+#define R_RISCV_RELATIVE	3
+#define R_RISCV_COPY		4
+#define R_RISCV_JUMP_SLOT	5
+#define R_RISCV_TLS_DTPMOD64	7
+#define R_RISCV_TLS_DTPREL64	9
+#define R_RISCV_TLS_TPREL64	11
+#define R_RISCV_IRELATIVE	58
+#endif
+
+/* DTPREL values are biased by TLS_DTV_OFFSET, so that signed 12-bit
+   offsets reach further into the TLS block.  */
+#define RISCV_TLS_DTV_OFFSET	0x800
+
+/* Return the section index of section NAME, or -1 if there is none.  */
+static int
+riscv64_find_progbits (DSO *dso, const char *name)
+{
+  int i;
+
+  for (i = 1; i < dso->ehdr.e_shnum; i++)
+    if (dso->shdr[i].sh_type == SHT_PROGBITS
+	&& ! strcmp (strptr (dso, dso->ehdr.e_shstrndx,
+			     dso->shdr[i].sh_name), name))
+      return i;
+  return -1;
+}
+
+static int
+riscv64_adjust_dyn (DSO *dso, int n, GElf_Dyn *dyn, GElf_Addr start,
+		    GElf_Addr adjust)
+{
+  if (dyn->d_tag == DT_PLTGOT)
+    {
+      int sec = addr_to_sec (dso, dyn->d_un.d_ptr);
+      Elf64_Addr data;
+      int i;
+
+      if (sec == -1)
+	return 0;
+
+      /* If .got[0] points to _DYNAMIC, it needs to be adjusted.  */
+      i = riscv64_find_progbits (dso, ".got");
+      if (i != -1 && dso->shdr[i].sh_size >= 8)
+	{
+	  data = read_une64 (dso, dso->shdr[i].sh_addr);
+	  if (data == dso->shdr[n].sh_addr && data >= start)
+	    write_ne64 (dso, dso->shdr[i].sh_addr, data + adjust);
+	}
+
+      data = read_une64 (dso, dyn->d_un.d_ptr + 8);
+      /* If .got.plt[1] points to .plt, it needs to be adjusted.  */
+      if (data && data >= start)
+	{
+	  i = riscv64_find_progbits (dso, ".plt");
+	  if (i != -1 && data == dso->shdr[i].sh_addr)
+	    write_ne64 (dso, dyn->d_un.d_ptr + 8, data + adjust);
+	}
+    }
+  return 0;
+}
+
+static int
+riscv64_adjust_rel (DSO *dso, GElf_Rel *rel, GElf_Addr start,
+		    GElf_Addr adjust)
+{
+  error (0, 0, "%s: RISC-V doesn't support REL relocs", dso->filename);
+  return 1;
+}
+
+static int
+riscv64_adjust_rela (DSO *dso, GElf_Rela *rela, GElf_Addr start,
+		     GElf_Addr adjust)
+{
+  Elf64_Addr addr;
+
+  switch (GELF_R_TYPE (rela->r_info))
+    {
+    case R_RISCV_RELATIVE:
+      if ((GElf_Addr) rela->r_addend >= start)
+	{
+	  if (read_une64 (dso, rela->r_offset) == (GElf_Addr) rela->r_addend)
+	    write_ne64 (dso, rela->r_offset, rela->r_addend + adjust);
+	  rela->r_addend += adjust;
+	}
+      break;
+    case R_RISCV_IRELATIVE:
+      if ((GElf_Addr) rela->r_addend >= start)
+	rela->r_addend += adjust;
+      /* FALLTHROUGH */
+    case R_RISCV_JUMP_SLOT:
+      addr = read_une64 (dso, rela->r_offset);
+      if (addr >= start)
+	write_ne64 (dso, rela->r_offset, addr + adjust);
+      break;
+    }
+  return 0;
+}
+
+/* Adjust a whole run of R_RISCV_RELATIVE or R_RISCV_JUMP_SLOT
+   relocations at once.  */
+static int
+riscv64_adjust_reloc_batch (struct reloc_view *view, struct reloc_run *run,
+			    GElf_Addr start, GElf_Addr adjust)
+{
+  if (!view->rela)
+    return 0;
+
+  switch (run->type)
+    {
+    case R_RISCV_RELATIVE:
+      adjust_relative_relocs (view, run, start, adjust);
+      return 1;
+    case R_RISCV_JUMP_SLOT:
+      adjust_reloc_words (view, run, 8, start, adjust);
+      return 1;
+    }
+  return 0;
+}
+
+static int
+riscv64_prelink_rel (struct prelink_info *info, GElf_Rel *rel,
+		     GElf_Addr reladdr)
+{
+  error (0, 0, "%s: RISC-V doesn't support REL relocs", info->dso->filename);
+  return 1;
+}
+
+static int
+riscv64_prelink_rela (struct prelink_info *info, GElf_Rela *rela,
+		      GElf_Addr relaaddr)
+{
+  DSO *dso;
+  GElf_Addr value;
+
+  dso = info->dso;
+  if (GELF_R_TYPE (rela->r_info) == R_RISCV_NONE
+      || GELF_R_TYPE (rela->r_info) == R_RISCV_IRELATIVE)
+    /* Fast path: nothing to do.  */
+    return 0;
+  else if (GELF_R_TYPE (rela->r_info) == R_RISCV_RELATIVE)
+    {
+      write_ne64 (dso, rela->r_offset, rela->r_addend);
+      return 0;
+    }
+  value = info->resolve (info, GELF_R_SYM (rela->r_info),
+			 GELF_R_TYPE (rela->r_info));
+  switch (GELF_R_TYPE (rela->r_info))
+    {
+    case R_RISCV_JUMP_SLOT:
+    case R_RISCV_64:
+      write_ne64 (dso, rela->r_offset, value + rela->r_addend);
+      break;
+    case R_RISCV_32:
+      write_ne32 (dso, rela->r_offset, value + rela->r_addend);
+      break;
+    case R_RISCV_TLS_DTPREL64:
+      write_ne64 (dso, rela->r_offset,
+		  value + rela->r_addend - RISCV_TLS_DTV_OFFSET);
+      break;
+    /* DTPMOD64 and TPREL64 are impossible to predict in shared libraries
+       unless prelink sets the rules.  */
+    case R_RISCV_TLS_DTPMOD64:
+      if (dso->ehdr.e_type == ET_EXEC)
+	{
+	  error (0, 0, "%s: R_RISCV_TLS_DTPMOD64 reloc in executable?",
+		 dso->filename);
+	  return 1;
+	}
+      break;
+    case R_RISCV_TLS_TPREL64:
+      if (dso->ehdr.e_type == ET_EXEC && info->resolvetls)
+	write_ne64 (dso, rela->r_offset,
+		    value + rela->r_addend + info->resolvetls->offset);
+      break;
+    case R_RISCV_COPY:
+      if (dso->ehdr.e_type == ET_EXEC)
+	/* COPY relocs are handled specially in generic code.  */
+	return 0;
+      error (0, 0, "%s: R_RISCV_COPY reloc in shared library?",
+	     dso->filename);
+      return 1;
+    default:
+      error (0, 0, "%s: Unknown RISC-V relocation type %d", dso->filename,
+	     (int) GELF_R_TYPE (rela->r_info));
+      return 1;
+    }
+  return 0;
+}
+
+static int
+riscv64_apply_conflict_rela (struct prelink_info *info, GElf_Rela *rela,
+			     char *buf, GElf_Addr dest_addr)
+{
+  GElf_Rela *ret;
+
+  switch (GELF_R_TYPE (rela->r_info))
+    {
+    case R_RISCV_JUMP_SLOT:
+    case R_RISCV_64:
+      buf_write_ne64 (info->dso, buf, rela->r_addend);
+      break;
+    case R_RISCV_32:
+      buf_write_ne32 (info->dso, buf, rela->r_addend);
+      break;
+    case R_RISCV_IRELATIVE:
+      if (dest_addr == 0)
+	return 5;
+      ret = prelink_conflict_add_rela (info);
+      if (ret == NULL)
+	return 1;
+      ret->r_offset = dest_addr;
+      ret->r_info = GELF_R_INFO (0, R_RISCV_IRELATIVE);
+      ret->r_addend = rela->r_addend;
+      break;
+    default:
+      abort ();
+    }
+  return 0;
+}
+
+static int
+riscv64_apply_rel (struct prelink_info *info, GElf_Rel *rel, char *buf)
+{
+  error (0, 0, "%s: RISC-V doesn't support REL relocs", info->dso->filename);
+  return 1;
+}
+
+static int
+riscv64_apply_rela (struct prelink_info *info, GElf_Rela *rela, char *buf)
+{
+  GElf_Addr value;
+
+  value = info->resolve (info, GELF_R_SYM (rela->r_info),
+			 GELF_R_TYPE (rela->r_info));
+  switch (GELF_R_TYPE (rela->r_info))
+    {
+    case R_RISCV_NONE:
+      break;
+    case R_RISCV_JUMP_SLOT:
+    case R_RISCV_64:
+      buf_write_ne64 (info->dso, buf, value + rela->r_addend);
+      break;
+    case R_RISCV_32:
+      buf_write_ne32 (info->dso, buf, value + rela->r_addend);
+      break;
+    case R_RISCV_COPY:
+      abort ();
+    case R_RISCV_RELATIVE:
+      error (0, 0, "%s: R_RISCV_RELATIVE in ET_EXEC object?",
+	     info->dso->filename);
+      return 1;
+    default:
+      return 1;
+    }
+  return 0;
+}
+
+static int
+riscv64_prelink_conflict_rel (DSO *dso, struct prelink_info *info,
+			      GElf_Rel *rel, GElf_Addr reladdr)
+{
+  error (0, 0, "%s: RISC-V doesn't support REL relocs", dso->filename);
+  return 1;
+}
+
+static int
+riscv64_prelink_conflict_rela (DSO *dso, struct prelink_info *info,
+			       GElf_Rela *rela, GElf_Addr relaaddr)
+{
+  GElf_Addr value;
+  struct prelink_conflict *conflict;
+  struct prelink_tls *tls;
+  GElf_Rela *ret;
+
+  if (GELF_R_TYPE (rela->r_info) == R_RISCV_RELATIVE
+      || GELF_R_TYPE (rela->r_info) == R_RISCV_NONE)
+    /* Fast path: nothing to do.  */
+    return 0;
+  conflict = prelink_conflict (info, GELF_R_SYM (rela->r_info),
+			       GELF_R_TYPE (rela->r_info));
+  if (conflict == NULL)
+    {
+      switch (GELF_R_TYPE (rela->r_info))
+	{
+	/* Even local DTPMOD64 and TPREL64 relocs need conflicts.  */
+	case R_RISCV_TLS_DTPMOD64:
+	case R_RISCV_TLS_TPREL64:
+	  if (info->curtls == NULL || info->dso == dso)
+	    return 0;
+	  break;
+	/* Similarly IRELATIVE relocations always need conflicts.  */
+	case R_RISCV_IRELATIVE:
+	  break;
+	default:
+	  return 0;
+	}
+      value = 0;
+    }
+  else if (info->dso == dso && !conflict->ifunc)
+    return 0;
+  else
+    {
+      /* DTPREL64 wants to see only real conflicts, not lookups
+	 with reloc_class RTYPE_CLASS_TLS.  */
+      if (GELF_R_TYPE (rela->r_info) == R_RISCV_TLS_DTPREL64
+	  && conflict->lookup.tls == conflict->conflict.tls
+	  && conflict->lookupval == conflict->conflictval)
+	return 0;
+
+      value = conflict_lookup_value (conflict);
+    }
+  ret = prelink_conflict_add_rela (info);
+  if (ret == NULL)
+    return 1;
+  ret->r_offset = rela->r_offset;
+  ret->r_info = GELF_R_INFO (0, GELF_R_TYPE (rela->r_info));
+  switch (GELF_R_TYPE (rela->r_info))
+    {
+    case R_RISCV_JUMP_SLOT:
+    case R_RISCV_64:
+    case R_RISCV_32:
+    case R_RISCV_IRELATIVE:
+      ret->r_addend = value + rela->r_addend;
+      if (conflict != NULL && conflict->ifunc)
+	ret->r_info = GELF_R_INFO (0, R_RISCV_IRELATIVE);
+      break;
+    case R_RISCV_COPY:
+      error (0, 0, "R_RISCV_COPY should not be present in shared libraries");
+      return 1;
+    case R_RISCV_TLS_DTPMOD64:
+    case R_RISCV_TLS_DTPREL64:
+    case R_RISCV_TLS_TPREL64:
+      if (conflict != NULL
+	  && (conflict->reloc_class != RTYPE_CLASS_TLS
+	      || conflict->lookup.tls == NULL))
+	{
+	  error (0, 0, "%s: TLS reloc not resolving to STT_TLS symbol",
+		 dso->filename);
+	  return 1;
+	}
+      tls = conflict ? conflict->lookup.tls : info->curtls;
+      ret->r_info = GELF_R_INFO (0, R_RISCV_64);
+      switch (GELF_R_TYPE (rela->r_info))
+	{
+	case R_RISCV_TLS_DTPMOD64:
+	  ret->r_addend = tls->modid;
+	  break;
+	case R_RISCV_TLS_DTPREL64:
+	  ret->r_addend = value + rela->r_addend - RISCV_TLS_DTV_OFFSET;
+	  break;
+	case R_RISCV_TLS_TPREL64:
+	  ret->r_addend = value + rela->r_addend + tls->offset;
+	  break;
+	}
+      break;
+    default:
+      error (0, 0, "%s: Unknown RISC-V relocation type %d", dso->filename,
+	     (int) GELF_R_TYPE (rela->r_info));
+      return 1;
+    }
+  return 0;
+}
+
+static int
+riscv64_rel_to_rela (DSO *dso, GElf_Rel *rel, GElf_Rela *rela)
+{
+  error (0, 0, "%s: RISC-V doesn't support REL relocs", dso->filename);
+  return 1;
+}
+
+static int
+riscv64_need_rel_to_rela (DSO *dso, int first, int last)
+{
+  return 0;
+}
+
+static int
+riscv64_arch_prelink (struct prelink_info *info)
+{
+  DSO *dso;
+  int i;
+
+  dso = info->dso;
+  if (dso->info[DT_PLTGOT])
+    {
+      /* Write address of .plt into got[1].
+	 .plt is what the lazy JUMP_SLOT entries contain unless
+	 prelinking, the dynamic linker restores them from got[1].  */
+      int sec = addr_to_sec (dso, dso->info[DT_PLTGOT]);
+
+      if (sec == -1)
+	return 1;
+
+      i = riscv64_find_progbits (dso, ".plt");
+      if (i == -1)
+	return 0;
+      write_ne64 (dso, dso->info[DT_PLTGOT] + 8, dso->shdr[i].sh_addr);
+    }
+
+  return 0;
+}
+
+static int
+riscv64_arch_undo_prelink (DSO *dso)
+{
+  int i;
+
+  if (dso->info[DT_PLTGOT])
+    {
+      /* Clear got[1] if it contains address of .plt.  */
+      int sec = addr_to_sec (dso, dso->info[DT_PLTGOT]);
+
+      if (sec == -1)
+	return 1;
+
+      i = riscv64_find_progbits (dso, ".plt");
+      if (i == -1)
+	return 0;
+      if (read_une64 (dso, dso->info[DT_PLTGOT] + 8) == dso->shdr[i].sh_addr)
+	write_ne64 (dso, dso->info[DT_PLTGOT] + 8, 0);
+    }
+
+  return 0;
+}
+
+static int
+riscv64_undo_prelink_rela (DSO *dso, GElf_Rela *rela, GElf_Addr relaaddr)
+{
+  int sec;
+  const char *name;
+
+  switch (GELF_R_TYPE (rela->r_info))
+    {
+    case R_RISCV_NONE:
+    case R_RISCV_RELATIVE:
+    case R_RISCV_IRELATIVE:
+      break;
+    case R_RISCV_JUMP_SLOT:
+      sec = addr_to_sec (dso, rela->r_offset);
+      if (sec != -1)
+	name = strptr (dso, dso->ehdr.e_shstrndx, dso->shdr[sec].sh_name);
+      if (sec == -1 || (strcmp (name, ".got") && strcmp (name, ".got.plt")))
+	{
+	  error (0, 0, "%s: R_RISCV_JUMP_SLOT not pointing into .got section",
+		 dso->filename);
+	  return 1;
+	}
+      else
+	{
+	  /* Lazy JUMP_SLOT entries point to the start of .plt.  */
+	  int plt = riscv64_find_progbits (dso, ".plt");
+
+	  assert (rela->r_offset >= dso->shdr[sec].sh_addr + 16);
+	  assert (((rela->r_offset - dso->shdr[sec].sh_addr) & 7) == 0);
+	  if (plt == -1)
+	    {
+	      error (0, 0, "%s: R_RISCV_JUMP_SLOT without .plt section",
+		     dso->filename);
+	      return 1;
+	    }
+	  write_ne64 (dso, rela->r_offset, dso->shdr[plt].sh_addr);
+	}
+      break;
+    case R_RISCV_64:
+    case R_RISCV_TLS_DTPMOD64:
+    case R_RISCV_TLS_DTPREL64:
+    case R_RISCV_TLS_TPREL64:
+      write_ne64 (dso, rela->r_offset, 0);
+      break;
+    case R_RISCV_32:
+      write_ne32 (dso, rela->r_offset, 0);
+      break;
+    case R_RISCV_COPY:
+      if (dso->ehdr.e_type == ET_EXEC)
+	/* COPY relocs are handled specially in generic code.  */
+	return 0;
+      error (0, 0, "%s: R_RISCV_COPY reloc in shared library?",
+	     dso->filename);
+      return 1;
+    default:
+      error (0, 0, "%s: Unknown RISC-V relocation type %d", dso->filename,
+	     (int) GELF_R_TYPE (rela->r_info));
+      return 1;
+    }
+  return 0;
+}
+
+static int
+riscv64_reloc_size (int reloc_type)
+{
+  switch (reloc_type)
+    {
+    case R_RISCV_32:
+      return 4;
+    default:
+      return 8;
+    }
+}
+
+static int
+riscv64_reloc_class (int reloc_type)
+{
+  switch (reloc_type)
+    {
+    case R_RISCV_COPY: return RTYPE_CLASS_COPY;
+    case R_RISCV_JUMP_SLOT: return RTYPE_CLASS_PLT;
+    case R_RISCV_TLS_DTPMOD64:
+    case R_RISCV_TLS_DTPREL64:
+    case R_RISCV_TLS_TPREL64:
+      return RTYPE_CLASS_TLS;
+    default: return RTYPE_CLASS_VALID;
+    }
+}
+
+PL_ARCH(riscv64) = {
+  .name = "RISC-V 64",
+  .class = ELFCLASS64,
+  .machine = EM_RISCV,
+  .alternate_machine = { EM_NONE },
+  .R_JMP_SLOT = R_RISCV_JUMP_SLOT,
+  .R_COPY = R_RISCV_COPY,
+  .R_RELATIVE = R_RISCV_RELATIVE,
+  .rtype_class_valid = RTYPE_CLASS_VALID,
+  .dynamic_linker = "/lib/ld-linux-riscv64-lp64d.so.1",
+  .dynamic_linker_alt = "/lib/ld-linux-riscv64-lp64.so.1",
+  .adjust_dyn = riscv64_adjust_dyn,
+  .adjust_rel = riscv64_adjust_rel,
+  .adjust_rela = riscv64_adjust_rela,
+  .prelink_rel = riscv64_prelink_rel,
+  .prelink_rela = riscv64_prelink_rela,
+  .prelink_conflict_rel = riscv64_prelink_conflict_rel,
+  .prelink_conflict_rela = riscv64_prelink_conflict_rela,
+  .apply_conflict_rela = riscv64_apply_conflict_rela,
+  .apply_rel = riscv64_apply_rel,
+  .apply_rela = riscv64_apply_rela,
+  .rel_to_rela = riscv64_rel_to_rela,
+  .need_rel_to_rela = riscv64_need_rel_to_rela,
+  .reloc_size = riscv64_reloc_size,
+  .reloc_class = riscv64_reloc_class,
+  .max_reloc_size = 8,
+  .arch_prelink = riscv64_arch_prelink,
+  .arch_undo_prelink = riscv64_arch_undo_prelink,
+  .undo_prelink_rela = riscv64_undo_prelink_rela,
+  .adjust_reloc_batch = riscv64_adjust_reloc_batch,
+  /* Sv39 gives user space 0x4000000000 bytes, leave the upper quarter
+     of it to the stack and mmap.  */
+  .mmap_base = 0x2000000000LL,
+  .mmap_end =  0x3000000000LL,
+  .max_page_size = 0x1000,
+  .page_size = 0x1000
+};
@@ -120,6 +120,27 @@ x86_64_adjust_rela (DSO *dso, GElf_Rela *rela, GElf_Addr start,
   return 0;
 }
 
+/* Adjust a whole run of R_X86_64_RELATIVE or R_X86_64_JUMP_SLOT
+   relocations at once.  */
+static int
+x86_64_adjust_reloc_batch (struct reloc_view *view, struct reloc_run *run,
+			   GElf_Addr start, GElf_Addr adjust)
+{
+  if (!view->rela)
+    return 0;
+
+  switch (run->type)
+    {
+    case R_X86_64_RELATIVE:
+      adjust_relative_relocs (view, run, start, adjust);
+      return 1;
+    case R_X86_64_JUMP_SLOT:
+      adjust_reloc_words (view, run, 8, start, adjust);
+      return 1;
+    }
+  return 0;
+}
+
 static int
 x86_64_prelink_rel (struct prelink_info *info, GElf_Rel *rel, GElf_Addr reladdr)
 {
@@ -192,6 +213,49 @@ x86_64_prelink_rela (struct prelink_info *info, GElf_Rela *rela,
   return 0;
 }
 
+/* Prelink a whole run of relocations which don't need anything
+   but the resolved symbol value.  */
+static int
+x86_64_prelink_reloc_batch (struct prelink_info *info,
+			    struct reloc_view *view, struct reloc_run *run)
+{
+  DSO *dso = info->dso;
+  unsigned char *p;
+  GElf_Addr value;
+  int i;
+
+  if (!view->rela)
+    return 0;
+
+  switch (run->type)
+    {
+    case R_X86_64_NONE:
+    case R_X86_64_IRELATIVE:
+      return 1;
+    case R_X86_64_RELATIVE:
+    case R_X86_64_GLOB_DAT:
+    case R_X86_64_JUMP_SLOT:
+      for (i = run->first; i < run->first + run->count; ++i)
+	{
+	  p = reloc_target (view, view->offset[i], 8);
+	  if (p == NULL && reloc_view_sec (view, view->offset[i]) == -1)
+	    continue;
+
+	  if (run->type == R_X86_64_RELATIVE)
+	    value = 0;
+	  else
+	    value = info->resolve (info, GELF_R_SYM (view->info[i]),
+				   run->type);
+	  if (p != NULL)
+	    buf_write_le64 (p, value + view->addend[i]);
+	  else
+	    write_le64 (dso, view->offset[i], value + view->addend[i]);
+	}
+      return 1;
+    }
+  return 0;
+}
+
 static int
 x86_64_apply_conflict_rela (struct prelink_info *info, GElf_Rela *rela,
 			    char *buf, GElf_Addr dest_addr)
@@ -516,6 +580,63 @@ x86_64_undo_prelink_rela (DSO *dso, GElf_Rela *rela, GElf_Addr relaaddr)
   return 0;
 }
 
+/* Undo a whole run of R_X86_64_JUMP_SLOT relocations, checking
+   each GOT section just once.  */
+static int
+x86_64_undo_prelink_reloc_batch (struct reloc_view *view,
+				 struct reloc_run *run)
+{
+  DSO *dso = view->dso;
+  int i, sec, last_sec = -1;
+  const char *name;
+  unsigned char *p;
+  Elf64_Addr data = 0;
+
+  if (!view->rela)
+    return 0;
+
+  switch (run->type)
+    {
+    case R_X86_64_NONE:
+    case R_X86_64_RELATIVE:
+    case R_X86_64_IRELATIVE:
+      return 1;
+    case R_X86_64_JUMP_SLOT:
+      for (i = run->first; i < run->first + run->count; ++i)
+	{
+	  sec = reloc_view_sec (view, view->offset[i]);
+	  if (sec == -1)
+	    continue;
+	  if (sec != last_sec)
+	    {
+	      name = strptr (dso, dso->ehdr.e_shstrndx,
+			     dso->shdr[sec].sh_name);
+	      if (strcmp (name, ".got") && strcmp (name, ".got.plt"))
+		{
+		  error (0, 0, "%s: R_X86_64_JUMP_SLOT not pointing into .got section",
+			 dso->filename);
+		  return -1;
+		}
+	      data = read_ule64 (dso, dso->shdr[sec].sh_addr + 8);
+	      last_sec = sec;
+	    }
+
+	  assert (view->offset[i] >= dso->shdr[sec].sh_addr + 24);
+	  assert (((view->offset[i] - dso->shdr[sec].sh_addr) & 7) == 0);
+	  p = reloc_target (view, view->offset[i], 8);
+	  if (p != NULL)
+	    buf_write_le64 (p, 2 * (view->offset[i] - dso->shdr[sec].sh_addr
+				    - 24) + data);
+	  else
+	    write_le64 (dso, view->offset[i],
+			2 * (view->offset[i] - dso->shdr[sec].sh_addr - 24)
+			+ data);
+	}
+      return 1;
+    }
+  return 0;
+}
+
 static int
 x86_64_reloc_size (int reloc_type)
 {
@@ -628,6 +749,9 @@ PL_ARCH(x86_64) = {
   .arch_prelink = x86_64_arch_prelink,
   .arch_undo_prelink = x86_64_arch_undo_prelink,
   .undo_prelink_rela = x86_64_undo_prelink_rela,
+  .adjust_reloc_batch = x86_64_adjust_reloc_batch,
+  .prelink_reloc_batch = x86_64_prelink_reloc_batch,
+  .undo_prelink_reloc_batch = x86_64_undo_prelink_reloc_batch,
   /* Although TASK_UNMAPPED_BASE is 0x2a95555555, we leave some
      area so that mmap of /etc/ld.so.cache and ld.so's malloc
      does not take some library's VA slot.
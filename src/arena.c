@@ -0,0 +1,100 @@
+/* Copyright (C) 2026 Red Hat, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.  */
+
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include "prelink.h"
+
+/* Bump pointer allocator for data which lives as long as the
+   struct prelink_info it belongs to.  Nothing is freed individually,
+   arena_free releases everything at once.  */
+
+#define ARENA_ALIGN		16
+#define ARENA_CHUNK_SIZE	(64 * 1024)
+
+struct prelink_arena_chunk
+{
+  struct prelink_arena_chunk *next;
+};
+
+#define ARENA_HDR_SIZE \
+  ((sizeof (struct prelink_arena_chunk) + ARENA_ALIGN - 1) & -ARENA_ALIGN)
+
+/* Return SIZE bytes of storage from ARENA, or NULL if out of memory.  */
+void *
+arena_alloc (struct prelink_arena *arena, size_t size)
+{
+  struct prelink_arena_chunk *c;
+  char *ret;
+
+  size = (size + ARENA_ALIGN - 1) & -ARENA_ALIGN;
+  if (size > (size_t) (arena->end - arena->ptr))
+    {
+      size_t chunk_size = ARENA_CHUNK_SIZE;
+
+      /* Big requests get a chunk of their own, so that the rest of
+	 the current chunk is not wasted.  */
+      if (size > ARENA_CHUNK_SIZE / 4)
+	chunk_size = size;
+      c = malloc (ARENA_HDR_SIZE + chunk_size);
+      if (c == NULL)
+	return NULL;
+      ret = (char *) c + ARENA_HDR_SIZE;
+      if (chunk_size == size && arena->chunks != NULL)
+	{
+	  c->next = arena->chunks->next;
+	  arena->chunks->next = c;
+	  return ret;
+	}
+      c->next = arena->chunks;
+      arena->chunks = c;
+      arena->ptr = ret;
+      arena->end = ret + chunk_size;
+    }
+
+  ret = arena->ptr;
+  arena->ptr += size;
+  return ret;
+}
+
+/* Return a copy of string S allocated from ARENA, or NULL.  */
+char *
+arena_strdup (struct prelink_arena *arena, const char *s)
+{
+  size_t len = strlen (s) + 1;
+  char *ret = arena_alloc (arena, len);
+
+  if (ret != NULL)
+    memcpy (ret, s, len);
+  return ret;
+}
+
+/* Release all memory allocated from ARENA.  */
+void
+arena_free (struct prelink_arena *arena)
+{
+  struct prelink_arena_chunk *c, *next;
+
+  for (c = arena->chunks; c; c = next)
+    {
+      next = c->next;
+      free (c);
+    }
+  arena->chunks = NULL;
+  arena->ptr = NULL;
+  arena->end = NULL;
+}
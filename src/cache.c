@@ -24,6 +24,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/file.h>
 #include <sys/wait.h>
 #include <sys/mman.h>
 #include "prelinktab.h"
@@ -32,12 +33,38 @@ htab_t prelink_devino_htab, prelink_filename_htab;
 
 int prelink_entry_count;
 
+extern uint32_t crc32 (uint32_t crc, unsigned char *buf, size_t len);
+
+/* The prelink cache stays mapped while prelink runs, entries are
+   turned into struct prelink_entry when they are first needed.
+   CACHE_MAP_FD holds a shared flock on it, so that nobody patches it
+   in place underneath us.  */
+static struct prelink_cache *cache_map;
+static int cache_map_fd = -1;
+static dev_t cache_map_dev;
+static ino64_t cache_map_ino;
+static uint32_t *cache_deps, *cache_filename_hash, *cache_devino_hash;
+static uint32_t cache_string_start;
+static struct prelink_entry **cache_ents;
+/* 1 while an entry is being loaded, 2 if it was loaded as a valid
+   cache entry and 3 if not.  */
+static char *cache_tried;
+
+static void prelink_cache_find_filename (const char *filename);
+static void prelink_cache_find_devino (const struct stat64 *stp);
+
+static hashval_t
+devino_hash_1 (dev_t dev, ino64_t ino)
+{
+  return (dev << 2) ^ ino ^ (ino >> 20);
+}
+
 static hashval_t
 devino_hash (const void *p)
 {
   struct prelink_entry *e = (struct prelink_entry *)p;
 
-  return (e->dev << 2) ^ (e->ino) ^ (e->ino >> 20);
+  return devino_hash_1 (e->dev, e->ino);
 }
 
 static int
@@ -50,10 +77,9 @@ devino_eq (const void *p, const void *q)
 }
 
 static hashval_t
-filename_hash (const void *p)
+string_hash (const char *str)
 {
-  struct prelink_entry *e = (struct prelink_entry *)p;
-  const unsigned char *s = (const unsigned char *)e->filename;
+  const unsigned char *s = (const unsigned char *)str;
   hashval_t h = 0;
   unsigned char c;
   size_t len = 0;
@@ -67,6 +93,14 @@ filename_hash (const void *p)
   return h + len + (len << 17);
 }
 
+static hashval_t
+filename_hash (const void *p)
+{
+  struct prelink_entry *e = (struct prelink_entry *)p;
+
+  return string_hash (e->filename);
+}
+
 static int
 filename_eq (const void *p, const void *q)
 {
@@ -97,6 +131,14 @@ prelink_find_entry (const char *filename, const struct stat64 *stp,
   struct stat64 st;
   char *canon_filename = NULL;
 
+  if (cache_map != NULL)
+    {
+      if (stp != NULL)
+	prelink_cache_find_devino (stp);
+      else
+	prelink_cache_find_filename (filename);
+    }
+
   e.filename = filename;
   filename_slot = htab_find_slot (prelink_filename_htab, &e,
 				  insert ? INSERT : NO_INSERT);
@@ -230,8 +272,56 @@ error_out2:
   return NULL;
 }
 
+/* Compute the crc field of cache entry CE.  */
+static uint32_t
+prelink_cache_crc (struct prelink_cache_entry *ce, uint32_t *deps,
+		   size_t ndeps, const char *filename)
+{
+  struct prelink_cache_entry e = *ce;
+  uint32_t crc;
+
+  e.crc = 0;
+  crc = crc32 (0, (unsigned char *) &e, sizeof (e));
+  crc = crc32 (crc, (unsigned char *) deps, ndeps * sizeof (uint32_t));
+  return crc32 (crc, (unsigned char *) filename, strlen (filename) + 1);
+}
+
+/* Return filename of cache entry I, or NULL if it is bogus.  */
+static const char *
+prelink_cache_filename (uint32_t i)
+{
+  uint32_t off = cache_map->entry[i].filename;
+
+  if (off < cache_string_start
+      || off >= cache_string_start + cache_map->len_strings
+      || memchr ((char *) cache_map + off, '\0',
+		 cache_string_start + cache_map->len_strings - off) == NULL)
+    return NULL;
+  return (char *) cache_map + off;
+}
+
+/* Return non-zero if cache entry I is sane and not corrupted.  */
+static int
+prelink_cache_entry_ok (uint32_t i)
+{
+  struct prelink_cache_entry *ce = &cache_map->entry[i];
+  const char *filename = prelink_cache_filename (i);
+  uint32_t j;
+
+  if (filename == NULL || ce->depends >= cache_map->ndeps)
+    return 0;
+  for (j = ce->depends; j < cache_map->ndeps && cache_deps[j] != i; ++j)
+    if (cache_deps[j] >= cache_map->nlibs)
+      return 0;
+  if (j == cache_map->ndeps)
+    return 0;
+  return prelink_cache_crc (ce, cache_deps + ce->depends,
+			    j + 1 - ce->depends, filename) == ce->crc;
+}
+
 static struct prelink_entry *
-prelink_load_entry (const char *filename)
+prelink_load_entry (const char *filename, struct prelink_cache_entry *ce,
+		    const struct stat64 *stp)
 {
   struct prelink_entry e, *ent = NULL;
   void **filename_slot, *dummy = NULL;
@@ -248,7 +338,16 @@ prelink_load_entry (const char *filename)
   if (*filename_slot != NULL)
     return (struct prelink_entry *) *filename_slot;
 
-  canon_filename = prelink_canonicalize (filename, &st);
+  /* The cache records canonical filenames.  If the file has not been
+     replaced since, avoid canonicalizing it again.  */
+  if (stp != NULL)
+    st = *stp;
+  if ((stp != NULL || stat64 (filename, &st) == 0)
+      && S_ISREG (st.st_mode)
+      && st.st_dev == ce->dev && st.st_ino == ce->ino)
+    canon_filename = strdup (filename);
+  else
+    canon_filename = prelink_canonicalize (filename, &st);
   if (canon_filename == NULL)
     goto error_out2;
   if (strcmp (canon_filename, filename) != 0)
@@ -330,158 +429,288 @@ error_out2:
   return NULL;
 }
 
-static int
-deps_cmp (const void *A, const void *B)
+/* Create struct prelink_entry for cache entry I and the entries it
+   depends on, unless already done.  STP, if non-NULL, is stat64 of
+   a file with the entry's dev/ino.  */
+static struct prelink_entry *
+prelink_cache_load (uint32_t i, const struct stat64 *stp)
 {
-  struct prelink_entry *a = * (struct prelink_entry **) A;
-  struct prelink_entry *b = * (struct prelink_entry **) B;
+  struct prelink_cache_entry *ce = &cache_map->entry[i];
+  struct prelink_entry *ent, *dep;
+  uint32_t j;
 
-  if (a == NULL)
-    return (b != NULL);
-  if (a != NULL && b == NULL)
-    return -1;
+  if (cache_tried[i])
+    return cache_ents[i];
+  cache_tried[i] = 3;
 
-  if (a->type == ET_NONE && b->type != ET_NONE)
-    return 1;
-  if (a->type != ET_NONE && b->type == ET_NONE)
-    return -1;
+  if (! prelink_cache_entry_ok (i))
+    {
+      if (verbose)
+	error (0, 0, "%s: Ignoring corrupted entry %u", prelink_cache, i);
+      return NULL;
+    }
 
-  /* Libraries with fewest dependencies first.  */
-  if (a->ndepends < b->ndepends)
-    return -1;
-  if (a->ndepends > b->ndepends)
-    return 1;
-  return 0;
+  ent = prelink_load_entry ((char *) cache_map + ce->filename, ce, stp);
+  cache_ents[i] = ent;
+  if (ent == NULL)
+    return ent;
+  if (ent->type != ET_NONE)
+    {
+      cache_tried[i] = 2;
+      return ent;
+    }
+
+  ent->checksum = ce->checksum;
+  ent->base = ce->base;
+  ent->end = ce->end;
+  ent->type = (ent->base == 0 && ent->end == 0)
+	      ? ET_CACHE_EXEC : ET_CACHE_DYN;
+  ent->flags = ce->flags;
+
+  if (ent->flags == PCF_UNPRELINKABLE)
+    ent->type = (quick || print_cache) ? ET_UNPRELINKABLE : ET_NONE;
+
+  /* If mtime is equal to ctime, assume the filesystem does not store
+     ctime.  */
+  if (quick
+      && ((ent->ctime == ent->mtime
+	   && ent->type != ET_UNPRELINKABLE)
+	  || ent->ctime != ce->ctime
+	  || ent->mtime != ce->mtime))
+    ent->type = ET_NONE;
+
+  cache_tried[i] = 1;
+  for (j = ce->depends; ent->type != ET_NONE && cache_deps[j] != i; ++j)
+    {
+      dep = prelink_cache_load (cache_deps[j], NULL);
+      if (dep == NULL || (quick && cache_tried[cache_deps[j]] == 3))
+	ent->type = ET_NONE;
+    }
+
+  if (ent->type == ET_NONE)
+    {
+      cache_tried[i] = 3;
+      return ent;
+    }
+  cache_tried[i] = 2;
+
+  ent->ndepends = j - ce->depends;
+  if (ent->ndepends)
+    {
+      ent->depends =
+	(struct prelink_entry **)
+	malloc (ent->ndepends * sizeof (struct prelink_entry *));
+      if (ent->depends == NULL)
+	error (EXIT_FAILURE, ENOMEM, "Cannot read cache file %s",
+	       prelink_cache);
+
+      for (j = 0; j < ent->ndepends; ++j)
+	ent->depends[j] = cache_ents[cache_deps[ce->depends + j]];
+    }
+  return ent;
+}
+
+/* Look FILENAME up in the cache's filename index.  */
+static void
+prelink_cache_find_filename (const char *filename)
+{
+  uint32_t mask = cache_map->nhash - 1, h, v;
+  const char *name;
+
+  for (h = string_hash (filename) & mask;
+       (v = cache_filename_hash[h]) != 0; h = (h + 1) & mask)
+    if (v != PRELINK_CACHE_DELETED && v <= cache_map->nlibs
+	&& (name = prelink_cache_filename (v - 1)) != NULL
+	&& strcmp (name, filename) == 0)
+      {
+	prelink_cache_load (v - 1, NULL);
+	return;
+      }
 }
 
+/* Look the file described by STP up in the cache's dev/ino index.  */
+static void
+prelink_cache_find_devino (const struct stat64 *stp)
+{
+  uint32_t mask = cache_map->nhash - 1, h, v;
+
+  for (h = devino_hash_1 (stp->st_dev, stp->st_ino) & mask;
+       (v = cache_devino_hash[h]) != 0; h = (h + 1) & mask)
+    if (v != PRELINK_CACHE_DELETED && v <= cache_map->nlibs
+	&& cache_map->entry[v - 1].dev == stp->st_dev
+	&& cache_map->entry[v - 1].ino == stp->st_ino)
+      {
+	prelink_cache_load (v - 1, S_ISREG (stp->st_mode) ? stp : NULL);
+	return;
+      }
+}
+
+/* Return non-zero if in quick mode the cache has an entry for the
+   file described by STP which looks unchanged.  Unlike
+   prelink_find_entry this only reads the mapped cache, so it can be
+   called from the gather_object worker threads.  */
 int
-prelink_load_cache (void)
+prelink_cache_unchanged_p (const struct stat64 *stp)
 {
-  int fd, i, j;
-  struct stat64 st;
+  struct prelink_cache_entry *ce;
+  uint32_t mask, h, v;
+
+  if (cache_map == NULL || ! quick)
+    return 0;
+
+  mask = cache_map->nhash - 1;
+  for (h = devino_hash_1 (stp->st_dev, stp->st_ino) & mask;
+       (v = cache_devino_hash[h]) != 0; h = (h + 1) & mask)
+    if (v != PRELINK_CACHE_DELETED && v <= cache_map->nlibs
+	&& cache_map->entry[v - 1].dev == stp->st_dev
+	&& cache_map->entry[v - 1].ino == stp->st_ino)
+      {
+	ce = &cache_map->entry[v - 1];
+	return ce->ctime == (uint32_t) stp->st_ctime
+	       && ce->mtime == (uint32_t) stp->st_mtime
+	       && (ce->ctime != ce->mtime || ce->flags == PCF_UNPRELINKABLE);
+      }
+  return 0;
+}
+
+/* Map the cache file and check its header.  Return NULL if there
+   is no cache or it is in the old format.  Otherwise *FDP is the
+   file descriptor holding a shared lock on the cache, which must stay
+   open as long as the cache is mapped.  */
+static struct prelink_cache *
+prelink_map_cache (struct stat64 *stp, int *fdp)
+{
+  int fd;
   struct prelink_cache *cache;
-  struct prelink_entry **ents;
   size_t cache_size;
-  uint32_t string_start, *dep;
+  uint64_t end, hash_size;
 
-  fd = open (prelink_cache, O_RDONLY);
+  fd = open (prelink_cache, O_RDONLY | O_CLOEXEC);
   if (fd < 0)
-    return 0; /* The cache does not exist yet.  */
+    return NULL; /* The cache does not exist yet.  */
 
-  if (fstat64 (fd, &st) < 0
-      || st.st_size == 0)
+  /* Wait for anybody patching the cache in place.  If locking is not
+     supported, prelink_cache_patch won't patch it either.  */
+  while (flock (fd, LOCK_SH) < 0 && errno == EINTR)
+    ;
+
+  if (fstat64 (fd, stp) < 0
+      || stp->st_size == 0)
     {
       close (fd);
-      return 0;
+      return NULL;
     }
 
-  cache = mmap (0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  cache = mmap (0, stp->st_size, PROT_READ, MAP_SHARED, fd, 0);
   if (cache == MAP_FAILED)
     error (EXIT_FAILURE, errno, "mmap of prelink cache file failed.");
-  cache_size = st.st_size;
-  if (memcmp (cache->magic, PRELINK_CACHE_MAGIC,
-	      sizeof (PRELINK_CACHE_MAGIC) - 1))
+  *fdp = fd;
+  cache_size = stp->st_size;
+  if (cache_size < sizeof (PRELINK_CACHE_MAGIC) - 1
+      || memcmp (cache->magic, PRELINK_CACHE_MAGIC,
+		 sizeof (PRELINK_CACHE_MAGIC) - 1))
     {
-      if (memcmp (cache->magic, PRELINK_CACHE_NAME,
-		  sizeof (PRELINK_CACHE_NAME) - 1))
+      if (cache_size < sizeof (PRELINK_CACHE_NAME) - 1
+	  || memcmp (cache->magic, PRELINK_CACHE_NAME,
+		     sizeof (PRELINK_CACHE_NAME) - 1))
 	error (EXIT_FAILURE, 0, "%s: is not prelink cache file",
 	       prelink_cache);
       munmap (cache, cache_size);
-      return 0;
-    }
-  dep = (uint32_t *) & cache->entry[cache->nlibs];
-  string_start = ((long) dep) - ((long) cache)
-		 + cache->ndeps * sizeof (uint32_t);
-  ents = (struct prelink_entry **)
-	 alloca (cache->nlibs * sizeof (struct prelink_entry *));
-  memset (ents, 0, cache->nlibs * sizeof (struct prelink_entry *));
-  for (i = 0; i < cache->nlibs; i++)
-    {
-      /* Sanity checks.  */
-      if (cache->entry[i].filename < string_start
-	  || cache->entry[i].filename >= string_start + cache->len_strings
-	  || cache->entry[i].depends >= cache->ndeps)
-	error (EXIT_FAILURE, 0, "%s: bogus prelink cache file",
-	       prelink_cache);
-
-      ents[i] = prelink_load_entry (((char *) cache)
-				    + cache->entry[i].filename);
+      close (fd);
+      return NULL;
     }
 
-  for (i = 0; i < cache->nlibs; i++)
-    {
-      if (ents[i] == NULL)
-	continue;
-
-      if (ents[i]->type != ET_NONE)
-	continue;
-
-      ents[i]->checksum = cache->entry[i].checksum;
-      ents[i]->base = cache->entry[i].base;
-      ents[i]->end = cache->entry[i].end;
-      ents[i]->type = (ents[i]->base == 0 && ents[i]->end == 0)
-		      ? ET_CACHE_EXEC : ET_CACHE_DYN;
-      ents[i]->flags = cache->entry[i].flags;
-
-      if (ents[i]->flags == PCF_UNPRELINKABLE)
-	ents[i]->type = (quick || print_cache) ? ET_UNPRELINKABLE : ET_NONE;
-
-      /* If mtime is equal to ctime, assume the filesystem does not store
-	 ctime.  */
-      if (quick
-	  && ((ents[i]->ctime == ents[i]->mtime
-	       && ents[i]->type != ET_UNPRELINKABLE)
-	      || ents[i]->ctime != cache->entry[i].ctime
-	      || ents[i]->mtime != cache->entry[i].mtime))
-	ents[i]->type = ET_NONE;
-
-      for (j = cache->entry[i].depends; dep[j] != i; ++j)
-	if (dep[j] >= cache->nlibs)
-	  error (EXIT_FAILURE, 0, "%s: bogus prelink cache file",
-		 prelink_cache);
-	else if (ents[dep[j]] == NULL)
-	  ents[i]->type = ET_NONE;
-
-      if (ents[i]->type == ET_NONE)
-	continue;
+  end = sizeof (struct prelink_cache)
+	+ (uint64_t) cache->nlibs * sizeof (struct prelink_cache_entry)
+	+ (uint64_t) cache->ndeps * sizeof (uint32_t) + cache->len_strings;
+  hash_size = (uint64_t) cache->nhash * sizeof (uint32_t);
+  if (cache_size < sizeof (struct prelink_cache)
+      || end > cache_size
+      || cache->nhash <= cache->nlibs
+      || (cache->nhash & (cache->nhash - 1)) != 0
+      || ((cache->filename_hash | cache->devino_hash) & 3) != 0
+      || cache->filename_hash < end
+      || cache->filename_hash + hash_size > cache_size
+      || cache->devino_hash < end
+      || cache->devino_hash + hash_size > cache_size)
+    error (EXIT_FAILURE, 0, "%s: bogus prelink cache file", prelink_cache);
+  return cache;
+}
 
-      ents[i]->ndepends = j - cache->entry[i].depends;
-      if (ents[i]->ndepends)
-	{
-	  ents[i]->depends =
-	    (struct prelink_entry **)
-	    malloc (ents[i]->ndepends * sizeof (struct prelink_entry *));
-	  if (ents[i]->depends == NULL)
-	    error (EXIT_FAILURE, ENOMEM, "Cannot read cache file %s",
-		   prelink_cache);
-
-	  for (j = 0; j < ents[i]->ndepends; ++j)
-	    ents[i]->depends[j] = ents[dep[cache->entry[i].depends + j]];
-	}
-    }
+/* Return the base address the cache recorded for library FILENAME,
+   or 0.  Unlike prelink_find_entry this doesn't load the entry, so it
+   also works for files replaced since they were cached, and with -a,
+   when the cache is otherwise not used, it maps the cache just for
+   this.  */
+GElf_Addr
+prelink_cache_base (const char *filename)
+{
+  static struct prelink_cache *bases;
+  static int bases_tried, bases_fd;
+  struct prelink_cache *c = cache_map;
+  struct stat64 st;
+  uint32_t *hash, mask, h, v, start, off;
 
-  if (quick)
+  if (c == NULL)
     {
-      qsort (ents, cache->nlibs, sizeof (struct prelink_entry *), deps_cmp);
-      for (i = 0; i < cache->nlibs; ++i)
+      if (! bases_tried)
 	{
-	  if (ents[i] == NULL || ents[i]->type == ET_NONE)
-	    continue;
-
-	  for (j = 0; j < ents[i]->ndepends; ++j)
-	    if (ents[i]->depends[j]->type == ET_NONE)
-	      {
-		ents[i]->type = ET_NONE;
-		free (ents[i]->depends);
-		ents[i]->depends = NULL;
-		ents[i]->ndepends = 0;
-		break;
-	      }
+	  bases_tried = 1;
+	  bases = prelink_map_cache (&st, &bases_fd);
 	}
+      c = bases;
+      if (c == NULL)
+	return 0;
     }
 
-  munmap (cache, cache_size);
-  close (fd);
+  hash = (uint32_t *) ((char *) c + c->filename_hash);
+  start = (char *) &((uint32_t *) &c->entry[c->nlibs])[c->ndeps] - (char *) c;
+  mask = c->nhash - 1;
+  for (h = string_hash (filename) & mask; (v = hash[h]) != 0;
+       h = (h + 1) & mask)
+    if (v != PRELINK_CACHE_DELETED && v <= c->nlibs)
+      {
+	off = c->entry[v - 1].filename;
+	if (off >= start && off < start + c->len_strings
+	    && memchr ((char *) c + off, '\0',
+		       start + c->len_strings - off) != NULL
+	    && strcmp ((char *) c + off, filename) == 0)
+	  return c->entry[v - 1].base;
+      }
+  return 0;
+}
+
+int
+prelink_load_cache (void)
+{
+  uint32_t i;
+  struct stat64 st;
+  struct prelink_cache *cache;
+
+  cache = prelink_map_cache (&st, &cache_map_fd);
+  if (cache == NULL)
+    return 0;
+
+  cache_map = cache;
+  cache_map_dev = st.st_dev;
+  cache_map_ino = st.st_ino;
+  cache_deps = (uint32_t *) &cache->entry[cache->nlibs];
+  cache_string_start = (char *) &cache_deps[cache->ndeps] - (char *) cache;
+  cache_filename_hash = (uint32_t *) ((char *) cache + cache->filename_hash);
+  cache_devino_hash = (uint32_t *) ((char *) cache + cache->devino_hash);
+  cache_ents = (struct prelink_entry **)
+	       calloc (cache->nlibs, sizeof (struct prelink_entry *));
+  cache_tried = (char *) calloc (cache->nlibs, 1);
+  if (cache->nlibs && (cache_ents == NULL || cache_tried == NULL))
+    error (EXIT_FAILURE, ENOMEM, "Cannot read cache file %s",
+	   prelink_cache);
+
+  /* In quick mode, executables are only looked at if gathering
+     finds them.  Libraries are needed by layout_libs even then.  */
+  for (i = 0; i < cache->nlibs; i++)
+    if (! quick || cache->entry[i].end != 0)
+      prelink_cache_load (i, NULL);
+
   return 0;
 }
 
@@ -547,9 +776,7 @@ prelink_print_cache (void)
 struct collect_ents
 {
   struct prelink_entry **ents;
-  size_t len_strings;
   int nents;
-  int ndeps;
 };
 
 static int
@@ -594,86 +821,208 @@ find_ents (void **p, void *info)
 	  && ! prelink_save_cache_check (e)))
     {
       l->ents[l->nents++] = e;
-      l->ndeps += e->ndepends + 1;
-      l->len_strings += strlen (e->canon_filename) + 1;
+      e->cache_idx = PRELINK_CACHE_DELETED;
     }
   return 1;
 }
 
-int
-prelink_save_cache (int do_warn)
+/* Decide whether cache entry I, which nothing looked at during this
+   run, can be copied to the new cache.  KEEP[I] is 1 while being
+   decided, 2 if it can be kept and 3 if not.  Dependency cycles are
+   dropped.  */
+static int
+prelink_cache_keep (uint32_t i, char *keep)
 {
-  struct prelink_cache cache;
-  struct collect_ents l;
-  struct prelink_cache_entry *data;
-  uint32_t *deps, ndeps = 0, i, j, k;
-  char *strings;
-  int fd, len;
-  struct prelink_entry *ents_array[prelink_entry_count];
+  struct prelink_cache_entry *ce = &cache_map->entry[i];
+  struct prelink_entry *dep;
+  struct stat64 st;
+  uint32_t j, d;
+
+  if (keep[i])
+    return keep[i] == 2;
+  keep[i] = 1;
+
+  if (! prelink_cache_entry_ok (i)
+      || (ce->ctime == ce->mtime && ce->flags != PCF_UNPRELINKABLE)
+      || stat64 ((char *) cache_map + ce->filename, &st) < 0
+      || ! S_ISREG (st.st_mode)
+      || st.st_dev != ce->dev || st.st_ino != ce->ino
+      || (uint32_t) st.st_ctime != ce->ctime
+      || (uint32_t) st.st_mtime != ce->mtime)
+    goto drop;
+
+  for (j = ce->depends; (d = cache_deps[j]) != i; ++j)
+    {
+      if (cache_map->entry[d].flags == PCF_UNPRELINKABLE
+	  && ce->flags != PCF_UNPRELINKABLE)
+	goto drop;
+      if (! cache_tried[d])
+	{
+	  if (! prelink_cache_keep (d, keep))
+	    goto drop;
+	  continue;
+	}
+      dep = cache_ents[d];
+      if (dep == NULL || dep->cache_idx == 0
+	  || dep->checksum != cache_map->entry[d].checksum
+	  || (dep->type == ET_UNPRELINKABLE
+	      && ce->flags != PCF_UNPRELINKABLE))
+	goto drop;
+    }
+  keep[i] = 2;
+  return 1;
 
-  memset (&cache, 0, sizeof (cache));
-  memcpy ((char *) & cache, PRELINK_CACHE_MAGIC,
-	  sizeof (PRELINK_CACHE_MAGIC) - 1);
-  l.ents = ents_array;
-  l.nents = 0;
-  l.ndeps = 0;
-  l.len_strings = 0;
-  htab_traverse (prelink_filename_htab, find_ents, &l);
-  cache.nlibs = l.nents;
-  cache.ndeps = l.ndeps;
-  cache.len_strings = l.len_strings;
+drop:
+  keep[i] = 3;
+  return 0;
+}
+
+static void
+prelink_cache_hash_insert (uint32_t *table, uint32_t nhash, hashval_t hash,
+			   uint32_t v)
+{
+  uint32_t h;
 
-  len = cache.nlibs * sizeof (struct prelink_cache_entry)
-	+ cache.ndeps * sizeof (uint32_t) + cache.len_strings;
-  char data_buf[len];
-  data = (struct prelink_cache_entry *) data_buf;
-  deps = (uint32_t *) & data[cache.nlibs];
-  strings = (char *) & deps[cache.ndeps];
+  for (h = hash & (nhash - 1);
+       table[h] != 0 && table[h] != PRELINK_CACHE_DELETED;
+       h = (h + 1) & (nhash - 1))
+    ;
+  table[h] = v;
+}
 
-  for (i = 0; i < l.nents; ++i)
+/* Try to update the mapped cache file in place to contain NLIBS
+   entries DATA with depends DEPS and strings STRINGS.  Return 0 if
+   done, 1 if the file needs to be written anew.  The file is either
+   patched completely or left as it was.  */
+static int
+prelink_cache_patch (struct prelink_cache *cache,
+		     struct prelink_cache_entry *data, uint32_t *deps,
+		     char *strings)
+{
+  uint32_t *devino_hash = NULL, i, first, last, h, nempty;
+  size_t len, hash_len;
+  off_t off;
+  char *saved = NULL;
+  struct stat64 st;
+  int fd = -1, changed = 0;
+
+  if (cache_map == NULL
+      || cache->nlibs != cache_map->nlibs
+      || cache->ndeps != cache_map->ndeps
+      || cache->len_strings != cache_map->len_strings
+      || memcmp (deps, cache_deps, cache->ndeps * sizeof (uint32_t))
+      || memcmp (strings, (char *) cache_map + cache_string_start,
+		 cache->len_strings))
+    return 1;
+
+  for (i = 0; i < cache->nlibs; ++i)
+    if (memcmp (&data[i], &cache_map->entry[i], sizeof (data[i])))
+      break;
+  if (i == cache->nlibs)
+    return 0;
+
+  /* Readers in other prelink processes hold shared locks for as long
+     as they have the cache mapped.  Only patch it if there are none,
+     otherwise write a new file, which they won't see.  */
+  if (flock (cache_map_fd, LOCK_EX | LOCK_NB) < 0)
     {
-      data[i].filename = (strings - (char *) data) + sizeof (cache);
-      strings = stpcpy (strings, l.ents[i]->canon_filename) + 1;
-      data[i].checksum = l.ents[i]->checksum;
-      data[i].flags = l.ents[i]->flags & ~PCF_PRELINKED;
-      data[i].ctime = l.ents[i]->ctime;
-      data[i].mtime = l.ents[i]->mtime;
-      if (l.ents[i]->type == ET_EXEC || l.ents[i]->type == ET_CACHE_EXEC)
-	{
-	  data[i].base = 0;
-	  data[i].end = 0;
-	}
-      else if (l.ents[i]->type == ET_UNPRELINKABLE)
-	{
-	  data[i].base = 0;
-	  data[i].end = 0;
-	  data[i].checksum = 0;
-	  data[i].flags = PCF_UNPRELINKABLE;
-	}
-      else
-	{
-	  data[i].base = l.ents[i]->base;
-	  data[i].end = l.ents[i]->end;
-	}
+      /* A failed conversion drops the shared lock too.  */
+      flock (cache_map_fd, LOCK_SH);
+      return 1;
     }
 
-  for (i = 0; i < cache.nlibs; i++)
+  fd = open (prelink_cache, O_RDWR);
+  if (fd < 0
+      || fstat64 (fd, &st) < 0
+      || st.st_dev != cache_map_dev || st.st_ino != cache_map_ino)
+    goto out;
+
+  hash_len = cache_map->nhash * sizeof (uint32_t);
+  devino_hash = malloc (hash_len);
+  if (devino_hash == NULL)
+    goto out;
+  memcpy (devino_hash, cache_devino_hash, hash_len);
+
+  /* Update the dev/ino index first, so that nothing is written if
+     the patch can't be done.  */
+  for (first = last = i; i < cache->nlibs; ++i)
     {
-      data[i].depends = ndeps;
-      for (j = 0; j < l.ents[i]->ndepends; j++)
+      struct prelink_cache_entry *ce = &cache_map->entry[i];
+
+      if (memcmp (&data[i], ce, sizeof (data[i])) == 0)
+	continue;
+
+      last = i;
+      if (data[i].dev != ce->dev || data[i].ino != ce->ino)
 	{
-	  for (k = 0; k < cache.nlibs; k++)
-	    if (l.ents[k] == l.ents[i]->depends[j])
-	      break;
-	  if (k == cache.nlibs)
-	    abort ();
-	  deps[ndeps++] = k;
+	  for (h = devino_hash_1 (ce->dev, ce->ino) & (cache_map->nhash - 1);
+	       devino_hash[h] != 0 && devino_hash[h] != i + 1;
+	       h = (h + 1) & (cache_map->nhash - 1))
+	    ;
+	  if (devino_hash[h] == 0)
+	    goto out;
+	  devino_hash[h] = PRELINK_CACHE_DELETED;
+	  prelink_cache_hash_insert (devino_hash, cache_map->nhash,
+				     devino_hash_1 (data[i].dev, data[i].ino),
+				     i + 1);
+	  changed = 1;
 	}
-      deps[ndeps++] = i;
     }
 
+  /* Rewrite the file if deleted slots make lookups too slow.  */
+  for (h = 0, nempty = 0; h < cache_map->nhash; ++h)
+    if (devino_hash[h] == 0)
+      ++nempty;
+  if (nempty < cache_map->nhash / 4)
+    goto out;
+
+  /* The writes below go through to the shared mapping, so save what
+     they overwrite to be able to put it back if one of them fails.  */
+  len = (last + 1 - first) * sizeof (data[0]);
+  off = (char *) &cache_map->entry[first] - (char *) cache_map;
+  saved = malloc (len + hash_len);
+  if (saved == NULL)
+    goto out;
+  memcpy (saved, &cache_map->entry[first], len);
+  memcpy (saved + len, cache_devino_hash, hash_len);
+
+  if (pwrite (fd, &data[first], len, off) != len
+      || (changed
+	  && pwrite (fd, devino_hash, hash_len, cache_map->devino_hash)
+	     != hash_len)
+      || fsync (fd))
+    {
+      pwrite (fd, saved, len, off);
+      if (changed)
+	pwrite (fd, saved + len, hash_len, cache_map->devino_hash);
+      goto out;
+    }
+  if (close (fd))
+    {
+      fd = -1;
+      goto out;
+    }
+  flock (cache_map_fd, LOCK_SH);
+  free (devino_hash);
+  free (saved);
+  return 0;
+
+out:
+  if (fd >= 0)
+    close (fd);
+  flock (cache_map_fd, LOCK_SH);
+  free (devino_hash);
+  free (saved);
+  return 1;
+}
+
+static int
+prelink_cache_write (struct prelink_cache *cache, char *data, size_t len)
+{
+  int fd;
   size_t prelink_cache_len = strlen (prelink_cache);
   char prelink_cache_tmp [prelink_cache_len + sizeof (".XXXXXX")];
+
   memcpy (mempcpy (prelink_cache_tmp, prelink_cache, prelink_cache_len),
 	  ".XXXXXX", sizeof (".XXXXXX"));
   fd = mkstemp (prelink_cache_tmp);
@@ -683,7 +1032,7 @@ prelink_save_cache (int do_warn)
       return 1;
     }
 
-  if (write (fd, &cache, sizeof (cache)) != sizeof (cache)
+  if (write (fd, cache, sizeof (*cache)) != sizeof (*cache)
       || write (fd, data, len) != len
       || fchmod (fd, 0644)
       || fsync (fd)
@@ -697,6 +1046,197 @@ prelink_save_cache (int do_warn)
   return 0;
 }
 
+int
+prelink_save_cache (int do_warn)
+{
+  struct prelink_cache cache, *old = cache_map;
+  struct collect_ents l;
+  struct prelink_cache_entry *data;
+  uint32_t *deps, *filename_hash, *devino_hash, *old2new = NULL, *src_old;
+  uint32_t ndeps = 0, nlibs = 0, nhash, i, j, k;
+  char *strings, *buf, *keep = NULL;
+  int ret = 1;
+  size_t len, len_strings = 0, string_start;
+  struct prelink_entry **src;
+  struct prelink_entry *ents_array[prelink_entry_count];
+
+  memset (&cache, 0, sizeof (cache));
+  memcpy ((char *) & cache, PRELINK_CACHE_MAGIC,
+	  sizeof (PRELINK_CACHE_MAGIC) - 1);
+  l.ents = ents_array;
+  l.nents = 0;
+  htab_traverse (prelink_filename_htab, find_ents, &l);
+
+  /* Entries of the old cache keep their order, so that the file
+     can be patched in place if nothing else changed.  */
+  k = l.nents + (old ? old->nlibs : 0);
+  src = (struct prelink_entry **) calloc (k ?: 1, sizeof (*src));
+  src_old = (uint32_t *) calloc (k ?: 1, sizeof (uint32_t));
+  if (old)
+    {
+      old2new = (uint32_t *) calloc (old->nlibs ?: 1, sizeof (uint32_t));
+      keep = (char *) calloc (old->nlibs ?: 1, 1);
+    }
+  if (src == NULL || src_old == NULL
+      || (old && (old2new == NULL || keep == NULL)))
+    {
+      error (0, ENOMEM, "Could not write prelink cache");
+      goto out;
+    }
+
+  for (i = 0; old && i < old->nlibs; ++i)
+    {
+      struct prelink_entry *ent = cache_tried[i] ? cache_ents[i] : NULL;
+
+      if (ent != NULL && ent->cache_idx == PRELINK_CACHE_DELETED)
+	{
+	  src[nlibs] = ent;
+	  ent->cache_idx = ++nlibs;
+	  old2new[i] = nlibs;
+	}
+      else if (! cache_tried[i] && prelink_cache_keep (i, keep))
+	{
+	  src_old[nlibs] = i;
+	  old2new[i] = ++nlibs;
+	}
+    }
+  for (i = 0; i < l.nents; ++i)
+    if (l.ents[i]->cache_idx == PRELINK_CACHE_DELETED)
+      {
+	src[nlibs] = l.ents[i];
+	l.ents[i]->cache_idx = ++nlibs;
+      }
+
+  for (i = 0; i < nlibs; ++i)
+    if (src[i])
+      {
+	ndeps += src[i]->ndepends + 1;
+	len_strings += strlen (src[i]->canon_filename) + 1;
+      }
+    else
+      {
+	struct prelink_cache_entry *ce = &old->entry[src_old[i]];
+
+	for (j = ce->depends; cache_deps[j] != src_old[i]; ++j)
+	  ++ndeps;
+	++ndeps;
+	len_strings += strlen ((char *) old + ce->filename) + 1;
+      }
+  len_strings = (len_strings + 3) & ~3;
+
+  for (nhash = 16; nhash < 2 * nlibs; nhash *= 2)
+    ;
+  cache.nlibs = nlibs;
+  cache.ndeps = ndeps;
+  cache.len_strings = len_strings;
+  cache.nhash = nhash;
+  string_start = sizeof (cache) + nlibs * sizeof (struct prelink_cache_entry)
+		 + ndeps * sizeof (uint32_t);
+  cache.filename_hash = string_start + len_strings;
+  cache.devino_hash = cache.filename_hash + nhash * sizeof (uint32_t);
+  len = cache.devino_hash + nhash * sizeof (uint32_t) - sizeof (cache);
+
+  buf = calloc (len, 1);
+  if (buf == NULL)
+    {
+      error (0, ENOMEM, "Could not write prelink cache");
+      goto out;
+    }
+  data = (struct prelink_cache_entry *) buf;
+  deps = (uint32_t *) & data[nlibs];
+  strings = (char *) & deps[ndeps];
+  filename_hash = (uint32_t *) (strings + len_strings);
+  devino_hash = filename_hash + nhash;
+
+  ndeps = 0;
+  for (i = 0; i < nlibs; ++i)
+    {
+      struct prelink_entry *ent = src[i];
+      const char *filename;
+
+      data[i].filename = (strings - (char *) data) + sizeof (cache);
+      data[i].depends = ndeps;
+      if (ent == NULL)
+	{
+	  struct prelink_cache_entry *ce = &old->entry[src_old[i]];
+
+	  filename = (char *) old + ce->filename;
+	  data[i].checksum = ce->checksum;
+	  data[i].flags = ce->flags;
+	  data[i].ctime = ce->ctime;
+	  data[i].mtime = ce->mtime;
+	  data[i].base = ce->base;
+	  data[i].end = ce->end;
+	  data[i].dev = ce->dev;
+	  data[i].ino = ce->ino;
+	  for (j = ce->depends; (k = cache_deps[j]) != src_old[i]; ++j)
+	    deps[ndeps++] = (cache_tried[k] ? cache_ents[k]->cache_idx
+			     : old2new[k]) - 1;
+	}
+      else
+	{
+	  filename = ent->canon_filename;
+	  data[i].checksum = ent->checksum;
+	  data[i].flags = ent->flags & ~PCF_PRELINKED;
+	  data[i].ctime = ent->ctime;
+	  data[i].mtime = ent->mtime;
+	  data[i].dev = ent->dev;
+	  data[i].ino = ent->ino;
+	  if (ent->type == ET_EXEC || ent->type == ET_CACHE_EXEC)
+	    {
+	      data[i].base = 0;
+	      data[i].end = 0;
+	    }
+	  else if (ent->type == ET_UNPRELINKABLE)
+	    {
+	      data[i].base = 0;
+	      data[i].end = 0;
+	      data[i].checksum = 0;
+	      data[i].flags = PCF_UNPRELINKABLE;
+	    }
+	  else
+	    {
+	      data[i].base = ent->base;
+	      data[i].end = ent->end;
+	    }
+	  for (j = 0; j < ent->ndepends; j++)
+	    {
+	      if (ent->depends[j]->cache_idx == 0
+		  || ent->depends[j]->cache_idx == PRELINK_CACHE_DELETED)
+		abort ();
+	      deps[ndeps++] = ent->depends[j]->cache_idx - 1;
+	    }
+	}
+      deps[ndeps++] = i;
+      strings = stpcpy (strings, filename) + 1;
+      data[i].crc = prelink_cache_crc (&data[i], deps + data[i].depends,
+				       ndeps - data[i].depends, filename);
+      prelink_cache_hash_insert (filename_hash, nhash,
+				 string_hash (filename), i + 1);
+      prelink_cache_hash_insert (devino_hash, nhash,
+				 devino_hash_1 (data[i].dev, data[i].ino),
+				 i + 1);
+    }
+
+  strings = (char *) & deps[ndeps];
+  if (prelink_cache_patch (&cache, data, deps, strings) == 0)
+    {
+      ret = 0;
+      goto out_free;
+    }
+
+  ret = prelink_cache_write (&cache, buf, len);
+
+out_free:
+  free (buf);
+out:
+  free (src);
+  free (src_old);
+  free (old2new);
+  free (keep);
+  return ret;
+}
+
 #ifndef NDEBUG
 static void
 prelink_entry_dumpfn (FILE *f, const void *ptr)
@@ -29,6 +29,74 @@
 #include "reloc.h"
 #include "reloc-info.h"
 
+/* Return the conflict against symbol at SYMOFF with RELOC_CLASS
+   in CONFLICTS, or NULL.  */
+struct prelink_conflict *
+prelink_conflict_find (struct prelink_conflicts *conflicts,
+		       GElf_Addr symoff, int reloc_class)
+{
+  struct prelink_conflict *conflict;
+  size_t idx;
+
+  if (conflicts->hash == NULL)
+    return NULL;
+
+  for (idx = conflict_hash (symoff * 16 + reloc_class, conflicts->hash_size);
+       (conflict = conflicts->hash[idx]) != NULL;
+       idx = (idx + 1) & (conflicts->hash_size - 1))
+    if (conflict->symoff == symoff && conflict->reloc_class == reloc_class)
+      return conflict;
+
+  return NULL;
+}
+
+/* Add CONFLICT, which must not be present yet, to CONFLICTS.
+   The hash table is kept at most half full, its memory comes from
+   INFO's arena.  */
+int
+prelink_conflict_insert (struct prelink_info *info,
+			 struct prelink_conflicts *conflicts,
+			 struct prelink_conflict *conflict)
+{
+  size_t idx;
+
+  conflict->next = conflicts->first;
+  conflicts->first = conflict;
+  ++conflicts->count;
+
+  if (2 * conflicts->count > conflicts->hash_size)
+    {
+      struct prelink_conflict *c;
+      size_t size = conflicts->hash_size ? 2 * conflicts->hash_size : 32;
+
+      conflicts->hash = arena_alloc (&info->arena,
+				     size * sizeof (struct prelink_conflict *));
+      if (conflicts->hash == NULL)
+	{
+	  error (0, ENOMEM, "Cannot build list of conflicts");
+	  return 1;
+	}
+      memset (conflicts->hash, 0, size * sizeof (struct prelink_conflict *));
+      conflicts->hash_size = size;
+      for (c = conflicts->first; c; c = c->next)
+	{
+	  for (idx = conflict_hash (c->symoff * 16 + c->reloc_class, size);
+	       conflicts->hash[idx] != NULL; idx = (idx + 1) & (size - 1))
+	    ;
+	  conflicts->hash[idx] = c;
+	}
+      return 0;
+    }
+
+  for (idx = conflict_hash (conflict->symoff * 16 + conflict->reloc_class,
+			    conflicts->hash_size);
+       conflicts->hash[idx] != NULL;
+       idx = (idx + 1) & (conflicts->hash_size - 1))
+    ;
+  conflicts->hash[idx] = conflict;
+  return 0;
+}
+
 struct prelink_conflict *
 prelink_conflict (struct prelink_info *info, GElf_Word r_sym,
 		  int reloc_type)
@@ -36,19 +104,11 @@ prelink_conflict (struct prelink_info *info, GElf_Word r_sym,
   GElf_Word symoff = info->symtab_start + r_sym * info->symtab_entsize;
   struct prelink_conflict *conflict;
   int reloc_class = info->dso->arch->reloc_class (reloc_type);
-  size_t idx = 0;
-
-  if (info->curconflicts->hash != &info->curconflicts->first)
-    idx = symoff % 251;
-  for (conflict = info->curconflicts->hash[idx]; conflict;
-       conflict = conflict->next)
-    if (conflict->symoff == symoff && conflict->reloc_class == reloc_class)
-      {
-	conflict->used = 1;
-	return conflict;
-      }
 
-  return NULL;
+  conflict = prelink_conflict_find (info->curconflicts, symoff, reloc_class);
+  if (conflict != NULL)
+    conflict->used = 1;
+  return conflict;
 }
 
 GElf_Rela *
@@ -58,15 +118,20 @@ prelink_conflict_add_rela (struct prelink_info *info)
 
   if (info->conflict_rela_alloced == info->conflict_rela_size)
     {
-      info->conflict_rela_alloced += 10;
-      info->conflict_rela = realloc (info->conflict_rela,
-				     info->conflict_rela_alloced
-				     * sizeof (GElf_Rela));
-      if (info->conflict_rela == NULL)
+      size_t alloced = 2 * info->conflict_rela_alloced + 16;
+      GElf_Rela *conflict_rela;
+
+      conflict_rela = arena_alloc (&info->arena, alloced * sizeof (GElf_Rela));
+      if (conflict_rela == NULL)
 	{
 	  error (0, ENOMEM, "Could not build .gnu.conflict section memory image");
 	  return NULL;
 	}
+      if (info->conflict_rela_size)
+	memcpy (conflict_rela, info->conflict_rela,
+		info->conflict_rela_size * sizeof (GElf_Rela));
+      info->conflict_rela = conflict_rela;
+      info->conflict_rela_alloced = alloced;
     }
   ret = info->conflict_rela + info->conflict_rela_size++;
   ret->r_offset = 0;
@@ -463,7 +528,7 @@ prelink_build_conflicts (struct prelink_info *info)
   for (i = 1; i < ndeps; ++i)
     {
       ent = info->ent->depends[i - 1];
-      if ((dso = open_dso (ent->filename)) == NULL)
+      if ((dso = borrow_dso (ent)) == NULL)
 	goto error_out;
       info->dsos[i] = dso;
       /* Now check that the DSO matches what we recorded about it.  */
@@ -479,7 +544,7 @@ prelink_build_conflicts (struct prelink_info *info)
 
   for (i = 0; i < ndeps; ++i)
     {
-      int j, sec, first_conflict, maxidx;
+      int j, sec, first_conflict;
       struct prelink_conflict *conflict;
 
       dso = info->dsos[i];
@@ -595,18 +660,14 @@ prelink_build_conflicts (struct prelink_info *info)
 	  && dso->arch->arch_prelink_conflict (dso, info))
 	goto error_out;
 
-      maxidx = 1;
-      if (info->curconflicts->hash != &info->curconflicts->first)
-	maxidx = 251;
-      for (j = 0; j < maxidx; j++)
-	for (conflict = info->curconflicts->hash[j]; conflict;
-	     conflict = conflict->next)
-	  if (! conflict->used && (i || conflict->ifunc))
-	    {
-	      error (0, 0, "%s: Conflict %08llx (%s) not found in any relocation",
-		     dso->filename, (unsigned long long) conflict->symoff, conflict->symname);
-	      ret = 1;
-	    }
+      for (conflict = info->curconflicts->first; conflict;
+	   conflict = conflict->next)
+	if (! conflict->used && (i || conflict->ifunc))
+	  {
+	    error (0, 0, "%s: Conflict %08llx (%s) not found in any relocation",
+		   dso->filename, (unsigned long long) conflict->symoff, conflict->symname);
+	    ret = 1;
+	  }
 
       /* Record library's position in search scope into R_SYM field.  */
       for (j = first_conflict; j < info->conflict_rela_size; ++j)
@@ -813,7 +874,7 @@ prelink_build_conflicts (struct prelink_info *info)
 
   for (i = 1; i < ndeps; ++i)
     if (info->dsos[i])
-      close_dso (info->dsos[i]);
+      return_dso (info->dsos[i]);
 
   info->dsos = NULL;
   free (cr.rela);
@@ -827,6 +888,6 @@ error_out:
   info->sdynbss = NULL;
   for (i = 1; i < ndeps; ++i)
     if (info->dsos[i])
-      close_dso (info->dsos[i]);
+      return_dso (info->dsos[i]);
   return 1;
 }
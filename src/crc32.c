@@ -16,6 +16,7 @@
    Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.  */
 
 #include <config.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <sys/types.h>
 
@@ -76,12 +77,195 @@ static const uint32_t crc32_table[256] =
   0x2d02ef8d
 };
 
-uint32_t crc32 (uint32_t crc, unsigned char *buf, size_t len)
+/* crc32_slice[K][B] is the crc of byte B followed by K zero bytes,
+   crc32_slice[0] is crc32_table.  Filled in by crc32_init.  */
+static uint32_t crc32_slice[8][256];
+
+/* The implementation chosen by crc32_init.  crc32 can be called from
+   several threads, so crc32_init is run through pthread_once.  */
+static uint32_t (*crc32_fn) (uint32_t, unsigned char *, size_t);
+static pthread_once_t crc32_once = PTHREAD_ONCE_INIT;
+
+/* Byte at a time crc of BUF, CRC is the inverted running value.  */
+static inline uint32_t
+crc32_bytes (uint32_t crc, unsigned char *buf, size_t len)
 {
   unsigned char *end;
 
-  crc = ~crc;
   for (end = buf + len; buf < end; ++buf)
     crc = crc32_table[(crc ^ *buf) & 0xff] ^ (crc >> 8);
-  return ~crc;
+  return crc;
+}
+
+/* Slicing-by-8: fold 8 bytes at a time using 8 lookups into
+   crc32_slice.  The bytes are assembled explicitly, so this
+   works for any alignment and host byte order.  */
+static uint32_t
+crc32_slice8 (uint32_t crc, unsigned char *buf, size_t len)
+{
+  uint32_t one, two;
+
+  crc = ~crc;
+  while (len && ((uintptr_t) buf & 7))
+    {
+      crc = crc32_table[(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+      --len;
+    }
+  for (; len >= 8; len -= 8, buf += 8)
+    {
+      one = crc ^ (buf[0] | (buf[1] << 8) | (buf[2] << 16)
+		   | ((uint32_t) buf[3] << 24));
+      two = buf[4] | (buf[5] << 8) | (buf[6] << 16)
+	    | ((uint32_t) buf[7] << 24);
+      crc = crc32_slice[7][one & 0xff]
+	    ^ crc32_slice[6][(one >> 8) & 0xff]
+	    ^ crc32_slice[5][(one >> 16) & 0xff]
+	    ^ crc32_slice[4][one >> 24]
+	    ^ crc32_slice[3][two & 0xff]
+	    ^ crc32_slice[2][(two >> 8) & 0xff]
+	    ^ crc32_slice[1][(two >> 16) & 0xff]
+	    ^ crc32_slice[0][two >> 24];
+    }
+  return ~crc32_bytes (crc, buf, len);
+}
+
+#if defined __x86_64__ && defined __GNUC__ \
+    && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#include <immintrin.h>
+#define CRC32_PCLMUL 1
+
+/* Carry-less multiplication folding, as described in Intel's
+   "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ
+   Instruction".  The constants are x^(4*128+32), x^(4*128-32),
+   x^(128+32), x^(128-32), x^64 mod P and the Barrett reduction
+   constants, all bit-reflected.  Processes LEN & ~15 bytes,
+   LEN must be at least 64.  CRC is the inverted running value.  */
+__attribute__ ((target ("pclmul,sse4.1")))
+static uint32_t
+crc32_pclmul_fold (uint32_t crc, unsigned char *buf, size_t len)
+{
+  static const uint64_t k1k2[2] __attribute__ ((aligned (16)))
+    = { 0x0154442bd4ULL, 0x01c6e41596ULL };
+  static const uint64_t k3k4[2] __attribute__ ((aligned (16)))
+    = { 0x01751997d0ULL, 0x00ccaa009eULL };
+  static const uint64_t k5k0[2] __attribute__ ((aligned (16)))
+    = { 0x0163cd6124ULL, 0 };
+  static const uint64_t poly[2] __attribute__ ((aligned (16)))
+    = { 0x01db710641ULL, 0x01f7011641ULL };
+  __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+  x1 = _mm_loadu_si128 ((__m128i *) (buf + 0x00));
+  x2 = _mm_loadu_si128 ((__m128i *) (buf + 0x10));
+  x3 = _mm_loadu_si128 ((__m128i *) (buf + 0x20));
+  x4 = _mm_loadu_si128 ((__m128i *) (buf + 0x30));
+  x1 = _mm_xor_si128 (x1, _mm_cvtsi32_si128 (crc));
+  x0 = _mm_load_si128 ((__m128i *) k1k2);
+  buf += 64;
+  len -= 64;
+
+  /* Fold 4 x 128 bits in parallel.  */
+  while (len >= 64)
+    {
+      x5 = _mm_clmulepi64_si128 (x1, x0, 0x00);
+      x6 = _mm_clmulepi64_si128 (x2, x0, 0x00);
+      x7 = _mm_clmulepi64_si128 (x3, x0, 0x00);
+      x8 = _mm_clmulepi64_si128 (x4, x0, 0x00);
+      x1 = _mm_clmulepi64_si128 (x1, x0, 0x11);
+      x2 = _mm_clmulepi64_si128 (x2, x0, 0x11);
+      x3 = _mm_clmulepi64_si128 (x3, x0, 0x11);
+      x4 = _mm_clmulepi64_si128 (x4, x0, 0x11);
+      x1 = _mm_xor_si128 (_mm_xor_si128 (x1, x5),
+			  _mm_loadu_si128 ((__m128i *) (buf + 0x00)));
+      x2 = _mm_xor_si128 (_mm_xor_si128 (x2, x6),
+			  _mm_loadu_si128 ((__m128i *) (buf + 0x10)));
+      x3 = _mm_xor_si128 (_mm_xor_si128 (x3, x7),
+			  _mm_loadu_si128 ((__m128i *) (buf + 0x20)));
+      x4 = _mm_xor_si128 (_mm_xor_si128 (x4, x8),
+			  _mm_loadu_si128 ((__m128i *) (buf + 0x30)));
+      buf += 64;
+      len -= 64;
+    }
+
+  /* Fold into 128 bits.  */
+  x0 = _mm_load_si128 ((__m128i *) k3k4);
+  x5 = _mm_clmulepi64_si128 (x1, x0, 0x00);
+  x1 = _mm_clmulepi64_si128 (x1, x0, 0x11);
+  x1 = _mm_xor_si128 (_mm_xor_si128 (x1, x2), x5);
+  x5 = _mm_clmulepi64_si128 (x1, x0, 0x00);
+  x1 = _mm_clmulepi64_si128 (x1, x0, 0x11);
+  x1 = _mm_xor_si128 (_mm_xor_si128 (x1, x3), x5);
+  x5 = _mm_clmulepi64_si128 (x1, x0, 0x00);
+  x1 = _mm_clmulepi64_si128 (x1, x0, 0x11);
+  x1 = _mm_xor_si128 (_mm_xor_si128 (x1, x4), x5);
+
+  while (len >= 16)
+    {
+      x2 = _mm_loadu_si128 ((__m128i *) buf);
+      x5 = _mm_clmulepi64_si128 (x1, x0, 0x00);
+      x1 = _mm_clmulepi64_si128 (x1, x0, 0x11);
+      x1 = _mm_xor_si128 (_mm_xor_si128 (x1, x2), x5);
+      buf += 16;
+      len -= 16;
+    }
+
+  /* Fold 128 bits to 64 bits.  */
+  x2 = _mm_clmulepi64_si128 (x1, x0, 0x10);
+  x3 = _mm_setr_epi32 (~0, 0, ~0, 0);
+  x1 = _mm_xor_si128 (_mm_srli_si128 (x1, 8), x2);
+  x0 = _mm_loadl_epi64 ((__m128i *) k5k0);
+  x2 = _mm_srli_si128 (x1, 4);
+  x1 = _mm_and_si128 (x1, x3);
+  x1 = _mm_clmulepi64_si128 (x1, x0, 0x00);
+  x1 = _mm_xor_si128 (x1, x2);
+
+  /* Barrett reduce to 32 bits.  */
+  x0 = _mm_load_si128 ((__m128i *) poly);
+  x2 = _mm_and_si128 (x1, x3);
+  x2 = _mm_clmulepi64_si128 (x2, x0, 0x10);
+  x2 = _mm_and_si128 (x2, x3);
+  x2 = _mm_clmulepi64_si128 (x2, x0, 0x00);
+  x1 = _mm_xor_si128 (x1, x2);
+  return _mm_extract_epi32 (x1, 1);
+}
+
+static uint32_t
+crc32_pclmul (uint32_t crc, unsigned char *buf, size_t len)
+{
+  size_t n;
+
+  if (len < 64)
+    return crc32_slice8 (crc, buf, len);
+  n = len & ~(size_t) 15;
+  crc = crc32_pclmul_fold (~crc, buf, n);
+  return ~crc32_bytes (crc, buf + n, len - n);
+}
+#endif
+
+/* Compute the slicing tables and choose the fastest implementation
+   the CPU supports.  */
+static void
+crc32_init (void)
+{
+  int i, k;
+
+  for (i = 0; i < 256; ++i)
+    {
+      crc32_slice[0][i] = crc32_table[i];
+      for (k = 1; k < 8; ++k)
+	crc32_slice[k][i] = (crc32_slice[k - 1][i] >> 8)
+			    ^ crc32_table[crc32_slice[k - 1][i] & 0xff];
+    }
+
+  crc32_fn = crc32_slice8;
+#ifdef CRC32_PCLMUL
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("pclmul") && __builtin_cpu_supports ("sse4.1"))
+    crc32_fn = crc32_pclmul;
+#endif
+}
+
+uint32_t crc32 (uint32_t crc, unsigned char *buf, size_t len)
+{
+  pthread_once (&crc32_once, crc32_init);
+  return crc32_fn (crc, buf, len);
 }
@@ -54,9 +54,14 @@ struct find_cxx_sym_valsize
   unsigned char mark;
 };
 
+/* Sorted address ranges of symbols.  For libraries this only
+   contains the specials[] symbols and is kept in the library's
+   prelink_entry, so that it is built just once per DT_CHECKSUM
+   rather than for every C++ executable linked against it.  It must
+   therefore not refer to any particular DSO handle.  */
 struct find_cxx_sym_cache
 {
-  Elf_Data *symtab, *strtab;
+  GElf_Word checksum;
   int symsec, strsec, count;
   struct find_cxx_sym_valsize vals[];
 };
@@ -123,10 +128,9 @@ create_cache (DSO *dso, int plt)
       return NULL;
     }
 
+  cache->checksum = dso->info_DT_CHECKSUM;
   cache->symsec = symsec;
   cache->strsec = strsec;
-  cache->symtab = symtab;
-  cache->strtab = strtab;
   for (ndx = 0, dndx = 0; ndx < maxndx; ++ndx)
     {
       GElf_Sym sym;
@@ -176,11 +180,39 @@ create_cache (DSO *dso, int plt)
       for (ndx = dndx = 0; ndx < maxndx; ++ndx)
 	if (cache->vals[ndx].mark)
 	  cache->vals[dndx++] = cache->vals[ndx];
+
+      /* Typically only a small fraction of symbols is left.  */
+      if (dndx < maxndx)
+	{
+	  struct find_cxx_sym_cache *c;
+
+	  c = realloc (cache, sizeof (*cache) + sizeof (cache->vals[0]) * dndx);
+	  if (c != NULL)
+	    cache = c;
+	}
     }
   cache->count = dndx;
   return cache;
 }
 
+/* Return the symbol cache of library ENT opened as DSO, creating it
+   unless ENT already has one for the same DT_CHECKSUM.  */
+static struct find_cxx_sym_cache *
+lib_cache (DSO *dso, struct prelink_entry *ent)
+{
+  struct find_cxx_sym_cache *cache = ent->cxx_cache;
+
+  if (cache != NULL && cache->checksum == dso->info_DT_CHECKSUM)
+    return cache;
+
+  cache = create_cache (dso, 0);
+  if (cache == NULL || cache == (struct find_cxx_sym_cache *) -1UL)
+    return cache;
+  free (ent->cxx_cache);
+  ent->cxx_cache = cache;
+  return cache;
+}
+
 static int
 find_cxx_sym (struct prelink_info *info, GElf_Addr addr,
 	      struct find_cxx_sym *fcs, int reloc_size,
@@ -215,7 +247,10 @@ find_cxx_sym (struct prelink_info *info, GElf_Addr addr,
 
       if (cache[n] == NULL)
 	{
-	  cache[n] = create_cache (dso, 0);
+	  if (n)
+	    cache[n] = lib_cache (dso, info->ent->depends[n - 1]);
+	  else
+	    cache[n] = create_cache (dso, 0);
 	  if (cache[n] == NULL)
 	    return -2;
 	}
@@ -227,9 +262,9 @@ find_cxx_sym (struct prelink_info *info, GElf_Addr addr,
       fcs->dso = dso;
       fcs->cache = cache[n];
       fcs->symsec = fcs->cache->symsec;
-      fcs->symtab = fcs->cache->symtab;
+      fcs->symtab = elf_getdata (dso->scn[fcs->symsec], NULL);
       fcs->strsec = fcs->cache->strsec;
-      fcs->strtab = fcs->cache->strtab;
+      fcs->strtab = elf_getdata (dso->scn[fcs->strsec], NULL);
       fcs->lastndx = -1;
     }
   else
@@ -290,6 +325,34 @@ find_cxx_sym (struct prelink_info *info, GElf_Addr addr,
    We check if they are and if yes, remove conflicts against
    virtual tables which will not be used.  */
 
+/* Build CONFLICTS->hash2, a hash table of conflicts with RELOC_CLASS
+   against defined symbols, keyed by the value they resolved to.  */
+static void
+cxx_conflict_hash2_init (struct prelink_info *info,
+			 struct prelink_conflicts *conflicts, int reloc_class)
+{
+  struct prelink_conflict *conflict;
+  size_t size = 32, idx;
+
+  while (size < 2 * conflicts->count)
+    size *= 2;
+  conflicts->hash2 = arena_alloc (&info->arena,
+				  size * sizeof (struct prelink_conflict *));
+  if (conflicts->hash2 == NULL)
+    return;
+  memset (conflicts->hash2, 0, size * sizeof (struct prelink_conflict *));
+  conflicts->hash2_size = size;
+  for (conflict = conflicts->first; conflict; conflict = conflict->next)
+    if (conflict->reloc_class == reloc_class && conflict->conflict.ent)
+      {
+	for (idx = conflict_hash (conflict->lookup.ent->base
+				  + conflict->lookupval, size);
+	     conflicts->hash2[idx] != NULL; idx = (idx + 1) & (size - 1))
+	  ;
+	conflicts->hash2[idx] = conflict;
+      }
+}
+
 int
 remove_redundant_cxx_conflicts (struct prelink_info *info)
 {
@@ -337,8 +400,6 @@ remove_redundant_cxx_conflicts (struct prelink_info *info)
 		       * (info->ent->ndepends + 1));
   for (i = 0; i < info->conflict_rela_size; ++i)
     {
-      size_t cidx;
-
       reloc_type = reloc_r_type (info->dso, info->conflict_rela[i].r_info);
       reloc_size = info->dso->arch->reloc_size (reloc_type);
 
@@ -399,14 +460,8 @@ remove_redundant_cxx_conflicts (struct prelink_info *info)
       symtab_start = fcs1.dso->shdr[fcs1.symsec].sh_addr - fcs1.dso->base;
       symoff = symtab_start + n * fcs1.dso->shdr[fcs1.symsec].sh_entsize;
 
-      cidx = 0;
-      if (info->conflicts[fcs1.n].hash != &info->conflicts[fcs1.n].first)
-	cidx = symoff % 251;
-      for (conflict = info->conflicts[fcs1.n].hash[cidx]; conflict;
-	   conflict = conflict->next)
-	if (conflict->symoff == symoff
-	    && conflict->reloc_class == rtype_class_valid)
-	  break;
+      conflict = prelink_conflict_find (&info->conflicts[fcs1.n], symoff,
+					rtype_class_valid);
 
       if (conflict == NULL)
 	goto check_pltref;
@@ -535,7 +590,6 @@ check_pltref:
 	  if (sym.st_shndx == SHN_UNDEF && sym.st_value)
 	    {
 	      struct prelink_symbol *s;
-	      size_t maxidx, l;
 
 	      if (verbose > 4)
 		error (0, 0, "Possible C++ conflict removal due to reference to binary's .plt at %s:%s+%d",
@@ -550,70 +604,48 @@ check_pltref:
 	      if (s == NULL)
 		break;
 
-	      maxidx = 1;
-	      if (info->conflicts[fcs1.n].hash
-		  != &info->conflicts[fcs1.n].first)
+	      if (info->conflicts[fcs1.n].hash2 == NULL)
+		cxx_conflict_hash2_init (info, &info->conflicts[fcs1.n],
+					 rtype_class_valid);
+	      if (info->conflicts[fcs1.n].hash2 != NULL)
 		{
-		  if (info->conflicts[fcs1.n].hash2 == NULL)
-		    {
-		      info->conflicts[fcs1.n].hash2
-			= calloc (sizeof (struct prelink_conflict *), 251);
-		      if (info->conflicts[fcs1.n].hash2 != NULL)
-			{
-			  for (l = 0; l < 251; l++)
-			    for (conflict = info->conflicts[fcs1.n].hash[l];
-				 conflict; conflict = conflict->next)
-			      if (conflict->reloc_class == rtype_class_valid
-				  && conflict->conflict.ent)
-				{
-				  size_t ccidx
-				    = (conflict->lookup.ent->base
-				       + conflict->lookupval) % 251;
-				  conflict->next2
-				    = info->conflicts[fcs1.n].hash2[ccidx];
-				  info->conflicts[fcs1.n].hash2[ccidx]
-				    = conflict;
-				}
-			}
-		    }
-		  if (info->conflicts[fcs1.n].hash2 != NULL)
-		    {
-		      size_t ccidx = info->conflict_rela[i].r_addend % 251;
-		      for (conflict = info->conflicts[fcs1.n].hash2[ccidx];
-			   conflict; conflict = conflict->next2)
-			if (conflict->lookup.ent->base + conflict->lookupval
-			    == info->conflict_rela[i].r_addend
-			    && (conflict->conflict.ent->base
-				+ conflict->conflictval
-				== s->u.ent->base + s->value))
-			  goto pltref_remove;
-		      break;
-		    }
-		  maxidx = 251;
+		  struct prelink_conflicts *cfls = &info->conflicts[fcs1.n];
+		  size_t ccidx;
+
+		  for (ccidx = conflict_hash (info->conflict_rela[i].r_addend,
+					      cfls->hash2_size);
+		       (conflict = cfls->hash2[ccidx]) != NULL;
+		       ccidx = (ccidx + 1) & (cfls->hash2_size - 1))
+		    if (conflict->lookup.ent->base + conflict->lookupval
+			== info->conflict_rela[i].r_addend
+			&& (conflict->conflict.ent->base
+			    + conflict->conflictval
+			    == s->u.ent->base + s->value))
+		      goto pltref_remove;
+		  break;
 		}
 
-	      for (l = 0; l < maxidx; l++)
-		for (conflict = info->conflicts[fcs1.n].hash[l];
-		     conflict; conflict = conflict->next)
-		  if (conflict->lookup.ent->base + conflict->lookupval
-		      == info->conflict_rela[i].r_addend
-		      && conflict->conflict.ent
-		      && (conflict->conflict.ent->base
-			  + conflict->conflictval == s->u.ent->base + s->value)
-		      && conflict->reloc_class == rtype_class_valid)
-		    {
+	      for (conflict = info->conflicts[fcs1.n].first; conflict;
+		   conflict = conflict->next)
+		if (conflict->lookup.ent->base + conflict->lookupval
+		    == info->conflict_rela[i].r_addend
+		    && conflict->conflict.ent
+		    && (conflict->conflict.ent->base
+			+ conflict->conflictval == s->u.ent->base + s->value)
+		    && conflict->reloc_class == rtype_class_valid)
+		  {
 pltref_remove:
-		      if (verbose > 3)
-			error (0, 0, "Removing C++ conflict due to reference to binary's .plt at %s:%s+%d",
-			       fcs1.dso->filename, name,
-			       (int) (info->conflict_rela[i].r_offset
-				      - fcs1.sym.st_value));
-
-		      info->conflict_rela[i].r_info =
-			reloc_r_info (info->dso, 1, reloc_r_type (info->dso, info->conflict_rela[i].r_info));
-		      ++removed;
-		      goto pltref_check_done;
-		    }
+		    if (verbose > 3)
+		      error (0, 0, "Removing C++ conflict due to reference to binary's .plt at %s:%s+%d",
+			     fcs1.dso->filename, name,
+			     (int) (info->conflict_rela[i].r_offset
+				    - fcs1.sym.st_value));
+
+		    info->conflict_rela[i].r_info =
+		      reloc_r_info (info->dso, 1, reloc_r_type (info->dso, info->conflict_rela[i].r_info));
+		    ++removed;
+		    goto pltref_check_done;
+		  }
 
 pltref_check_done:
 	      break;
@@ -634,9 +666,9 @@ pltref_check_done:
     }
 
 out_free_cache:
-  for (i = 0; i < info->ent->ndepends + 1; i++)
-    if (cache[i] && cache[i] != (struct find_cxx_sym_cache *) -1UL)
-      free (cache[i]);
+  /* Caches of libraries are kept in their prelink_entry.  */
+  if (cache[0] && cache[0] != (struct find_cxx_sym_cache *) -1UL)
+    free (cache[0]);
   if (binsymcache && binsymcache != (struct find_cxx_sym_cache *) -1UL)
     free (binsymcache);
   return ret;
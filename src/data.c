@@ -16,6 +16,7 @@
    Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.  */
 
 #include <config.h>
+#include <string.h>
 #include "prelink.h"
 
 #define UREAD(le,nn)						\
@@ -100,11 +101,116 @@ buf_write_ne##nn (DSO *dso, unsigned char *buf,			\
   BUFREADUNE(nn) READUNE(nn) \
   WRITENE(nn) BUFWRITENE(nn)
 
+static int
+data_index_cmp (const void *A, const void *B)
+{
+  Elf_Data *a = * (Elf_Data **) A;
+  Elf_Data *b = * (Elf_Data **) B;
+
+  if (a->d_off < b->d_off)
+    return -1;
+  if (a->d_off > b->d_off)
+    return 1;
+  return 0;
+}
+
+static struct data_index *
+build_data_index (DSO *dso, int sec)
+{
+  struct data_index *di;
+  Elf_Data *data = NULL;
+  int i, n = 0;
+
+  if (sec >= dso->ndata_index)
+    {
+      int ndata_index = dso->ehdr.e_shnum > sec ? dso->ehdr.e_shnum : sec + 1;
+      struct data_index **data_index
+	= realloc (dso->data_index, ndata_index * sizeof (struct data_index *));
+
+      if (data_index == NULL)
+	return NULL;
+      memset (data_index + dso->ndata_index, 0,
+	      (ndata_index - dso->ndata_index) * sizeof (struct data_index *));
+      dso->data_index = data_index;
+      dso->ndata_index = ndata_index;
+    }
+
+  while ((data = elf_getdata (dso->scn[sec], data)) != NULL)
+    ++n;
+  di = malloc (sizeof (struct data_index) + n * sizeof (Elf_Data *));
+  if (di == NULL)
+    return NULL;
+  di->n = n;
+  for (i = 0; i < n; i++)
+    di->data[i] = data = elf_getdata (dso->scn[sec], data);
+  if (n > 1)
+    {
+      qsort (di->data, n, sizeof (Elf_Data *), data_index_cmp);
+      for (i = 1; i < n; i++)
+	if (di->data[i]->d_off
+	    < di->data[i - 1]->d_off + di->data[i - 1]->d_size)
+	  {
+	    di->n = -1;
+	    break;
+	  }
+    }
+  dso->data_index[sec] = di;
+  return di;
+}
+
+/* Return the Elf_Data chunk of section SEC of DSO which contains
+   section offset OFFSET, or NULL.  Like addr_to_sec, the index is
+   only a hint: chunks can be added or resized at any time, so if
+   it does not give the answer, the chunks are searched linearly and
+   the index is rebuilt on the next call.  */
+
+Elf_Data *
+sec_offset_to_data (DSO *dso, int sec, GElf_Addr offset)
+{
+  struct data_index *di = NULL;
+  Elf_Data *data = NULL;
+
+  if (sec < dso->ndata_index)
+    di = dso->data_index[sec];
+  if (di == NULL)
+    di = build_data_index (dso, sec);
+
+  if (di != NULL && di->n >= 0)
+    {
+      int lo = 0, hi = di->n;
+
+      while (lo < hi)
+	{
+	  int mid = (lo + hi) / 2;
+
+	  if (di->data[mid]->d_off <= offset)
+	    lo = mid + 1;
+	  else
+	    hi = mid;
+	}
+      if (lo > 0 && di->data[lo - 1]->d_off + di->data[lo - 1]->d_size
+		    > offset)
+	return di->data[lo - 1];
+    }
+
+  while ((data = elf_getdata (dso->scn[sec], data)) != NULL)
+    if (data->d_off <= offset && data->d_off + data->d_size > offset)
+      {
+	if (di != NULL && di->n >= 0)
+	  {
+	    free (di);
+	    dso->data_index[sec] = NULL;
+	  }
+	return data;
+      }
+  return NULL;
+}
+
 unsigned char *
 get_data (DSO *dso, GElf_Addr addr, int *secp, Elf_Type *typep)
 {
   int sec = addr_to_sec (dso, addr);
-  Elf_Data *data = NULL;
+  Elf_Data *data;
 
   if (sec == -1)
     return NULL;
@@ -113,13 +219,11 @@ get_data (DSO *dso, GElf_Addr addr, int *secp, Elf_Type *typep)
     *secp = sec;
 
   addr -= dso->shdr[sec].sh_addr;
-  while ((data = elf_getdata (dso->scn[sec], data)) != NULL)
-    if (data->d_off <= addr && data->d_off + data->d_size > addr)
-    {
-      if (typep) *typep = data->d_type;
-      return (unsigned char *) data->d_buf + (addr - data->d_off);
-    }
-  return NULL;
+  data = sec_offset_to_data (dso, sec, addr);
+  if (data == NULL)
+    return NULL;
+  if (typep) *typep = data->d_type;
+  return (unsigned char *) data->d_buf + (addr - data->d_off);
 }
 
 /* Initialize IT so that the first byte it provides is address ADDR
@@ -153,11 +257,9 @@ get_data_from_iterator (struct data_iterator *it, GElf_Addr size)
       if (it->sec < 0)
 	return NULL;
 
-      /* Fast-forward to the block that contains ADDR, if any.  */
+      /* Find the block that contains ADDR, if any.  */
       it->sec_offset = it->addr - it->dso->shdr[it->sec].sh_addr;
-      do
-	it->data = elf_getdata (it->dso->scn[it->sec], it->data);
-      while (it->data && it->data->d_off + it->data->d_size <= it->sec_offset);
+      it->data = sec_offset_to_data (it->dso, it->sec, it->sec_offset);
     }
 
   /* Make sure that all the data we want is included in this block.  */
@@ -22,6 +22,7 @@
 #include <fcntl.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <time.h>
 #include <unistd.h>
 #include "prelinktab.h"
@@ -46,19 +47,13 @@ find_ents (void **p, void *info)
   return 1;
 }
 
-static void
-prelink_ent (struct prelink_entry *ent)
+/* Check whether ENT can be prelinked now that all its dependencies
+   have been processed.  Return 1 (and mark ENT as not prelinked)
+   if not.  */
+static int
+prelink_ent_check (struct prelink_entry *ent)
 {
   int i, j;
-  DSO *dso;
-  struct stat64 st;
-  struct prelink_link *hardlink;
-  char *move = NULL, *move_temp;
-  size_t movelen = 0;
-
-  for (i = 0; i < ent->ndepends; ++i)
-    if (ent->depends[i]->done == 1)
-      prelink_ent (ent->depends[i]);
 
   for (i = 0; i < ent->ndepends; ++i)
     if (ent->depends[i]->done != 2)
@@ -69,7 +64,7 @@ prelink_ent (struct prelink_entry *ent)
 	if (verbose)
 	  error (0, 0, "Could not prelink %s because its dependency %s could not be prelinked",
 		 ent->filename, ent->depends[i]->filename);
-	return;
+	return 1;
       }
 
   ent->u.tmp = 1;
@@ -90,12 +85,24 @@ prelink_ent (struct prelink_entry *ent)
 	    ent->u.tmp = 0;
 	    for (i = 0; i < ent->ndepends; ++i)
 	      ent->depends[i]->u.tmp = 0;
-	    return;
+	    return 1;
 	  }
     }
   ent->u.tmp = 0;
   for (i = 0; i < ent->ndepends; ++i)
     ent->depends[i]->u.tmp = 0;
+  return 0;
+}
+
+/* Prelink ENT itself, assuming prelink_ent_check succeeded.  */
+static void
+prelink_ent_1 (struct prelink_entry *ent)
+{
+  DSO *dso;
+  struct stat64 st;
+  struct prelink_link *hardlink;
+  char *move = NULL, *move_temp;
+  size_t movelen = 0;
 
   if (verbose)
     {
@@ -237,6 +244,378 @@ error_out:
   return;
 }
 
+static void
+prelink_ent (struct prelink_entry *ent)
+{
+  int i;
+
+  for (i = 0; i < ent->ndepends; ++i)
+    if (ent->depends[i]->done == 1)
+      prelink_ent (ent->depends[i]);
+
+  if (prelink_ent_check (ent))
+    return;
+
+  prelink_ent_1 (ent);
+}
+
+/* State of one object in the parallel prelink_all dependency graph.  */
+struct prelink_job
+  {
+    struct prelink_entry *ent;
+    /* Number of dependencies which still have to be prelinked
+       before ENT can be started.  */
+    int nblocked;
+    int ndependents;
+    struct prelink_job **dependents;
+  };
+
+/* What a worker process reports back about the object it prelinked.  */
+struct prelink_job_result
+  {
+    int done, type, flags;
+    GElf_Word timestamp, checksum;
+    GElf_Addr base, end, pltgot;
+    dev_t dev;
+    ino64_t ino;
+    uint32_t ctime, mtime;
+  };
+
+struct prelink_worker
+  {
+    pid_t pid;
+    int fd;
+    struct prelink_job *job;
+  };
+
+struct prelink_queue
+  {
+    struct prelink_job **jobs;
+    int head, tail;
+  };
+
+static int
+job_ent_cmp (const void *A, const void *B)
+{
+  const struct prelink_job *a = * (const struct prelink_job **) A;
+  const struct prelink_job *b = * (const struct prelink_job **) B;
+
+  if (a->ent < b->ent)
+    return -1;
+  if (a->ent > b->ent)
+    return 1;
+  return 0;
+}
+
+static int
+job_dependents_cmp (const void *A, const void *B)
+{
+  const struct prelink_job *a = * (const struct prelink_job **) A;
+  const struct prelink_job *b = * (const struct prelink_job **) B;
+
+  /* Libraries which unblock the most objects go first.  */
+  if (a->ndependents > b->ndependents)
+    return -1;
+  if (a->ndependents < b->ndependents)
+    return 1;
+  return 0;
+}
+
+static struct prelink_job *
+find_job (struct prelink_job **sorted, int njobs, struct prelink_entry *ent)
+{
+  struct prelink_job key, *keyp = &key, **ret;
+
+  key.ent = ent;
+  ret = bsearch (&keyp, sorted, njobs, sizeof (struct prelink_job *),
+		 job_ent_cmp);
+  return ret ? *ret : NULL;
+}
+
+static void
+queue_job (struct prelink_queue *libs, struct prelink_queue *execs,
+	   struct prelink_job *job)
+{
+  if (job->ent->type == ET_DYN)
+    libs->jobs[libs->tail++] = job;
+  else
+    execs->jobs[execs->tail++] = job;
+}
+
+static void
+finish_job (struct prelink_queue *libs, struct prelink_queue *execs,
+	    struct prelink_job *job)
+{
+  int i;
+
+  for (i = 0; i < job->ndependents; ++i)
+    if (--job->dependents[i]->nblocked == 0)
+      queue_job (libs, execs, job->dependents[i]);
+}
+
+static void
+prelink_job_result (struct prelink_worker *w, int status)
+{
+  struct prelink_entry *ent = w->job->ent;
+  struct prelink_job_result res;
+  ssize_t len;
+  size_t got = 0;
+
+  do
+    {
+      len = read (w->fd, (char *) &res + got, sizeof (res) - got);
+      if (len > 0)
+	got += len;
+    }
+  while ((len > 0 && got < sizeof (res)) || (len < 0 && errno == EINTR));
+  close (w->fd);
+
+  if (got != sizeof (res))
+    {
+      error (0, 0, "Prelinking %s failed (worker exit status %d)",
+	     ent->filename, status);
+      ent->done = 0;
+      return;
+    }
+
+  ent->done = res.done;
+  ent->type = res.type;
+  ent->flags = res.flags;
+  ent->timestamp = res.timestamp;
+  ent->checksum = res.checksum;
+  ent->base = res.base;
+  ent->end = res.end;
+  ent->pltgot = res.pltgot;
+  ent->dev = res.dev;
+  ent->ino = res.ino;
+  ent->ctime = res.ctime;
+  ent->mtime = res.mtime;
+
+  /* The worker has relocated the library, so what we read during
+     gathering is stale.  Dependents are forked from us and need the
+     new .opd contents.  */
+  if (ent->done == 2 && ent->opd != NULL)
+    {
+      DSO *dso = open_dso (ent->canon_filename);
+
+      if (dso != NULL)
+	{
+	  if (dso->arch->read_opd)
+	    dso->arch->read_opd (dso, ent);
+	  close_dso (dso);
+	}
+    }
+}
+
+static int
+prelink_job_start (struct prelink_worker *w, struct prelink_job *job)
+{
+  struct prelink_entry *ent = job->ent;
+  struct prelink_job_result res;
+  int p[2];
+
+  if (pipe (p) < 0)
+    return 1;
+
+  fflush (stdout);
+  fflush (stderr);
+  switch (w->pid = fork ())
+    {
+    case -1:
+      close (p[0]);
+      close (p[1]);
+      return 1;
+    case 0:
+      close (p[0]);
+      prelink_ent_1 (ent);
+      memset (&res, 0, sizeof (res));
+      res.done = ent->done;
+      res.type = ent->type;
+      res.flags = ent->flags;
+      res.timestamp = ent->timestamp;
+      res.checksum = ent->checksum;
+      res.base = ent->base;
+      res.end = ent->end;
+      res.pltgot = ent->pltgot;
+      res.dev = ent->dev;
+      res.ino = ent->ino;
+      res.ctime = ent->ctime;
+      res.mtime = ent->mtime;
+      fflush (stdout);
+      fflush (stderr);
+      if (write (p[1], &res, sizeof (res)) != sizeof (res))
+	_exit (1);
+      _exit (0);
+    }
+
+  close (p[1]);
+  w->fd = p[0];
+  w->job = job;
+  return 0;
+}
+
+/* Prelink the collected objects using up to JOBS worker processes.
+   An object is only started once all its dependencies have been
+   prelinked, so workers always see final dependency images on disk.  */
+static void
+prelink_all_parallel (struct collect_ents *l)
+{
+  struct prelink_job *jobs, **sorted, **dependents;
+  struct prelink_worker *workers;
+  struct prelink_queue libs, execs;
+  int i, j, k, ndeps, nrunning = 0;
+
+  jobs = calloc (l->nents, sizeof (struct prelink_job));
+  sorted = malloc (l->nents * sizeof (struct prelink_job *));
+  workers = calloc (parallel_jobs, sizeof (struct prelink_worker));
+  libs.jobs = malloc (l->nents * sizeof (struct prelink_job *));
+  execs.jobs = malloc (l->nents * sizeof (struct prelink_job *));
+  if (jobs == NULL || sorted == NULL || workers == NULL
+      || libs.jobs == NULL || execs.jobs == NULL)
+    {
+      error (0, ENOMEM, "Could not schedule parallel prelinking");
+      free (jobs);
+      free (sorted);
+      free (workers);
+      free (libs.jobs);
+      free (execs.jobs);
+      for (i = 0; i < l->nents; ++i)
+	if (l->ents[i]->done == 1
+	    || (l->ents[i]->done == 0 && l->ents[i]->type == ET_EXEC))
+	  prelink_ent (l->ents[i]);
+      return;
+    }
+  libs.head = libs.tail = 0;
+  execs.head = execs.tail = 0;
+
+  for (i = 0; i < l->nents; ++i)
+    {
+      jobs[i].ent = l->ents[i];
+      sorted[i] = &jobs[i];
+    }
+  qsort (sorted, l->nents, sizeof (struct prelink_job *), job_ent_cmp);
+
+  /* Build the dependency graph.  Only dependencies which still need
+     prelinking block an object, the rest is checked when it is
+     started.  */
+  ndeps = 0;
+  for (i = 0; i < l->nents; ++i)
+    for (j = 0; j < jobs[i].ent->ndepends; ++j)
+      if (jobs[i].ent->depends[j]->done == 1)
+	{
+	  struct prelink_job *dep
+	    = find_job (sorted, l->nents, jobs[i].ent->depends[j]);
+
+	  if (dep != NULL && dep != &jobs[i])
+	    {
+	      ++jobs[i].nblocked;
+	      ++dep->ndependents;
+	      ++ndeps;
+	    }
+	}
+
+  dependents = malloc ((ndeps + 1) * sizeof (struct prelink_job *));
+  if (dependents == NULL)
+    error (EXIT_FAILURE, ENOMEM, "Could not schedule parallel prelinking");
+  for (i = 0, k = 0; i < l->nents; ++i)
+    {
+      jobs[i].dependents = dependents + k;
+      k += jobs[i].ndependents;
+      jobs[i].ndependents = 0;
+    }
+  for (i = 0; i < l->nents; ++i)
+    for (j = 0; j < jobs[i].ent->ndepends; ++j)
+      if (jobs[i].ent->depends[j]->done == 1)
+	{
+	  struct prelink_job *dep
+	    = find_job (sorted, l->nents, jobs[i].ent->depends[j]);
+
+	  if (dep != NULL && dep != &jobs[i])
+	    dep->dependents[dep->ndependents++] = &jobs[i];
+	}
+
+  for (i = 0, k = 0; i < l->nents; ++i)
+    if (jobs[i].nblocked == 0)
+      sorted[k++] = &jobs[i];
+  qsort (sorted, k, sizeof (struct prelink_job *), job_dependents_cmp);
+  for (i = 0; i < k; ++i)
+    queue_job (&libs, &execs, sorted[i]);
+
+  for (;;)
+    {
+      while (nrunning < parallel_jobs
+	     && (libs.head < libs.tail || execs.head < execs.tail))
+	{
+	  struct prelink_job *job;
+	  struct prelink_entry *ent;
+
+	  if (libs.head < libs.tail)
+	    job = libs.jobs[libs.head++];
+	  else
+	    job = execs.jobs[execs.head++];
+	  ent = job->ent;
+
+	  if ((ent->done != 1
+	       && (ent->done != 0 || ent->type != ET_EXEC))
+	      || prelink_ent_check (ent))
+	    {
+	      finish_job (&libs, &execs, job);
+	      continue;
+	    }
+
+	  for (i = 0; i < parallel_jobs; ++i)
+	    if (workers[i].job == NULL)
+	      break;
+	  if (prelink_job_start (&workers[i], job))
+	    {
+	      /* Could not fork, do it ourselves.  */
+	      prelink_ent_1 (ent);
+	      finish_job (&libs, &execs, job);
+	      continue;
+	    }
+	  ++nrunning;
+	}
+
+      if (nrunning == 0)
+	break;
+
+      for (;;)
+	{
+	  pid_t pid;
+	  int status;
+
+	  while ((pid = waitpid (-1, &status, 0)) == -1 && errno == EINTR);
+	  if (pid == -1)
+	    error (EXIT_FAILURE, errno, "Could not wait for prelink workers");
+	  for (i = 0; i < parallel_jobs; ++i)
+	    if (workers[i].job != NULL && workers[i].pid == pid)
+	      break;
+	  if (i == parallel_jobs)
+	    continue;
+	  prelink_job_result (&workers[i], status);
+	  finish_job (&libs, &execs, workers[i].job);
+	  workers[i].job = NULL;
+	  --nrunning;
+	  break;
+	}
+    }
+
+  /* Whatever is left is part of a dependency cycle; handle it the
+     serial way.  */
+  for (i = 0; i < l->nents; ++i)
+    if (jobs[i].nblocked
+	&& (jobs[i].ent->done == 1
+	    || (jobs[i].ent->done == 0 && jobs[i].ent->type == ET_EXEC)))
+      prelink_ent (jobs[i].ent);
+
+  free (dependents);
+  free (jobs);
+  free (sorted);
+  free (workers);
+  free (libs.jobs);
+  free (execs.jobs);
+}
+
 void
 prelink_all (void)
 {
@@ -249,8 +628,14 @@ prelink_all (void)
   l.nents = 0;
   htab_traverse (prelink_filename_htab, find_ents, &l);
 
-  for (i = 0; i < l.nents; ++i)
-    if (l.ents[i]->done == 1
-	|| (l.ents[i]->done == 0 && l.ents[i]->type == ET_EXEC))
-      prelink_ent (l.ents[i]);
+  if (parallel_jobs > 1 && l.nents > 1)
+    prelink_all_parallel (&l);
+  else
+    for (i = 0; i < l.nents; ++i)
+      if (l.ents[i]->done == 1
+	  || (l.ents[i]->done == 0 && l.ents[i]->type == ET_EXEC))
+	prelink_ent (l.ents[i]);
+
+  /* Libraries borrowed while building conflicts are kept open.  */
+  flush_dso_cache ();
 }
@@ -21,6 +21,7 @@
 #include <error.h>
 #include <fcntl.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <time.h>
@@ -279,6 +280,41 @@ section_cmp (const void *A, const void *B)
   return *a > *b;
 }
 
+/* Return the index of .gnu.prelink_debug section of DSO, or 0.  */
+static int
+find_debug_delta (DSO *dso)
+{
+  int i;
+
+  for (i = 1; i < dso->ehdr.e_shnum; ++i)
+    if (dso->shdr[i].sh_type == SHT_PROGBITS
+	&& ! (dso->shdr[i].sh_flags & SHF_ALLOC)
+	&& ! strcmp (strptr (dso, dso->ehdr.e_shstrndx,
+			     dso->shdr[i].sh_name), ".gnu.prelink_debug"))
+      return i;
+  return 0;
+}
+
+static int
+read_debug_delta (DSO *dso, int n)
+{
+  Elf_Data *data = elf_getdata (dso->scn[n], NULL);
+  size_t size = gelf_fsize (dso->elf, ELF_T_ADDR, 1, EV_CURRENT);
+
+  if (data == NULL || data->d_buf == NULL || data->d_size != size
+      || dso->shdr[n].sh_size != size)
+    {
+      error (0, 0, "%s: Bogus .gnu.prelink_debug section", dso->filename);
+      return 1;
+    }
+  if (size == 4)
+    dso->debug_delta = buf_read_une32 (dso, data->d_buf);
+  else
+    dso->debug_delta = buf_read_une64 (dso, data->d_buf);
+  dso->has_debug_delta = 1;
+  return 0;
+}
+
 DSO *
 fdopen_dso (int fd, const char *name)
 {
@@ -289,8 +325,30 @@ fdopen_dso (int fd, const char *name)
   DSO *dso = NULL;
   struct PLArch *plarch;
   extern struct PLArch __start_pl_arch[], __stop_pl_arch[];
-
-  elf = elf_begin (fd, ELF_C_READ, NULL);
+  struct stat64 st;
+  void *map = NULL;
+  size_t map_size = 0;
+
+  /* Map the file copy-on-write, so that section data is never read
+     into memory unless it is looked at, and of what is modified only
+     the touched pages are copied.  Fall back to reading it if it
+     can't be mapped.  */
+  if (fstat64 (fd, &st) == 0 && S_ISREG (st.st_mode) && st.st_size > 0
+      && (size_t) st.st_size == st.st_size)
+    {
+      map_size = st.st_size;
+      map = mmap (NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+		  fd, 0);
+      if (map == MAP_FAILED)
+	map = NULL;
+      else if ((elf = elf_memory (map, map_size)) == NULL)
+	{
+	  munmap (map, map_size);
+	  map = NULL;
+	}
+    }
+  if (elf == NULL)
+    elf = elf_begin (fd, ELF_C_READ, NULL);
   if (elf == NULL)
     {
       error (0, 0, "cannot open ELF file: %s", elf_errmsg (-1));
@@ -359,7 +417,10 @@ fdopen_dso (int fd, const char *name)
   elf_flagelf (elf, ELF_C_SET, ELF_F_LAYOUT | ELF_F_PERMISSIVE);
 
   memset (dso, 0, sizeof(DSO));
+  dso->naddr_index = -1;
   dso->elf = elf;
+  dso->map = map;
+  dso->map_size = map_size;
   dso->ehdr = ehdr;
   dso->phdr = (GElf_Phdr *) &dso->shdr[ehdr.e_shnum + 20];
   dso->scn = (Elf_Scn **) &dso->phdr[ehdr.e_phnum + 1];
@@ -552,11 +613,16 @@ fdopen_dso (int fd, const char *name)
 	  }
       }
 
+  i = find_debug_delta (dso);
+  if (i && read_debug_delta (dso, i))
+    goto error_out;
+
   return dso;
 
 error_out:
   if (dso)
     {
+      invalidate_section_index (dso);
       free (dso->move);
       if (dso->soname != dso->filename)
 	free ((char *) dso->soname);
@@ -565,11 +631,10 @@ error_out:
     }
   if (elf)
     elf_end (elf);
+  if (map)
+    munmap (map, map_size);
   if (fd != -1)
-    {
-      fsync (fd);
-      close (fd);
-    }
+    close (fd);
   return NULL;
 }
 
@@ -862,12 +927,15 @@ reopen_dso (DSO *dso, struct section_move *move, const char *temp_base)
 	    }
 	  else
 	    {
+	      int nchunks = 0;
+
 	      memset (&data, 0, sizeof data);
 	      data.d_type = ELF_T_NUM;
 	      data1 = NULL;
 	      while ((data1 = elf_getdata (dso->scn[j], data1))
 		     != NULL)
 		{
+		  ++nchunks;
 		  if (data.d_type == ELF_T_NUM)
 		    data = *data1;
 		  else if (data.d_type != data1->d_type
@@ -893,6 +961,15 @@ reopen_dso (DSO *dso, struct section_move *move, const char *temp_base)
 		  assert (dso->shdr[j].sh_size == 0);
 		  continue;
 		}
+	      /* A section which is in one piece in the mapping of the
+		 input file is used in place, the kernel copies only the
+		 pages which are modified.  */
+	      if (nchunks == 1 && dso_is_mapped (dso, data.d_buf))
+		{
+		  data2 = elf_newdata (scn);
+		  memcpy (data2, &data, sizeof (data));
+		  continue;
+		}
 	      if (data.d_size != 0)
 		{
 		  data.d_buf = calloc (1, data.d_size);
@@ -928,7 +1005,7 @@ reopen_dso (DSO *dso, struct section_move *move, const char *temp_base)
   dso->fdro = dso->fd;
   dso->fd = fd;
   dso->ehdr = ehdr;
-  dso->lastscn = 0;
+  invalidate_section_index (dso);
   elf = NULL;
   fd = -1;
   for (i = 1; i < move->old_shnum; i++)
@@ -1165,6 +1242,7 @@ adjust_dynamic (DSO *dso, int n, GElf_Addr start, GElf_Addr adjust)
 	      {
 	      case DT_REL:
 	      case DT_RELA:
+	      case DT_RELR:
 		/* On some arches DT_REL* may be 0 indicating no relocations
 		   (if DT_REL*SZ is also 0).  Don't adjust it in that case.  */
 		if (dyn.d_un.d_ptr && dyn.d_un.d_ptr >= start)
@@ -1209,80 +1287,234 @@ adjust_dynamic (DSO *dso, int n, GElf_Addr start, GElf_Addr adjust)
   return 0;
 }
 
+/* Forget the section indexes of DSO, because its sections
+   have been moved, added or removed.  */
+void
+invalidate_section_index (DSO *dso)
+{
+  int i;
+
+  for (i = 0; i < dso->ndata_index; i++)
+    free (dso->data_index[i]);
+  free (dso->data_index);
+  dso->data_index = NULL;
+  dso->ndata_index = 0;
+  free (dso->addr_index);
+  dso->addr_index = NULL;
+  dso->naddr_index = -1;
+  dso->lastscn = 0;
+}
+
+static inline int
+addr_in_sec_p (GElf_Shdr *shdr, GElf_Addr addr)
+{
+  return RELOCATE_SCN (shdr->sh_flags)
+	 && shdr->sh_addr <= addr && shdr->sh_addr + shdr->sh_size > addr
+	 && (shdr->sh_type != SHT_NOBITS || (shdr->sh_flags & SHF_TLS) == 0);
+}
+
+static int
+addr_index_cmp (const void *A, const void *B)
+{
+  struct addr_index *a = (struct addr_index *) A;
+  struct addr_index *b = (struct addr_index *) B;
+
+  if (a->start < b->start)
+    return -1;
+  if (a->start > b->start)
+    return 1;
+  return a->sec - b->sec;
+}
+
+/* Build the index addr_to_sec and addr_in_dso_p search.  */
+void
+build_addr_index (DSO *dso)
+{
+  GElf_Shdr *shdr;
+  int i, n;
+
+  free (dso->addr_index);
+  dso->addr_index = malloc (dso->ehdr.e_shnum * sizeof (struct addr_index));
+  if (dso->addr_index == NULL)
+    {
+      dso->naddr_index = -2;
+      return;
+    }
+
+  for (i = 1, n = 0; i < dso->ehdr.e_shnum; i++)
+    {
+      shdr = &dso->shdr[i];
+      if (shdr->sh_size && addr_in_sec_p (shdr, shdr->sh_addr))
+	{
+	  dso->addr_index[n].start = shdr->sh_addr;
+	  dso->addr_index[n].end = shdr->sh_addr + shdr->sh_size;
+	  dso->addr_index[n++].sec = i;
+	}
+    }
+  qsort (dso->addr_index, n, sizeof (struct addr_index), addr_index_cmp);
+  dso->naddr_index = n;
+  /* With overlapping sections the lowest numbered one containing
+     the address must be returned, leave that to the linear search.  */
+  for (i = 1; i < n; i++)
+    if (dso->addr_index[i].start < dso->addr_index[i - 1].end)
+      {
+	dso->naddr_index = -2;
+	break;
+      }
+}
+
+/* Return the section containing ADDR, or -1.  Sections are looked up
+   in addr_index, which is verified against the current section headers,
+   as many places adjust them in place.  If the index does not give
+   the right answer, fall back to a linear search and rebuild it
+   next time.  */
 int
 addr_to_sec (DSO *dso, GElf_Addr addr)
 {
-  GElf_Shdr *shdr;
   int i;
 
-  shdr = &dso->shdr[dso->lastscn];
-  for (i = -1; i < dso->ehdr.e_shnum; shdr = &dso->shdr[++i])
-    if (RELOCATE_SCN (shdr->sh_flags)
-	&& shdr->sh_addr <= addr && shdr->sh_addr + shdr->sh_size > addr
-	&& (shdr->sh_type != SHT_NOBITS || (shdr->sh_flags & SHF_TLS) == 0))
+  if (addr_in_sec_p (&dso->shdr[dso->lastscn], addr))
+    return dso->lastscn;
+
+  if (dso->naddr_index == -1)
+    build_addr_index (dso);
+
+  if (dso->naddr_index >= 0)
+    {
+      struct addr_index *ai = dso->addr_index;
+      int lo = 0, hi = dso->naddr_index;
+
+      while (lo < hi)
+	{
+	  int mid = (lo + hi) / 2;
+
+	  if (ai[mid].start <= addr)
+	    lo = mid + 1;
+	  else
+	    hi = mid;
+	}
+      if (lo > 0 && addr < ai[lo - 1].end
+	  && ai[lo - 1].sec < dso->ehdr.e_shnum
+	  && addr_in_sec_p (&dso->shdr[ai[lo - 1].sec], addr))
+	return dso->lastscn = ai[lo - 1].sec;
+    }
+
+  for (i = 0; i < dso->ehdr.e_shnum; i++)
+    if (addr_in_sec_p (&dso->shdr[i], addr))
       {
-	if (i != -1)
-	  dso->lastscn = i;
-	return dso->lastscn;
+	if (dso->naddr_index >= 0)
+	  dso->naddr_index = -1;
+	return dso->lastscn = i;
       }
 
   return -1;
 }
 
-static int
-adjust_rel (DSO *dso, int n, GElf_Addr start, GElf_Addr adjust)
+/* Return nonzero if addr_to_sec would find a section containing ADDR.
+   Unlike addr_to_sec this doesn't modify DSO, so several threads can
+   call it at once as long as the section headers don't change.
+   Call build_addr_index first if dso->naddr_index is -1.  */
+int
+addr_in_dso_p (DSO *dso, GElf_Addr addr)
 {
-  Elf_Data *data = NULL;
-  Elf_Scn *scn = dso->scn[n];
-  GElf_Rel rel;
-  int sec, ndx, maxndx;
+  int i;
 
-  while ((data = elf_getdata (scn, data)) != NULL)
+  if (dso->naddr_index >= 0)
     {
-      maxndx = data->d_size / dso->shdr[n].sh_entsize;
-      for (ndx = 0; ndx < maxndx; ++ndx)
+      struct addr_index *ai = dso->addr_index;
+      int lo = 0, hi = dso->naddr_index;
+
+      while (lo < hi)
 	{
-	  gelfx_getrel (dso->elf, data, ndx, &rel);
-	  sec = addr_to_sec (dso, rel.r_offset);
-	  if (sec == -1)
-	    continue;
+	  int mid = (lo + hi) / 2;
 
-	  dso->arch->adjust_rel (dso, &rel, start, adjust);
-	  addr_adjust (rel.r_offset, start, adjust);
-	  gelfx_update_rel (dso->elf, data, ndx, &rel);
+	  if (ai[mid].start <= addr)
+	    lo = mid + 1;
+	  else
+	    hi = mid;
 	}
+      if (lo > 0 && addr < ai[lo - 1].end
+	  && ai[lo - 1].sec < dso->ehdr.e_shnum
+	  && addr_in_sec_p (&dso->shdr[ai[lo - 1].sec], addr))
+	return 1;
     }
 
-  elf_flagscn (scn, ELF_C_SET, ELF_F_DIRTY);
+  for (i = 0; i < dso->ehdr.e_shnum; i++)
+    if (addr_in_sec_p (&dso->shdr[i], addr))
+      return 1;
+
   return 0;
 }
 
 static int
-adjust_rela (DSO *dso, int n, GElf_Addr start, GElf_Addr adjust)
+adjust_relocs (DSO *dso, int n, GElf_Addr start, GElf_Addr adjust)
 {
-  Elf_Data *data = NULL;
-  Elf_Scn *scn = dso->scn[n];
-  GElf_Rela rela;
-  int sec, ndx, maxndx;
+  struct reloc_view view;
+  struct reloc_run *run;
+  int i, ret;
 
-  while ((data = elf_getdata (scn, data)) != NULL)
+  if (read_reloc_view (dso, n, &view))
+    return 1;
+
+  for (run = view.runs; run < view.runs + view.nruns; ++run)
     {
-      maxndx = data->d_size / dso->shdr[n].sh_entsize;
-      for (ndx = 0; ndx < maxndx; ++ndx)
+      ret = 0;
+      if (view.relr)
 	{
-	  gelfx_getrela (dso->elf, data, ndx, &rela);
-	  sec = addr_to_sec (dso, rela.r_offset);
-	  if (sec == -1)
-	    continue;
+	  adjust_reloc_words (&view, run, dso->shdr[n].sh_entsize, start,
+			      adjust);
+	  ret = 1;
+	}
+      else if (dso->arch->adjust_reloc_batch)
+	{
+	  ret = dso->arch->adjust_reloc_batch (&view, run, start, adjust);
+	  if (ret < 0)
+	    {
+	      free_reloc_view (&view);
+	      return 1;
+	    }
+	}
+
+      for (i = run->first; i < run->first + run->count; ++i)
+	{
+	  if (reloc_view_sec (&view, view.offset[i]) == -1)
+	    {
+	      /* A RELR entry only says which word to relocate, that word
+		 must exist.  */
+	      if (view.relr)
+		{
+		  error (0, 0, "%s: RELR relocation at 0x%08llx not in any section",
+			 dso->filename, (unsigned long long) view.offset[i]);
+		  free_reloc_view (&view);
+		  return 1;
+		}
+	      continue;
+	    }
+
+	  /* Batch hooks leave r_offset adjustment to us.  */
+	  if (ret == 0 && view.rela)
+	    {
+	      GElf_Rela rela;
 
-	  dso->arch->adjust_rela (dso, &rela, start, adjust);
-	  addr_adjust (rela.r_offset, start, adjust);
-	  gelfx_update_rela (dso->elf, data, ndx, &rela);
+	      reloc_view_get_rela (&view, i, &rela);
+	      dso->arch->adjust_rela (dso, &rela, start, adjust);
+	      reloc_view_set_rela (&view, i, &rela);
+	    }
+	  else if (ret == 0)
+	    {
+	      GElf_Rel rel;
+
+	      reloc_view_get_rel (&view, i, &rel);
+	      dso->arch->adjust_rel (dso, &rel, start, adjust);
+	      reloc_view_set_rel (&view, i, &rel);
+	    }
+	  addr_adjust (view.offset[i], start, adjust);
 	}
     }
 
-  elf_flagscn (scn, ELF_C_SET, ELF_F_DIRTY);
-  return 0;
+  ret = write_reloc_view (&view);
+  free_reloc_view (&view);
+  return ret;
 }
 
 int
@@ -1330,11 +1562,175 @@ adjust_dso_nonalloc (DSO *dso, int first, GElf_Addr start, GElf_Addr adjust)
   return adjust_nonalloc (dso, &dso->ehdr, dso->shdr, first, start, adjust);
 }
 
+/* Return non-zero if section N of DSO is a debugging section
+   with addresses in it.  */
+int
+debug_section_p (DSO *dso, int n)
+{
+  const char *name;
+
+  if ((dso->arch->machine == EM_ALPHA
+       && dso->shdr[n].sh_type == SHT_ALPHA_DEBUG)
+      || (dso->arch->machine == EM_MIPS
+	  && dso->shdr[n].sh_type == SHT_MIPS_DEBUG))
+    return 1;
+  if (dso->shdr[n].sh_type != SHT_PROGBITS
+      && dso->shdr[n].sh_type != SHT_MIPS_DWARF)
+    return 0;
+  name = strptr (dso, dso->ehdr.e_shstrndx, dso->shdr[n].sh_name);
+  return strcmp (name, ".stab") == 0 || strcmp (name, ".debug_info") == 0;
+}
+
+static int
+adjust_debug_section (DSO *dso, int n, GElf_Addr start, GElf_Addr adjust)
+{
+  const char *name;
+
+  if (dso->shdr[n].sh_type == SHT_ALPHA_DEBUG
+      || dso->shdr[n].sh_type == SHT_MIPS_DEBUG)
+    return adjust_mdebug (dso, n, start, adjust);
+  name = strptr (dso, dso->ehdr.e_shstrndx, dso->shdr[n].sh_name);
+  if (strcmp (name, ".stab") == 0)
+    return adjust_stabs (dso, n, start, adjust);
+  return adjust_dwarf2 (dso, n, start, adjust);
+}
+
+/* Store debug_delta into .gnu.prelink_debug section of DSO.  If it
+   has been removed meanwhile (e.g. by prelink_undo), bring the
+   debugging sections up to date instead.  */
+static int
+write_debug_delta (DSO *dso)
+{
+  Elf_Data *data;
+  int n;
+
+  if (! dso->has_debug_delta)
+    return 0;
+
+  n = find_debug_delta (dso);
+  if (n == 0)
+    {
+      if (apply_debug_delta (dso))
+	return 1;
+      dso->has_debug_delta = 0;
+      return 0;
+    }
+
+  data = elf_getdata (dso->scn[n], NULL);
+  assert (data != NULL && data->d_size == dso->shdr[n].sh_size);
+  if (data->d_size == 4)
+    {
+      if (buf_read_une32 (dso, data->d_buf) == dso->debug_delta)
+	return 0;
+      buf_write_ne32 (dso, data->d_buf, dso->debug_delta);
+    }
+  else
+    {
+      if (buf_read_une64 (dso, data->d_buf) == dso->debug_delta)
+	return 0;
+      buf_write_ne64 (dso, data->d_buf, dso->debug_delta);
+    }
+  elf_flagdata (data, ELF_C_SET, ELF_F_DIRTY);
+  return 0;
+}
+
+/* Turn section N of DSO, just added by reopen_dso, into a
+   .gnu.prelink_debug section with zero delta.  */
+int
+init_debug_delta (DSO *dso, int n)
+{
+  Elf_Scn *scn;
+  Elf_Data *data;
+  GElf_Addr newoffset;
+  size_t size = gelf_fsize (dso->elf, ELF_T_ADDR, 1, EV_CURRENT);
+
+  memset (&dso->shdr[n], 0, sizeof (GElf_Shdr));
+  dso->shdr[n].sh_name = shstrtabadd (dso, ".gnu.prelink_debug");
+  if (dso->shdr[n].sh_name == 0)
+    return 1;
+  dso->shdr[n].sh_type = SHT_PROGBITS;
+  dso->shdr[n].sh_offset = dso->shdr[n - 1].sh_offset;
+  if (dso->shdr[n - 1].sh_type != SHT_NOBITS)
+    dso->shdr[n].sh_offset += dso->shdr[n - 1].sh_size;
+  dso->shdr[n].sh_addralign = size;
+  dso->shdr[n].sh_entsize = size;
+  dso->shdr[n].sh_size = size;
+  newoffset = dso->shdr[n].sh_offset + size - 1;
+  newoffset &= ~(dso->shdr[n].sh_addralign - 1);
+  if (adjust_dso_nonalloc (dso, n + 1, dso->shdr[n].sh_offset,
+			   size + newoffset - dso->shdr[n].sh_offset))
+    return 1;
+  dso->shdr[n].sh_offset = newoffset;
+  scn = dso->scn[n];
+  data = elf_getdata (scn, NULL);
+  assert (data != NULL && elf_getdata (scn, data) == NULL);
+  free_section_data (dso, data->d_buf);
+  data->d_buf = calloc (1, size);
+  if (data->d_buf == NULL)
+    {
+      error (0, ENOMEM, "%s: Could not create .gnu.prelink_debug section",
+	     dso->filename);
+      return 1;
+    }
+  data->d_type = ELF_T_BYTE;
+  data->d_size = size;
+  data->d_off = 0;
+  data->d_align = size;
+  data->d_version = EV_CURRENT;
+  dso->has_debug_delta = 1;
+  dso->debug_delta = 0;
+  return 0;
+}
+
+/* Bring debugging sections of DSO up to date with the allocated
+   sections.  Addresses in them lag behind by debug_delta, that is,
+   they describe the object as if it was still debug_delta lower,
+   so pretend so while adjusting them.  */
+int
+apply_debug_delta (DSO *dso)
+{
+  GElf_Addr delta = dso->debug_delta, addr[dso->ehdr.e_shnum];
+  int i, ret = 0;
+
+  if (delta == 0)
+    return 0;
+
+  for (i = 1; i < dso->ehdr.e_shnum; i++)
+    {
+      addr[i] = dso->shdr[i].sh_addr;
+      if (RELOCATE_SCN (dso->shdr[i].sh_flags))
+	dso->shdr[i].sh_addr = (addr[i] - delta) & dso->mask;
+    }
+  dso->naddr_index = -1;
+
+  for (i = 1; i < dso->ehdr.e_shnum && ! ret; i++)
+    if (debug_section_p (dso, i))
+      ret = adjust_debug_section (dso, i, 0, delta);
+
+  for (i = 1; i < dso->ehdr.e_shnum; i++)
+    dso->shdr[i].sh_addr = addr[i];
+  dso->naddr_index = -1;
+
+  if (ret == 0)
+    dso->debug_delta = 0;
+  return ret;
+}
+
 /* Add ADJUST to all addresses above START.  */
 int
 adjust_dso (DSO *dso, GElf_Addr start, GElf_Addr adjust)
 {
-  int i;
+  int i, defer = 0;
+
+  /* Moving the whole object only changes how much its debugging
+     sections lag behind, anything else needs them up to date.  */
+  if (dso->has_debug_delta)
+    {
+      if (start == 0)
+	defer = 1;
+      else if (apply_debug_delta (dso))
+	return 1;
+    }
 
   if (dso->arch->arch_adjust
       && dso->arch->arch_adjust (dso, start, adjust))
@@ -1388,8 +1784,6 @@ adjust_dso (DSO *dso, GElf_Addr start, GElf_Addr adjust)
 
   for (i = 1; i < dso->ehdr.e_shnum; i++)
     {
-      const char *name;
-
       if (dso->arch->adjust_section)
 	{
 	  int ret = dso->arch->adjust_section (dso, i, start, adjust);
@@ -1399,18 +1793,14 @@ adjust_dso (DSO *dso, GElf_Addr start, GElf_Addr adjust)
 	  else if (ret)
 	    continue;
 	}
-      switch (dso->shdr[i].sh_type)
+      if (debug_section_p (dso, i))
 	{
-	case SHT_PROGBITS:
-	case SHT_MIPS_DWARF:
-	  name = strptr (dso, dso->ehdr.e_shstrndx, dso->shdr[i].sh_name);
-	  if (strcmp (name, ".stab") == 0
-	      && adjust_stabs (dso, i, start, adjust))
-	    return 1;
-	  if (strcmp (name, ".debug_info") == 0
-	      && adjust_dwarf2 (dso, i, start, adjust))
+	  if (! defer && adjust_debug_section (dso, i, start, adjust))
 	    return 1;
-	  break;
+	  continue;
+	}
+      switch (dso->shdr[i].sh_type)
+	{
 	case SHT_HASH:
 	case SHT_GNU_HASH:
 	case SHT_NOBITS:
@@ -1426,23 +1816,14 @@ adjust_dso (DSO *dso, GElf_Addr start, GElf_Addr adjust)
 	    return 1;
 	  break;
 	case SHT_REL:
-	  /* Don't adjust reloc sections for debug info.  */
-	  if (dso->shdr[i].sh_flags & SHF_ALLOC)
-	    if (adjust_rel (dso, i, start, adjust))
-	      return 1;
-	  break;
 	case SHT_RELA:
+	case SHT_RELR:
+	  /* Don't adjust reloc sections for debug info.  */
 	  if (dso->shdr[i].sh_flags & SHF_ALLOC)
-	    if (adjust_rela (dso, i, start, adjust))
+	    if (adjust_relocs (dso, i, start, adjust))
 	      return 1;
 	  break;
 	}
-      if ((dso->arch->machine == EM_ALPHA
-	   && dso->shdr[i].sh_type == SHT_ALPHA_DEBUG)
-	  || (dso->arch->machine == EM_MIPS
-	      && dso->shdr[i].sh_type == SHT_MIPS_DEBUG))
-	if (adjust_mdebug (dso, i, start, adjust))
-	  return 1;
     }
 
   for (i = 0; i < dso->ehdr.e_shnum; i++)
@@ -1461,10 +1842,18 @@ adjust_dso (DSO *dso, GElf_Addr start, GElf_Addr adjust)
 	    }
 	}
     }
+  dso->naddr_index = -1;
 
   addr_adjust (dso->base, start, adjust);
   addr_adjust (dso->end, start, adjust);
 
+  if (defer)
+    {
+      dso->debug_delta = (dso->debug_delta + adjust) & dso->mask;
+      if (! defer_debug && apply_debug_delta (dso))
+	return 1;
+    }
+
   if (start)
     {
       start = adjust_new_to_old (dso, start);
@@ -1597,7 +1986,8 @@ shstrtabadd (DSO *dso, const char *name)
 	return (r - (const char *) data->d_buf) - len;
     }
 
-  data->d_buf = realloc (data->d_buf, data->d_size + len + 1);
+  data->d_buf = realloc_section_data (dso, data->d_buf, data->d_size,
+				      data->d_size + len + 1);
   if (data->d_buf == NULL)
     {
       error (0, ENOMEM, "Cannot add new section name %s", name);
@@ -1627,13 +2017,82 @@ relocate_dso (DSO *dso, GElf_Addr base)
 
   if (! dso_is_rdwr (dso))
     {
-      if (reopen_dso (dso, NULL, NULL))
+      int i, n = 0;
+      struct section_move *move = NULL;
+
+      /* With --defer-debug, add .gnu.prelink_debug section where
+	 prelink_prepare would, after .gnu.prelink_undo.  */
+      if (defer_debug && ! dso->has_debug_delta)
+	{
+	  for (i = 1; i < dso->ehdr.e_shnum; ++i)
+	    if (debug_section_p (dso, i))
+	      break;
+	  if (i < dso->ehdr.e_shnum)
+	    {
+	      move = init_section_move (dso);
+	      if (move == NULL)
+		return 1;
+	      n = dso->ehdr.e_shstrndx;
+	      for (i = 1; i < dso->ehdr.e_shnum; ++i)
+		if (! strcmp (strptr (dso, dso->ehdr.e_shstrndx,
+				      dso->shdr[i].sh_name),
+			      ".gnu.prelink_undo"))
+		  n = i + 1;
+	      add_section (move, n);
+	    }
+	}
+
+      if (reopen_dso (dso, move, NULL))
+	{
+	  free (move);
+	  return 1;
+	}
+      free (move);
+      /* Lay the non-allocated sections out the way prelink would
+	 after prelink_prepare added the section, so that --verify
+	 can reproduce the file.  */
+      if (n && (init_debug_delta (dso, n)
+		|| recompute_nonalloc_offsets (dso)))
 	return 1;
     }
 
   return adjust_dso (dso, 0, base - dso->base);
 }
 
+/* Return non-zero if BUF points into the mapping of the input file
+   of DSO, so it must not be freed or reallocated.  */
+int
+dso_is_mapped (DSO *dso, const void *buf)
+{
+  return dso->map != NULL && buf != NULL
+	 && (const char *) buf >= (const char *) dso->map
+	 && (const char *) buf < (const char *) dso->map + dso->map_size;
+}
+
+/* Free section data BUF of DSO, unless it is in the mapping.  */
+void
+free_section_data (DSO *dso, void *buf)
+{
+  if (! dso_is_mapped (dso, buf))
+    free (buf);
+}
+
+/* Like realloc, but if BUF is in the mapping, copy its first OLDSIZE
+   bytes into a new buffer instead.  */
+void *
+realloc_section_data (DSO *dso, void *buf, size_t oldsize, size_t size)
+{
+  void *p;
+
+  if (! dso_is_mapped (dso, buf))
+    return realloc (buf, size);
+
+  p = malloc (size);
+  if (p != NULL)
+    memcpy (p, buf, oldsize < size ? oldsize : size);
+  return p;
+}
+
 static int
 close_dso_1 (DSO *dso)
 {
@@ -1648,21 +2107,24 @@ close_dso_1 (DSO *dso)
 
 	  while ((data = elf_getdata (scn, data)) != NULL)
 	    {
-	      free (data->d_buf);
+	      free_section_data (dso, data->d_buf);
 	      data->d_buf = NULL;
 	    }
 	}
     }
 
   elf_end (dso->elf);
-  fsync (dso->fd);
+  /* Unless reopen_dso has been called, dso->fd is read-only.  */
+  if (dso->elfro)
+    fsync (dso->fd);
   close (dso->fd);
   if (dso->elfro)
     {
       elf_end (dso->elfro);
-      fsync (dso->fdro);
       close (dso->fdro);
     }
+  if (dso->map)
+    munmap (dso->map, dso->map_size);
   if (dso->filename != dso->soname)
     free ((char *) dso->soname);
   free ((char *) dso->filename);
@@ -1670,6 +2132,7 @@ close_dso_1 (DSO *dso)
   free (dso->move);
   free (dso->adjust);
   free (dso->undo.d_buf);
+  invalidate_section_index (dso);
   free (dso);
   return 0;
 }
@@ -1690,7 +2153,8 @@ prepare_write_dso (DSO *dso)
 {
   int i;
 
-  if (check_dso (dso)
+  if (write_debug_delta (dso)
+      || check_dso (dso)
       || (dso->mdebug_orig_offset && finalize_mdebug (dso)))
     return 1;
 
@@ -1707,6 +2171,207 @@ prepare_write_dso (DSO *dso)
   return 0;
 }
 
+#ifdef HAVE_COPY_FILE_RANGE
+static int
+pwrite_all (int fd, const char *buf, size_t len, off_t off)
+{
+  ssize_t n;
+
+  while (len > 0)
+    {
+      n = TEMP_FAILURE_RETRY (pwrite (fd, buf, len, off));
+      if (n <= 0)
+	return -1;
+      buf += n;
+      len -= n;
+      off += n;
+    }
+  return 0;
+}
+
+/* Set once copy_file_range turned out not to work between the files.  */
+static int no_copy_file_range;
+
+/* Copy LEN bytes at INOFF in the input file of DSO to OUTOFF in
+   the output file.  MEM is the same bytes in the mapping.  */
+static int
+copy_dso_range (DSO *dso, const char *mem, size_t len, off_t outoff)
+{
+  loff_t in = mem - (const char *) dso->map, out = outoff;
+  ssize_t n;
+
+  while (len > 0 && ! no_copy_file_range)
+    {
+      n = copy_file_range (dso->fdro, &in, dso->fd, &out, len, 0);
+      if (n > 0)
+	{
+	  mem += n;
+	  len -= n;
+	  continue;
+	}
+      if (n == 0 || (errno != EINTR && errno != EAGAIN))
+	no_copy_file_range = 1;
+    }
+  return pwrite_all (dso->fd, mem, len, out);
+}
+
+/* Write LEN bytes of section data MEM to OFF in the output file of
+   DSO.  Runs of pages of the mapping of the input file which have
+   never been written to, according to PAGEMAP, still hold what is in
+   the file and are copied from there, letting the kernel share or
+   copy the blocks without dragging them through our memory.  */
+static int
+write_dso_range (DSO *dso, int pagemap, const char *mem, size_t len,
+		 off_t off)
+{
+  size_t pagesize = sysconf (_SC_PAGESIZE);
+  uint64_t entries[512];
+  uintptr_t page, first, last;
+  const char *run = mem, *end = mem + len;
+  int run_clean = -1;
+
+  if (len == 0)
+    return 0;
+  if (! dso_is_mapped (dso, mem) || ! dso_is_mapped (dso, end - 1))
+    return pwrite_all (dso->fd, mem, len, off);
+
+  first = (uintptr_t) mem / pagesize;
+  last = ((uintptr_t) end - 1) / pagesize;
+  for (page = first; page <= last; )
+    {
+      size_t n = last - page + 1, i;
+      ssize_t got;
+
+      if (n > sizeof (entries) / sizeof (entries[0]))
+	n = sizeof (entries) / sizeof (entries[0]);
+      got = pread (pagemap, entries, n * sizeof (entries[0]),
+		   page * sizeof (entries[0]));
+      if (got < (ssize_t) sizeof (entries[0]))
+	return pwrite_all (dso->fd, run, end - run, off + (run - mem));
+      n = got / sizeof (entries[0]);
+
+      for (i = 0; i < n; ++i, ++page)
+	{
+	  /* A page which is present but not file backed, or which has
+	     been swapped out, is our private copy.  */
+	  int clean = ! (((entries[i] >> 63) & 1) && ! ((entries[i] >> 61) & 1))
+		      && ! ((entries[i] >> 62) & 1);
+	  const char *p = page == first ? mem : (const char *) (page * pagesize);
+
+	  if (clean == run_clean)
+	    continue;
+	  if (run_clean != -1 && p > run
+	      && (run_clean
+		  ? copy_dso_range (dso, run, p - run, off + (run - mem))
+		  : pwrite_all (dso->fd, run, p - run, off + (run - mem))))
+	    return -1;
+	  run = p;
+	  run_clean = clean;
+	}
+    }
+
+  if (run_clean == 1)
+    return copy_dso_range (dso, run, end - run, off + (run - mem));
+  return pwrite_all (dso->fd, run, end - run, off + (run - mem));
+}
+
+/* Write DSO ourselves instead of through elf_update, copying whatever
+   is unchanged from the input file.  Return -1 if that can't be done,
+   otherwise like write_dso.  */
+static int
+write_dso_copy (DSO *dso)
+{
+  int pagemap, i, class = gelf_getclass (dso->elf);
+  off_t size;
+
+  /* Without the mapping there is nothing known to be unchanged.  The
+     in-memory data is written as is, so it must be in the byte order
+     of the file.  */
+  if (dso->map == NULL || dso->elfro == NULL
+      || dso->ehdr.e_ident[EI_DATA]
+	 != (__BYTE_ORDER == __LITTLE_ENDIAN ? ELFDATA2LSB : ELFDATA2MSB))
+    return -1;
+
+  pagemap = open ("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+  if (pagemap == -1)
+    return -1;
+
+  /* This does all the checking elf_update (, ELF_C_WRITE) does.  */
+  if (elf_update (dso->elf, ELF_C_NULL) == -1)
+    {
+      close (pagemap);
+      return 2;
+    }
+
+  size = dso->ehdr.e_ehsize;
+  if (dso->ehdr.e_phoff + dso->ehdr.e_phnum * dso->ehdr.e_phentsize > size)
+    size = dso->ehdr.e_phoff + dso->ehdr.e_phnum * dso->ehdr.e_phentsize;
+  if (dso->ehdr.e_shoff + dso->ehdr.e_shnum * dso->ehdr.e_shentsize > size)
+    size = dso->ehdr.e_shoff + dso->ehdr.e_shnum * dso->ehdr.e_shentsize;
+
+  for (i = 1; i < dso->ehdr.e_shnum; ++i)
+    {
+      Elf_Data *data = NULL;
+
+      if (dso->shdr[i].sh_type == SHT_NOBITS)
+	continue;
+      if (dso->shdr[i].sh_offset + dso->shdr[i].sh_size > size)
+	size = dso->shdr[i].sh_offset + dso->shdr[i].sh_size;
+      while ((data = elf_getdata (dso->scn[i], data)) != NULL)
+	if (data->d_buf != NULL
+	    && write_dso_range (dso, pagemap, data->d_buf, data->d_size,
+				dso->shdr[i].sh_offset + data->d_off))
+	  goto error_out;
+    }
+
+#define WRITE_HEADERS(nn) \
+  do									\
+    {									\
+      Elf##nn##_Ehdr *ehdr = elf##nn##_getehdr (dso->elf);		\
+      Elf##nn##_Phdr *phdr = elf##nn##_getphdr (dso->elf);		\
+									\
+      if (ehdr == NULL							\
+	  || pwrite_all (dso->fd, (char *) ehdr, sizeof (*ehdr), 0))	\
+	goto error_out;							\
+      if (ehdr->e_phnum							\
+	  && (phdr == NULL						\
+	      || pwrite_all (dso->fd, (char *) phdr,			\
+			     ehdr->e_phnum * sizeof (*phdr),		\
+			     ehdr->e_phoff)))				\
+	goto error_out;							\
+      for (i = 0; i < dso->ehdr.e_shnum; ++i)				\
+	{								\
+	  Elf##nn##_Shdr *shdr						\
+	    = elf##nn##_getshdr (elf_getscn (dso->elf, i));		\
+									\
+	  if (shdr == NULL						\
+	      || pwrite_all (dso->fd, (char *) shdr, sizeof (*shdr),	\
+			     dso->ehdr.e_shoff + i * sizeof (*shdr)))	\
+	    goto error_out;						\
+	}								\
+    }									\
+  while (0)
+
+  if (class == ELFCLASS32)
+    WRITE_HEADERS (32);
+  else
+    WRITE_HEADERS (64);
+#undef WRITE_HEADERS
+
+  /* Gaps read back as zeros, like libelf fills them.  */
+  if (ftruncate (dso->fd, size) < 0)
+    goto error_out;
+
+  close (pagemap);
+  return 0;
+
+error_out:
+  close (pagemap);
+  error (0, errno, "Could not write %s", dso->temp_filename);
+  return 1;
+}
+#endif
+
 int
 write_dso (DSO *dso)
 {
@@ -1716,6 +2381,15 @@ write_dso (DSO *dso)
   if (! dso->permissive && ELF_F_PERMISSIVE)
     elf_flagelf (dso->elf, ELF_C_CLR, ELF_F_PERMISSIVE);
 
+#ifdef HAVE_COPY_FILE_RANGE
+  {
+    int ret = write_dso_copy (dso);
+
+    if (ret != -1)
+      return ret;
+  }
+#endif
+
   if (elf_update (dso->elf, ELF_C_WRITE) == -1)
     return 2;
   return 0;
@@ -1840,11 +2514,38 @@ set_security_context (const char *temp_name, const char *name,
   return copy_xattrs (temp_name, name, ignore_errors);
 }
 
+/* Copy COUNT bytes from the start of FDIN to FDOUT.  */
+static ssize_t
+copy_fd (int fdout, int fdin, size_t count)
+{
+  off_t off = 0;
+
+#ifdef HAVE_COPY_FILE_RANGE
+  loff_t in = 0;
+  ssize_t n;
+
+  /* This can share the blocks on filesystems with reflinks.  */
+  while ((size_t) in < count)
+    {
+      n = copy_file_range (fdin, &in, fdout, NULL, count - in, 0);
+      if (n <= 0)
+	break;
+    }
+  if ((size_t) in == count)
+    return count;
+  off = in;
+  if (send_file (fdout, fdin, &off, count - in) != count - in)
+    return -1;
+  return count;
+#else
+  return send_file (fdout, fdin, &off, count);
+#endif
+}
+
 int
 copy_fd_to_file (int fdin, const char *name, struct stat64 *st)
 {
   struct stat64 stt;
-  off_t off = 0;
   int err, fdout;
   struct utimbuf u;
 
@@ -1854,7 +2555,7 @@ copy_fd_to_file (int fdin, const char *name, struct stat64 *st)
     fdout = open (name, O_WRONLY | O_CREAT, 0600);
   if (fdout != -1
       && fstat64 (fdin, &stt) >= 0
-      && send_file (fdout, fdin, &off, stt.st_size) == stt.st_size)
+      && copy_fd (fdout, fdin, stt.st_size) == stt.st_size)
     {
       if (fchown (fdout, st->st_uid, st->st_gid) >= 0)
 	fchmod (fdout, st->st_mode & 07777);
@@ -1984,6 +2685,12 @@ dso_has_bad_textrel (DSO *dso)
     case EM_S390:
     case EM_MIPS:
     case EM_ARM:
+#ifdef EM_AARCH64
+    case EM_AARCH64:
+#endif
+#ifdef EM_RISCV
+    case EM_RISCV:
+#endif
       return dynamic_info_is_set (dso, DT_TEXTREL);
 
     default:
@@ -0,0 +1,242 @@
+/* Copyright (C) 2026 Red Hat, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.  */
+
+#include <config.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "prelink.h"
+#include "hashtab.h"
+
+/* Cache of read-only handles of already prelinked libraries.
+   Building conflicts for an executable needs all its dependencies
+   opened, and the same few libraries are needed by nearly every
+   executable, so instead of opening and parsing them again each time
+   the handles are kept around and borrowed with borrow_dso.
+   Entries are keyed by device, inode and DT_CHECKSUM, so a library
+   which has been prelinked again is never handed out stale.
+   At most DSO_CACHE_IDLE handles which nobody has borrowed are kept
+   open, least recently used ones are closed first.  */
+
+#define DSO_CACHE_IDLE	64
+
+struct dso_cache_entry
+{
+  dev_t dev;
+  ino64_t ino;
+  GElf_Word checksum;
+  DSO *dso;
+  int refs;
+  /* Chain of unreferenced entries, most recently used first.  */
+  struct dso_cache_entry *prev, *next;
+};
+
+static pthread_mutex_t dso_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static htab_t dso_cache_htab;
+static htab_t dso_cache_dso_htab;
+static struct dso_cache_entry *dso_cache_idle_first, *dso_cache_idle_last;
+static int dso_cache_nidle;
+
+static hashval_t
+dso_cache_hash (const void *p)
+{
+  const struct dso_cache_entry *e = (const struct dso_cache_entry *) p;
+
+  return (e->ino ^ (e->ino >> 32) ^ e->dev ^ e->checksum) * 0x9e3779b1;
+}
+
+static int
+dso_cache_eq (const void *p, const void *q)
+{
+  const struct dso_cache_entry *a = (const struct dso_cache_entry *) p;
+  const struct dso_cache_entry *b = (const struct dso_cache_entry *) q;
+
+  return a->dev == b->dev && a->ino == b->ino && a->checksum == b->checksum;
+}
+
+static hashval_t
+dso_cache_dso_hash (const void *p)
+{
+  const struct dso_cache_entry *e = (const struct dso_cache_entry *) p;
+
+  return (hashval_t) ((uintptr_t) e->dso >> 4) * 0x9e3779b1;
+}
+
+static int
+dso_cache_dso_eq (const void *p, const void *q)
+{
+  return ((const struct dso_cache_entry *) p)->dso
+	 == ((const struct dso_cache_entry *) q)->dso;
+}
+
+static void
+dso_cache_unlink_idle (struct dso_cache_entry *e)
+{
+  if (e->prev)
+    e->prev->next = e->next;
+  else
+    dso_cache_idle_first = e->next;
+  if (e->next)
+    e->next->prev = e->prev;
+  else
+    dso_cache_idle_last = e->prev;
+  e->prev = e->next = NULL;
+  --dso_cache_nidle;
+}
+
+/* Remove unreferenced entry E from the cache and close its handle.
+   Called with dso_cache_lock held.  */
+static void
+dso_cache_evict (struct dso_cache_entry *e)
+{
+  dso_cache_unlink_idle (e);
+  htab_remove_elt (dso_cache_htab, e);
+  htab_remove_elt (dso_cache_dso_htab, e);
+  close_dso (e->dso);
+  free (e);
+}
+
+/* Return a read-only handle of already prelinked library ENT,
+   opening it unless it is in the cache.  The handle must not be
+   modified and must be given back with return_dso.  */
+DSO *
+borrow_dso (struct prelink_entry *ent)
+{
+  struct dso_cache_entry key, *e;
+  struct stat64 st;
+  void **slot;
+  DSO *dso;
+
+  key.dev = ent->dev;
+  key.ino = ent->ino;
+  key.checksum = ent->checksum;
+
+  pthread_mutex_lock (&dso_cache_lock);
+  if (dso_cache_htab != NULL
+      && (e = htab_find (dso_cache_htab, &key)) != NULL)
+    {
+      if (e->refs++ == 0)
+	dso_cache_unlink_idle (e);
+      pthread_mutex_unlock (&dso_cache_lock);
+      return e->dso;
+    }
+  pthread_mutex_unlock (&dso_cache_lock);
+
+  dso = open_dso (ent->filename);
+  if (dso == NULL)
+    return NULL;
+
+  /* If the file isn't what ENT describes, let the caller complain
+     about it, but don't cache it.  */
+  if (fstat64 (dso->fd, &st) < 0
+      || st.st_dev != ent->dev || st.st_ino != ent->ino
+      || dso->info_DT_CHECKSUM != ent->checksum)
+    return dso;
+
+  pthread_mutex_lock (&dso_cache_lock);
+  if (dso_cache_htab == NULL)
+    dso_cache_htab = htab_try_create (64, dso_cache_hash, dso_cache_eq,
+				      NULL);
+  if (dso_cache_dso_htab == NULL)
+    dso_cache_dso_htab = htab_try_create (64, dso_cache_dso_hash,
+					  dso_cache_dso_eq, NULL);
+  if (dso_cache_htab == NULL || dso_cache_dso_htab == NULL)
+    goto no_cache;
+
+  slot = htab_find_slot (dso_cache_htab, &key, INSERT);
+  if (slot == NULL)
+    goto no_cache;
+  if (*slot != NULL)
+    {
+      /* Somebody else has opened it in the mean time.  */
+      e = (struct dso_cache_entry *) *slot;
+      if (e->refs++ == 0)
+	dso_cache_unlink_idle (e);
+      pthread_mutex_unlock (&dso_cache_lock);
+      close_dso (dso);
+      return e->dso;
+    }
+
+  e = calloc (1, sizeof (*e));
+  if (e == NULL)
+    {
+      htab_clear_slot (dso_cache_htab, slot);
+      goto no_cache;
+    }
+  e->dev = key.dev;
+  e->ino = key.ino;
+  e->checksum = key.checksum;
+  e->dso = dso;
+  e->refs = 1;
+  *slot = e;
+  slot = htab_find_slot (dso_cache_dso_htab, e, INSERT);
+  if (slot == NULL)
+    {
+      htab_remove_elt (dso_cache_htab, e);
+      free (e);
+      goto no_cache;
+    }
+  *slot = e;
+  pthread_mutex_unlock (&dso_cache_lock);
+  return dso;
+
+no_cache:
+  pthread_mutex_unlock (&dso_cache_lock);
+  return dso;
+}
+
+/* Give back DSO obtained from borrow_dso.  */
+void
+return_dso (DSO *dso)
+{
+  struct dso_cache_entry key, *e = NULL;
+
+  key.dso = dso;
+  pthread_mutex_lock (&dso_cache_lock);
+  if (dso_cache_dso_htab != NULL)
+    e = htab_find (dso_cache_dso_htab, &key);
+  if (e == NULL)
+    {
+      pthread_mutex_unlock (&dso_cache_lock);
+      close_dso (dso);
+      return;
+    }
+
+  if (--e->refs == 0)
+    {
+      e->prev = NULL;
+      e->next = dso_cache_idle_first;
+      if (e->next)
+	e->next->prev = e;
+      else
+	dso_cache_idle_last = e;
+      dso_cache_idle_first = e;
+      if (++dso_cache_nidle > DSO_CACHE_IDLE)
+	dso_cache_evict (dso_cache_idle_last);
+    }
+  pthread_mutex_unlock (&dso_cache_lock);
+}
+
+/* Close all handles nobody has borrowed.  */
+void
+flush_dso_cache (void)
+{
+  pthread_mutex_lock (&dso_cache_lock);
+  while (dso_cache_idle_last != NULL)
+    dso_cache_evict (dso_cache_idle_last);
+  pthread_mutex_unlock (&dso_cache_lock);
+}
@@ -23,7 +23,10 @@
 #include <errno.h>
 #include <error.h>
 #include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <sys/types.h>
 
 #include "dwarf2.h"
@@ -46,6 +49,21 @@
   ret;					\
 })
 
+#define read_uleb128_64(ptr) ({		\
+  uint64_t ret = 0;			\
+  unsigned int c;			\
+  int shift = 0;			\
+  do					\
+    {					\
+      c = *ptr++;			\
+      if (shift < 64)			\
+	ret |= (uint64_t) (c & 0x7f) << shift; \
+      shift += 7;			\
+    } while (c & 0x80);			\
+					\
+  ret;					\
+})
+
 static uint16_t (*do_read_16) (unsigned char *ptr);
 static uint32_t (*do_read_32) (unsigned char *ptr);
 static uint64_t (*do_read_32_64) (unsigned char *ptr);
@@ -65,6 +83,12 @@ static int ptr_size;
   ret;					\
 })
 
+#define read_24(ptr) ({			\
+  uint32_t ret = buf_read_24 (ptr);	\
+  ptr += 3;				\
+  ret;					\
+})
+
 #define read_32(ptr) ({			\
   uint32_t ret = do_read_32 (ptr);	\
   ptr += 4;				\
@@ -95,6 +119,14 @@ buf_read_ube32_64 (unsigned char *p)
   return buf_read_ube32 (p);
 }
 
+static uint32_t
+buf_read_24 (unsigned char *p)
+{
+  if (do_read_16 == buf_read_ule16)
+    return p[0] | (p[1] << 8) | (p[2] << 16);
+  return (p[0] << 16) | (p[1] << 8) | p[2];
+}
+
 static void
 dwarf2_write_le32 (unsigned char *p, GElf_Addr val)
 {
@@ -164,6 +196,14 @@ static struct
 #define DEBUG_RANGES	10
 #define DEBUG_TYPES	11
 #define DEBUG_MACRO	12
+#define DEBUG_ADDR	13
+#define DEBUG_RNGLISTS	14
+#define DEBUG_LOCLISTS	15
+#define DEBUG_LINE_STR	16
+#define DEBUG_STR_OFFSETS 17
+#define DEBUG_NAMES	18
+#define DEBUG_GNU_PUBNAMES 19
+#define DEBUG_GNU_PUBTYPES 20
     { ".debug_info", NULL, 0, 0 },
     { ".debug_abbrev", NULL, 0, 0 },
     { ".debug_line", NULL, 0, 0 },
@@ -177,6 +217,14 @@ static struct
     { ".debug_ranges", NULL, 0, 0 },
     { ".debug_types", NULL, 0, 0 },
     { ".debug_macro", NULL, 0, 0 },
+    { ".debug_addr", NULL, 0, 0 },
+    { ".debug_rnglists", NULL, 0, 0 },
+    { ".debug_loclists", NULL, 0, 0 },
+    { ".debug_line_str", NULL, 0, 0 },
+    { ".debug_str_offsets", NULL, 0, 0 },
+    { ".debug_names", NULL, 0, 0 },
+    { ".debug_gnu_pubnames", NULL, 0, 0 },
+    { ".debug_gnu_pubtypes", NULL, 0, 0 },
     { NULL, NULL, 0 }
   };
 
@@ -194,11 +242,76 @@ struct abbrev_tag
     struct abbrev_attr attr[0];
   };
 
+struct dwarf2_ref
+  {
+    GElf_Addr offset;
+    GElf_Addr base;
+    /* OFFSET is a DW_FORM_rnglistx or DW_FORM_loclistx index.  */
+    int indexed;
+  };
+
 struct cu_data
   {
     GElf_Addr cu_entry_pc;
     GElf_Addr cu_low_pc;
     unsigned char cu_version;
+    /* cu_entry_pc resp. cu_low_pc is a .debug_addr index.  */
+    unsigned char cu_entry_pc_x, cu_low_pc_x;
+    /* DWARF 5 DW_AT_addr_base, DW_AT_rnglists_base and
+       DW_AT_loclists_base.  */
+    GElf_Addr cu_addr_base, cu_rnglists_base, cu_loclists_base;
+    int cu_type;
+    unsigned char *cu_ptr, *cu_end;
+    uint32_t cu_abbrev;
+    /* DW_AT_ranges and loclistptr attributes found in the CU.  The
+       lists they point to are adjusted once all CUs have been walked,
+       in CU order, as several CUs can share them.  */
+    struct dwarf2_ref *ranges, *locs;
+    size_t nranges, nlocs;
+    size_t ranges_alloced, locs_alloced;
+    /* .debug_addr offsets of DW_OP_constx and DW_OP_GNU_const_index
+       operands.  */
+    GElf_Addr *consts;
+    size_t nconsts, consts_alloced;
+  };
+
+/* .debug_info and .debug_types CUs, .debug_line units and the other
+   sections are independent of each other and are adjusted by a pool
+   of threads if there is enough debug info to make it worthwhile.
+   All the static variables in this file are only written before the
+   threads are started.  */
+
+#define DWARF2_TASK_CU		0
+#define DWARF2_TASK_LINE	1
+#define DWARF2_TASK_ARANGES	2
+#define DWARF2_TASK_FRAME	3
+#define DWARF2_TASK_RANGES	4
+#define DWARF2_TASK_LOC		5
+#define DWARF2_TASK_ADDR	6
+
+/* Debug info smaller than this is adjusted by the calling thread,
+   unless PRELINK_DWARF2_THREADS in the environment asks for a number
+   of threads.  */
+#define DWARF2_PARALLEL_MIN	(1024 * 1024)
+#define DWARF2_MAX_THREADS	16
+
+struct dwarf2_task
+  {
+    int kind;
+    unsigned char *ptr, *end;
+    struct cu_data *cu;
+  };
+
+struct dwarf2_pool
+  {
+    DSO *dso;
+    GElf_Addr start, adjust;
+    struct cu_data *cus;
+    int ncus, cus_alloced;
+    struct dwarf2_task *tasks;
+    int ntasks, tasks_alloced;
+    int next, failed;
+    pthread_mutex_t lock;
   };
 
 static hashval_t
@@ -277,8 +390,7 @@ no_memory:
 	    }
 	  form = read_uleb128 (ptr);
 	  if (form == 2
-	      || (form > DW_FORM_flag_present
-		  && form != DW_FORM_ref_sig8
+	      || (form > DW_FORM_addrx4
 		  && form != DW_FORM_GNU_ref_alt
 		  && form != DW_FORM_GNU_strp_alt))
 	    {
@@ -286,6 +398,8 @@ no_memory:
 	      htab_delete (h);
 	      return NULL;
 	    }
+	  if (form == DW_FORM_implicit_const)
+	    read_uleb128 (ptr); /* Skip the constant.  */
 
 	  t->attr[t->nattr].attr = attr;
 	  t->attr[t->nattr++].form = form;
@@ -303,6 +417,30 @@ no_memory:
   return h;
 }
 
+/* Remember that the .debug_addr entry at OFFSET is used by CU as
+   a constant.  */
+static int
+add_dwarf2_const (DSO *dso, struct cu_data *cu, GElf_Addr offset)
+{
+  if (cu->nconsts == cu->consts_alloced)
+    {
+      GElf_Addr *c;
+      size_t size = cu->consts_alloced ? cu->consts_alloced * 2 : 16;
+
+      c = realloc (cu->consts, size * sizeof (GElf_Addr));
+      if (c == NULL)
+	{
+	  error (0, ENOMEM, "%s: Could not record DWARF constant indexes",
+		 dso->filename);
+	  return 1;
+	}
+      cu->consts = c;
+      cu->consts_alloced = size;
+    }
+  cu->consts[cu->nconsts++] = offset;
+  return 0;
+}
+
 static int
 adjust_location_list (DSO *dso, struct cu_data *cu, unsigned char *ptr,
 		      size_t len, GElf_Addr start, GElf_Addr adjust)
@@ -318,7 +456,7 @@ adjust_location_list (DSO *dso, struct cu_data *cu, unsigned char *ptr,
 	{
 	case DW_OP_addr:
 	  addr = read_ptr (ptr);
-	  if (addr >= start && addr_to_sec (dso, addr) != -1)
+	  if (addr >= start && addr_in_dso_p (dso, addr))
 	    write_ptr (ptr - ptr_size, addr + adjust);
 	  break;
 	case DW_OP_deref:
@@ -403,11 +541,26 @@ adjust_location_list (DSO *dso, struct cu_data *cu, unsigned char *ptr,
 	case DW_OP_fbreg:
 	case DW_OP_GNU_convert:
 	case DW_OP_GNU_reinterpret:
+	case DW_OP_convert:
+	case DW_OP_reinterpret:
+	/* .debug_addr entries are adjusted by adjust_dwarf2_addr.  */
+	case DW_OP_addrx:
+	case DW_OP_GNU_addr_index:
 	  read_uleb128 (ptr);
 	  break;
+	case DW_OP_constx:
+	case DW_OP_GNU_const_index:
+	  /* The entry is a constant, not an address, make sure
+	     adjust_dwarf2_addr leaves it alone.  */
+	  addr = read_uleb128_64 (ptr);
+	  if (cu != NULL
+	      && add_dwarf2_const (dso, cu, cu->cu_addr_base + addr * ptr_size))
+	    return 1;
+	  break;
 	case DW_OP_bregx:
 	case DW_OP_bit_piece:
 	case DW_OP_GNU_regval_type:
+	case DW_OP_regval_type:
 	  read_uleb128 (ptr);
 	  read_uleb128 (ptr);
 	  break;
@@ -418,6 +571,7 @@ adjust_location_list (DSO *dso, struct cu_data *cu, unsigned char *ptr,
 	  }
 	  break;
 	case DW_OP_GNU_implicit_pointer:
+	case DW_OP_implicit_pointer:
 	  if (cu == NULL)
 	    {
 	      error (0, 0, "%s: DWARF DW_OP_GNU_implicit_pointer shouldn't"
@@ -431,6 +585,7 @@ adjust_location_list (DSO *dso, struct cu_data *cu, unsigned char *ptr,
 	  read_uleb128 (ptr);
 	  break;
         case DW_OP_GNU_entry_value:
+	case DW_OP_entry_value:
 	  {
 	    uint32_t leni = read_uleb128 (ptr);
 	    if ((end - ptr) < leni)
@@ -445,13 +600,28 @@ adjust_location_list (DSO *dso, struct cu_data *cu, unsigned char *ptr,
 	  }
 	  break;
         case DW_OP_GNU_const_type:
+	case DW_OP_const_type:
 	  read_uleb128 (ptr);
 	  ptr += *ptr + 1;
 	  break;
 	case DW_OP_GNU_deref_type:
+	case DW_OP_deref_type:
+	case DW_OP_xderef_type:
 	  ++ptr;
 	  read_uleb128 (ptr);
 	  break;
+	case DW_OP_GNU_variable_value:
+	  if (cu == NULL)
+	    {
+	      error (0, 0, "%s: DWARF DW_OP_GNU_variable_value shouldn't"
+		     " appear in .debug_frame", dso->filename);
+	      return 1;
+	    }
+	  if (cu->cu_version == 2)
+	    ptr += ptr_size;
+	  else
+	    ptr += 4;
+	  break;
 	default:
 	  error (0, 0, "%s: Unknown DWARF DW_OP_%d", dso->filename, op);
 	  return 1;
@@ -484,7 +654,7 @@ adjust_dwarf2_ranges (DSO *dso, GElf_Addr offset, GElf_Addr base,
     }
   endsec = ptr + debug_sections[DEBUG_RANGES].size;
   ptr += offset;
-  adjusted_base = (base && base >= start && addr_to_sec (dso, base) != -1);
+  adjusted_base = (base && base >= start && addr_in_dso_p (dso, base));
   while (ptr < endsec)
     {
       low = read_ptr (ptr);
@@ -496,26 +666,24 @@ adjust_dwarf2_ranges (DSO *dso, GElf_Addr offset, GElf_Addr base,
 	{
 	  base = high;
 	  adjusted_base = (base && base >= start
-			   && addr_to_sec (dso, base) != -1);
+			   && addr_in_dso_p (dso, base));
 	  if (adjusted_base)
 	    write_ptr (ptr - ptr_size, base + adjust);
 	}
       else if (! adjusted_base)
 	{
-	  if (base + low >= start && addr_to_sec (dso, base + low) != -1)
+	  if (base + low >= start && addr_in_dso_p (dso, base + low))
 	    {
 	      write_ptr (ptr - 2 * ptr_size, low + adjust);
 	      if (high == low)
 		write_ptr (ptr - ptr_size, high + adjust);
 	    }
 	  if (low != high && base + high >= start
-	      && addr_to_sec (dso, base + high - 1) != -1)
+	      && addr_in_dso_p (dso, base + high - 1))
 	    write_ptr (ptr - ptr_size, high + adjust);
 	}
     }
 
-  elf_flagscn (dso->scn[debug_sections[DEBUG_RANGES].sec], ELF_C_SET,
-	       ELF_F_DIRTY);
   return 0;
 }
 
@@ -544,7 +712,7 @@ adjust_dwarf2_loc (DSO *dso, struct cu_data *cu, GElf_Addr offset,
     }
   endsec = ptr + debug_sections[DEBUG_LOC].size;
   ptr += offset;
-  adjusted_base = (base && base >= start && addr_to_sec (dso, base) != -1);
+  adjusted_base = (base && base >= start && addr_in_dso_p (dso, base));
   while (ptr < endsec)
     {
       low = read_ptr (ptr);
@@ -556,11 +724,23 @@ adjust_dwarf2_loc (DSO *dso, struct cu_data *cu, GElf_Addr offset,
 	{
 	  base = high;
 	  adjusted_base = (base && base >= start
-			   && addr_to_sec (dso, base) != -1);
+			   && addr_in_dso_p (dso, base));
 	  if (adjusted_base)
 	    write_ptr (ptr - ptr_size, base + adjust);
 	  continue;
 	}
+      else if (! adjusted_base)
+	{
+	  if (base + low >= start && addr_in_dso_p (dso, base + low))
+	    {
+	      write_ptr (ptr - 2 * ptr_size, low + adjust);
+	      if (high == low)
+		write_ptr (ptr - ptr_size, high + adjust);
+	    }
+	  if (low != high && base + high >= start
+	      && addr_in_dso_p (dso, base + high - 1))
+	    write_ptr (ptr - ptr_size, high + adjust);
+	}
       len = read_16 (ptr);
       assert (ptr + len <= endsec);
 
@@ -570,18 +750,449 @@ adjust_dwarf2_loc (DSO *dso, struct cu_data *cu, GElf_Addr offset,
       ptr += len;
     }
 
-  elf_flagscn (dso->scn[debug_sections[DEBUG_LOC].sec], ELF_C_SET,
-	       ELF_F_DIRTY);
+  return 0;
+}
+
+/* Store VAL as ULEB128 into the LEN bytes at PTR, using redundant
+   continuation bytes if needed.  Return nonzero if VAL needs more
+   than LEN bytes.  */
+static int
+write_uleb128_fixed (unsigned char *ptr, size_t len, GElf_Addr val)
+{
+  size_t i;
+
+  if (len < 10 && (val >> (7 * len)) != 0)
+    return 1;
+  for (i = 0; i < len; ++i)
+    {
+      ptr[i] = (val & 0x7f) | (i + 1 < len ? 0x80 : 0);
+      val >>= 7;
+    }
+  return 0;
+}
+
+/* Adjust DW_RLE_offset_pair or DW_LLE_offset_pair at PTR, relative
+   to base address BASE which is not being adjusted, i.e. usually
+   absolute addresses.  Return the end of the pair or NULL.  */
+static unsigned char *
+adjust_dwarf2_offset_pair (DSO *dso, unsigned char *ptr, GElf_Addr base,
+			   GElf_Addr start, GElf_Addr adjust)
+{
+  unsigned char *lowp = ptr, *highp;
+  GElf_Addr low, high;
+  int err = 0;
+
+  low = read_uleb128_64 (ptr);
+  highp = ptr;
+  high = read_uleb128_64 (ptr);
+  if (base + low >= start && addr_in_dso_p (dso, base + low))
+    {
+      err |= write_uleb128_fixed (lowp, highp - lowp, low + adjust);
+      if (high == low)
+	err |= write_uleb128_fixed (highp, ptr - highp, high + adjust);
+    }
+  if (low != high && base + high >= start
+      && addr_in_dso_p (dso, base + high - 1))
+    err |= write_uleb128_fixed (highp, ptr - highp, high + adjust);
+  if (err)
+    {
+      error (0, 0, "%s: DWARF offset pair too short to be adjusted in place",
+	     dso->filename);
+      return NULL;
+    }
+  return ptr;
+}
+
+/* Adjust DWARF 5 range list at OFFSET into .debug_rnglists.  */
+static int
+adjust_dwarf2_rnglist (DSO *dso, GElf_Addr offset, GElf_Addr base,
+		       GElf_Addr start, GElf_Addr adjust)
+{
+  unsigned char *ptr, *endsec;
+  GElf_Addr low, high;
+  int adjusted_base;
+
+  ptr = debug_sections[DEBUG_RNGLISTS].data;
+  if (ptr == NULL)
+    {
+      error (0, 0, "%s: DW_AT_ranges attribute, yet no .debug_rnglists"
+	     " section", dso->filename);
+      return 1;
+    }
+  if (offset >= debug_sections[DEBUG_RNGLISTS].size)
+    {
+      error (0, 0,
+	     "%s: DW_AT_ranges offset %Ld outside of .debug_rnglists section",
+	     dso->filename, (long long) offset);
+      return 1;
+    }
+  endsec = ptr + debug_sections[DEBUG_RNGLISTS].size;
+  ptr += offset;
+  adjusted_base = (base && base >= start && addr_in_dso_p (dso, base));
+  while (ptr < endsec)
+    {
+      switch (*ptr++)
+	{
+	case DW_RLE_end_of_list:
+	  return 0;
+	case DW_RLE_base_addressx:
+	  /* Adjusted in .debug_addr.  */
+	  read_uleb128 (ptr);
+	  adjusted_base = 1;
+	  break;
+	case DW_RLE_startx_endx:
+	case DW_RLE_startx_length:
+	  read_uleb128 (ptr);
+	  read_uleb128_64 (ptr);
+	  break;
+	case DW_RLE_offset_pair:
+	  if (adjusted_base)
+	    {
+	      read_uleb128_64 (ptr);
+	      read_uleb128_64 (ptr);
+	    }
+	  else
+	    {
+	      ptr = adjust_dwarf2_offset_pair (dso, ptr, base, start, adjust);
+	      if (ptr == NULL)
+		return 1;
+	    }
+	  break;
+	case DW_RLE_base_address:
+	  base = read_ptr (ptr);
+	  adjusted_base = (base && base >= start
+			   && addr_in_dso_p (dso, base));
+	  if (adjusted_base)
+	    write_ptr (ptr - ptr_size, base + adjust);
+	  break;
+	case DW_RLE_start_end:
+	  low = read_ptr (ptr);
+	  high = read_ptr (ptr);
+	  if (low >= start && addr_in_dso_p (dso, low))
+	    {
+	      write_ptr (ptr - 2 * ptr_size, low + adjust);
+	      if (high == low)
+		write_ptr (ptr - ptr_size, high + adjust);
+	    }
+	  if (low != high && high >= start
+	      && addr_in_dso_p (dso, high - 1))
+	    write_ptr (ptr - ptr_size, high + adjust);
+	  break;
+	case DW_RLE_start_length:
+	  low = read_ptr (ptr);
+	  if (low >= start && addr_in_dso_p (dso, low))
+	    write_ptr (ptr - ptr_size, low + adjust);
+	  read_uleb128_64 (ptr);
+	  break;
+	default:
+	  error (0, 0, "%s: Unknown DWARF DW_RLE_%d", dso->filename, ptr[-1]);
+	  return 1;
+	}
+    }
+
+  return 0;
+}
+
+/* Adjust DWARF 5 location list at OFFSET into .debug_loclists.  */
+static int
+adjust_dwarf2_loclist (DSO *dso, struct cu_data *cu, GElf_Addr offset,
+		       GElf_Addr base, GElf_Addr start, GElf_Addr adjust)
+{
+  unsigned char *ptr, *endsec;
+  GElf_Addr low, high;
+  int adjusted_base;
+  size_t len;
+
+  ptr = debug_sections[DEBUG_LOCLISTS].data;
+  if (ptr == NULL)
+    {
+      error (0, 0, "%s: loclistptr attribute, yet no .debug_loclists section",
+	     dso->filename);
+      return 1;
+    }
+  if (offset >= debug_sections[DEBUG_LOCLISTS].size)
+    {
+      error (0, 0,
+	     "%s: loclistptr offset %Ld outside of .debug_loclists section",
+	     dso->filename, (long long) offset);
+      return 1;
+    }
+  endsec = ptr + debug_sections[DEBUG_LOCLISTS].size;
+  ptr += offset;
+  adjusted_base = (base && base >= start && addr_in_dso_p (dso, base));
+  while (ptr < endsec)
+    {
+      switch (*ptr++)
+	{
+	case DW_LLE_end_of_list:
+	  return 0;
+	case DW_LLE_base_addressx:
+	  /* Adjusted in .debug_addr.  */
+	  read_uleb128 (ptr);
+	  adjusted_base = 1;
+	  continue;
+	case DW_LLE_base_address:
+	  base = read_ptr (ptr);
+	  adjusted_base = (base && base >= start
+			   && addr_in_dso_p (dso, base));
+	  if (adjusted_base)
+	    write_ptr (ptr - ptr_size, base + adjust);
+	  continue;
+	case DW_LLE_GNU_view_pair:
+	  read_uleb128 (ptr);
+	  read_uleb128 (ptr);
+	  continue;
+	case DW_LLE_startx_endx:
+	case DW_LLE_startx_length:
+	  read_uleb128 (ptr);
+	  read_uleb128_64 (ptr);
+	  break;
+	case DW_LLE_offset_pair:
+	  if (adjusted_base)
+	    {
+	      read_uleb128_64 (ptr);
+	      read_uleb128_64 (ptr);
+	    }
+	  else
+	    {
+	      ptr = adjust_dwarf2_offset_pair (dso, ptr, base, start, adjust);
+	      if (ptr == NULL)
+		return 1;
+	    }
+	  break;
+	case DW_LLE_default_location:
+	  break;
+	case DW_LLE_start_end:
+	  low = read_ptr (ptr);
+	  high = read_ptr (ptr);
+	  if (low >= start && addr_in_dso_p (dso, low))
+	    {
+	      write_ptr (ptr - 2 * ptr_size, low + adjust);
+	      if (high == low)
+		write_ptr (ptr - ptr_size, high + adjust);
+	    }
+	  if (low != high && high >= start
+	      && addr_in_dso_p (dso, high - 1))
+	    write_ptr (ptr - ptr_size, high + adjust);
+	  break;
+	case DW_LLE_start_length:
+	  low = read_ptr (ptr);
+	  if (low >= start && addr_in_dso_p (dso, low))
+	    write_ptr (ptr - ptr_size, low + adjust);
+	  read_uleb128_64 (ptr);
+	  break;
+	default:
+	  error (0, 0, "%s: Unknown DWARF DW_LLE_%d", dso->filename, ptr[-1]);
+	  return 1;
+	}
+
+      /* Counted location description.  */
+      len = read_uleb128 (ptr);
+      if (len > (size_t) (endsec - ptr))
+	{
+	  error (0, 0, "%s: .debug_loclists location description too long",
+		 dso->filename);
+	  return 1;
+	}
+      if (adjust_location_list (dso, cu, ptr, len, start, adjust))
+	return 1;
+      ptr += len;
+    }
+
+  return 0;
+}
+
+static int
+addr_cmp (const void *A, const void *B)
+{
+  GElf_Addr a = * (const GElf_Addr *) A;
+  GElf_Addr b = * (const GElf_Addr *) B;
+
+  if (a < b)
+    return -1;
+  return a > b;
+}
+
+/* Adjust all addresses in .debug_addr.  DWARF 5 DIEs, range and location
+   lists refer to addresses by their index into this table, so once it
+   is adjusted they need no further work.  Entries used by DW_OP_constx
+   or DW_OP_GNU_const_index hold constants like TLS offsets and are
+   left alone, so the CUs must have been walked already.  */
+static int
+adjust_dwarf2_addr (struct dwarf2_pool *pool)
+{
+  DSO *dso = pool->dso;
+  GElf_Addr start = pool->start, adjust = pool->adjust;
+  unsigned char *ptr = debug_sections[DEBUG_ADDR].data;
+  unsigned char *endsec = ptr + debug_sections[DEBUG_ADDR].size;
+  unsigned char *endcu;
+  GElf_Addr addr, offset, *consts = NULL;
+  size_t nconsts = 0;
+  uint32_t value;
+  int i, ret = 1;
+
+  for (i = 0; i < pool->ncus; ++i)
+    nconsts += pool->cus[i].nconsts;
+  if (nconsts)
+    {
+      consts = malloc (nconsts * sizeof (GElf_Addr));
+      if (consts == NULL)
+	{
+	  error (0, ENOMEM, "%s: Could not record DWARF constant indexes",
+		 dso->filename);
+	  return 1;
+	}
+      nconsts = 0;
+      for (i = 0; i < pool->ncus; ++i)
+	{
+	  memcpy (consts + nconsts, pool->cus[i].consts,
+		  pool->cus[i].nconsts * sizeof (GElf_Addr));
+	  nconsts += pool->cus[i].nconsts;
+	}
+      qsort (consts, nconsts, sizeof (GElf_Addr), addr_cmp);
+    }
+
+  while (ptr < endsec)
+    {
+      endcu = ptr + 4;
+      endcu += read_32 (ptr);
+      if (endcu == ptr + 0xffffffff)
+	{
+	  error (0, 0, "%s: 64-bit DWARF not supported", dso->filename);
+	  goto out;
+	}
+
+      if (endcu > endsec)
+	{
+	  error (0, 0, "%s: .debug_addr table does not fit into section",
+		 dso->filename);
+	  goto out;
+	}
+
+      value = read_16 (ptr);
+      if (value != 5)
+	{
+	  error (0, 0, "%s: DWARF version %d unhandled", dso->filename,
+		 value);
+	  goto out;
+	}
+
+      if (ptr[0] != ptr_size || ptr[1])
+	{
+	  error (0, 0, "%s: Unsupported .debug_addr address size %d or segment size %d",
+		 dso->filename, ptr[0], ptr[1]);
+	  goto out;
+	}
+
+      ptr += 2;
+      while (ptr + ptr_size <= endcu)
+	{
+	  offset = ptr - debug_sections[DEBUG_ADDR].data;
+	  addr = read_ptr (ptr);
+	  if (nconsts
+	      && bsearch (&offset, consts, nconsts, sizeof (GElf_Addr),
+			  addr_cmp) != NULL)
+	    continue;
+	  /* The entry might be the end of a range, which need not be
+	     inside of any section.  */
+	  if (addr >= start
+	      && (addr_in_dso_p (dso, addr)
+		  || (addr > start && addr_in_dso_p (dso, addr - 1))))
+	    write_ptr (ptr - ptr_size, addr + adjust);
+	}
+      ptr = endcu;
+    }
+
+  ret = 0;
+out:
+  free (consts);
+  return ret;
+}
+
+/* Return the entry INDEX of CU's .debug_addr table, or 0 if there is
+   none.  */
+static GElf_Addr
+read_dwarf2_addrx (struct cu_data *cu, GElf_Addr index)
+{
+  GElf_Addr offset = cu->cu_addr_base + index * ptr_size;
+
+  if (debug_sections[DEBUG_ADDR].data == NULL
+      || offset + ptr_size > debug_sections[DEBUG_ADDR].size)
+    return 0;
+  return do_read_ptr (debug_sections[DEBUG_ADDR].data + offset);
+}
+
+/* Return the base address of DWARF 5 CU.  */
+static GElf_Addr
+dwarf2_cu_base (struct cu_data *cu)
+{
+  if (cu->cu_entry_pc != ~ (GElf_Addr) 0)
+    return cu->cu_entry_pc_x
+	   ? read_dwarf2_addrx (cu, cu->cu_entry_pc) : cu->cu_entry_pc;
+  if (cu->cu_low_pc != ~ (GElf_Addr) 0)
+    return cu->cu_low_pc_x
+	   ? read_dwarf2_addrx (cu, cu->cu_low_pc) : cu->cu_low_pc;
+  return 0;
+}
+
+/* Turn DW_FORM_rnglistx or DW_FORM_loclistx index in REF into an offset
+   into section SEC, using the offsets table at LISTS_BASE.  */
+static int
+dwarf2_list_offset (DSO *dso, int sec, GElf_Addr lists_base,
+		    struct dwarf2_ref *ref)
+{
+  GElf_Addr offset = lists_base + ref->offset * 4;
+
+  if (debug_sections[sec].data == NULL
+      || offset + 4 > debug_sections[sec].size)
+    {
+      error (0, 0, "%s: DWARF list index %Ld outside of %s section",
+	     dso->filename, (long long) ref->offset, debug_sections[sec].name);
+      return 1;
+    }
+  ref->offset = lists_base + do_read_32 (debug_sections[sec].data + offset);
+  ref->indexed = 0;
+  return 0;
+}
+
+/* Remember that the list at OFFSET into .debug_ranges or .debug_loc
+   with base address BASE needs adjusting.  If INDEXED, OFFSET is
+   a DWARF 5 index into .debug_rnglists or .debug_loclists offsets.  */
+static int
+add_dwarf2_ref (DSO *dso, struct dwarf2_ref **refs, size_t *nrefs,
+		size_t *alloced, GElf_Addr offset, GElf_Addr base, int indexed)
+{
+  if (*nrefs == *alloced)
+    {
+      struct dwarf2_ref *r;
+      size_t size = *alloced ? *alloced * 2 : 16;
+
+      r = realloc (*refs, size * sizeof (struct dwarf2_ref));
+      if (r == NULL)
+	{
+	  error (0, ENOMEM, "%s: Could not record DWARF list offsets",
+		 dso->filename);
+	  return 1;
+	}
+      *refs = r;
+      *alloced = size;
+    }
+  (*refs)[*nrefs].offset = offset;
+  (*refs)[*nrefs].base = base;
+  (*refs)[*nrefs].indexed = indexed;
+  ++*nrefs;
   return 0;
 }
 
 static unsigned char *
 adjust_attributes (DSO *dso, unsigned char *ptr, struct abbrev_tag *t,
-		   struct cu_data *cu,
-		   GElf_Addr start, GElf_Addr adjust, htab_t offset_hash)
+		   struct cu_data *cu, GElf_Addr start, GElf_Addr adjust)
 {
-  int i;
+  int i, indexed;
   GElf_Addr addr;
+  int cu_tag = (t->tag == DW_TAG_compile_unit
+		|| t->tag == DW_TAG_partial_unit
+		|| t->tag == DW_TAG_skeleton_unit);
 
   for (i = 0; i < t->nattr; ++i)
     {
@@ -608,10 +1219,19 @@ adjust_attributes (DSO *dso, unsigned char *ptr, struct abbrev_tag *t,
 	    case DW_AT_use_location:
 	    case DW_AT_vtable_elem_location:
 	    case DW_AT_ranges:
-	      if (form == DW_FORM_data4 || form == DW_FORM_sec_offset)
+	      indexed = 0;
+	      if (form == DW_FORM_sec_offset
+		  || (cu->cu_version < 5 && form == DW_FORM_data4))
 		addr = read_32 (ptr), ptr -= 4;
-	      else if (form == DW_FORM_data8)
+	      else if (cu->cu_version < 5 && form == DW_FORM_data8)
 		addr = read_64 (ptr), ptr -= 8;
+	      else if (form == DW_FORM_loclistx || form == DW_FORM_rnglistx)
+		{
+		  unsigned char *p = ptr;
+
+		  addr = read_uleb128_64 (p);
+		  indexed = 1;
+		}
 	      else
 		break;
 	      {
@@ -625,41 +1245,36 @@ adjust_attributes (DSO *dso, unsigned char *ptr, struct abbrev_tag *t,
 		  base = 0;
 		if (t->attr[i].attr == DW_AT_ranges)
 		  {
-		    if (adjust_dwarf2_ranges (dso, addr, base, start, adjust))
+		    if (add_dwarf2_ref (dso, &cu->ranges, &cu->nranges,
+					&cu->ranges_alloced, addr, base,
+					indexed))
 		      return NULL;
 		  }
-		else
-		  {
-		    GElf_Addr *offsetp = malloc (sizeof (addr));
-		    void **slot;
-		    if (offsetp == NULL)
-		      return NULL;
-		    *offsetp = addr;
-		    slot = htab_find_slot (offset_hash, offsetp, INSERT);
-		    if (slot == NULL)
-		      {
-			free (offsetp);
-			return NULL;
-		      }
-		    if (*slot == NULL)
-		      {
-			*slot = offsetp;
-			if (adjust_dwarf2_loc (dso, cu, addr, base,
-					       start, adjust))
-			  return NULL;
-		      }
-		    else
-		      free (offsetp);
-		  }
+		else if (add_dwarf2_ref (dso, &cu->locs, &cu->nlocs,
+					 &cu->locs_alloced, addr, base,
+					 indexed))
+		  return NULL;
 	      }
 	      break;
+	    case DW_AT_addr_base:
+	    case DW_AT_rnglists_base:
+	    case DW_AT_loclists_base:
+	      if (form != DW_FORM_sec_offset)
+		break;
+	      addr = read_32 (ptr), ptr -= 4;
+	      if (t->attr[i].attr == DW_AT_addr_base)
+		cu->cu_addr_base = addr;
+	      else if (t->attr[i].attr == DW_AT_rnglists_base)
+		cu->cu_rnglists_base = addr;
+	      else
+		cu->cu_loclists_base = addr;
+	      break;
 	    }
 	  switch (form)
 	    {
 	    case DW_FORM_addr:
 	      addr = read_ptr (ptr);
-	      if (t->tag == DW_TAG_compile_unit
-		  || t->tag == DW_TAG_partial_unit)
+	      if (cu_tag)
 		{
 		  if (t->attr[i].attr == DW_AT_entry_pc)
 		    cu->cu_entry_pc = addr;
@@ -669,38 +1284,81 @@ adjust_attributes (DSO *dso, unsigned char *ptr, struct abbrev_tag *t,
 		    break;
 		}
 	      if (addr >= start
-		  && addr_to_sec (dso,
-				  ((t->attr[i].attr == DW_AT_high_pc
-				    && addr > start)
-				   ? addr - 1
-				   : addr)) != -1)
+		  && addr_in_dso_p (dso,
+				    ((t->attr[i].attr == DW_AT_high_pc
+				      && addr > start)
+				     ? addr - 1
+				     : addr)))
 		write_ptr (ptr - ptr_size, addr + adjust);
 	      break;
+	    case DW_FORM_addrx:
+	    case DW_FORM_addrx1:
+	    case DW_FORM_addrx2:
+	    case DW_FORM_addrx3:
+	    case DW_FORM_addrx4:
+	      /* The .debug_addr entry is adjusted by adjust_dwarf2_addr,
+		 just remember the CU base address index.  */
+	      if (form == DW_FORM_addrx)
+		addr = read_uleb128_64 (ptr);
+	      else if (form == DW_FORM_addrx1)
+		addr = read_1 (ptr);
+	      else if (form == DW_FORM_addrx2)
+		addr = read_16 (ptr);
+	      else if (form == DW_FORM_addrx3)
+		addr = read_24 (ptr);
+	      else
+		addr = read_32 (ptr);
+	      if (cu_tag && t->attr[i].attr == DW_AT_entry_pc)
+		{
+		  cu->cu_entry_pc = addr;
+		  cu->cu_entry_pc_x = 1;
+		}
+	      else if (cu_tag && t->attr[i].attr == DW_AT_low_pc)
+		{
+		  cu->cu_low_pc = addr;
+		  cu->cu_low_pc_x = 1;
+		}
+	      break;
 	    case DW_FORM_flag_present:
+	    case DW_FORM_implicit_const:
 	      break;
 	    case DW_FORM_ref1:
 	    case DW_FORM_flag:
 	    case DW_FORM_data1:
+	    case DW_FORM_strx1:
 	      ++ptr;
 	      break;
 	    case DW_FORM_ref2:
 	    case DW_FORM_data2:
+	    case DW_FORM_strx2:
 	      ptr += 2;
 	      break;
+	    case DW_FORM_strx3:
+	      ptr += 3;
+	      break;
 	    case DW_FORM_ref4:
 	    case DW_FORM_GNU_ref_alt:
 	    case DW_FORM_data4:
 	    case DW_FORM_sec_offset:
+	    case DW_FORM_ref_sup4:
+	    case DW_FORM_strx4:
 	      ptr += 4;
 	      break;
 	    case DW_FORM_ref8:
 	    case DW_FORM_data8:
 	    case DW_FORM_ref_sig8:
+	    case DW_FORM_ref_sup8:
 	      ptr += 8;
 	      break;
+	    case DW_FORM_data16:
+	      ptr += 16;
+	      break;
 	    case DW_FORM_sdata:
 	    case DW_FORM_ref_udata:
 	    case DW_FORM_udata:
+	    case DW_FORM_strx:
+	    case DW_FORM_loclistx:
+	    case DW_FORM_rnglistx:
 	      read_uleb128 (ptr);
 	      break;
 	    case DW_FORM_ref_addr:
@@ -711,6 +1369,8 @@ adjust_attributes (DSO *dso, unsigned char *ptr, struct abbrev_tag *t,
 	      break;
 	    case DW_FORM_strp:
 	    case DW_FORM_GNU_strp_alt:
+	    case DW_FORM_strp_sup:
+	    case DW_FORM_line_strp:
 	      ptr += 4;
 	      break;
 	    case DW_FORM_string:
@@ -773,11 +1433,16 @@ adjust_attributes (DSO *dso, unsigned char *ptr, struct abbrev_tag *t,
 		case DW_AT_GNU_call_site_data_value:
 		case DW_AT_GNU_call_site_target:
 		case DW_AT_GNU_call_site_target_clobbered:
+		case DW_AT_call_value:
+		case DW_AT_call_data_value:
+		case DW_AT_call_target:
+		case DW_AT_call_target_clobbered:
+		case DW_AT_call_data_location:
 		  if (adjust_location_list (dso, cu, ptr, len, start, adjust))
 		    return NULL;
 		  break;
 		default:
-		  if (t->attr[i].attr <= DW_AT_linkage_name
+		  if (t->attr[i].attr <= DW_AT_loclists_base
 		      || (t->attr[i].attr >= DW_AT_MIPS_fde
 			  && t->attr[i].attr <= DW_AT_MIPS_has_inlines)
 		      || (t->attr[i].attr >= DW_AT_sf_names
@@ -803,91 +1468,62 @@ adjust_attributes (DSO *dso, unsigned char *ptr, struct abbrev_tag *t,
   return ptr;
 }
 
+/* Adjust .debug_line unit from PTR to ENDCU, whose header has been
+   checked by scan_dwarf2_line.  */
 static int
-adjust_dwarf2_line (DSO *dso, GElf_Addr start, GElf_Addr adjust)
+adjust_dwarf2_line (DSO *dso, unsigned char *ptr, unsigned char *endcu,
+		    GElf_Addr start, GElf_Addr adjust)
 {
-  unsigned char *ptr = debug_sections[DEBUG_LINE].data;
-  unsigned char *endsec = ptr + debug_sections[DEBUG_LINE].size;
-  unsigned char *endcu, *endprol;
+  unsigned char *endprol;
   unsigned char opcode_base, *opcode_lengths, op;
   uint32_t value;
   GElf_Addr addr;
   int i;
 
-  while (ptr < endsec)
-    {
-      endcu = ptr + 4;
-      endcu += read_32 (ptr);
-      if (endcu == ptr + 0xffffffff)
-	{
-	  error (0, 0, "%s: 64-bit DWARF not supported", dso->filename);
-	  return 1;
-	}
-
-      if (endcu > endsec)
-	{
-	  error (0, 0, "%s: .debug_line CU does not fit into section",
-		 dso->filename);
-	  return 1;
-	}
+  ptr += 4;
+  value = read_16 (ptr);
+  if (value >= 5)
+    ptr += 2; /* Skip address_size and segment_selector_size.  */
+  endprol = ptr + 4;
+  endprol += read_32 (ptr);
 
-      value = read_16 (ptr);
-      if (value != 2 && value != 3 && value != 4)
-	{
-	  error (0, 0, "%s: DWARF version %d unhandled", dso->filename,
-		 value);
-	  return 1;
-	}
+  opcode_base = ptr[4 + (value >= 4)];
+  opcode_lengths = ptr + 4 + (value >= 4);
 
-      endprol = ptr + 4;
-      endprol += read_32 (ptr);
-      if (endprol > endcu)
+  ptr = endprol;
+  while (ptr < endcu)
+    {
+      op = *ptr++;
+      if (op >= opcode_base)
+	continue;
+      if (op == DW_LNS_extended_op)
 	{
-	  error (0, 0, "%s: .debug_line CU prologue does not fit into CU",
-		 dso->filename);
-	  return 1;
-	}
+	  unsigned int len = read_uleb128 (ptr);
 
-      opcode_base = ptr[4 + (value >= 4)];
-      opcode_lengths = ptr + 4 + (value >= 4);
-
-      ptr = endprol;
-      while (ptr < endcu)
-	{
+	  assert (len < UINT_MAX);
 	  op = *ptr++;
-	  if (op >= opcode_base)
-	    continue;
-	  if (op == DW_LNS_extended_op)
+	  switch (op)
 	    {
-	      unsigned int len = read_uleb128 (ptr);
-
-	      assert (len < UINT_MAX);
-	      op = *ptr++;
-	      switch (op)
-		{
-		case DW_LNE_set_address:
-		  addr = read_ptr (ptr);
-		  if (addr >= start && addr_to_sec (dso, addr) != -1)
-		    write_ptr (ptr - ptr_size, addr + adjust);
-		  break;
-		case DW_LNE_end_sequence:
-		case DW_LNE_define_file:
-		case DW_LNE_set_discriminator:
-		default:
-		  ptr += len - 1;
-		  break;
-		}
+	    case DW_LNE_set_address:
+	      addr = read_ptr (ptr);
+	      if (addr >= start && addr_in_dso_p (dso, addr))
+		write_ptr (ptr - ptr_size, addr + adjust);
+	      break;
+	    case DW_LNE_end_sequence:
+	    case DW_LNE_define_file:
+	    case DW_LNE_set_discriminator:
+	    default:
+	      ptr += len - 1;
+	      break;
 	    }
-	  else if (op == DW_LNS_fixed_advance_pc)
-	    ptr += 2;
-	  else
-	    for (i = 0; i < opcode_lengths[op]; ++i)
-	      read_uleb128 (ptr);
 	}
+      else if (op == DW_LNS_fixed_advance_pc)
+	ptr += 2;
+      else
+	for (i = 0; i < opcode_lengths[op]; ++i)
+	  read_uleb128 (ptr);
     }
 
-  elf_flagscn (dso->scn[debug_sections[DEBUG_LINE].sec], ELF_C_SET,
-	       ELF_F_DIRTY);
   return 0;
 }
 
@@ -940,14 +1576,12 @@ adjust_dwarf2_aranges (DSO *dso, GElf_Addr start, GElf_Addr adjust)
 	  len = read_ptr (ptr);
 	  if (addr == 0 && len == 0)
 	    break;
-	  if (addr >= start && addr_to_sec (dso, addr) != -1)
+	  if (addr >= start && addr_in_dso_p (dso, addr))
 	    write_ptr (ptr - 2 * ptr_size, addr + adjust);
 	}
       assert (ptr == endcu);
     }
 
-  elf_flagscn (dso->scn[debug_sections[DEBUG_LINE].sec], ELF_C_SET,
-	       ELF_F_DIRTY);
   return 0;
 }
 
@@ -1026,7 +1660,7 @@ adjust_dwarf2_frame (DSO *dso, GElf_Addr start, GElf_Addr adjust)
       else
 	{
 	  addr = read_ptr (ptr);
-	  if (addr >= start && addr_to_sec (dso, addr) != -1)
+	  if (addr >= start && addr_in_dso_p (dso, addr))
 	    write_ptr (ptr - ptr_size, addr + adjust);
 	  read_ptr (ptr);  /* Skip address range.  */
 	}
@@ -1071,7 +1705,7 @@ adjust_dwarf2_frame (DSO *dso, GElf_Addr start, GElf_Addr adjust)
 	      break;
 	    case DW_CFA_set_loc:
 	      addr = read_ptr (ptr);
-	      if (addr >= start && addr_to_sec (dso, addr) != -1)
+	      if (addr >= start && addr_in_dso_p (dso, addr))
 		write_ptr (ptr - ptr_size, addr + adjust);
 	      break;
 	    case DW_CFA_advance_loc1:
@@ -1101,8 +1735,6 @@ adjust_dwarf2_frame (DSO *dso, GElf_Addr start, GElf_Addr adjust)
 	}
     }
 
-  elf_flagscn (dso->scn[debug_sections[DEBUG_FRAME].sec], ELF_C_SET,
-	       ELF_F_DIRTY);
   return 0;
 }
 
@@ -1120,34 +1752,46 @@ loclistoffset_eq (const void *p, const void *q)
   GElf_Addr *offset1 = (GElf_Addr *)p;
   GElf_Addr *offset2 = (GElf_Addr *)q;
 
-  return *offset1 = *offset2;
+  return *offset1 == *offset2;
 }
 
-static void
-loclistoffset_del (void *p)
+static int
+add_dwarf2_task (struct dwarf2_pool *pool, int kind, unsigned char *ptr,
+		 unsigned char *end, struct cu_data *cu)
 {
-  free (p);
+  if (pool->ntasks == pool->tasks_alloced)
+    {
+      struct dwarf2_task *t;
+      int size = pool->tasks_alloced ? pool->tasks_alloced * 2 : 64;
+
+      t = realloc (pool->tasks, size * sizeof (struct dwarf2_task));
+      if (t == NULL)
+	{
+	  error (0, ENOMEM, "%s: Could not split debug info",
+		 pool->dso->filename);
+	  return 1;
+	}
+      pool->tasks = t;
+      pool->tasks_alloced = size;
+    }
+  pool->tasks[pool->ntasks].kind = kind;
+  pool->tasks[pool->ntasks].ptr = ptr;
+  pool->tasks[pool->ntasks].end = end;
+  pool->tasks[pool->ntasks++].cu = cu;
+  return 0;
 }
 
+/* Check the CU headers in .debug_info or .debug_types section TYPE
+   and add the CUs to POOL.  */
 static int
-adjust_dwarf2_info (DSO *dso, GElf_Addr start, GElf_Addr adjust, int type)
+scan_dwarf2_info (struct dwarf2_pool *pool, int type)
 {
+  DSO *dso = pool->dso;
   unsigned char *ptr, *endcu, *endsec;
   uint32_t value;
-  htab_t abbrev;
-  struct abbrev_tag tag, *t;
-  struct cu_data cu;
-  htab_t offset_hash = htab_try_create (50, loclistoffset_hash,
-					loclistoffset_eq, loclistoffset_del);
-
-  if (offset_hash == NULL)
-    {
-      error (0, ENOMEM, "%s: Could not create hash for attributes",
-	     dso->filename);
-      return 1;
-    }
+  int unit_type = 0, addr_size = 0;
+  struct cu_data *cu;
 
-  memset (&cu, 0, sizeof(cu));
   ptr = debug_sections[type].data;
   endsec = ptr + debug_sections[type].size;
   while (ptr < endsec)
@@ -1155,7 +1799,6 @@ adjust_dwarf2_info (DSO *dso, GElf_Addr start, GElf_Addr adjust, int type)
       if (ptr + 11 > endsec)
 	{
 	  error (0, 0, "%s: .debug_info CU header too small", dso->filename);
-	  htab_delete (offset_hash);
 	  return 1;
 	}
 
@@ -1164,25 +1807,57 @@ adjust_dwarf2_info (DSO *dso, GElf_Addr start, GElf_Addr adjust, int type)
       if (endcu == ptr + 0xffffffff)
 	{
 	  error (0, 0, "%s: 64-bit DWARF not supported", dso->filename);
-	  htab_delete (offset_hash);
 	  return 1;
 	}
 
       if (endcu > endsec)
 	{
 	  error (0, 0, "%s: .debug_info too small", dso->filename);
-	  htab_delete (offset_hash);
 	  return 1;
 	}
 
+      if (pool->ncus == pool->cus_alloced)
+	{
+	  int size = pool->cus_alloced ? pool->cus_alloced * 2 : 64;
+
+	  cu = realloc (pool->cus, size * sizeof (struct cu_data));
+	  if (cu == NULL)
+	    {
+	      error (0, ENOMEM, "%s: Could not split debug info",
+		     dso->filename);
+	      return 1;
+	    }
+	  pool->cus = cu;
+	  pool->cus_alloced = size;
+	}
+      cu = &pool->cus[pool->ncus];
+      memset (cu, 0, sizeof (*cu));
+
       value = read_16 (ptr);
-      if (value != 2 && value != 3 && value != 4)
+      if (value != 2 && value != 3 && value != 4 && value != 5)
 	{
 	  error (0, 0, "%s: DWARF version %d unhandled", dso->filename, value);
-	  htab_delete (offset_hash);
 	  return 1;
 	}
-      cu.cu_version = value;
+      cu->cu_version = value;
+
+      if (cu->cu_version >= 5)
+	{
+	  /* DWARF 5 has the unit type first and address size before
+	     the abbrev offset.  */
+	  unit_type = read_1 (ptr);
+	  if (unit_type < DW_UT_compile || unit_type > DW_UT_split_type)
+	    {
+	      error (0, 0, "%s: DWARF unit type %d unhandled", dso->filename,
+		     unit_type);
+	      return 1;
+	    }
+	  addr_size = read_1 (ptr);
+	  /* The bases default to the first contribution's header.  */
+	  cu->cu_addr_base = 8;
+	  cu->cu_rnglists_base = 12;
+	  cu->cu_loclists_base = 12;
+	}
 
       value = read_32 (ptr);
       if (value >= debug_sections[DEBUG_ABBREV].size)
@@ -1192,13 +1867,15 @@ adjust_dwarf2_info (DSO *dso, GElf_Addr start, GElf_Addr adjust, int type)
 	  else
 	    error (0, 0, "%s: DWARF CU abbrev offset too large",
 		   dso->filename);
-	  htab_delete (offset_hash);
 	  return 1;
 	}
+      cu->cu_abbrev = value;
 
+      if (cu->cu_version < 5)
+	addr_size = read_1 (ptr);
       if (ptr_size == 0)
 	{
-	  ptr_size = read_1 (ptr);
+	  ptr_size = addr_size;
 	  if (ptr_size == 4)
 	    {
 	      do_read_ptr = do_read_32_64;
@@ -1213,71 +1890,389 @@ adjust_dwarf2_info (DSO *dso, GElf_Addr start, GElf_Addr adjust, int type)
 	    {
 	      error (0, 0, "%s: Invalid DWARF pointer size %d",
 		     dso->filename, ptr_size);
-	      htab_delete (offset_hash);
 	      return 1;
 	    }
 	}
-      else if (read_1 (ptr) != ptr_size)
+      else if (addr_size != ptr_size)
 	{
 	  error (0, 0, "%s: DWARF pointer size differs between CUs",
 		 dso->filename);
-	  htab_delete (offset_hash);
 	  return 1;
 	}
 
-      abbrev = read_abbrev (dso, debug_sections[DEBUG_ABBREV].data + value);
-      if (abbrev == NULL)
+      if (type == DEBUG_TYPES
+	  || (cu->cu_version >= 5
+	      && (unit_type == DW_UT_type || unit_type == DW_UT_split_type)))
+	{
+	  ptr += 8; /* Skip type_signature.  */
+	  ptr += 4; /* Skip type_offset.  */
+	}
+      else if (cu->cu_version >= 5
+	       && (unit_type == DW_UT_skeleton
+		   || unit_type == DW_UT_split_compile))
+	ptr += 8; /* Skip dwo_id.  */
+
+      cu->cu_type = type;
+      cu->cu_ptr = ptr;
+      cu->cu_end = endcu;
+      ++pool->ncus;
+      ptr = endcu;
+    }
+
+  return 0;
+}
+
+/* Adjust the DIEs of CU.  */
+static int
+adjust_dwarf2_cu (DSO *dso, struct cu_data *cu, GElf_Addr start,
+		  GElf_Addr adjust)
+{
+  unsigned char *ptr = cu->cu_ptr, *endcu = cu->cu_end;
+  htab_t abbrev;
+  struct abbrev_tag tag, *t;
+
+  abbrev = read_abbrev (dso, debug_sections[DEBUG_ABBREV].data
+			     + cu->cu_abbrev);
+  if (abbrev == NULL)
+    return 1;
+
+  cu->cu_entry_pc = ~ (GElf_Addr) 0;
+  cu->cu_low_pc = ~ (GElf_Addr) 0;
+
+  while (ptr < endcu)
+    {
+      tag.entry = read_uleb128 (ptr);
+      if (tag.entry == 0)
+	continue;
+      t = htab_find_with_hash (abbrev, &tag, tag.entry);
+      if (t == NULL)
+	{
+	  error (0, 0, "%s: Could not find DWARF abbreviation %d",
+		 dso->filename, tag.entry);
+	  htab_delete (abbrev);
+	  return 1;
+	}
+
+      ptr = adjust_attributes (dso, ptr, t, cu, start, adjust);
+      if (ptr == NULL)
+	{
+	  htab_delete (abbrev);
+	  return 1;
+	}
+    }
+
+  htab_delete (abbrev);
+  return 0;
+}
+
+/* Check the .debug_line unit headers and add the units to POOL.  */
+static int
+scan_dwarf2_line (struct dwarf2_pool *pool)
+{
+  DSO *dso = pool->dso;
+  unsigned char *ptr = debug_sections[DEBUG_LINE].data;
+  unsigned char *endsec = ptr + debug_sections[DEBUG_LINE].size;
+  unsigned char *unit, *endcu, *endprol;
+  uint32_t value;
+
+  while (ptr < endsec)
+    {
+      unit = ptr;
+      endcu = ptr + 4;
+      endcu += read_32 (ptr);
+      if (endcu == ptr + 0xffffffff)
 	{
-	  htab_delete (offset_hash);
+	  error (0, 0, "%s: 64-bit DWARF not supported", dso->filename);
 	  return 1;
 	}
 
-      cu.cu_entry_pc = ~ (GElf_Addr) 0;
-      cu.cu_low_pc = ~ (GElf_Addr) 0;
+      if (endcu > endsec)
+	{
+	  error (0, 0, "%s: .debug_line CU does not fit into section",
+		 dso->filename);
+	  return 1;
+	}
 
-      if (type == DEBUG_TYPES)
+      value = read_16 (ptr);
+      if (value != 2 && value != 3 && value != 4 && value != 5)
 	{
-	  ptr += 8; /* Skip type_signature.  */
-	  ptr += 4; /* Skip type_offset.  */
+	  error (0, 0, "%s: DWARF version %d unhandled", dso->filename,
+		 value);
+	  return 1;
 	}
 
-      while (ptr < endcu)
+      if (value >= 5)
 	{
-	  tag.entry = read_uleb128 (ptr);
-	  if (tag.entry == 0)
-	    continue;
-	  t = htab_find_with_hash (abbrev, &tag, tag.entry);
-	  if (t == NULL)
+	  if (ptr[0] != ptr_size || ptr[1])
 	    {
-	      error (0, 0, "%s: Could not find DWARF abbreviation %d",
-		     dso->filename, tag.entry);
-	      htab_delete (abbrev);
-	      htab_delete (offset_hash);
+	      error (0, 0, "%s: Unsupported .debug_line address size %d or segment selector size %d",
+		     dso->filename, ptr[0], ptr[1]);
 	      return 1;
 	    }
+	  ptr += 2;
+	}
+
+      endprol = ptr + 4;
+      endprol += read_32 (ptr);
+      if (endprol > endcu)
+	{
+	  error (0, 0, "%s: .debug_line CU prologue does not fit into CU",
+		 dso->filename);
+	  return 1;
+	}
+
+      if (add_dwarf2_task (pool, DWARF2_TASK_LINE, unit, endcu, NULL))
+	return 1;
+      ptr = endcu;
+    }
+
+  return 0;
+}
+
+/* Return 1 if OFFSETP, which must stay valid as long as *HASHP, hasn't
+   been seen before, 0 if it has, -1 on error.  */
+static int
+dwarf2_first_ref (DSO *dso, htab_t *hashp, GElf_Addr *offsetp)
+{
+  void **slot;
+
+  if (*hashp == NULL)
+    {
+      *hashp = htab_try_create (50, loclistoffset_hash, loclistoffset_eq,
+				NULL);
+      if (*hashp == NULL)
+	{
+	  error (0, ENOMEM, "%s: Could not create hash for attributes",
+		 dso->filename);
+	  return -1;
+	}
+    }
+  slot = htab_find_slot (*hashp, offsetp, INSERT);
+  if (slot == NULL)
+    {
+      error (0, ENOMEM, "%s: Could not create hash for attributes",
+	     dso->filename);
+      return -1;
+    }
+  if (*slot != NULL)
+    return 0;
+  *slot = offsetp;
+  return 1;
+}
+
+/* Adjust .debug_ranges and .debug_rnglists lists referenced from all
+   CUs in POOL.  DWARF 5 lists are adjusted only once.  */
+static int
+adjust_dwarf2_range_lists (struct dwarf2_pool *pool)
+{
+  DSO *dso = pool->dso;
+  struct cu_data *cu;
+  struct dwarf2_ref *ref;
+  htab_t rnglists_hash = NULL;
+  int ret = 0, first;
+
+  for (cu = pool->cus; cu < pool->cus + pool->ncus && ret == 0; ++cu)
+    for (ref = cu->ranges; ref < cu->ranges + cu->nranges; ++ref)
+      {
+	if (cu->cu_version < 5)
+	  ret = adjust_dwarf2_ranges (dso, ref->offset, ref->base,
+				      pool->start, pool->adjust);
+	else if (ref->indexed
+		 && dwarf2_list_offset (dso, DEBUG_RNGLISTS,
+					cu->cu_rnglists_base, ref))
+	  ret = 1;
+	else if ((first = dwarf2_first_ref (dso, &rnglists_hash,
+					    &ref->offset)) < 0)
+	  ret = 1;
+	else if (first)
+	  ret = adjust_dwarf2_rnglist (dso, ref->offset, dwarf2_cu_base (cu),
+				       pool->start, pool->adjust);
+	if (ret)
+	  break;
+      }
+
+  if (rnglists_hash)
+    htab_delete (rnglists_hash);
+  return ret;
+}
 
-	  ptr = adjust_attributes (dso, ptr, t, &cu, start, adjust,
-				   offset_hash);
-	  if (ptr == NULL)
+/* Adjust .debug_loc and .debug_loclists lists referenced from all CUs
+   in POOL.  A list is adjusted only the first time it is referenced
+   from .debug_info, resp. .debug_types.  */
+static int
+adjust_dwarf2_loc_lists (struct dwarf2_pool *pool)
+{
+  DSO *dso = pool->dso;
+  struct cu_data *cu;
+  struct dwarf2_ref *ref;
+  htab_t loc_hash = NULL, loclists_hash = NULL;
+  int type = -1, ret = 0, first;
+
+  for (cu = pool->cus; cu < pool->cus + pool->ncus && ret == 0; ++cu)
+    {
+      if (cu->nlocs == 0)
+	continue;
+      if (cu->cu_version < 5 && cu->cu_type != type)
+	{
+	  if (loc_hash)
+	    htab_delete (loc_hash);
+	  loc_hash = NULL;
+	  type = cu->cu_type;
+	}
+      for (ref = cu->locs; ref < cu->locs + cu->nlocs; ++ref)
+	{
+	  if (cu->cu_version < 5)
 	    {
-	      htab_delete (abbrev);
-	      htab_delete (offset_hash);
-	      return 1;
+	      first = dwarf2_first_ref (dso, &loc_hash, &ref->offset);
+	      if (first > 0)
+		ret = adjust_dwarf2_loc (dso, cu, ref->offset, ref->base,
+					 pool->start, pool->adjust);
+	    }
+	  else if (ref->indexed
+		   && dwarf2_list_offset (dso, DEBUG_LOCLISTS,
+					  cu->cu_loclists_base, ref))
+	    first = -1;
+	  else
+	    {
+	      first = dwarf2_first_ref (dso, &loclists_hash, &ref->offset);
+	      if (first > 0)
+		ret = adjust_dwarf2_loclist (dso, cu, ref->offset,
+					     dwarf2_cu_base (cu),
+					     pool->start, pool->adjust);
+	    }
+	  if (first < 0 || ret)
+	    {
+	      ret = 1;
+	      break;
 	    }
 	}
+    }
+
+  if (loc_hash)
+    htab_delete (loc_hash);
+  if (loclists_hash)
+    htab_delete (loclists_hash);
+  return ret;
+}
 
-      htab_delete (abbrev);
+static int
+run_dwarf2_task (struct dwarf2_pool *pool, struct dwarf2_task *task)
+{
+  switch (task->kind)
+    {
+    case DWARF2_TASK_CU:
+      return adjust_dwarf2_cu (pool->dso, task->cu, pool->start,
+			       pool->adjust);
+    case DWARF2_TASK_LINE:
+      return adjust_dwarf2_line (pool->dso, task->ptr, task->end,
+				 pool->start, pool->adjust);
+    case DWARF2_TASK_ARANGES:
+      return adjust_dwarf2_aranges (pool->dso, pool->start, pool->adjust);
+    case DWARF2_TASK_FRAME:
+      return adjust_dwarf2_frame (pool->dso, pool->start, pool->adjust);
+    case DWARF2_TASK_RANGES:
+      return adjust_dwarf2_range_lists (pool);
+    case DWARF2_TASK_LOC:
+      return adjust_dwarf2_loc_lists (pool);
+    case DWARF2_TASK_ADDR:
+      return adjust_dwarf2_addr (pool);
+    default:
+      abort ();
     }
-  htab_delete (offset_hash);
-  return 0;
+}
+
+static void *
+dwarf2_worker (void *arg)
+{
+  struct dwarf2_pool *pool = (struct dwarf2_pool *) arg;
+  int i;
+
+  for (;;)
+    {
+      pthread_mutex_lock (&pool->lock);
+      i = pool->failed ? pool->ntasks : pool->next++;
+      pthread_mutex_unlock (&pool->lock);
+      if (i >= pool->ntasks)
+	break;
+      if (run_dwarf2_task (pool, &pool->tasks[i]))
+	{
+	  pthread_mutex_lock (&pool->lock);
+	  pool->failed = 1;
+	  pthread_mutex_unlock (&pool->lock);
+	}
+    }
+  return NULL;
+}
+
+/* Run all tasks in POOL using up to NTHREADS threads including the
+   calling one.  Once a task fails, no further tasks are started.  */
+static int
+run_dwarf2_tasks (struct dwarf2_pool *pool, int nthreads)
+{
+  pthread_t threads[DWARF2_MAX_THREADS];
+  int i, nstarted = 0;
+
+  pool->next = 0;
+  pool->failed = 0;
+  if (nthreads > pool->ntasks)
+    nthreads = pool->ntasks;
+  for (; nstarted < nthreads - 1; ++nstarted)
+    if (pthread_create (&threads[nstarted], NULL, dwarf2_worker, pool))
+      break;
+  dwarf2_worker (pool);
+  for (i = 0; i < nstarted; ++i)
+    pthread_join (threads[i], NULL);
+  return pool->failed;
+}
+
+static int
+dwarf2_nthreads (void)
+{
+  const char *env = getenv ("PRELINK_DWARF2_THREADS");
+  size_t size = 0;
+  long n;
+
+  /* Let the testsuite force the threaded path on small debug info.  */
+  if (env != NULL && (n = atol (env)) > 0)
+    return n > DWARF2_MAX_THREADS ? DWARF2_MAX_THREADS : n;
+
+  size += debug_sections[DEBUG_INFO].size;
+  size += debug_sections[DEBUG_TYPES].size;
+  size += debug_sections[DEBUG_LINE].size;
+  size += debug_sections[DEBUG_FRAME].size;
+  if (size < DWARF2_PARALLEL_MIN)
+    return 1;
+
+  /* With -j the CPUs are shared with the other worker processes.  */
+  n = sysconf (_SC_NPROCESSORS_ONLN) / parallel_jobs;
+  if (n > DWARF2_MAX_THREADS)
+    n = DWARF2_MAX_THREADS;
+  return n < 1 ? 1 : n;
+}
+
+static void
+free_dwarf2_pool (struct dwarf2_pool *pool)
+{
+  int i;
+
+  for (i = 0; i < pool->ncus; ++i)
+    {
+      free (pool->cus[i].ranges);
+      free (pool->cus[i].locs);
+      free (pool->cus[i].consts);
+    }
+  free (pool->cus);
+  free (pool->tasks);
+  pthread_mutex_destroy (&pool->lock);
 }
 
 int
 adjust_dwarf2 (DSO *dso, int n, GElf_Addr start, GElf_Addr adjust)
 {
+  struct dwarf2_pool pool;
   Elf_Data *data;
   Elf_Scn *scn;
-  int i, j;
+  int i, j, nthreads, ranges = 0, locs = 0, rnglists = 0, loclists = 0;
 
   for (i = 0; debug_sections[i].name; ++i)
     {
@@ -1351,29 +2346,98 @@ adjust_dwarf2 (DSO *dso, int n, GElf_Addr start, GElf_Addr adjust)
       return 1;
     }
 
-  if (debug_sections[DEBUG_INFO].data != NULL
-      && adjust_dwarf2_info (dso, start, adjust, DEBUG_INFO))
-    return 1;
+  memset (&pool, 0, sizeof (pool));
+  pool.dso = dso;
+  pool.start = start;
+  pool.adjust = adjust;
+  pthread_mutex_init (&pool.lock, NULL);
 
-  if (debug_sections[DEBUG_TYPES].data != NULL
-      && adjust_dwarf2_info (dso, start, adjust, DEBUG_TYPES))
-    return 1;
+  if ((debug_sections[DEBUG_INFO].data != NULL
+       && scan_dwarf2_info (&pool, DEBUG_INFO))
+      || (debug_sections[DEBUG_TYPES].data != NULL
+	  && scan_dwarf2_info (&pool, DEBUG_TYPES)))
+    goto error_out;
 
   if (ptr_size == 0)
     /* Should not happen.  */
     ptr_size = dso->ehdr.e_ident[EI_CLASS] == ELFCLASS64 ? 8 : 4;
 
+  /* The big undivided sections go first, so that they are not
+     left for last.  */
+  if ((debug_sections[DEBUG_FRAME].data != NULL
+       && add_dwarf2_task (&pool, DWARF2_TASK_FRAME, NULL, NULL, NULL))
+      || (debug_sections[DEBUG_ARANGES].data != NULL
+	  && add_dwarf2_task (&pool, DWARF2_TASK_ARANGES, NULL, NULL, NULL)))
+    goto error_out;
+  for (i = 0; i < pool.ncus; ++i)
+    if (add_dwarf2_task (&pool, DWARF2_TASK_CU, NULL, NULL, &pool.cus[i]))
+      goto error_out;
   if (debug_sections[DEBUG_LINE].data != NULL
-      && adjust_dwarf2_line (dso, start, adjust))
-    return 1;
-
-  if (debug_sections[DEBUG_ARANGES].data != NULL
-      && adjust_dwarf2_aranges (dso, start, adjust))
-    return 1;
-
-  if (debug_sections[DEBUG_FRAME].data != NULL
-      && adjust_dwarf2_frame (dso, start, adjust))
-    return 1;
+      && scan_dwarf2_line (&pool))
+    goto error_out;
+
+  /* addr_in_dso_p is called from several threads, make sure the
+     section index it uses has been built.  */
+  if (dso->naddr_index == -1)
+    build_addr_index (dso);
+  nthreads = dwarf2_nthreads ();
+  if (run_dwarf2_tasks (&pool, nthreads))
+    goto error_out;
+
+  /* Now that all CUs have been walked, adjust the lists they point to.  */
+  pool.ntasks = 0;
+  if (add_dwarf2_task (&pool, DWARF2_TASK_RANGES, NULL, NULL, NULL)
+      || add_dwarf2_task (&pool, DWARF2_TASK_LOC, NULL, NULL, NULL)
+      || run_dwarf2_tasks (&pool, nthreads))
+    goto error_out;
+
+  /* The CU base addresses used above are read from .debug_addr,
+     so it must be adjusted last.  */
+  pool.ntasks = 0;
+  if (debug_sections[DEBUG_ADDR].data != NULL
+      && (add_dwarf2_task (&pool, DWARF2_TASK_ADDR, NULL, NULL, NULL)
+	  || run_dwarf2_tasks (&pool, nthreads)))
+    goto error_out;
+
+  for (i = 0; i < pool.ncus; ++i)
+    {
+      if (pool.cus[i].cu_version < 5)
+	{
+	  ranges |= pool.cus[i].nranges != 0;
+	  locs |= pool.cus[i].nlocs != 0;
+	}
+      else
+	{
+	  rnglists |= pool.cus[i].nranges != 0;
+	  loclists |= pool.cus[i].nlocs != 0;
+	}
+    }
+  free_dwarf2_pool (&pool);
+
+  if (ranges)
+    elf_flagscn (dso->scn[debug_sections[DEBUG_RANGES].sec], ELF_C_SET,
+		 ELF_F_DIRTY);
+  if (locs)
+    elf_flagscn (dso->scn[debug_sections[DEBUG_LOC].sec], ELF_C_SET,
+		 ELF_F_DIRTY);
+  if (rnglists)
+    elf_flagscn (dso->scn[debug_sections[DEBUG_RNGLISTS].sec], ELF_C_SET,
+		 ELF_F_DIRTY);
+  if (loclists)
+    elf_flagscn (dso->scn[debug_sections[DEBUG_LOCLISTS].sec], ELF_C_SET,
+		 ELF_F_DIRTY);
+  if (debug_sections[DEBUG_ADDR].data != NULL)
+    elf_flagscn (dso->scn[debug_sections[DEBUG_ADDR].sec], ELF_C_SET,
+		 ELF_F_DIRTY);
+  if (debug_sections[DEBUG_LINE].data != NULL)
+    elf_flagscn (dso->scn[debug_sections[DEBUG_LINE].sec], ELF_C_SET,
+		 ELF_F_DIRTY);
+  if (debug_sections[DEBUG_ARANGES].data != NULL)
+    elf_flagscn (dso->scn[debug_sections[DEBUG_ARANGES].sec], ELF_C_SET,
+		 ELF_F_DIRTY);
+  if (debug_sections[DEBUG_FRAME].data != NULL)
+    elf_flagscn (dso->scn[debug_sections[DEBUG_FRAME].sec], ELF_C_SET,
+		 ELF_F_DIRTY);
 
   /* .debug_abbrev requires no adjustement.  */
   /* .debug_pubnames requires no adjustement.  */
@@ -1382,7 +2446,14 @@ adjust_dwarf2 (DSO *dso, int n, GElf_Addr start, GElf_Addr adjust)
   /* .debug_str requires no adjustement.  */
   /* .debug_ranges adjusted for each DW_AT_ranges pointing into it.  */
   /* .debug_loc adjusted for each loclistptr pointing into it.  */
+  /* .debug_rnglists and .debug_loclists likewise.  */
+  /* .debug_line_str, .debug_str_offsets, .debug_names and
+     .debug_gnu_pub{names,types} require no adjustement.  */
 
   elf_flagscn (dso->scn[n], ELF_C_SET, ELF_F_DIRTY);
   return 0;
+
+error_out:
+  free_dwarf2_pool (&pool);
+  return 1;
 }
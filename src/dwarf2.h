@@ -76,6 +76,14 @@
 #define DW_TAG_type_unit		0x41
 #define DW_TAG_rvalue_reference_type	0x42
 #define DW_TAG_template_alias		0x43
+#define DW_TAG_coarray_type		0x44
+#define DW_TAG_generic_subrange		0x45
+#define DW_TAG_dynamic_type		0x46
+#define DW_TAG_atomic_type		0x47
+#define DW_TAG_call_site		0x48
+#define DW_TAG_call_site_parameter	0x49
+#define DW_TAG_skeleton_unit		0x4a
+#define DW_TAG_immutable_type		0x4b
 #define DW_TAG_MIPS_loop		0x4081
 #define DW_TAG_format_label		0x4101
 #define DW_TAG_function_template	0x4102
@@ -117,7 +125,25 @@
 #define DW_FORM_sec_offset		0x17
 #define DW_FORM_exprloc			0x18
 #define DW_FORM_flag_present		0x19
+#define DW_FORM_strx			0x1a
+#define DW_FORM_addrx			0x1b
+#define DW_FORM_ref_sup4		0x1c
+#define DW_FORM_strp_sup		0x1d
+#define DW_FORM_data16			0x1e
+#define DW_FORM_line_strp		0x1f
 #define DW_FORM_ref_sig8		0x20
+#define DW_FORM_implicit_const		0x21
+#define DW_FORM_loclistx		0x22
+#define DW_FORM_rnglistx		0x23
+#define DW_FORM_ref_sup8		0x24
+#define DW_FORM_strx1			0x25
+#define DW_FORM_strx2			0x26
+#define DW_FORM_strx3			0x27
+#define DW_FORM_strx4			0x28
+#define DW_FORM_addrx1			0x29
+#define DW_FORM_addrx2			0x2a
+#define DW_FORM_addrx3			0x2b
+#define DW_FORM_addrx4			0x2c
 #define DW_FORM_GNU_ref_alt		0x1f20
 #define DW_FORM_GNU_strp_alt		0x1f21
 
@@ -218,6 +244,35 @@
 #define DW_AT_const_expr		0x6c
 #define DW_AT_enum_class		0x6d
 #define DW_AT_linkage_name		0x6e
+#define DW_AT_string_length_bit_size	0x6f
+#define DW_AT_string_length_byte_size	0x70
+#define DW_AT_rank			0x71
+#define DW_AT_str_offsets_base		0x72
+#define DW_AT_addr_base			0x73
+#define DW_AT_rnglists_base		0x74
+#define DW_AT_dwo_name			0x76
+#define DW_AT_reference			0x77
+#define DW_AT_rvalue_reference		0x78
+#define DW_AT_macros			0x79
+#define DW_AT_call_all_calls		0x7a
+#define DW_AT_call_all_source_calls	0x7b
+#define DW_AT_call_all_tail_calls	0x7c
+#define DW_AT_call_return_pc		0x7d
+#define DW_AT_call_value		0x7e
+#define DW_AT_call_origin		0x7f
+#define DW_AT_call_parameter		0x80
+#define DW_AT_call_pc			0x81
+#define DW_AT_call_tail_call		0x82
+#define DW_AT_call_target		0x83
+#define DW_AT_call_target_clobbered	0x84
+#define DW_AT_call_data_location	0x85
+#define DW_AT_call_data_value		0x86
+#define DW_AT_noreturn			0x87
+#define DW_AT_alignment			0x88
+#define DW_AT_export_symbols		0x89
+#define DW_AT_deleted			0x8a
+#define DW_AT_defaulted			0x8b
+#define DW_AT_loclists_base		0x8c
 #define DW_AT_MIPS_fde			0x2001
 #define DW_AT_MIPS_loop_begin		0x2002
 #define DW_AT_MIPS_tail_loop_begin	0x2003
@@ -410,6 +465,16 @@
 #define DW_OP_bit_piece			0x9d
 #define DW_OP_implicit_value		0x9e
 #define DW_OP_stack_value		0x9f
+#define DW_OP_implicit_pointer		0xa0
+#define DW_OP_addrx			0xa1
+#define DW_OP_constx			0xa2
+#define DW_OP_entry_value		0xa3
+#define DW_OP_const_type		0xa4
+#define DW_OP_regval_type		0xa5
+#define DW_OP_deref_type		0xa6
+#define DW_OP_xderef_type		0xa7
+#define DW_OP_convert			0xa8
+#define DW_OP_reinterpret		0xa9
 #define DW_OP_GNU_push_tls_address	0xe0
 #define DW_OP_GNU_uninit		0xf0
 #define DW_OP_GNU_encoded_addr		0xf1
@@ -421,6 +486,9 @@
 #define DW_OP_GNU_convert		0xf7
 #define DW_OP_GNU_reinterpret		0xf9
 #define DW_OP_GNU_parameter_ref		0xfa
+#define DW_OP_GNU_addr_index		0xfb
+#define DW_OP_GNU_const_index		0xfc
+#define DW_OP_GNU_variable_value	0xfd
 #define DW_OP_lo_user			0xe0
 #define DW_OP_hi_user			0xff
 
@@ -496,6 +564,33 @@
 #define DW_LNE_define_file		0x3
 #define DW_LNE_set_discriminator	0x4
 
+#define DW_UT_compile			0x01
+#define DW_UT_type			0x02
+#define DW_UT_partial			0x03
+#define DW_UT_skeleton			0x04
+#define DW_UT_split_compile		0x05
+#define DW_UT_split_type		0x06
+
+#define DW_RLE_end_of_list		0x00
+#define DW_RLE_base_addressx		0x01
+#define DW_RLE_startx_endx		0x02
+#define DW_RLE_startx_length		0x03
+#define DW_RLE_offset_pair		0x04
+#define DW_RLE_base_address		0x05
+#define DW_RLE_start_end		0x06
+#define DW_RLE_start_length		0x07
+
+#define DW_LLE_end_of_list		0x00
+#define DW_LLE_base_addressx		0x01
+#define DW_LLE_startx_endx		0x02
+#define DW_LLE_startx_length		0x03
+#define DW_LLE_offset_pair		0x04
+#define DW_LLE_default_location		0x05
+#define DW_LLE_base_address		0x06
+#define DW_LLE_start_end		0x07
+#define DW_LLE_start_length		0x08
+#define DW_LLE_GNU_view_pair		0x09
+
 #define DW_CFA_advance_loc		0x40
 #define DW_CFA_offset			0x80
 #define DW_CFA_restore			0xc0
@@ -631,7 +631,9 @@ error_out:
 			|| j == new_sdynbss + 1);
 		if (data->d_size)
 		  {
-		    data->d_buf = realloc (data->d_buf, data->d_size);
+		    data->d_buf = realloc_section_data (dso, data->d_buf,
+							data->d_size,
+							data->d_size);
 		    if (data->d_buf == NULL)
 		      {
 			error (0, ENOMEM, "%s: Could not convert NOBITS section into PROGBITS",
@@ -794,7 +796,8 @@ error_out:
       i = new[new_dynstr];
       data = elf_getdata (dso->scn[i], NULL);
       assert (data->d_off == 0);
-      data->d_buf = realloc (data->d_buf, dso->shdr[i].sh_size);
+      data->d_buf = realloc_section_data (dso, data->d_buf, data->d_size,
+					  dso->shdr[i].sh_size);
       if (data->d_buf == NULL)
 	{
 	  error (0, ENOMEM, "%s: Could not append names needed for .gnu.liblist to .dynstr",
@@ -851,7 +854,7 @@ error_out:
 	    }
 	}
       data = elf_getdata (dso->scn[new_sdynbss], NULL);
-      free (data->d_buf);
+      free_section_data (dso, data->d_buf);
       data->d_buf = info->sdynbss;
       info->sdynbss = NULL;
       data->d_off = info->sdynbss_base - dso->shdr[new_sdynbss].sh_addr;
@@ -1012,7 +1015,7 @@ error_out:
 	    }
 	}
       data = elf_getdata (dso->scn[new_dynbss], NULL);
-      free (data->d_buf);
+      free_section_data (dso, data->d_buf);
       data->d_buf = info->dynbss;
       info->dynbss = NULL;
       data->d_off = info->dynbss_base - dso->shdr[new_dynbss].sh_addr;
@@ -1033,7 +1036,7 @@ error_out:
 		  break;
 	      assert (buf_start == buf_end);
 #endif
-	      free (data->d_buf);
+	      free_section_data (dso, data->d_buf);
 	      data->d_buf = NULL;
 	    }
 	  if (data->d_size != dso->shdr[new_dynbss + 1].sh_size)
@@ -1062,7 +1065,7 @@ error_out:
       data = elf_getdata (dso->scn[i], NULL);
       data->d_type = ELF_T_WORD;
       data->d_size = (ndeps - 1) * sizeof (Elf32_Lib);
-      free (data->d_buf);
+      free_section_data (dso, data->d_buf);
       data->d_buf = liblist;
       liblist = NULL;
       data->d_off = 0;
@@ -1089,7 +1092,8 @@ error_out:
       data->d_version = EV_CURRENT;
       if (data->d_size)
 	{
-	  data->d_buf = realloc (data->d_buf, data->d_size);
+	  data->d_buf = realloc_section_data (dso, data->d_buf, 0,
+					      data->d_size);
 	  if (data->d_buf == NULL)
 	    {
 	      error (0, ENOMEM, "%s: Could not build .gnu.conflict section",
@@ -1099,12 +1103,11 @@ error_out:
 	}
       else
 	{
-	  free (data->d_buf);
+	  free_section_data (dso, data->d_buf);
 	  data->d_buf = NULL;
 	}
       for (j = 0; j < info->conflict_rela_size; ++j)
 	gelfx_update_rela (dso->elf, data, j, info->conflict_rela + j);
-      free (info->conflict_rela);
       info->conflict_rela = NULL;
 
       dso->shdr[i].sh_flags = shdr[i].sh_flags;
@@ -1148,7 +1151,7 @@ error_out:
       scn = dso->scn[undo];
       data = elf_getdata (scn, NULL);
       assert (data != NULL && elf_getdata (scn, data) == NULL);
-      free (data->d_buf);
+      free_section_data (dso, data->d_buf);
       *data = dso->undo;
       dso->undo.d_buf = NULL;
     }
@@ -18,42 +18,86 @@
 #include <config.h>
 #include <errno.h>
 #include <error.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
-static pid_t pid;
+#include "prelink.h"
 
-int
-execve_close (FILE *f)
+/* One outstanding child.  Its output is either read directly from
+   the pipe, or, after execve_collect, from BUF.  */
+struct execve_child
 {
-  pid_t p;
+  struct execve_child *next;
+  pid_t pid;
+  int fd;
   int status;
+  int reaped;
+  FILE *f;
+  char *buf;
+  size_t len, alloced;
+  const char *path;
+};
 
-  if (f != NULL)
-    fclose (f);
-  while ((p = waitpid (pid, &status, 0)) == -1 && errno == EINTR);
-  if (p == -1 || ! WIFEXITED (status))
+/* Children whose output stream has been handed out by execve_open
+   or execve_output and not yet closed.  */
+static struct execve_child *children;
+
+static int
+execve_reap (struct execve_child *c)
+{
+  pid_t p;
+
+  if (c->reaped)
+    return 0;
+  while ((p = waitpid (c->pid, &c->status, 0)) == -1 && errno == EINTR);
+  if (p == -1)
     return -1;
-  return WEXITSTATUS (status);
+  c->reaped = 1;
+  return 0;
 }
 
-FILE *
-execve_open (const char *path, char *const argv[], char *const envp[])
+static void
+execve_free (struct execve_child *c)
+{
+  if (c->fd != -1)
+    close (c->fd);
+  free (c->buf);
+  free (c);
+}
+
+struct execve_child *
+execve_start (const char *path, char *const argv[], char *const envp[])
 {
   int p[2];
-  FILE *f;
+  struct execve_child *c;
+
+  c = calloc (1, sizeof (struct execve_child));
+  if (c == NULL)
+    {
+      error (0, ENOMEM, "Could not run %s", path);
+      return NULL;
+    }
+  c->path = path;
 
   if (pipe (p) < 0)
     {
       error (0, errno, "Could not run %s", path);
+      free (c);
       return NULL;
     }
 
-  switch (pid = vfork ())
+  switch (c->pid = vfork ())
     {
     case -1:
       error (0, errno, "Could not run %s", path);
+      close (p[0]);
+      close (p[1]);
+      free (c);
       return NULL;
     case 0:
       close (p[0]);
@@ -69,13 +113,178 @@ execve_open (const char *path, char *const argv[], char *const envp[])
     }
 
   close (p[1]);
+  fcntl (p[0], F_SETFD, FD_CLOEXEC);
+  c->fd = p[0];
+  return c;
+}
+
+/* Read the whole output of the N children in CHILDREN concurrently,
+   so that none of them blocks on a full pipe while we wait for
+   another one.  NULL entries are ignored.  On failure all the children
+   are closed and reaped, they still have to be discarded.  */
+int
+execve_collect (struct execve_child **cs, int n)
+{
+  struct pollfd *pfd;
+  struct execve_child *c;
+  int i, left = 0, ret = 0;
 
-  f = fdopen (p[0], "r");
-  if (f == NULL)
+  pfd = alloca (n * sizeof (struct pollfd));
+  for (i = 0; i < n; ++i)
     {
-      close (p[0]);
-      execve_close (NULL);
+      pfd[i].fd = cs[i] ? cs[i]->fd : -1;
+      pfd[i].events = POLLIN;
+      if (pfd[i].fd != -1)
+	++left;
     }
 
-  return f;
+  while (left)
+    {
+      if (poll (pfd, n, -1) < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  for (i = 0; cs[i] == NULL; ++i)
+	    ;
+	  error (0, errno, "Could not read output of %s", cs[i]->path);
+	  goto fail;
+	}
+
+      for (i = 0; i < n; ++i)
+	{
+	  ssize_t len;
+
+	  c = cs[i];
+
+	  if (pfd[i].fd == -1 || pfd[i].revents == 0)
+	    continue;
+
+	  if (c->alloced - c->len < 4096)
+	    {
+	      char *buf;
+
+	      c->alloced = c->alloced ? c->alloced * 2 : 16384;
+	      buf = realloc (c->buf, c->alloced);
+	      if (buf == NULL)
+		{
+		  error (0, ENOMEM, "Could not read output of %s", c->path);
+		  goto fail;
+		}
+	      c->buf = buf;
+	    }
+
+	  len = read (c->fd, c->buf + c->len, c->alloced - c->len);
+	  if (len < 0 && errno == EINTR)
+	    continue;
+	  if (len > 0)
+	    {
+	      c->len += len;
+	      continue;
+	    }
+	  if (len < 0)
+	    {
+	      error (0, errno, "Could not read output of %s", c->path);
+	      ret = 1;
+	    }
+	  close (c->fd);
+	  c->fd = -1;
+	  pfd[i].fd = -1;
+	  --left;
+	  if (execve_reap (c))
+	    ret = 1;
+	}
+    }
+
+  return ret;
+
+fail:
+  for (i = 0; i < n; ++i)
+    if ((c = cs[i]) != NULL)
+      {
+	if (c->fd != -1)
+	  {
+	    close (c->fd);
+	    c->fd = -1;
+	  }
+	execve_reap (c);
+      }
+  return 1;
+}
+
+/* Return a stream with the output of C.  It has to be closed with
+   execve_close.  */
+FILE *
+execve_output (struct execve_child *c)
+{
+  if (c->fd != -1)
+    c->f = fdopen (c->fd, "r");
+  else if (c->len)
+    c->f = fmemopen (c->buf, c->len, "r");
+  else
+    c->f = fopen ("/dev/null", "r");
+
+  if (c->f == NULL)
+    {
+      error (0, errno, "Could not read output of %s", c->path);
+      execve_discard (c);
+      return NULL;
+    }
+  if (c->fd != -1)
+    c->fd = -1;
+
+  c->next = children;
+  children = c;
+  return c->f;
+}
+
+/* Throw away a child whose output is not needed.  */
+void
+execve_discard (struct execve_child *c)
+{
+  if (c->fd != -1)
+    {
+      close (c->fd);
+      c->fd = -1;
+    }
+  execve_reap (c);
+  execve_free (c);
+}
+
+int
+execve_close (FILE *f)
+{
+  struct execve_child **cp, *c;
+  int status;
+
+  for (cp = &children; *cp; cp = &(*cp)->next)
+    if ((*cp)->f == f)
+      break;
+  c = *cp;
+  if (c == NULL)
+    return -1;
+  *cp = c->next;
+
+  if (f != NULL)
+    fclose (f);
+  if (execve_reap (c))
+    {
+      execve_free (c);
+      return -1;
+    }
+  status = c->status;
+  execve_free (c);
+  if (! WIFEXITED (status))
+    return -1;
+  return WEXITSTATUS (status);
+}
+
+FILE *
+execve_open (const char *path, char *const argv[], char *const envp[])
+{
+  struct execve_child *c = execve_start (path, argv, envp);
+
+  if (c == NULL)
+    return NULL;
+
+  return execve_output (c);
 }
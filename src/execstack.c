@@ -472,6 +472,13 @@ prelink_conflict_add_rela (struct prelink_info *info)
   abort ();
 }
 
+struct prelink_conflict *
+prelink_conflict_find (struct prelink_conflicts *conflicts,
+		       GElf_Addr symoff, int reloc_class)
+{
+  abort ();
+}
+
 ssize_t
 send_file (int outfd, int infd, off_t *poff, size_t count)
 {
@@ -481,3 +488,5 @@ send_file (int outfd, int infd, off_t *poff, size_t count)
 GElf_Addr mmap_reg_start;
 GElf_Addr mmap_reg_end;
 int exec_shield;
+int parallel_jobs = 1;
+int defer_debug;
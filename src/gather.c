@@ -32,22 +32,17 @@
 
 #include "prelinktab.h"
 #include "reloc.h"
+#include "ldtrace.h"
+#include "walk.h"
 
-#ifndef HAVE_FTW_ACTIONRETVAL
-# define FTW_ACTIONRETVAL	0
-# define FTW_CONTINUE		0
-# define FTW_STOP		1
-#endif
+/* Minimum number of threads walking directories.  */
+#define GATHER_THREADS	4
 
 static int gather_lib (struct prelink_entry *ent);
 static int implicit;
 
 static struct prelink_dir *dirs;
 static struct prelink_dir *blacklist;
-#ifndef HAVE_FTW_ACTIONRETVAL
-static char *blacklist_dir;
-static size_t blacklist_dir_len;
-#endif
 static struct extension
 {
   const char *ext;
@@ -56,15 +51,183 @@ static struct extension
 } *blacklist_ext;
 static int blacklist_next;
 
+/* Dependency traces started ahead of time by gather_prefetch_deps.  */
+static struct gather_trace
+{
+  struct gather_trace *next;
+  struct prelink_entry *ent;
+  struct execve_child *child;
+} *traces;
+
+/* Start the dynamic linker DL tracing dependencies of FILENAME.  */
+static struct execve_child *
+gather_trace_start (const char *dl, const char *filename, int etype)
+{
+  const char *argv[5];
+  const char *envp[6];
+  char *p;
+  int i;
+
+  i = 0;
+  argv[i++] = dl;
+  if (ld_library_path)
+    {
+      argv[i++] = "--library-path";
+      argv[i++] = ld_library_path;
+    }
+  argv[i++] = filename;
+  argv[i] = NULL;
+
+  i = 0;
+  if(etype == ET_EXEC && ld_preload)
+    {
+      p = alloca (sizeof "LD_PRELOAD=" + strlen (ld_preload) + 1);
+      strcpy (stpcpy (p, "LD_PRELOAD="), ld_preload);
+      envp[i++] = p;
+    }
+
+  envp[i++] = "LD_TRACE_LOADED_OBJECTS=1";
+  envp[i++] = "LD_TRACE_PRELINKING=1";
+  envp[i++] = "LD_WARN=";
+  envp[i++] = "LD_TRACE_PRELINKING_FORMAT=binary";
+  envp[i] = NULL;
+
+  return execve_start (dl, (char * const *)argv, (char * const *)envp);
+}
+
+static struct execve_child *
+gather_take_trace (struct prelink_entry *ent)
+{
+  struct gather_trace **tp, *t;
+  struct execve_child *child;
+
+  for (tp = &traces; *tp; tp = &(*tp)->next)
+    if ((*tp)->ent == ent)
+      {
+	t = *tp;
+	*tp = t->next;
+	child = t->child;
+	free (t);
+	return child;
+      }
+  return NULL;
+}
+
+/* Trace the not yet gathered dependencies of ENT, up to parallel_jobs
+   of them at a time, before gather_lib looks at them one by one.  */
+static void
+gather_prefetch_deps (struct prelink_entry *ent, const char *dl)
+{
+  struct execve_child **cs;
+  struct prelink_entry **es;
+  struct gather_trace *t;
+  int i, n;
+
+  if (parallel_jobs <= 1 || ent->ndepends < 2)
+    return;
+
+  cs = alloca (parallel_jobs * sizeof (struct execve_child *));
+  es = alloca (parallel_jobs * sizeof (struct prelink_entry *));
+  for (i = 0; i < ent->ndepends; )
+    {
+      for (n = 0; i < ent->ndepends && n < parallel_jobs; ++i)
+	{
+	  struct prelink_entry *dep = ent->depends[i];
+	  const char *filename = dep->filename;
+
+	  if (dep->type != ET_NONE || strcmp (filename, dl) == 0)
+	    continue;
+	  for (t = traces; t; t = t->next)
+	    if (t->ent == dep)
+	      break;
+	  if (t != NULL)
+	    continue;
+
+	  if (strchr (filename, '/') == NULL)
+	    {
+	      size_t flen = strlen (filename);
+	      char *tp = alloca (2 + flen + 1);
+	      memcpy (tp, "./", 2);
+	      memcpy (tp + 2, filename, flen + 1);
+	      filename = tp;
+	    }
+
+	  cs[n] = gather_trace_start (dl, filename, ET_DYN);
+	  if (cs[n] == NULL)
+	    break;
+	  es[n++] = dep;
+	}
+
+      if (n == 0)
+	return;
+
+      if (execve_collect (cs, n))
+	{
+	  while (n--)
+	    execve_discard (cs[n]);
+	  return;
+	}
+
+      while (n--)
+	{
+	  t = malloc (sizeof (struct gather_trace));
+	  if (t == NULL)
+	    {
+	      execve_discard (cs[n]);
+	      continue;
+	    }
+	  t->ent = es[n];
+	  t->child = cs[n];
+	  t->next = traces;
+	  traces = t;
+	}
+    }
+}
+
+/* Throw away prefetched traces of ENT's dependencies which were
+   not consumed.  */
+static void
+gather_drop_prefetched (struct prelink_entry *ent)
+{
+  struct execve_child *child;
+  int i;
+
+  for (i = 0; i < ent->ndepends; ++i)
+    if ((child = gather_take_trace (ent->depends[i])) != NULL)
+      execve_discard (child);
+}
+
+/* Make room for one more dependency in *DEPENDSP, which has
+   NDEPENDS entries.  */
+static int
+gather_grow_depends (struct prelink_entry *ent, const char ***dependsp,
+		     size_t ndepends, size_t *ndepends_allocedp)
+{
+  const char **depends;
+
+  if (ndepends < *ndepends_allocedp)
+    return 0;
+
+  depends = (const char **) realloc (*dependsp, (*ndepends_allocedp + 10)
+						* sizeof (char *));
+  if (depends == NULL)
+    {
+      error (0, ENOMEM, "%s: Could not record dependencies", ent->filename);
+      return 1;
+    }
+  *ndepends_allocedp += 10;
+  *dependsp = depends;
+  return 0;
+}
+
 static int
 gather_deps (DSO *dso, struct prelink_entry *ent)
 {
   int i, j, seen = 0;
   FILE *f = NULL;
-  const char *argv[5];
-  const char *envp[5];
+  struct execve_child *child;
   char *line = NULL, *p, *q = NULL;
-  const char **depends = NULL, **depends_temp;
+  const char **depends = NULL;
   size_t ndepends = 0, ndepends_alloced = 0;
   size_t len = 0;
   ssize_t n;
@@ -75,6 +238,8 @@ gather_deps (DSO *dso, struct prelink_entry *ent)
   const char *dl;
   const char *ent_filename;
   int etype = dso->ehdr.e_type;
+  struct PLArch *arch = dso->arch;
+  int resolve;
 
   if (check_dso (dso))
     {
@@ -93,6 +258,7 @@ gather_deps (DSO *dso, struct prelink_entry *ent)
       goto error_out;
     }
 
+  resolve = prelink_resolve_p (dso);
   dl = dynamic_linker ?: dso->arch->dynamic_linker;
   if (strcmp (dso->filename, dl) == 0
       || is_ldso_soname (dso->soname))
@@ -105,6 +271,8 @@ gather_deps (DSO *dso, struct prelink_entry *ent)
 	  ent->done = 2;
 	}
       close_dso (dso);
+      if ((child = gather_take_trace (ent)) != NULL)
+	execve_discard (child);
       return 0;
     }
 
@@ -142,13 +310,6 @@ gather_deps (DSO *dso, struct prelink_entry *ent)
   close_dso (dso);
   dso = NULL;
 
-  i = 0;
-  argv[i++] = dl;
-  if (ld_library_path)
-    {
-      argv[i++] = "--library-path";
-      argv[i++] = ld_library_path;
-    }
   if (strchr (ent->filename, '/') != NULL)
     ent_filename = ent->filename;
   else
@@ -160,26 +321,85 @@ gather_deps (DSO *dso, struct prelink_entry *ent)
       ent_filename = tp;
     }
 
-  argv[i++] = ent_filename;
-  argv[i] = NULL;
-
-  j = 0;
-  if(etype == ET_EXEC && ld_preload)
+  if (resolve)
     {
-      p = alloca (sizeof "LD_PRELOAD=" + strlen (ld_preload) + 1);
-      strcpy (stpcpy (p, "LD_PRELOAD="), ld_preload);
-      envp[j++] = p;
-    }
+      char **rdepends;
+      int nrdepends;
 
-  envp[j++] = "LD_TRACE_LOADED_OBJECTS=1";
-  envp[j++] = "LD_TRACE_PRELINKING=1";
-  envp[j++] = "LD_WARN=";
-  envp[j] = NULL;
+      if (prelink_resolve_deps (arch, etype, ent_filename, &rdepends,
+				&nrdepends))
+	goto error_out;
+
+      depends = (const char **) malloc ((nrdepends ?: 1) * sizeof (char *));
+      if (depends == NULL)
+	{
+	  error (0, ENOMEM, "%s: Could not record dependencies",
+		 ent->filename);
+	  for (i = 0; i < nrdepends; ++i)
+	    free (rdepends[i]);
+	  free (rdepends);
+	  goto error_out;
+	}
+      for (i = 0; i < nrdepends; ++i)
+	{
+	  depends[i] = strdupa (rdepends[i]);
+	  free (rdepends[i]);
+	}
+      free (rdepends);
+      ndepends = nrdepends;
+      goto got_depends;
+    }
 
-  f = execve_open (dl, (char * const *)argv, (char * const *)envp);
-  if (f == NULL)
+  child = gather_take_trace (ent);
+  if (child == NULL)
+    child = gather_trace_start (dl, ent_filename, etype);
+  if (child == NULL || (f = execve_output (child)) == NULL)
     goto error_out;
 
+  if (ldtrace_binary_p (f))
+    {
+      struct ldtrace_reader r;
+      struct ldtrace_record rec;
+
+      if (ldtrace_open (&r, f, ent->filename))
+	goto error_out;
+      for (;;)
+	{
+	  if (ldtrace_read (&r, &rec, ent->filename))
+	    {
+	      ldtrace_close (&r);
+	      goto error_out;
+	    }
+	  if (rec.r_type == LDTRACE_END)
+	    break;
+	  if (rec.r_type != LDTRACE_DEP)
+	    continue;
+
+	  p = (char *) ldtrace_string (&r, rec.r_name2);
+	  if (p == NULL)
+	    {
+	      error (0, 0, "%s: Could not find one of the dependencies: %s",
+		     ent->filename, ldtrace_string (&r, rec.r_name) ?: "");
+	      ldtrace_close (&r);
+	      goto error_out;
+	    }
+	  if (! strcmp (p, ent_filename))
+	    {
+	      ++seen;
+	      continue;
+	    }
+	  if (gather_grow_depends (ent, &depends, ndepends, &ndepends_alloced))
+	    {
+	      ldtrace_close (&r);
+	      goto error_out;
+	    }
+
+	  depends[ndepends] = strdupa (p);
+	  ++ndepends;
+	}
+      ldtrace_close (&r);
+    }
+  else
   do
     {
       n = getline (&line, &len, f);
@@ -233,21 +453,8 @@ gather_deps (DSO *dso, struct prelink_entry *ent)
 	  ++seen;
 	  continue;
 	}
-      if (ndepends == ndepends_alloced)
-	{
-	  ndepends_alloced += 10;
-	  depends_temp = depends;
-	  depends =
-	    (const char **) realloc (depends,
-				     ndepends_alloced * sizeof (char *));
-	  if (depends == NULL)
-	    {
-	      free(depends_temp);
-	      error (0, ENOMEM, "%s: Could not record dependencies",
-		     ent->filename);
-	      goto error_out;
-	    }
-	}
+      if (gather_grow_depends (ent, &depends, ndepends, &ndepends_alloced))
+	goto error_out;
 
       depends[ndepends] = strdupa (p);
       ++ndepends;
@@ -271,6 +478,7 @@ gather_deps (DSO *dso, struct prelink_entry *ent)
   free (line);
   line = NULL;
 
+got_depends:
   if (ndepends == 0)
     ent->depends = NULL;
   else
@@ -326,13 +534,17 @@ error_out_regather_libs:
   free (depends);
   depends = NULL;
 
+  if (! resolve)
+    gather_prefetch_deps (ent, dl);
   for (i = 0; i < ndepends; ++i)
     if (ent->depends[i]->type == ET_NONE
 	&& gather_lib (ent->depends[i]))
       {
 	cache_dyn_depends[i] = 0;
+	gather_drop_prefetched (ent);
 	goto error_out_regather_libs;
       }
+  gather_drop_prefetched (ent);
 
   for (i = 0; i < ndepends; ++i)
     for (j = 0; j < ent->depends[i]->ndepends; ++j)
@@ -726,47 +938,135 @@ maybe_pie (unsigned char *e_ident, int big_endian, int sixty_four)
   return 0;
 }
 
+/* Classes of walked files, see gather_classify.  */
+enum
+{
+  GATHER_UNKNOWN,	/* Not looked at yet.  */
+  GATHER_BLACKLISTED,	/* Has a blacklisted extension.  */
+  GATHER_IGNORE,	/* Unreadable, too small or a shared library.  */
+  GATHER_UNPRELINKABLE,	/* Not an ELF executable.  */
+  GATHER_PIE,		/* ET_DYN which might be a PIE.  */
+  GATHER_EXEC		/* ET_EXEC.  */
+};
+
 static int
-gather_func (const char *name, const struct stat64 *st, int type,
-	     struct FTW *ftwp)
+gather_blacklisted_p (const char *name)
+{
+  size_t len = strlen (name);
+  const char *base = NULL;
+  int i;
+
+  for (i = 0; i < blacklist_next; ++i)
+    if (blacklist_ext[i].is_glob)
+      {
+	if (base == NULL)
+	  {
+	    base = strrchr (name, '/');
+	    if (base == NULL)
+	      base = name;
+	    else
+	      ++base;
+	  }
+	if (fnmatch (blacklist_ext[i].ext, base, FNM_PERIOD) == 0)
+	  return 1;
+      }
+    else if (blacklist_ext[i].len <= len
+	     && memcmp (name + len - blacklist_ext[i].len,
+			blacklist_ext[i].ext, blacklist_ext[i].len) == 0)
+      return 1;
+  return 0;
+}
+
+/* Read the ELF header of NAME relative to DIRFD and quickly find
+   ET_EXEC ELF binaries and most of PIE binaries.  */
+static int
+gather_read_class (int dirfd, const char *name, const struct stat64 *st)
 {
   unsigned char e_ident [sizeof (Elf64_Ehdr) + sizeof (Elf64_Phdr)];
+  int fd, big_endian;
+
+  if (st->st_size < sizeof (e_ident))
+    return GATHER_IGNORE;
+
+  fd = openat (dirfd, name, O_RDONLY | O_CLOEXEC);
+  if (fd == -1)
+    return GATHER_IGNORE;
+
+  if (read (fd, e_ident, sizeof (e_ident)) != sizeof (e_ident))
+    {
+      close (fd);
+      return GATHER_IGNORE;
+    }
+  close (fd);
+
+  if (memcmp (e_ident, ELFMAG, SELFMAG) != 0)
+    return GATHER_UNPRELINKABLE;
+
+  switch (e_ident [EI_DATA])
+    {
+    case ELFDATA2LSB:
+      if (e_ident [EI_NIDENT + 1] != 0)
+	return GATHER_UNPRELINKABLE;
+      if (e_ident [EI_NIDENT] == ET_EXEC)
+	return GATHER_EXEC;
+      if (e_ident [EI_NIDENT] != ET_DYN)
+	return GATHER_UNPRELINKABLE;
+      big_endian = 0;
+      break;
+    case ELFDATA2MSB:
+      if (e_ident [EI_NIDENT] != 0)
+	return GATHER_UNPRELINKABLE;
+      if (e_ident [EI_NIDENT + 1] == ET_EXEC)
+	return GATHER_EXEC;
+      if (e_ident [EI_NIDENT + 1] != ET_DYN)
+	return GATHER_UNPRELINKABLE;
+      big_endian = 1;
+      break;
+    default:
+      return GATHER_UNPRELINKABLE;
+    }
 
-#ifndef HAVE_FTW_ACTIONRETVAL
-  if (blacklist_dir)
+  switch (e_ident [EI_CLASS])
     {
-      if (strncmp (name, blacklist_dir, blacklist_dir_len) == 0)
-	return FTW_CONTINUE;
-      free (blacklist_dir);
-      blacklist_dir = NULL;
+    case ELFCLASS32:
+      return maybe_pie (e_ident, big_endian, 0) ? GATHER_PIE : GATHER_IGNORE;
+    case ELFCLASS64:
+      return maybe_pie (e_ident, big_endian, 1) ? GATHER_PIE : GATHER_IGNORE;
+    default:
+      return GATHER_UNPRELINKABLE;
     }
-#endif
-  if (type == FTW_F && S_ISREG (st->st_mode) && (st->st_mode & 0111))
+}
+
+/* Called by the walk_tree worker threads for each file NAME in
+   directory DIRFD, so it must not touch anything gather_func may
+   be changing.  */
+static int
+gather_classify (int dirfd, const char *name, const struct stat64 *st)
+{
+  if (! S_ISREG (st->st_mode) || (st->st_mode & 0111) == 0)
+    return GATHER_IGNORE;
+
+  if (gather_blacklisted_p (name))
+    return GATHER_BLACKLISTED;
+
+  /* Don't bother reading files gather_func will find in the cache.  */
+  if (prelink_cache_unchanged_p (st))
+    return GATHER_UNKNOWN;
+
+  return gather_read_class (dirfd, name, st);
+}
+
+static int
+gather_func (const char *name, const struct stat64 *st, int type, int class)
+{
+  if (type == WALK_F && S_ISREG (st->st_mode) && (st->st_mode & 0111))
     {
-      int fd, i;
+      int fd;
       DSO *dso;
       struct prelink_entry *ent;
-      size_t len = strlen (name);
-      const char *base = NULL;
 
-      for (i = 0; i < blacklist_next; ++i)
-	if (blacklist_ext[i].is_glob)
-	  {
-	    if (base == NULL)
-	      {
-		base = strrchr (name, '/');
-		if (base == NULL)
-		  base = name;
-		else
-		  ++base;
-	      }
-	    if (fnmatch (blacklist_ext[i].ext, base, FNM_PERIOD) == 0)
-	      return FTW_CONTINUE;
-	  }
-	else if (blacklist_ext[i].len <= len
-		 && memcmp (name + len - blacklist_ext[i].len,
-			    blacklist_ext[i].ext, blacklist_ext[i].len) == 0)
-	  return FTW_CONTINUE;
+      if (class == GATHER_BLACKLISTED)
+	return WALK_CONTINUE;
 
       ent = prelink_find_entry (name, st, 0);
       if (ent != NULL && ent->type != ET_NONE)
@@ -779,140 +1079,59 @@ gather_func (const char *name, const struct stat64 *st, int type,
 		printf ("Assuming non-prelinkable %s\n", name);
 	    }
 	  ent->u.explicit = 1;
-	  return FTW_CONTINUE;
+	  return WALK_CONTINUE;
 	}
 
-      if (st->st_size < sizeof (e_ident))
-	return FTW_CONTINUE;
+      if (class == GATHER_UNKNOWN)
+	class = gather_read_class (AT_FDCWD, name, st);
 
-      fd = open (name, O_RDONLY);
-      if (fd == -1)
-	return FTW_CONTINUE;
-
-      if (read (fd, e_ident, sizeof (e_ident)) != sizeof (e_ident))
+      switch (class)
 	{
-close_it:
-	  fsync (fd);
-	  close (fd);
-	  return FTW_CONTINUE;
-	}
-
-      /* Quickly find ET_EXEC ELF binaries and most of PIE binaries.  */
-
-      if (memcmp (e_ident, ELFMAG, SELFMAG) != 0)
-	{
-make_unprelinkable:
-	  if (! undo)
-	    {
-	      ent = prelink_find_entry (name, st, 1);
-	      if (ent != NULL)
-		{
-		  assert (ent->type == ET_NONE);
-		  ent->type = ET_UNPRELINKABLE;
-		}
-	    }
-	  fsync (fd);
-	  close (fd);
-	  return FTW_CONTINUE;
-	}
-
-      switch (e_ident [EI_DATA])
-	{
-	case ELFDATA2LSB:
-	  if (e_ident [EI_NIDENT + 1] != 0)
-	    goto make_unprelinkable;
-	  if (e_ident [EI_NIDENT] != ET_EXEC)
+	case GATHER_UNPRELINKABLE:
+	  break;
+	case GATHER_PIE:
+	case GATHER_EXEC:
+	  fd = open (name, O_RDONLY);
+	  if (fd == -1)
+	    return WALK_CONTINUE;
+	  dso = fdopen_dso (fd, name);
+	  if (dso == NULL)
+	    return WALK_CONTINUE;
+	  if (class == GATHER_EXEC)
 	    {
-	      if (e_ident [EI_NIDENT] != ET_DYN)
-		goto make_unprelinkable;
-	      else if (e_ident [EI_CLASS] == ELFCLASS32)
-		{
-		  if (maybe_pie (e_ident, 0, 0))
-		    {
-maybe_pie:
-		      dso = fdopen_dso (fd, name);
-		      if (dso == NULL)
-			goto close_it;
-		      if (dynamic_info_is_set (dso, DT_DEBUG))
-			{
-			  close_dso (dso);
-			  goto make_unprelinkable;
-			}
-		      close_dso (dso);
-		    }
-		  goto close_it;
-		}
-	      else if (e_ident [EI_CLASS] == ELFCLASS64)
-		{
-		  if (maybe_pie (e_ident, 0, 1))
-		    goto maybe_pie;
-		  goto close_it;
-		}
-	      else
-		goto make_unprelinkable;
+	      gather_exec (dso, st);
+	      return WALK_CONTINUE;
 	    }
-	  break;
-	case ELFDATA2MSB:
-	  if (e_ident [EI_NIDENT] != 0)
-	    goto make_unprelinkable;
-	  if (e_ident [EI_NIDENT + 1] != ET_EXEC)
+	  if (! dynamic_info_is_set (dso, DT_DEBUG))
 	    {
-	      if (e_ident [EI_NIDENT + 1] != ET_DYN)
-		goto make_unprelinkable;
-	      else if (e_ident [EI_CLASS] == ELFCLASS32)
-		{
-		  if (maybe_pie (e_ident, 1, 0))
-		    goto maybe_pie;
-		  goto close_it;
-		}
-	      else if (e_ident [EI_CLASS] == ELFCLASS64)
-		{
-		  if (maybe_pie (e_ident, 1, 1))
-		    goto maybe_pie;
-		  goto close_it;
-		}
-	      else
-		goto make_unprelinkable;
+	      close_dso (dso);
+	      return WALK_CONTINUE;
 	    }
+	  close_dso (dso);
 	  break;
 	default:
-	  goto make_unprelinkable;
+	  return WALK_CONTINUE;
 	}
 
-      dso = fdopen_dso (fd, name);
-      if (dso == NULL)
-	return FTW_CONTINUE;
-
-      gather_exec (dso, st);
-    }
-  else if (type == FTW_D)
-    switch (add_dir_to_dirlist (name, st->st_dev, FTW_CHDIR))
-      {
-      case 0: return FTW_CONTINUE;
-      default: return FTW_STOP;
-      case 2:
-#ifdef HAVE_FTW_ACTIONRETVAL
-	return FTW_SKIP_SUBTREE;
-#else
+      if (! undo)
 	{
-	  blacklist_dir_len = strlen (name) + 1;
-	  if (blacklist_dir_len > 1 && name[blacklist_dir_len - 2] == '/')
-	    blacklist_dir_len--;
-	  blacklist_dir = malloc (blacklist_dir_len + 1);
-	  if (blacklist_dir == NULL)
+	  ent = prelink_find_entry (name, st, 1);
+	  if (ent != NULL)
 	    {
-	      error (0, ENOMEM, "Cannot store blacklisted dir name");
-	      return FTW_STOP;
+	      assert (ent->type == ET_NONE);
+	      ent->type = ET_UNPRELINKABLE;
 	    }
-	  memcpy (blacklist_dir, name, blacklist_dir_len - 1);
-	  blacklist_dir[blacklist_dir_len - 1] = '/';
-	  blacklist_dir[blacklist_dir_len] = '\0';
-	  return FTW_CONTINUE;
 	}
-#endif
+    }
+  else if (type == WALK_D)
+    switch (add_dir_to_dirlist (name, st->st_dev, FTW_CHDIR))
+      {
+      case 0: return WALK_CONTINUE;
+      case 2: return WALK_SKIP_SUBTREE;
+      default: return WALK_STOP;
       }
 
-  return FTW_CONTINUE;
+  return WALK_CONTINUE;
 }
 
 static int
@@ -953,7 +1172,6 @@ gather_binlib (const char *name, const struct stat64 *st)
   if (read (fd, e_ident, sizeof (e_ident)) != sizeof (e_ident))
     {
       error (0, errno, "Could not read ELF header from %s", name);
-      fsync (fd);
       close (fd);
       return 1;
     }
@@ -963,7 +1181,6 @@ gather_binlib (const char *name, const struct stat64 *st)
   if (memcmp (e_ident, ELFMAG, SELFMAG) != 0)
     {
       error (0, 0, "%s is not an ELF object", name);
-      fsync (fd);
       close (fd);
       return 1;
     }
@@ -988,7 +1205,6 @@ gather_binlib (const char *name, const struct stat64 *st)
     {
 unsupported_type:
       error (0, 0, "%s is neither ELF executable nor ELF shared library", name);
-      fsync (fd);
       close (fd);
       return 1;
     }
@@ -1057,14 +1273,14 @@ gather_object (const char *name, int deref, int onefs)
       if (!all && implicit && ! deref)
 	return 0;
       ++implicit;
-      ret = nftw64 (name, gather_func, 20, flags | FTW_ACTIONRETVAL);
+      ret = walk_tree (name,
+		       (deref ? 0 : WALK_PHYS) | (onefs ? WALK_MOUNT : 0),
+		       parallel_jobs > GATHER_THREADS
+		       ? parallel_jobs : GATHER_THREADS,
+		       gather_classify, gather_func);
       --implicit;
       if (ret < 0)
 	error (0, errno, "Failed searching %s", name);
-#ifndef HAVE_FTW_ACTIONRETVAL
-      free (blacklist_dir);
-      blacklist_dir = NULL;
-#endif
       return ret;
     }
   else
@@ -25,6 +25,7 @@
 #include <unistd.h>
 #include <sys/wait.h>
 #include "prelink.h"
+#include "ldtrace.h"
 
 int
 is_ldso_soname (const char *soname)
@@ -40,25 +41,550 @@ is_ldso_soname (const char *soname)
   return 0;
 }
 
-static void
-conflict_hash_init (struct prelink_conflicts *conflicts)
+int
+prelink_trace_init (struct prelink_trace *t, struct prelink_info *info,
+		    const char *ent_filename)
+{
+  memset (t, 0, sizeof (*t));
+  t->info = info;
+  t->ent_filename = ent_filename;
+  t->mask_32bit = (info->dso->ehdr.e_ident[EI_CLASS] == ELFCLASS32);
+  t->deps = calloc (info->ent->ndepends + 1,
+		    sizeof (struct prelink_trace_dep));
+  if (t->deps == NULL)
+    {
+      error (0, ENOMEM, "%s: Could not record dependencies",
+	     info->ent->filename);
+      return 1;
+    }
+  return 0;
+}
+
+void
+prelink_trace_free (struct prelink_trace *t)
+{
+  int i;
+
+  if (t->deps == NULL)
+    return;
+  for (i = 0; i <= t->info->ent->ndepends; i++)
+    free (t->deps[i].soname);
+  free (t->deps);
+  t->deps = NULL;
+}
+
+/* Record the next object in the search list of the object being
+   prelinked.  The first one is the object itself.  */
+int
+prelink_trace_dep (struct prelink_trace *t, const char *soname,
+		   const char *filename, GElf_Addr start, GElf_Addr l_addr,
+		   GElf_Addr tls_modid, GElf_Addr tls_offset)
+{
+  struct prelink_info *info = t->info;
+  struct prelink_entry *ent2;
+  int tdeps;
+
+  if (t->ndeps > info->ent->ndepends)
+    {
+      error (0, 0, "%s: Recorded %d dependencies, now seeing %d\n",
+	     info->ent->filename, info->ent->ndepends, t->ndeps - 1);
+      return 1;
+    }
+
+  tdeps = t->ndeps - t->seen + 1;
+  if (! t->seen
+      && (strcmp (info->ent->filename, filename) == 0
+	  || (info->ent->filename != t->ent_filename
+	      && strcmp (t->ent_filename, filename) == 0)
+	  || strcmp (info->ent->canon_filename, filename) == 0))
+    {
+      t->seen = 1;
+      tdeps = 0;
+    }
+  else if (tdeps > info->ent->ndepends)
+    {
+      error (0, 0, "%s: Recorded %d dependencies, now seeing %d\n",
+	     info->ent->filename, info->ent->ndepends, t->ndeps - 1);
+      return 1;
+    }
+  else if (ent2 = info->ent->depends [tdeps - 1],
+	   strcmp (ent2->filename, filename) != 0
+	   && strcmp (ent2->canon_filename, filename) != 0)
+    {
+      struct prelink_link *hardlink;
+
+      for (hardlink = ent2->hardlink; hardlink; hardlink = hardlink->next)
+	if (strcmp (hardlink->canon_filename, filename) == 0)
+	  break;
+
+      if (hardlink == NULL)
+	{
+	  struct stat64 st;
+
+	  if (stat64 (filename, &st) < 0)
+	    {
+	      error (0, errno, "%s: Could not stat %s",
+		     info->ent->filename, filename);
+	      return 1;
+	    }
+
+	  if (st.st_dev != ent2->dev || st.st_ino != ent2->ino)
+	    {
+	      error (0, 0, "%s: %s => %s does not match recorded dependency",
+		     info->ent->filename, soname, filename);
+	      return 1;
+	    }
+	}
+    }
+
+  if (! tdeps)
+    t->deps[0].ent = info->ent;
+  else
+    t->deps[tdeps].ent = info->ent->depends[tdeps - 1];
+  t->deps[tdeps].soname = strdup (soname);
+  if (t->deps[tdeps].soname == NULL)
+    {
+      error (0, ENOMEM, "Could not record `%s' SONAME", soname);
+      return 1;
+    }
+  t->deps[tdeps].start = start;
+  t->deps[tdeps].l_addr = l_addr;
+  t->deps[tdeps].tls_modid = tls_modid;
+  t->deps[tdeps].tls_offset = tls_offset;
+  ++t->ndeps;
+  return 0;
+}
+
+/* Called once all dependencies have been recorded, before any
+   lookups or conflicts.  */
+int
+prelink_trace_deps_done (struct prelink_trace *t)
+{
+  struct prelink_info *info = t->info;
+  DSO *dso = info->dso;
+  int i;
+
+  if (t->ndeps != info->ent->ndepends + 1 || ! t->seen)
+    {
+      error (0, 0, "%s: Recorded %d dependencies, now seeing %d\n",
+	     info->ent->filename, info->ent->ndepends, t->ndeps - 1);
+      return 1;
+    }
+
+  info->tls = arena_alloc (&info->arena,
+			   t->ndeps * sizeof (struct prelink_tls));
+  if (info->tls == NULL)
+    {
+      error (0, ENOMEM, "%s: Could not record dependency TLS information",
+	     dso->filename);
+      return 1;
+    }
+
+  for (i = 0; i < t->ndeps; i++)
+    {
+      info->tls[i].modid = t->deps[i].tls_modid;
+      info->tls[i].offset = t->deps[i].tls_offset;
+    }
+
+  if (dso->ehdr.e_type == ET_EXEC || dso->arch->create_opd)
+    {
+      info->conflicts = (struct prelink_conflicts *)
+			arena_alloc (&info->arena,
+				     t->ndeps * sizeof (struct prelink_conflicts));
+      if (info->conflicts == NULL)
+	{
+	  error (0, ENOMEM, "%s: Can't build list of conflicts", info->ent->filename);
+	  return 1;
+	}
+      memset (info->conflicts, 0,
+	      t->ndeps * sizeof (struct prelink_conflicts));
+    }
+  return 0;
+}
+
+/* Return VALUE, which is the st_value of a symbol defined in
+   dependency I, relative to the base of that dependency.  */
+static GElf_Addr
+trace_value (struct prelink_trace *t, int i, GElf_Addr value)
+{
+  /* If the library the symbol is bound to is already
+     prelinked, adjust the value so that it is relative
+     to library base.  */
+  if (t->mask_32bit)
+    return value - (Elf32_Addr) (t->deps[i].start - t->deps[i].l_addr);
+  return value - (t->deps[i].start - t->deps[i].l_addr);
+}
+
+static int
+trace_add_conflict (struct prelink_trace *t, int symowner, GElf_Addr symoff,
+		    struct prelink_entry *ents[2], struct prelink_tls *tlss[2],
+		    GElf_Addr value[2], int reloc_class, int ifunc,
+		    const char *symname)
+{
+  struct prelink_info *info = t->info;
+  struct prelink_conflict *conflict;
+
+  conflict = prelink_conflict_find (&info->conflicts[symowner], symoff,
+				    reloc_class);
+  if (conflict != NULL)
+    {
+      if ((reloc_class != RTYPE_CLASS_TLS
+	   && (conflict->lookup.ent != ents[0]
+	       || conflict->conflict.ent != ents[1]))
+	  || (reloc_class == RTYPE_CLASS_TLS
+	      && (conflict->lookup.tls != tlss[0]
+		  || conflict->conflict.tls != tlss[1]))
+	  || conflict->lookupval != value[0]
+	  || conflict->conflictval != value[1])
+	{
+	  error (0, 0, "%s: Symbol `%s' with the same reloc type resolves to different values each time",
+		 info->ent->filename, symname);
+	  return 1;
+	}
+      return 0;
+    }
+
+  conflict = arena_alloc (&info->arena, sizeof (struct prelink_conflict));
+  if (conflict == NULL)
+    {
+      error (0, ENOMEM, "Cannot build list of conflicts");
+      return 1;
+    }
+
+  if (reloc_class != RTYPE_CLASS_TLS)
+    {
+      conflict->lookup.ent = ents[0];
+      conflict->conflict.ent = ents[1];
+    }
+  else
+    {
+      conflict->lookup.tls = tlss[0];
+      conflict->conflict.tls = tlss[1];
+    }
+  conflict->lookupval = value[0];
+  conflict->conflictval = value[1];
+  conflict->symoff = symoff;
+  conflict->reloc_class = reloc_class;
+  conflict->used = 0;
+  conflict->ifunc = ifunc;
+  conflict->symname = arena_strdup (&info->arena, symname);
+  return prelink_conflict_insert (info, &info->conflicts[symowner], conflict);
+}
+
+/* Record that the symbol at offset SYMOFF in dependency SYMOWNER
+   resolved to VALUE in dependency VALOWNER (-1 if unresolved).  */
+int
+prelink_trace_lookup (struct prelink_trace *t, int symowner,
+		      GElf_Addr symoff, int valowner, GElf_Addr value,
+		      int reloc_class, int ifunc, const char *symname)
+{
+  struct prelink_info *info = t->info;
+  struct prelink_entry *ent = NULL;
+  struct prelink_tls *tls = NULL;
+
+  if (valowner >= 0
+      && (symowner == 0
+	  || ((reloc_class == RTYPE_CLASS_TLS || ifunc) && info->conflicts)))
+    {
+      if (reloc_class == RTYPE_CLASS_TLS)
+	tls = info->tls + valowner;
+      else
+	{
+	  ent = t->deps[valowner].ent;
+	  value = trace_value (t, valowner, value);
+	}
+    }
+
+  if (symowner == 0 && (!ifunc || info->conflicts == NULL))
+    {
+      struct prelink_symbol *s;
+
+      /* Only interested in relocations from the current object.  */
+      if (symoff < info->symtab_start || symoff >= info->symtab_end)
+	{
+	  error (0, 0, "%s: Symbol `%s' offset 0x%08llx does not point into .dynsym section",
+		 info->ent->filename, symname, (unsigned long long) symoff);
+	  return 1;
+	}
+
+      if (ent == info->ent
+	  && reloc_class != RTYPE_CLASS_TLS)
+	value = adjust_old_to_new (info->dso, value);
+
+      s = &info->symbols[(symoff - info->symtab_start)
+			  / info->symtab_entsize];
+      if (s->reloc_class)
+	{
+	  while (s->reloc_class != reloc_class && s->next != NULL)
+	    s = s->next;
+	  if (s->reloc_class == reloc_class)
+	    {
+	      if ((reloc_class != RTYPE_CLASS_TLS && s->u.ent != ent)
+		  || (reloc_class == RTYPE_CLASS_TLS
+		      && s->u.tls != tls)
+		  || s->value != value)
+		{
+		  error (0, 0, "%s: Symbol `%s' with the same reloc type resolves to different values each time",
+			 info->ent->filename, symname);
+		  return 1;
+		}
+	      return 0;
+	    }
+
+	  s->next = (struct prelink_symbol *)
+		    arena_alloc (&info->arena, sizeof (struct prelink_symbol));
+	  if (s->next == NULL)
+	    {
+	      error (0, ENOMEM, "Cannot build symbol lookup map");
+	      return 1;
+	    }
+	  s = s->next;
+	}
+      if (reloc_class == RTYPE_CLASS_TLS)
+	s->u.tls = tls;
+      else
+	s->u.ent = ent;
+      s->value = value;
+      s->reloc_class = reloc_class;
+      s->next = NULL;
+    }
+  else if ((reloc_class == RTYPE_CLASS_TLS || ifunc)
+	   && info->conflicts)
+    {
+      struct prelink_entry *ents[2] = { ent, ent };
+      struct prelink_tls *tlss[2] = { tls, tls };
+      GElf_Addr values[2] = { value, value };
+
+      return trace_add_conflict (t, symowner, symoff, ents, tlss, values,
+				 reloc_class, ifunc, symname);
+    }
+  return 0;
+}
+
+/* Record that the symbol at offset SYMOFF in dependency SYMOWNER
+   resolves to VALUE[0] in dependency VALOWNER[0] in the global scope,
+   but to VALUE[1] in VALOWNER[1] in the dependency's own scope.  */
+int
+prelink_trace_conflict (struct prelink_trace *t, int symowner,
+			GElf_Addr symoff, int valowner[2], GElf_Addr value[2],
+			int reloc_class, int ifunc, const char *symname)
 {
-  struct prelink_conflict **hash
-    = calloc (sizeof (struct prelink_conflict *), 251);
-  struct prelink_conflict *conflict, *next;
-  size_t idx;
+  struct prelink_info *info = t->info;
+  struct prelink_entry *ents[2];
+  struct prelink_tls *tlss[2];
+  GElf_Addr values[2];
+  int j;
+
+  if (symowner == 0)
+    {
+      error (0, 0, "%s: Conflict in _dl_loaded for `%s'",
+	     info->ent->filename, symname);
+      return 1;
+    }
+
+  if (info->conflicts == NULL)
+    return 0;
+
+  for (j = 0; j < 2; j++)
+    {
+      ents[j] = NULL;
+      tlss[j] = NULL;
+      values[j] = value[j];
+      if (valowner[j] < 0)
+	continue;
+      if (reloc_class == RTYPE_CLASS_TLS)
+	tlss[j] = info->tls + valowner[j];
+      else
+	{
+	  ents[j] = t->deps[valowner[j]].ent;
+	  values[j] = trace_value (t, valowner[j], value[j]);
+	}
+    }
 
-  if (hash == NULL)
+  return trace_add_conflict (t, symowner, symoff, ents, tlss, values,
+			     reloc_class, ifunc, symname);
+}
+
+void
+prelink_trace_undefined (struct prelink_trace *t)
+{
+  if (t->undef)
     return;
+  t->undef = 1;
+  if (verbose)
+    error (0, 0, "Warning: %s has undefined non-weak symbols",
+	   t->info->ent->filename);
+}
+
+/* Hand the recorded SONAMEs over to INFO.  */
+int
+prelink_trace_finish (struct prelink_trace *t)
+{
+  struct prelink_info *info = t->info;
+  int i;
+
+  info->sonames = malloc (t->ndeps * sizeof (const char *));
+  if (info->sonames == NULL)
+    {
+      error (0, ENOMEM, "%s: Could not record dependency SONAMEs",
+	     info->dso->filename);
+      prelink_trace_free (t);
+      return 1;
+    }
+
+  for (i = 0; i < t->ndeps; i++)
+    info->sonames[i] = t->deps[i].soname;
+  free (t->deps);
+  t->deps = NULL;
+  return 0;
+}
+
+/* Return index of the dependency mapped at START, or -1.  */
+static int
+trace_find_start (struct prelink_trace *t, GElf_Addr start)
+{
+  int i;
+
+  for (i = 0; i < t->ndeps; i++)
+    if (t->deps[i].start == start)
+      return i;
+  return -1;
+}
+
+/* Translate reloc class VALUE of a lookup or conflict, a relocation
+   type or, if TYPE is 0, the dynamic linker's type class.
+   Return 1 on failure.  */
+static int
+trace_reloc_class (DSO *dso, unsigned long value, int type,
+		   int *reloc_classp, int *ifuncp)
+{
+  int reloc_class = value;
+
+  *ifuncp = 0;
+  if (type)
+    {
+      if (value == 0)
+	return 1;
+      reloc_class = dso->arch->reloc_class (reloc_class);
+    }
+  else
+    {
+      if (reloc_class & RTYPE_CLASS_VALID)
+	{
+	  reloc_class = ((reloc_class & ~RTYPE_CLASS_VALID)
+			 | dso->arch->rtype_class_valid);
+	  *ifuncp = 1;
+	}
+      else if ((reloc_class | RTYPE_CLASS_VALID) == RTYPE_CLASS_TLS)
+	reloc_class |= RTYPE_CLASS_VALID;
+      else
+	reloc_class |= dso->arch->rtype_class_valid;
+    }
+
+  *reloc_classp = reloc_class;
+  return 0;
+}
+
+/* Parse the reloc class of a lookup or conflict line, which starts
+   at P.  Return 1 on failure.  */
+static int
+parse_reloc_class (DSO *dso, char *p, int *reloc_classp, int *ifuncp,
+		   char **symnamep)
+{
+  unsigned long value;
+  int type = 1;
+  char *symname;
+
+  if (*p == '/')
+    {
+      ++p;
+      type = 0;
+    }
+
+  value = strtoul (p, &symname, 16);
+  if (p == symname || (*symname != ' ' && *symname != '\t')
+      || trace_reloc_class (dso, value, type, reloc_classp, ifuncp))
+    return 1;
+
+  while (*symname == ' ' || *symname == '\t') ++symname;
+  *symnamep = symname;
+  return 0;
+}
+
+/* Record a lookup of a symbol at SYMOFF in the dependency mapped at
+   SYMSTART.  LINE describes it in error messages.  */
+static int
+trace_record_lookup (struct prelink_trace *t, GElf_Addr symstart,
+		     GElf_Addr symoff, GElf_Addr valstart, GElf_Addr value,
+		     int reloc_class, int ifunc, const char *symname,
+		     const char *line)
+{
+  int symowner, valowner;
+
+  symowner = trace_find_start (t, symstart);
+  valowner = trace_find_start (t, valstart);
+  if (symowner == 0
+      || ((reloc_class == RTYPE_CLASS_TLS || ifunc)
+	  && t->info->conflicts))
+    {
+      if (valowner == -1 && valstart)
+	{
+	  error (0, 0, "Could not find base 0x%08llx in the list of bases `%s'",
+		 (unsigned long long) valstart, line);
+	  return 1;
+	}
+      if (symowner == -1)
+	{
+	  error (0, 0, "Could not find base 0x%08llx in the list of bases `%s'",
+		 (unsigned long long) symstart, line);
+	  return 1;
+	}
+    }
+
+  return prelink_trace_lookup (t, symowner, symoff, valowner, value,
+			       reloc_class, ifunc, symname);
+}
 
-  for (conflict = conflicts->first; conflict; conflict = next)
+/* Record a conflict of a symbol at SYMOFF in the dependency mapped at
+   SYMSTART.  LINE describes it in error messages.  */
+static int
+trace_record_conflict (struct prelink_trace *t, GElf_Addr symstart,
+		       GElf_Addr symoff, GElf_Addr valstart[2],
+		       GElf_Addr value[2], int reloc_class, int ifunc,
+		       const char *symname, const char *line)
+{
+  int symowner, valowner[2], j;
+
+  if (symstart == t->deps[0].start)
+    {
+      error (0, 0, "Conflict in _dl_loaded `%s'", line);
+      return 1;
+    }
+
+  if (! t->info->conflicts)
+    return 0;
+
+  symowner = trace_find_start (t, symstart);
+  if (symowner == -1)
     {
-      next = conflict->next;
-      idx = conflict->symoff % 251;
-      conflict->next = hash[idx];
-      hash[idx] = conflict;
+      error (0, 0, "Could not find base 0x%08llx in the list of bases `%s'",
+	     (unsigned long long) symstart, line);
+      return 1;
     }
-  conflicts->hash = hash;
+
+  for (j = 0; j < 2; j++)
+    {
+      valowner[j] = trace_find_start (t, valstart[j]);
+      if (valowner[j] == -1 && valstart[j])
+	{
+	  error (0, 0, "Could not find base 0x%08llx in the list of bases `%s'",
+		 (unsigned long long) valstart[j], line);
+	  return 1;
+	}
+    }
+
+  return prelink_trace_conflict (t, symowner, symoff, valowner, value,
+				 reloc_class, ifunc, symname);
 }
 
 static int
@@ -67,20 +593,11 @@ prelink_record_relocations (struct prelink_info *info, FILE *f,
 {
   char buffer[8192];
   DSO *dso = info->dso;
-  struct prelink_entry *ent, *ent2;
-  struct prelink_tls *tls;
-  struct deps
-    {
-      struct prelink_entry *ent;
-      char *soname;
-      GElf_Addr start;
-      GElf_Addr l_addr;
-      GElf_Addr tls_modid;
-      GElf_Addr tls_offset;
-    } deps[info->ent->ndepends + 1];
+  struct prelink_trace t;
   char *r;
-  int i, ndeps = 0, undef = 0, seen = 0, tdeps = 0;
-  int mask_32bit = (info->dso->ehdr.e_ident[EI_CLASS] == ELFCLASS32);
+
+  if (prelink_trace_init (&t, info, ent_filename))
+    return 1;
 
   /* Record the dependencies.  */
   while ((r = fgets (buffer, 8192, f)) != NULL)
@@ -136,114 +653,25 @@ prelink_record_relocations (struct prelink_info *info, FILE *f,
       filename += sizeof (" => ") - 1;
       *p = '\0';
 
-      if (ndeps > info->ent->ndepends)
-	{
-	  error (0, 0, "%s: Recorded %d dependencies, now seeing %d\n",
-		 info->ent->filename, info->ent->ndepends, ndeps - 1);
-	  goto error_out;
-	}
-
-      tdeps = ndeps - seen + 1;
-      if (! seen
-	  && (strcmp (info->ent->filename, filename) == 0
-	      || (info->ent->filename != ent_filename
-		  && strcmp (ent_filename, filename) == 0)
-	      || strcmp (info->ent->canon_filename, filename) == 0))
-	{
-	  seen = 1;
-	  tdeps = 0;
-	}
-      else if (ent2 = info->ent->depends [tdeps - 1],
-	       strcmp (ent2->filename, filename) != 0
-	       && strcmp (ent2->canon_filename, filename) != 0)
-	{
-	  struct prelink_link *hardlink;
-
-	  for (hardlink = ent2->hardlink; hardlink; hardlink = hardlink->next)
-	    if (strcmp (hardlink->canon_filename, filename) == 0)
-	      break;
-
-	  if (hardlink == NULL)
-	    {
-	      struct stat64 st;
-
-	      if (stat64 (filename, &st) < 0)
-		{
-		  error (0, errno, "%s: Could not stat %s",
-			 info->ent->filename, filename);
-		  goto error_out;
-		}
-
-	      if (st.st_dev != ent2->dev || st.st_ino != ent2->ino)
-		{
-		  error (0, 0, "%s: %s => %s does not match recorded dependency",
-			 info->ent->filename, soname, filename);
-		  goto error_out;
-		}
-	    }
-	}
-
-      if (! tdeps)
-	deps[0].ent = info->ent;
-      else
-	deps[tdeps].ent = info->ent->depends[tdeps - 1];
-      deps[tdeps].soname = strdup (soname);
-      if (deps[tdeps].soname == NULL)
-	{
-	  error (0, ENOMEM, "Could not record `%s' SONAME", soname);
-	  goto error_out;
-	}
-      deps[tdeps].start = start;
-      deps[tdeps].l_addr = l_addr;
-      deps[tdeps].tls_modid = tls_modid;
-      deps[tdeps].tls_offset = tls_offset;
-      ++ndeps;
+      if (prelink_trace_dep (&t, soname, filename, start, l_addr,
+			     tls_modid, tls_offset))
+	goto error_out;
     }
 
-  if (ndeps != info->ent->ndepends + 1)
-    {
-      error (0, 0, "%s: Recorded %d dependencies, now seeing %d\n",
-	     info->ent->filename, info->ent->ndepends, ndeps - 1);
-      goto error_out;
-    }
+  if (prelink_trace_deps_done (&t))
+    goto error_out;
 
-  if (r == NULL && !ndeps)
+  if (r == NULL && !t.ndeps)
     {
       error (0, 0, "%s: %s did not print any lookup lines", info->ent->filename,
 	     dynamic_linker ?: dso->arch->dynamic_linker);
       goto error_out;
     }
 
-  info->tls = malloc (ndeps * sizeof (struct prelink_tls));
-  if (info->tls == NULL)
-    {
-      error (0, ENOMEM, "%s: Could not record dependency TLS information",
-	     dso->filename);
-      goto error_out;
-    }
-
-  for (i = 0; i < ndeps; i++)
-    {
-      info->tls[i].modid = deps[i].tls_modid;
-      info->tls[i].offset = deps[i].tls_offset;
-    }
-
-  if (dso->ehdr.e_type == ET_EXEC || dso->arch->create_opd)
-    {
-      info->conflicts = (struct prelink_conflicts *)
-			calloc (sizeof (struct prelink_conflicts), ndeps);
-      if (info->conflicts == NULL)
-	{
-	  error (0, ENOMEM, "%s: Can't build list of conflicts", info->ent->filename);
-	  goto error_out;
-	}
-      for (i = 0; i < ndeps; i++)
-	info->conflicts[i].hash = &info->conflicts[i].first;
-    }
   do
     {
-      unsigned long long symstart, symoff, valstart[3], value[3];
-      int reloc_class, len, type = 1, ifunc = 0;
+      unsigned long long symstart, symoff, valstart[2], value[2];
+      int reloc_class, len, ifunc;
       char *symname;
 
       r = strchr (buffer, '\n');
@@ -251,389 +679,151 @@ prelink_record_relocations (struct prelink_info *info, FILE *f,
 	*r = '\0';
       if (strncmp (buffer, "lookup ", sizeof ("lookup ") - 1) == 0)
 	{
-	  struct prelink_symbol *s;
-
 	  if (sscanf (buffer, "lookup 0x%llx 0x%llx -> 0x%llx 0x%llx %n",
-		      &symstart, &symoff, &valstart[0], &value[0], &len) != 4)
+		      &symstart, &symoff, &valstart[0], &value[0], &len) != 4
+	      || parse_reloc_class (dso, buffer + len, &reloc_class, &ifunc,
+				    &symname))
 	    {
 	      error (0, 0, "%s: Could not parse `%s'", info->ent->filename, buffer);
 	      goto error_out;
 	    }
 
-	  if (buffer[len] == '/')
-	    {
-	      ++len;
-	      type = 0;
-	    }
-
-	  reloc_class = strtoul (buffer + len, &symname, 16);
-	  if (buffer + len == symname || (reloc_class == 0 && type)
-	      || (*symname != ' ' && *symname != '\t'))
+	  if (trace_record_lookup (&t, symstart, symoff, valstart[0],
+				   value[0], reloc_class, ifunc, symname,
+				   buffer))
+	    goto error_out;
+	}
+      else if (strncmp (buffer, "conflict ", sizeof ("conflict ") - 1) == 0)
+	{
+	  if (sscanf (buffer, "conflict 0x%llx 0x%llx -> 0x%llx 0x%llx x 0x%llx 0x%llx %n",
+		      &symstart, &symoff, &valstart[0], &value[0],
+		      &valstart[1], &value[1], &len) != 6
+	      || parse_reloc_class (dso, buffer + len, &reloc_class, &ifunc,
+				    &symname))
 	    {
 	      error (0, 0, "%s: Could not parse `%s'", info->ent->filename, buffer);
 	      goto error_out;
 	    }
 
-	  if (type)
-	    reloc_class = dso->arch->reloc_class (reloc_class);
-	  else
-	    {
-	      if (reloc_class & RTYPE_CLASS_VALID)
-		{
-		  reloc_class = ((reloc_class & ~RTYPE_CLASS_VALID)
-				 | dso->arch->rtype_class_valid);
-		  ifunc = 1;
-		}
-	      else if ((reloc_class | RTYPE_CLASS_VALID) == RTYPE_CLASS_TLS)
-		reloc_class |= RTYPE_CLASS_VALID;
-	      else
-		reloc_class |= dso->arch->rtype_class_valid;
-	    }
+	  if (trace_record_conflict (&t, symstart, symoff,
+				     (GElf_Addr []) { valstart[0], valstart[1] },
+				     (GElf_Addr []) { value[0], value[1] },
+				     reloc_class, ifunc, symname, buffer))
+	    goto error_out;
+	}
+      else if (strncmp (buffer, "undefined symbol: ",
+			sizeof ("undefined symbol: ") - 1) == 0)
+	prelink_trace_undefined (&t);
+    } while (fgets (buffer, 8192, f) != NULL);
 
-	  while (*symname == ' ' || *symname == '\t') ++symname;
+  return prelink_trace_finish (&t);
 
-	  ent = NULL;
-	  tls = NULL;
-	  if (symstart == deps[0].start
-	      || ((reloc_class == RTYPE_CLASS_TLS || ifunc)
-		  && info->conflicts))
-	    {
-	      for (i = 0; i < ndeps; i++)
-		if (deps[i].start == valstart[0])
-		  {
-		    if (reloc_class == RTYPE_CLASS_TLS)
-		      tls = info->tls + i;
-		    else
-		      {
-			ent = deps[i].ent;
-			/* If the library the symbol is bound to is already
-			   prelinked, adjust the value so that it is relative
-			   to library base.  */
-			if (mask_32bit)
-			  value[0] -= (Elf32_Addr) (deps[i].start - deps[i].l_addr);
-			else
-			  value[0] -= deps[i].start - deps[i].l_addr;
-		      }
-		    break;
-		  }
-
-	      if (ent == NULL && tls == NULL && valstart[0])
-		{
-		  error (0, 0, "Could not find base 0x%08llx in the list of bases `%s'",
-			 valstart[0], buffer);
-		  goto error_out;
-		}
-	    }
+error_out:
+  prelink_trace_free (&t);
+  return 1;
+}
 
-	  if (symstart == deps[0].start && (!ifunc || info->conflicts == NULL))
-	    {
-	      /* Only interested in relocations from the current object.  */
-	      if (symoff < info->symtab_start || symoff >= info->symtab_end)
-		{
-		  error (0, 0, "%s: Symbol `%s' offset 0x%08llx does not point into .dynsym section",
-			 info->ent->filename, symname, symoff);
-		  goto error_out;
-		}
+/* Like prelink_record_relocations, but read the binary trace
+   format described in ldtrace.h.  */
+static int
+prelink_record_binary (struct prelink_info *info, FILE *f,
+		       const char *ent_filename)
+{
+  DSO *dso = info->dso;
+  struct prelink_trace t;
+  struct ldtrace_reader r;
+  struct ldtrace_record rec;
+  const char *soname, *filename, *symname;
+  int reloc_class, ifunc;
 
-	      if (ent == info->ent
-		  && reloc_class != RTYPE_CLASS_TLS)
-		value[0] = adjust_old_to_new (info->dso, value[0]);
+  if (prelink_trace_init (&t, info, ent_filename))
+    return 1;
 
-	      s = &info->symbols[(symoff - info->symtab_start)
-				  / info->symtab_entsize];
-	      if (s->reloc_class)
-		{
-		  while (s->reloc_class != reloc_class && s->next != NULL)
-		    s = s->next;
-		  if (s->reloc_class == reloc_class)
-		    {
-		      if ((reloc_class != RTYPE_CLASS_TLS && s->u.ent != ent)
-			  || (reloc_class == RTYPE_CLASS_TLS
-			      && s->u.tls != tls)
-			  || s->value != value[0])
-			{
-			  error (0, 0, "%s: Symbol `%s' with the same reloc type resolves to different values each time",
-				 info->ent->filename, symname);
-			  goto error_out;
-			}
-		      s = NULL;
-		    }
-		  else
-		    {
-		      s->next = (struct prelink_symbol *)
-				malloc (sizeof (struct prelink_symbol));
-		      if (s->next == NULL)
-			{
-			  error (0, ENOMEM, "Cannot build symbol lookup map");
-			  goto error_out;
-			}
-		      s = s->next;
-		    }
-		}
-	      if (s)
-		{
-		  if (reloc_class == RTYPE_CLASS_TLS)
-		    s->u.tls = tls;
-		  else
-		    s->u.ent = ent;
-		  s->value = value[0];
-		  s->reloc_class = reloc_class;
-		  s->next = NULL;
-		}
-	    }
-	  else if ((reloc_class == RTYPE_CLASS_TLS || ifunc)
-		   && info->conflicts)
-	    {
-	      struct prelink_conflict *conflict;
-	      int symowner;
-	      size_t idx;
-
-	      for (symowner = 0; symowner < ndeps; symowner++)
-		if (deps[symowner].start == symstart)
-		  break;
-	      if (symowner == ndeps)
-		{
-		  error (0, 0, "Could not find base 0x%08llx in the list of bases `%s'",
-			 symstart, buffer);
-		  goto error_out;
-		}
+  if (ldtrace_open (&r, f, info->ent->filename))
+    goto error_out;
 
-              idx = 0;
-	      if (info->conflicts[symowner].hash != &info->conflicts[symowner].first)
-		idx = symoff % 251;
-	      for (conflict = info->conflicts[symowner].hash[idx]; conflict;
-		   conflict = conflict->next)
-		if (conflict->symoff == symoff
-		    && conflict->reloc_class == reloc_class)
-		  {
-		    if ((reloc_class != RTYPE_CLASS_TLS
-			 && (conflict->lookup.ent != ent
-			     || conflict->conflict.ent != ent))
-			|| (reloc_class == RTYPE_CLASS_TLS
-			    && (conflict->lookup.tls != tls
-				|| conflict->conflict.tls != tls))
-			|| conflict->lookupval != value[0]
-			|| conflict->conflictval != value[0])
-		      {
-			error (0, 0, "%s: Symbol `%s' with the same reloc type resolves to different values each time",
-			       info->ent->filename, symname);
-			goto error_out;
-		      }
-		    break;
-		  }
-	      if (conflict == NULL)
-		{
-		  conflict = malloc (sizeof (struct prelink_conflict));
-		  if (conflict == NULL)
-		    {
-		      error (0, ENOMEM, "Cannot build list of conflicts");
-		      goto error_out;
-		    }
+  /* Record the dependencies.  */
+  for (;;)
+    {
+      if (ldtrace_read (&r, &rec, info->ent->filename))
+	goto error_out;
+      if (rec.r_type != LDTRACE_DEP)
+	break;
 
-		  conflict->next = info->conflicts[symowner].hash[idx];
-		  conflict->next2 = NULL;
-		  info->conflicts[symowner].hash[idx] = conflict;
-		  if (reloc_class != RTYPE_CLASS_TLS)
-		    {
-		      conflict->lookup.ent = ent;
-		      conflict->conflict.ent = ent;
-		    }
-		  else
-		    {
-		      conflict->lookup.tls = tls;
-		      conflict->conflict.tls = tls;
-		    }
-		  conflict->lookupval = value[0];
-		  conflict->conflictval = value[0];
-		  conflict->symoff = symoff;
-		  conflict->reloc_class = reloc_class;
-		  conflict->used = 0;
-		  conflict->ifunc = ifunc;
-		  conflict->symname = strdup(symname);
-		  if (++info->conflicts[symowner].count == 16)
-		    conflict_hash_init (&info->conflicts[symowner]);
-		}
-	    }
-	}
-      else if (strncmp (buffer, "conflict ", sizeof ("conflict ") - 1) == 0)
+      soname = ldtrace_string (&r, rec.r_name);
+      filename = ldtrace_string (&r, rec.r_name2);
+      if (soname == NULL || filename == NULL)
 	{
-	  if (sscanf (buffer, "conflict 0x%llx 0x%llx -> 0x%llx 0x%llx x 0x%llx 0x%llx %n",
-		      &symstart, &symoff, &valstart[0], &value[0],
-		      &valstart[1], &value[1], &len) != 6)
-	    {
-	      error (0, 0, "%s: Could not parse `%s'", info->ent->filename, buffer);
-	      goto error_out;
-	    }
-
-	  if (buffer[len] == '/')
-	    {
-	      ++len;
-	      type = 0;
-	    }
+	  error (0, 0, "%s: Could not parse binary trace dependency %s",
+		 info->ent->filename, soname ?: "");
+	  goto error_out;
+	}
 
-	  reloc_class = strtoul (buffer + len, &symname, 16);
-	  if (buffer + len == symname || (reloc_class == 0 && type)
-	      || (*symname != ' ' && *symname != '\t'))
-	    {
-	      error (0, 0, "%s: Could not parse `%s'", info->ent->filename, buffer);
-	      goto error_out;
-	    }
+      if (prelink_trace_dep (&t, soname, filename, rec.r_addr[0],
+			     rec.r_addr[1], rec.r_addr[2], rec.r_addr[3]))
+	goto error_out;
+    }
 
-	  if (type)
-	    reloc_class = dso->arch->reloc_class (reloc_class);
-	  else
-	    {
-	      if (reloc_class & RTYPE_CLASS_VALID)
-		{
-		  reloc_class = ((reloc_class & ~RTYPE_CLASS_VALID)
-				 | dso->arch->rtype_class_valid);
-		  ifunc = 1;
-		}
-	      else if ((reloc_class | RTYPE_CLASS_VALID) == RTYPE_CLASS_TLS)
-		reloc_class |= RTYPE_CLASS_VALID;
-	      else
-		reloc_class |= dso->arch->rtype_class_valid;
-	    }
+  if (prelink_trace_deps_done (&t))
+    goto error_out;
 
-	  while (*symname == ' ' || *symname == '\t') ++symname;
+  if (!t.ndeps)
+    {
+      error (0, 0, "%s: %s did not print any lookup lines", info->ent->filename,
+	     dynamic_linker ?: dso->arch->dynamic_linker);
+      goto error_out;
+    }
 
-	  if (symstart == deps[0].start)
+  while (rec.r_type != LDTRACE_END)
+    {
+      if (rec.r_type == LDTRACE_UNDEFINED)
+	prelink_trace_undefined (&t);
+      else if (rec.r_type == LDTRACE_LOOKUP || rec.r_type == LDTRACE_CONFLICT)
+	{
+	  symname = ldtrace_string (&r, rec.r_name);
+	  if (symname == NULL
+	      || trace_reloc_class (dso, rec.r_class,
+				    ! (rec.r_flags & LDTRACE_F_TYPE_CLASS),
+				    &reloc_class, &ifunc))
 	    {
-	      error (0, 0, "Conflict in _dl_loaded `%s'", buffer);
+	      error (0, 0, "%s: Could not parse binary trace %s record",
+		     info->ent->filename,
+		     rec.r_type == LDTRACE_LOOKUP ? "lookup" : "conflict");
 	      goto error_out;
 	    }
 
-	  if (info->conflicts)
+	  if (rec.r_type == LDTRACE_LOOKUP)
 	    {
-	      struct prelink_entry *ents[2];
-	      struct prelink_tls *tlss[2];
-	      struct prelink_conflict *conflict;
-	      int symowner, j;
-	      size_t idx;
-
-	      for (symowner = 1; symowner < ndeps; symowner++)
-		if (deps[symowner].start == symstart)
-		  break;
-	      if (symowner == ndeps)
-		{
-		  error (0, 0, "Could not find base 0x%08llx in the list of bases `%s'",
-			 symstart, buffer);
-		  goto error_out;
-		}
-
-	      for (j = 0; j < 2; j++)
-		{
-		  ents[j] = NULL;
-		  tlss[j] = NULL;
-		  for (i = 0; i < ndeps; i++)
-		    if (deps[i].start == valstart[j])
-		      {
-			if (reloc_class == RTYPE_CLASS_TLS)
-			  tlss[j] = info->tls + i;
-			else
-			  {
-			    ents[j] = deps[i].ent;
-			    /* If the library the symbol is bound to is already
-			       prelinked, adjust the value so that it is relative
-			       to library base.  */
-			    if (mask_32bit)
-			      value[j] -= (Elf32_Addr) (deps[i].start - deps[i].l_addr);
-			    else
-			      value[j] -= deps[i].start - deps[i].l_addr;
-			  }
-			break;
-		      }
-		  if (ents[j] == NULL && tlss[j] == NULL && valstart[j])
-		    {
-		      error (0, 0, "Could not find base 0x%08llx in the list of bases `%s'",
-			     valstart[j], buffer);
-		      goto error_out;
-		    }
-		}
-
-	      idx = 0;
-	      if (info->conflicts[symowner].hash
-		  != &info->conflicts[symowner].first)
-		idx = symoff % 251;
-	      for (conflict = info->conflicts[symowner].hash[idx]; conflict;
-		   conflict = conflict->next)
-		if (conflict->symoff == symoff
-		    && conflict->reloc_class == reloc_class)
-		  {
-		    if ((reloc_class != RTYPE_CLASS_TLS
-			 && (conflict->lookup.ent != ents[0]
-			     || conflict->conflict.ent != ents[1]))
-			|| (reloc_class == RTYPE_CLASS_TLS
-			    && (conflict->lookup.tls != tlss[0]
-				|| conflict->conflict.tls != tlss[1]))
-			|| conflict->lookupval != value[0]
-			|| conflict->conflictval != value[1])
-		      {
-			error (0, 0, "%s: Symbol `%s' with the same reloc type resolves to different values each time",
-			       info->ent->filename, symname);
-			goto error_out;
-		      }
-		    break;
-		  }
-	      if (conflict == NULL)
-		{
-		  conflict = malloc (sizeof (struct prelink_conflict));
-		  if (conflict == NULL)
-		    {
-		      error (0, ENOMEM, "Cannot build list of conflicts");
-		      goto error_out;
-		    }
-
-		  conflict->next = info->conflicts[symowner].hash[idx];
-		  conflict->next2 = NULL;
-		  info->conflicts[symowner].hash[idx] = conflict;
-		  if (reloc_class != RTYPE_CLASS_TLS)
-		    {
-		      conflict->lookup.ent = ents[0];
-		      conflict->conflict.ent = ents[1];
-		    }
-		  else
-		    {
-		      conflict->lookup.tls = tlss[0];
-		      conflict->conflict.tls = tlss[1];
-		    }
-		  conflict->lookupval = value[0];
-		  conflict->conflictval = value[1];
-		  conflict->symoff = symoff;
-		  conflict->reloc_class = reloc_class;
-		  conflict->used = 0;
-		  conflict->ifunc = ifunc;
-		  conflict->symname = strdup(symname);
-		  if (++info->conflicts[symowner].count == 16)
-		    conflict_hash_init (&info->conflicts[symowner]);
-		}
+	      if (trace_record_lookup (&t, rec.r_addr[0], rec.r_addr[1],
+				       rec.r_addr[2], rec.r_addr[3],
+				       reloc_class, ifunc, symname, symname))
+		goto error_out;
 	    }
+	  else if (trace_record_conflict (&t, rec.r_addr[0], rec.r_addr[1],
+					  (GElf_Addr []) { rec.r_addr[2],
+							   rec.r_addr[4] },
+					  (GElf_Addr []) { rec.r_addr[3],
+							   rec.r_addr[5] },
+					  reloc_class, ifunc, symname, symname))
+	    goto error_out;
 	}
-      else if (strncmp (buffer, "undefined symbol: ",
-			sizeof ("undefined symbol: ") - 1) == 0 && ! undef)
+      else
 	{
-	  undef = 1;
-	  if (verbose)
-	    error (0, 0, "Warning: %s has undefined non-weak symbols",
-		   info->ent->filename);
+	  error (0, 0, "%s: Unexpected record type %d in binary trace",
+		 info->ent->filename, rec.r_type);
+	  goto error_out;
 	}
-    } while (fgets (buffer, 8192, f) != NULL);
 
-  info->sonames = malloc (ndeps * sizeof (const char *));
-  if (info->sonames == NULL)
-    {
-      error (0, ENOMEM, "%s: Could not record dependency SONAMEs", dso->filename);
-      goto error_out;
+      if (ldtrace_read (&r, &rec, info->ent->filename))
+	goto error_out;
     }
 
-  for (i = 0; i < ndeps; i++)
-    info->sonames[i] = deps[i].soname;
-
-  return 0;
+  ldtrace_close (&r);
+  return prelink_trace_finish (&t);
 
 error_out:
-  for (i = 0; i < ndeps; i++)
-    free (deps[i].soname);
+  ldtrace_close (&r);
+  prelink_trace_free (&t);
   return 1;
 }
 
@@ -643,7 +833,7 @@ prelink_get_relocations (struct prelink_info *info)
   FILE *f;
   DSO *dso = info->dso;
   const char *argv[5];
-  const char *envp[5];
+  const char *envp[6];
   int i, j, ret, status;
   char *p;
   const char *dl = dynamic_linker ?: dso->arch->dynamic_linker;
@@ -670,15 +860,16 @@ prelink_get_relocations (struct prelink_info *info)
 
   info->symbol_count = (info->symtab_end - info->symtab_start)
 		       / info->symtab_entsize;
-  info->symbols = calloc (sizeof (struct prelink_symbol), info->symbol_count);
-
-  i = 0;
-  argv[i++] = dl;
-  if (ld_library_path)
+  info->symbols = arena_alloc (&info->arena, info->symbol_count
+					     * sizeof (struct prelink_symbol));
+  if (info->symbols == NULL)
     {
-      argv[i++] = "--library-path";
-      argv[i++] = ld_library_path;
+      error (0, ENOMEM, "%s: Cannot build symbol lookup map",
+	     info->ent->filename);
+      return 0;
     }
+  memset (info->symbols, 0, info->symbol_count * sizeof (struct prelink_symbol));
+
   if (strchr (info->ent->filename, '/') != NULL)
     ent_filename = info->ent->filename;
   else
@@ -689,6 +880,17 @@ prelink_get_relocations (struct prelink_info *info)
       memcpy (p + 2, info->ent->filename, flen + 1);
       ent_filename = p;
     }
+
+  if (prelink_resolve_p (dso))
+    return prelink_resolve_relocations (info, ent_filename) ? 0 : 2;
+
+  i = 0;
+  argv[i++] = dl;
+  if (ld_library_path)
+    {
+      argv[i++] = "--library-path";
+      argv[i++] = ld_library_path;
+    }
   argv[i++] = ent_filename;
   argv[i] = NULL;
 
@@ -704,6 +906,7 @@ prelink_get_relocations (struct prelink_info *info)
   p = alloca (sizeof "LD_TRACE_PRELINKING=" + strlen (info->ent->filename));
   strcpy (stpcpy (p, "LD_TRACE_PRELINKING="), info->ent->filename);
   envp[j++] = p;
+  envp[j++] = "LD_TRACE_PRELINKING_FORMAT=binary";
   envp[j] = NULL;
 
   ret = 2;
@@ -715,7 +918,9 @@ prelink_get_relocations (struct prelink_info *info)
       return 0;
     }
 
-  if (prelink_record_relocations (info, f, ent_filename))
+  if (ldtrace_binary_p (f)
+      ? prelink_record_binary (info, f, ent_filename)
+      : prelink_record_relocations (info, f, ent_filename))
     ret = 0;
 
   if ((status = execve_close (f)))
@@ -205,6 +205,254 @@ int deps_cmp (const void *A, const void *B)
   return 0;
 }
 
+/* Free address space gaps between the entries of the layout list,
+   in address order.  Libraries are always placed at the start of the
+   lowest gap they fit into, so gaps only shrink from the front, never
+   split or change order, and a tree of maximum gap lengths finds
+   the slot for each library in O(log n).  */
+struct layout_gaps
+{
+  GElf_Addr *start, *end;
+  /* tree[1] is the root, the leaves start at tree[size].  */
+  GElf_Addr *tree;
+  int n, size;
+};
+
+static void
+layout_gaps_update (struct layout_gaps *g, int i)
+{
+  GElf_Addr a, b;
+
+  i += g->size;
+  g->tree[i] = g->end[i - g->size] - g->start[i - g->size];
+  for (i >>= 1; i > 0; i >>= 1)
+    {
+      a = g->tree[2 * i];
+      b = g->tree[2 * i + 1];
+      g->tree[i] = a > b ? a : b;
+    }
+}
+
+/* Record the gaps above START between the N address sorted
+   entries ENTS.  The last gap is unbounded.  */
+static void
+layout_gaps_init (struct layout_gaps *g, struct prelink_entry **ents, int n,
+		  GElf_Addr start)
+{
+  GElf_Addr a, b;
+  int i;
+
+  g->start = (GElf_Addr *) malloc ((n + 1) * sizeof (GElf_Addr));
+  g->end = (GElf_Addr *) malloc ((n + 1) * sizeof (GElf_Addr));
+  g->n = 0;
+  if (g->start == NULL || g->end == NULL)
+    error (EXIT_FAILURE, ENOMEM, "Cannot lay libraries out");
+  for (i = 0; i < n; ++i)
+    {
+      if (ents[i]->base > start)
+	{
+	  g->start[g->n] = start;
+	  g->end[g->n++] = ents[i]->base;
+	}
+      if (ents[i]->layend > start)
+	start = ents[i]->layend;
+    }
+  g->start[g->n] = start;
+  g->end[g->n++] = ~(GElf_Addr) 0;
+
+  for (g->size = 1; g->size < g->n; g->size <<= 1)
+    ;
+  g->tree = (GElf_Addr *) calloc (2 * g->size, sizeof (GElf_Addr));
+  if (g->tree == NULL)
+    error (EXIT_FAILURE, ENOMEM, "Cannot lay libraries out");
+  for (i = 0; i < g->n; ++i)
+    g->tree[g->size + i] = g->end[i] - g->start[i];
+  for (i = g->size - 1; i > 0; --i)
+    {
+      a = g->tree[2 * i];
+      b = g->tree[2 * i + 1];
+      g->tree[i] = a > b ? a : b;
+    }
+}
+
+/* Return index of the lowest gap at least SIZE bytes long.  */
+static int
+layout_gaps_find (struct layout_gaps *g, GElf_Addr size)
+{
+  int i = 1;
+
+  if (g->tree[1] < size)
+    return -1;
+  while (i < g->size)
+    i = g->tree[2 * i] >= size ? 2 * i : 2 * i + 1;
+  return i - g->size;
+}
+
+static void
+layout_gaps_free (struct layout_gaps *g)
+{
+  free (g->start);
+  free (g->end);
+  free (g->tree);
+}
+
+/* Find the lowest address at or above BASE where SIZE bytes don't
+   overlap any of the N address sorted entries ENTS.  If MARK is
+   non-NULL, libraries whose MARK is not M are ignored.  Set *LAST
+   if the slot is above all the entries considered.  */
+static GElf_Addr
+layout_find_slot (struct prelink_entry **ents, int n, const int *mark, int m,
+		  GElf_Addr base, GElf_Addr size, int *last)
+{
+  struct prelink_entry *e;
+  int i;
+
+  for (i = 0; i < n; ++i)
+    {
+      e = ents[i];
+      if (mark && e->u.tmp >= 0 && mark[e->u.tmp] != m)
+	continue;
+      if (base + size <= e->base)
+	{
+	  *last = 0;
+	  return base;
+	}
+      if (base < e->layend)
+	base = e->layend;
+    }
+  *last = 1;
+  return base;
+}
+
+/* Insert E into the address sorted array ENTS of N entries, after
+   all entries with the same base.  */
+static void
+layout_insert (struct prelink_entry **ents, int n, struct prelink_entry *e)
+{
+  int lo = 0, hi = n, mid;
+
+  while (lo < hi)
+    {
+      mid = (lo + hi) / 2;
+      if (ents[mid]->base <= e->base)
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+  memmove (ents + lo + 1, ents + lo, (n - lo) * sizeof (*ents));
+  ents[lo] = e;
+}
+
+static int
+sticky_cmp (const void *A, const void *B)
+{
+  struct prelink_entry *a = * (struct prelink_entry **) A;
+  struct prelink_entry *b = * (struct prelink_entry **) B;
+
+  if (a->base < b->base)
+    return -1;
+  if (a->base > b->base)
+    return 1;
+  return a->u.tmp - b->u.tmp;
+}
+
+/* Return the size library E needs without any --layout-slack.  */
+static GElf_Addr
+layout_min_size (struct prelink_entry *e, GElf_Addr max_page_size)
+{
+  return ((e->end + 8192 + max_page_size - 1) & ~(max_page_size - 1))
+	 - e->base;
+}
+
+/* Return BASE if library E fits at it into <MMAP_START,MMAP_END),
+   otherwise 0.  */
+static GElf_Addr
+layout_sticky_base (struct prelink_entry *e, GElf_Addr base,
+		    GElf_Addr mmap_start, GElf_Addr mmap_end,
+		    GElf_Addr max_page_size)
+{
+  GElf_Addr size = layout_min_size (e, max_page_size);
+
+  if (base == 0 || (base & (max_page_size - 1))
+      || base < mmap_start || base + size < base || base + size > mmap_end)
+    return 0;
+  return base;
+}
+
+/* Try to keep each of the N libraries CAND, already moved to the
+   addresses they had before, at that address.  A library which
+   doesn't fit there with its --layout-slack is kept if it fits without
+   it.  Kept libraries are marked done and merged into the NPLACED
+   address sorted entries PLACED.  Return the new number of entries
+   in PLACED.  */
+static int
+layout_keep_bases (struct prelink_entry **placed, int nplaced,
+		   struct prelink_entry **cand, int n, char *listed,
+		   GElf_Addr mmap_end, GElf_Addr max_page_size)
+{
+  struct prelink_entry *e;
+  GElf_Addr top = 0, next, size;
+  int i, j, k, nkept = 0;
+
+  qsort (cand, n, sizeof (struct prelink_entry *), sticky_cmp);
+  for (i = 0, k = 0; i < n; ++i)
+    {
+      e = cand[i];
+      for (; k < nplaced && placed[k]->base < e->base; ++k)
+	if (placed[k]->layend > top)
+	  top = placed[k]->layend;
+      if (top > e->base)
+	continue;
+      /* Skip empty entries at E's address.  */
+      for (j = k; j < nplaced && placed[j]->layend <= e->base; ++j)
+	;
+      next = j < nplaced ? placed[j]->base : ~(GElf_Addr) 0;
+      size = e->layend - e->base;
+      if (e->base + size > next || e->base + size > mmap_end)
+	{
+	  size = layout_min_size (e, max_page_size);
+	  if (e->base + size > next)
+	    continue;
+	  e->layend = e->base + size;
+	}
+      e->done = 1;
+      listed[e->u.tmp] = 1;
+      top = e->layend;
+      cand[nkept++] = e;
+    }
+
+  for (i = nplaced + nkept, j = nplaced - 1, k = nkept - 1; k >= 0; )
+    if (j >= 0 && placed[j]->base > cand[k]->base)
+      placed[--i] = placed[j--];
+    else
+      placed[--i] = cand[k--];
+  return nplaced + nkept;
+}
+
+/* Order in which -m colors the interference graph: dynamic linkers
+   first, then by decreasing size times number of users.  Big widely
+   used libraries conflict with the most others and are placed first,
+   small rarely used ones then fill the holes left between them.  */
+static int
+color_cmp (const void *A, const void *B)
+{
+  struct prelink_entry *a = * (struct prelink_entry **) A;
+  struct prelink_entry *b = * (struct prelink_entry **) B;
+  GElf_Addr wa, wb;
+
+  if (! a->ndepends && b->ndepends)
+    return -1;
+  if (a->ndepends && ! b->ndepends)
+    return 1;
+  wa = (a->layend - a->base) * (a->refs + 1);
+  wb = (b->layend - b->base) * (b->refs + 1);
+  if (wa > wb)
+    return -1;
+  if (wa < wb)
+    return 1;
+  return a->u.tmp - b->u.tmp;
+}
+
 int
 layout_libs (void)
 {
@@ -229,12 +477,17 @@ layout_libs (void)
     {
       struct PLArch *plarch;
       extern struct PLArch __start_pl_arch[], __stop_pl_arch[];
-      int i, j, k, m, done, class;
+      int i, j, k, n, done, class, nplaced, nfakes, ncand, last;
+      int pass, sticky, nsticky;
+      int *mark, *emark, *bins, *binstart, *adj, *adjstart, *order;
+      int o, nadj, adjsize;
+      char *listed;
       GElf_Addr mmap_start, mmap_base, mmap_end, mmap_fin, max_page_size;
-      GElf_Addr base, size;
+      GElf_Addr base, size, *oldbase;
       struct prelink_entry *list, *e, *fake, **deps;
+      struct prelink_entry **placed, **cand, **fakes, **ents;
+      struct layout_gaps gaps;
       struct prelink_entry fakeent;
-      int fakecnt;
       int (*layout_libs_pre) (struct layout_libs *l);
       int (*layout_libs_post) (struct layout_libs *l);
 
@@ -249,7 +502,6 @@ layout_libs (void)
 
       list = NULL;
       fake = NULL;
-      fakecnt = 0;
       memset (&l, 0, sizeof (l));
       l.flags = arches[arch];
       l.libs = plibs;
@@ -260,9 +512,13 @@ layout_libs (void)
       l.max_page_size = max_page_size;
       htab_traverse (prelink_filename_htab, find_libs, &l);
 
-      /* Make sure there is some room between libraries.  */
+      /* Make sure there is some room between libraries, plus
+	 --layout-slack percent of their size to grow into.  */
       for (i = 0; i < l.nlibs; ++i)
-	l.libs[i]->layend = (l.libs[i]->end + 8192 + max_page_size - 1)
+	l.libs[i]->layend = (l.libs[i]->end + 8192
+			     + (l.libs[i]->end - l.libs[i]->base) / 100
+			       * layout_slack
+			     + max_page_size - 1)
 			    & ~(max_page_size - 1);
 
       if (plarch->layout_libs_init)
@@ -296,8 +552,22 @@ layout_libs (void)
       deps = (struct prelink_entry **)
 	     alloca (l.nlibs * sizeof (struct prelink_entry *));
 
+      if (incremental_layout)
+	{
+	  /* Count the up to date binaries and libraries which need each
+	     library.  Moving a library invalidates all of them.  */
+	  for (i = 0; i < l.nbinlibs; ++i)
+	    for (j = 0; j < l.binlibs[i]->ndepends; ++j)
+	      l.binlibs[i]->depends[j]->u.tmp = 0;
+	  for (i = 0; i < l.nbinlibs; ++i)
+	    if (l.binlibs[i]->done)
+	      for (j = 0; j < l.binlibs[i]->ndepends; ++j)
+		++l.binlibs[i]->depends[j]->u.tmp;
+	}
+
       /* Now see which already prelinked libraries have to be
-	 re-prelinked to avoid overlaps.  */
+	 re-prelinked to avoid overlaps.  With --incremental-layout
+	 re-prelink the one fewer up to date objects depend on.  */
       for (i = 0; i < l.nbinlibs; ++i)
 	{
 	  for (j = 0, k = 0; j < l.binlibs[i]->ndepends; ++j)
@@ -315,7 +585,13 @@ layout_libs (void)
 		    && (deps[j]->type == ET_DYN
 			|| deps[j - 1]->type == ET_DYN))
 		  {
-		    if (deps[j - 1]->refs < deps[j]->refs)
+		    if (incremental_layout
+			&& deps[j - 1]->u.tmp != deps[j]->u.tmp)
+		      {
+			if (deps[j - 1]->u.tmp < deps[j]->u.tmp)
+			  --j;
+		      }
+		    else if (deps[j - 1]->refs < deps[j]->refs)
 		      --j;
 		    deps[j]->done = 0;
 		    --k;
@@ -389,7 +665,6 @@ layout_libs (void)
 		  mmap_start += mmap_base;
 		}
 
-	      fsync (fd);
 	      close (fd);
 	    }
 
@@ -436,7 +711,6 @@ layout_libs (void)
 	  mmap_fin = l.mmap_fin;
 	  mmap_end = l.mmap_end;
 	  fake = l.fake;
-	  fakecnt = l.fakecnt;
 	}
 
       if (mmap_start != mmap_base && list)
@@ -464,7 +738,6 @@ layout_libs (void)
 		  fakeent.end = mmap_end;
 		  fakeent.layend = mmap_end;
 		  fake = &fakeent;
-		  fakecnt = 1;
 		  fakeent.prev = list->prev;
 		  fakeent.next = list;
 		  list->prev = fake;
@@ -493,109 +766,269 @@ layout_libs (void)
 	  mmap_fin = mmap_end + (mmap_start - mmap_base);
 	}
 
+      /* Number the libraries and put the layout list into an address
+	 sorted array.  Newly placed libraries are inserted into it,
+	 the list is rebuilt from it at the end.  */
+      for (i = 0; i < l.nbinlibs; ++i)
+	for (j = 0; j < l.binlibs[i]->ndepends; ++j)
+	  l.binlibs[i]->depends[j]->u.tmp = -1;
       for (i = 0; i < l.nlibs; ++i)
-	l.libs[i]->u.tmp = -1;
-      m = -1;
-
+	l.libs[i]->u.tmp = i;
+      /* With --incremental-layout first try to put libraries which
+	 need a new slot where they were before.  The arch hooks and -R
+	 move the address space around, so don't bother then.  */
+      sticky = incremental_layout && ! random_base && fake == NULL;
+      oldbase = NULL;
+      nplaced = 0;
+      for (e = list; e != NULL; e = e->next)
+	++nplaced;
+      placed = (struct prelink_entry **)
+	       malloc ((nplaced + l.nlibs) * sizeof (struct prelink_entry *));
+      cand = (struct prelink_entry **)
+	     malloc ((nplaced + l.nlibs) * sizeof (struct prelink_entry *));
+      fakes = (struct prelink_entry **)
+	      malloc ((nplaced + 1) * sizeof (struct prelink_entry *));
+      listed = (char *) calloc (l.nlibs + 1, 1);
+      mark = (int *) malloc ((l.nlibs + 1) * sizeof (int));
+      if (incremental_layout)
+	oldbase = (GElf_Addr *) malloc ((l.nlibs + 1) * sizeof (GElf_Addr));
+      if (placed == NULL || cand == NULL || fakes == NULL || listed == NULL
+	  || mark == NULL || (incremental_layout && oldbase == NULL))
+	error (EXIT_FAILURE, ENOMEM, "Cannot lay libraries out");
+      nplaced = 0;
+      nfakes = 0;
+      for (e = list; e != NULL; e = e->next)
+	{
+	  placed[nplaced++] = e;
+	  if (e->u.tmp >= 0)
+	    listed[e->u.tmp] = 1;
+	  else
+	    fakes[nfakes++] = e;
+	}
       for (i = 0; i < l.nlibs; ++i)
-	if (! l.libs[i]->done)
-	  {
-	    if (conserve_memory)
-	      {
-		/* If conserving virtual address space, only consider libraries
-		   which ever appear together with this one.  Otherwise consider
-		   all libraries.  */
-		m = i;
-		for (j = 0; j < l.nbinlibs; ++j)
-		  {
-		    for (k = 0; k < l.binlibs[j]->ndepends; ++k)
-		      if (l.binlibs[j]->depends[k] == l.libs[i])
-			{
-			  for (k = 0; k < l.binlibs[j]->ndepends; ++k)
-			    l.binlibs[j]->depends[k]->u.tmp = m;
-			  break;
-			}
-		  }
-		for (j = 0; j < fakecnt; ++j)
-		  fake[j].u.tmp = m;
-	      }
+	mark[i] = -1;
 
-	    size = l.libs[i]->layend - l.libs[i]->base;
-	    base = mmap_start;
-	    for (e = list; e; e = e->next)
-	      if (e->u.tmp == m)
-		{
-		  if (base + size <= e->base)
-		    goto found;
+      nsticky = 0;
+      for (i = 0; incremental_layout && i < l.nlibs; ++i)
+	{
+	  e = l.libs[i];
+	  oldbase[i] = e->base;
+	  if (e->done & 0x80)
+	    oldbase[i] -= mmap_end - mmap_base;
+	  /* A library replaced since it was prelinked has its previous
+	     address only in the cache.  */
+	  if (oldbase[i] == 0)
+	    oldbase[i] = prelink_cache_base (e->canon_filename);
+	  if (sticky && ! e->done
+	      && (base = layout_sticky_base (e, oldbase[i], mmap_start,
+					     mmap_end, max_page_size)) != 0)
+	    {
+	      e->end += base - e->base;
+	      e->layend += base - e->base;
+	      e->base = base;
+	      cand[nsticky++] = e;
+	    }
+	}
 
-		  if (base < e->layend)
-		    base = e->layend;
-		}
+      bins = NULL;
+      binstart = NULL;
+      adj = NULL;
+      adjstart = NULL;
+      order = NULL;
+      memset (&gaps, 0, sizeof (gaps));
+      if (conserve_memory)
+	{
+	  /* Build the interference graph: for each library find out
+	     which binaries need it and from them the libraries which
+	     ever appear together with it.  */
+	  binstart = (int *) calloc (l.nlibs + 1, sizeof (int));
+	  if (binstart == NULL)
+	    error (EXIT_FAILURE, ENOMEM, "Cannot lay libraries out");
+	  for (i = 0; i < l.nbinlibs; ++i)
+	    for (j = 0; j < l.binlibs[i]->ndepends; ++j)
+	      if (l.binlibs[i]->depends[j]->u.tmp >= 0)
+		++binstart[l.binlibs[i]->depends[j]->u.tmp + 1];
+	  for (i = 0; i < l.nlibs; ++i)
+	    binstart[i + 1] += binstart[i];
+	  bins = (int *) malloc ((binstart[l.nlibs] + 1) * sizeof (int));
+	  if (bins == NULL)
+	    error (EXIT_FAILURE, ENOMEM, "Cannot lay libraries out");
+	  for (i = 0; i < l.nlibs; ++i)
+	    mark[i] = binstart[i];
+	  for (i = 0; i < l.nbinlibs; ++i)
+	    for (j = 0; j < l.binlibs[i]->ndepends; ++j)
+	      if (l.binlibs[i]->depends[j]->u.tmp >= 0)
+		bins[mark[l.binlibs[i]->depends[j]->u.tmp]++] = i;
+	  for (i = 0; i < l.nlibs; ++i)
+	    mark[i] = -1;
 
-	    if (base + size > mmap_fin)
-	      goto not_found;
-found:
-	    l.libs[i]->end += base - l.libs[i]->base;
-	    l.libs[i]->base = base;
-	    l.libs[i]->layend = base + size;
-	    if (base >= mmap_end)
-	      l.libs[i]->done = done;
-	    else
-	      l.libs[i]->done = 1;
-	    if (list == NULL)
-	      {
-		list = l.libs[i];
-		list->prev = list;
-	      }
-	    else
-	      {
-		if (e == NULL)
-		  e = list->prev;
-		else
-		  e = e->prev;
-		while (e != list && e->base > base)
-		  e = e->prev;
-		if (e->base > base)
-		  {
-		    l.libs[i]->next = list;
-		    l.libs[i]->prev = list->prev;
-		    list->prev = l.libs[i];
-		    list = l.libs[i];
-		  }
-		else
+	  adjsize = l.nlibs + 16;
+	  adj = (int *) malloc (adjsize * sizeof (int));
+	  adjstart = (int *) malloc ((l.nlibs + 1) * sizeof (int));
+	  if (adj == NULL || adjstart == NULL)
+	    error (EXIT_FAILURE, ENOMEM, "Cannot lay libraries out");
+	  nadj = 0;
+	  for (i = 0; i < l.nlibs; ++i)
+	    {
+	      adjstart[i] = nadj;
+	      mark[i] = i;
+	      for (j = binstart[i]; j < binstart[i + 1]; ++j)
+		for (k = 0; k < l.binlibs[bins[j]]->ndepends; ++k)
 		  {
-		    l.libs[i]->next = e->next;
-		    l.libs[i]->prev = e;
-		    if (e->next)
-		      e->next->prev = l.libs[i];
-		    else
-		      list->prev = l.libs[i];
-		    e->next = l.libs[i];
+		    e = l.binlibs[bins[j]]->depends[k];
+		    if (e->u.tmp < 0 || mark[e->u.tmp] == i)
+		      continue;
+		    mark[e->u.tmp] = i;
+		    if (nadj == adjsize)
+		      {
+			adjsize *= 2;
+			adj = (int *) realloc (adj, adjsize * sizeof (int));
+			if (adj == NULL)
+			  error (EXIT_FAILURE, ENOMEM, "Cannot lay libraries out");
+		      }
+		    adj[nadj++] = e->u.tmp;
 		  }
-	      }
-#ifdef DEBUG_LAYOUT
+	    }
+	  adjstart[l.nlibs] = nadj;
+	  for (i = 0; i < l.nlibs; ++i)
+	    mark[i] = -1;
+	  free (bins);
+	  free (binstart);
+	  bins = NULL;
+	  binstart = NULL;
+
+	  /* Color it greedily, each library getting the lowest slot
+	     not overlapping any of its neighbors placed before.  With -R
+	     keep the randomized order.  */
+	  order = (int *) malloc ((l.nlibs + 1) * sizeof (int));
+	  if (order == NULL)
+	    error (EXIT_FAILURE, ENOMEM, "Cannot lay libraries out");
+	  memcpy (cand, l.libs, l.nlibs * sizeof (struct prelink_entry *));
+	  if (! random_base)
+	    qsort (cand, l.nlibs, sizeof (struct prelink_entry *), color_cmp);
+	  for (i = 0; i < l.nlibs; ++i)
+	    order[i] = cand[i]->u.tmp;
+	}
+      else
+	{
+	  if (nsticky)
+	    nplaced = layout_keep_bases (placed, nplaced, cand, nsticky,
+					 listed, mmap_end, max_page_size);
+	  layout_gaps_init (&gaps, placed, nplaced, mmap_start);
+	}
+
+      /* With -m the libraries kept at their previous addresses are
+	 found in an extra pass before the others, using mark stamps
+	 distinct from the second pass.  */
+      for (pass = sticky && conserve_memory ? 0 : 1; pass < 2; ++pass)
+	for (o = 0; o < l.nlibs; ++o)
+	  if (! l.libs[i = conserve_memory ? order[o] : o]->done)
 	    {
-	      struct prelink_entry *last = list;
-	      base = 0;
-	      for (e = list; e; last = e, e = e->next)
+	      int gap = -1, m = i + pass * l.nlibs;
+
+	      if (pass == 0
+		  && layout_sticky_base (l.libs[i], l.libs[i]->base, mmap_start,
+					 mmap_end, max_page_size) == 0)
+		continue;
+	      size = l.libs[i]->layend - l.libs[i]->base;
+	      if (conserve_memory)
+		{
+		  /* If conserving virtual address space, only consider
+		     this library's neighbors in the interference graph.
+		     Otherwise consider all libraries.  */
+		  ncand = 0;
+		  for (j = adjstart[i]; j < adjstart[i + 1]; ++j)
+		    {
+		      mark[adj[j]] = m;
+		      if (listed[adj[j]])
+			cand[ncand++] = l.libs[adj[j]];
+		    }
+		  /* Unless most of the libraries appear together with this
+		     one, sort just those instead of walking all of them.  */
+		  if ((ncand + nfakes) * 8 < nplaced)
+		    {
+		      memcpy (cand + ncand, fakes,
+			      nfakes * sizeof (struct prelink_entry *));
+		      qsort (cand, ncand + nfakes,
+			     sizeof (struct prelink_entry *), deps_cmp);
+		      ents = cand;
+		      n = ncand + nfakes;
+		      emark = NULL;
+		    }
+		  else
+		    {
+		      ents = placed;
+		      n = nplaced;
+		      emark = mark;
+		    }
+		  if (pass == 0)
+		    {
+		      base = l.libs[i]->base;
+		      if (base + size > mmap_end
+			  || layout_find_slot (ents, n, emark, m, base, size,
+					       &last) != base)
+			{
+			  size = layout_min_size (l.libs[i], max_page_size);
+			  if (layout_find_slot (ents, n, emark, m, base, size,
+						&last) != base)
+			    continue;
+			}
+		    }
+		  else
+		    base = layout_find_slot (ents, n, emark, m, mmap_start,
+					     size, &last);
+		}
+	      else
+		{
+		  gap = layout_gaps_find (&gaps, size);
+		  assert (gap != -1);
+		  base = gaps.start[gap];
+		  last = gap == gaps.n - 1;
+		}
+
+	      if (last && base + size > mmap_fin)
+		error (EXIT_FAILURE, 0,
+		       "Could not find virtual address slot for %s",
+		       l.libs[i]->filename);
+
+	      if (gap != -1)
 		{
-		  if (e->base < base)
-		    abort ();
-		  base = e->base;
-		  if ((e == list && e->prev->next != NULL)
-		      || (e != list && e->prev->next != e))
-		    abort ();
+		  gaps.start[gap] = base + size;
+		  layout_gaps_update (&gaps, gap);
 		}
-	      if (list->prev != last)
-		abort ();
+	      l.libs[i]->end += base - l.libs[i]->base;
+	      l.libs[i]->base = base;
+	      l.libs[i]->layend = base + size;
+	      if (base >= mmap_end)
+		l.libs[i]->done = done;
+	      else
+		l.libs[i]->done = 1;
+	      layout_insert (placed, nplaced++, l.libs[i]);
+	      listed[i] = 1;
 	    }
-#endif
-	    continue;
 
-not_found:
-	    error (EXIT_FAILURE, 0, "Could not find virtual address slot for %s",
-		   l.libs[i]->filename);
-	  }
+      list = nplaced ? placed[0] : NULL;
+      for (i = 0; i < nplaced; ++i)
+	{
+	  placed[i]->prev = placed[i ? i - 1 : nplaced - 1];
+	  placed[i]->next = i + 1 < nplaced ? placed[i + 1] : NULL;
+	}
+#ifdef DEBUG_LAYOUT
+      for (i = 1; i < nplaced; ++i)
+	if (placed[i]->base < placed[i - 1]->base)
+	  abort ();
+#endif
+      layout_gaps_free (&gaps);
+      free (placed);
+      free (cand);
+      free (fakes);
+      free (listed);
+      free (mark);
+      free (binstart);
+      free (bins);
+      free (adj);
+      free (adjstart);
+      free (order);
 
       if (layout_libs_post)
 	{
@@ -628,6 +1061,40 @@ not_found:
 		      class == ELFCLASS32 ? 8 : 16, (long long) l.libs[i]->end);
 	}
 
+      if (incremental_layout)
+	{
+	  int nkept = 0, nmoved = 0, nnew = 0;
+
+	  for (i = 0; i < l.nlibs; ++i)
+	    {
+	      e = l.libs[i];
+	      if (e->done < 1)
+		continue;
+	      if (oldbase[i] == e->base)
+		{
+		  ++nkept;
+		  continue;
+		}
+	      if (oldbase[i])
+		{
+		  ++nmoved;
+		  printf ("Moved %-54s %0*llx -> %0*llx\n", e->filename,
+			  class == ELFCLASS32 ? 8 : 16, (long long) oldbase[i],
+			  class == ELFCLASS32 ? 8 : 16, (long long) e->base);
+		}
+	      else
+		{
+		  ++nnew;
+		  if (verbose)
+		    printf ("New   %-54s %0*llx\n", e->filename,
+			    class == ELFCLASS32 ? 8 : 16, (long long) e->base);
+		}
+	    }
+	  printf ("%d libraries kept their address, %d moved, %d new\n",
+		  nkept, nmoved, nnew);
+	  free (oldbase);
+	}
+
 #ifdef DEBUG_LAYOUT
       for (i = 0; i < l.nbinlibs; ++i)
 	{
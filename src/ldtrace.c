@@ -0,0 +1,156 @@
+/* Copyright (C) 2026 Red Hat, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.  */
+
+#include <config.h>
+#include <byteswap.h>
+#include <endian.h>
+#include <errno.h>
+#include <error.h>
+#include <stdlib.h>
+#include <string.h>
+#include "prelink.h"
+#include "ldtrace.h"
+
+/* Return non-zero if F starts with a binary trace.  */
+int
+ldtrace_binary_p (FILE *f)
+{
+  int c = getc (f);
+
+  if (c == EOF)
+    return 0;
+  ungetc (c, f);
+  return c == LDTRACE_MAGIC[0];
+}
+
+int
+ldtrace_open (struct ldtrace_reader *r, FILE *f, const char *filename)
+{
+  struct ldtrace_header h;
+  uint16_t recsize;
+
+  memset (r, 0, sizeof (*r));
+  r->f = f;
+  if (fread (&h, sizeof (h), 1, f) != 1
+      || memcmp (h.h_magic, LDTRACE_MAGIC, LDTRACE_MAGIC_LEN))
+    {
+      error (0, 0, "%s: Could not read binary trace header", filename);
+      return 1;
+    }
+
+  if (h.h_data != ELFDATA2LSB && h.h_data != ELFDATA2MSB)
+    {
+      error (0, 0, "%s: Unknown binary trace byte order %d", filename,
+	     h.h_data);
+      return 1;
+    }
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+  r->swap = h.h_data == ELFDATA2MSB;
+#else
+  r->swap = h.h_data == ELFDATA2LSB;
+#endif
+  recsize = r->swap ? bswap_16 (h.h_recsize) : h.h_recsize;
+  if (h.h_version != LDTRACE_VERSION
+      || recsize != sizeof (struct ldtrace_record))
+    {
+      error (0, 0, "%s: Unsupported binary trace version %d", filename,
+	     h.h_version);
+      return 1;
+    }
+  return 0;
+}
+
+/* Read the next record other than LDTRACE_STRTAB into REC.
+   Return 1 on failure or if the stream ends without LDTRACE_END.  */
+int
+ldtrace_read (struct ldtrace_reader *r, struct ldtrace_record *rec,
+	      const char *filename)
+{
+  int i;
+
+  do
+    {
+      if (fread (rec, sizeof (*rec), 1, r->f) != 1)
+	{
+	  error (0, 0, "%s: Binary trace truncated", filename);
+	  return 1;
+	}
+
+      if (r->swap)
+	{
+	  rec->r_class = bswap_32 (rec->r_class);
+	  rec->r_name = bswap_32 (rec->r_name);
+	  rec->r_name2 = bswap_32 (rec->r_name2);
+	  for (i = 0; i < 6; ++i)
+	    rec->r_addr[i] = bswap_64 (rec->r_addr[i]);
+	}
+
+      if (rec->r_type == LDTRACE_STRTAB)
+	{
+	  size_t len = rec->r_name;
+
+	  if (r->strtab_size + len > r->strtab_alloced)
+	    {
+	      size_t alloced = 2 * r->strtab_alloced + len + 4096;
+	      char *strtab = realloc (r->strtab, alloced);
+
+	      if (strtab == NULL)
+		{
+		  error (0, ENOMEM, "%s: Could not read binary trace",
+			 filename);
+		  return 1;
+		}
+	      r->strtab = strtab;
+	      r->strtab_alloced = alloced;
+	    }
+	  if (fread (r->strtab + r->strtab_size, 1, len, r->f) != len)
+	    {
+	      error (0, 0, "%s: Binary trace truncated", filename);
+	      return 1;
+	    }
+	  r->strtab_size += len;
+	}
+      else if (rec->r_type > LDTRACE_STRTAB)
+	{
+	  error (0, 0, "%s: Unknown binary trace record type %d", filename,
+		 rec->r_type);
+	  return 1;
+	}
+    }
+  while (rec->r_type == LDTRACE_STRTAB);
+
+  return 0;
+}
+
+/* Return string at offset OFF, NULL for LDTRACE_NONE or if OFF
+   is not a valid string.  */
+const char *
+ldtrace_string (struct ldtrace_reader *r, uint32_t off)
+{
+  if (off == LDTRACE_NONE || off >= r->strtab_size
+      || memchr (r->strtab + off, '\0', r->strtab_size - off) == NULL)
+    return NULL;
+  return r->strtab + off;
+}
+
+void
+ldtrace_close (struct ldtrace_reader *r)
+{
+  free (r->strtab);
+  r->strtab = NULL;
+  r->strtab_size = 0;
+  r->strtab_alloced = 0;
+}
@@ -0,0 +1,110 @@
+/* Copyright (C) 2026 Red Hat, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.  */
+
+#ifndef LDTRACE_H
+#define LDTRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* Binary LD_TRACE_PRELINKING protocol.
+
+   If LD_TRACE_PRELINKING_FORMAT=binary is set in the environment,
+   a dynamic linker which supports it writes, instead of the usual
+   text lines, a struct ldtrace_header followed by a stream of
+   struct ldtrace_record.  Anything the dynamic linker prints before
+   the header (e.g. a fatal error about a missing library) is text,
+   and a dynamic linker not knowing the variable prints text only,
+   so readers must check for LDTRACE_MAGIC and fall back to parsing
+   text.
+
+   All integers are in the byte order given by h_data (ELFDATA2LSB
+   or ELFDATA2MSB).  Names are offsets into a string table, which is
+   transmitted incrementally: an LDTRACE_STRTAB record is followed
+   by r_name bytes which are appended to it.  A string must be sent
+   before the first record which refers to it.  The stream ends with
+   an LDTRACE_END record; if it is missing, the trace is truncated.  */
+
+#define LDTRACE_MAGIC		"\177PLTRACE"
+#define LDTRACE_MAGIC_LEN	8
+#define LDTRACE_VERSION		1
+
+/* String table offset standing for no string.  */
+#define LDTRACE_NONE		0xffffffff
+
+struct ldtrace_header
+{
+  unsigned char h_magic[LDTRACE_MAGIC_LEN];
+  unsigned char h_data;
+  unsigned char h_version;
+  uint16_t h_recsize;		/* sizeof (struct ldtrace_record).  */
+  uint32_t h_pad;
+};
+
+/* r_type values.  */
+#define LDTRACE_END		0
+/* A loaded object: r_name is its soname (as ld.so would print it),
+   r_name2 its filename or LDTRACE_NONE if it was not found,
+   r_addr[] its l_map_start, l_addr, TLS module id and TLS offset.  */
+#define LDTRACE_DEP		1
+/* A symbol lookup: r_name is the symbol name, r_addr[] the
+   l_map_start of the object containing the reference, the symbol
+   offset, l_map_start of the defining object (0 if none) and the
+   symbol value.  */
+#define LDTRACE_LOOKUP		2
+/* Like LDTRACE_LOOKUP, followed by r_addr[4] and r_addr[5] with the
+   defining object and value found in the referencing object's local
+   scope.  */
+#define LDTRACE_CONFLICT	3
+/* A strong undefined symbol r_name.  */
+#define LDTRACE_UNDEFINED	4
+/* r_name bytes of string table follow.  */
+#define LDTRACE_STRTAB		5
+
+/* r_flags.  */
+/* r_class is the dynamic linker's ELF_RTYPE_CLASS_* value,
+   with ELF_RTYPE_CLASS_VALID (8) set for STT_GNU_IFUNC definitions,
+   rather than a relocation type.  */
+#define LDTRACE_F_TYPE_CLASS	1
+
+struct ldtrace_record
+{
+  uint8_t r_type;
+  uint8_t r_flags;
+  uint16_t r_pad;
+  uint32_t r_class;
+  uint32_t r_name;
+  uint32_t r_name2;
+  uint64_t r_addr[6];
+};
+
+struct ldtrace_reader
+{
+  FILE *f;
+  int swap;
+  char *strtab;
+  size_t strtab_size;
+  size_t strtab_alloced;
+};
+
+int ldtrace_binary_p (FILE *f);
+int ldtrace_open (struct ldtrace_reader *r, FILE *f, const char *filename);
+int ldtrace_read (struct ldtrace_reader *r, struct ldtrace_record *rec,
+		  const char *filename);
+const char *ldtrace_string (struct ldtrace_reader *r, uint32_t off);
+void ldtrace_close (struct ldtrace_reader *r);
+
+#endif /* LDTRACE_H */
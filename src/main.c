@@ -40,6 +40,10 @@ GElf_Addr reloc_base;
 int no_update;
 int random_base;
 int conserve_memory;
+int incremental_layout;
+int layout_slack;
+int parallel_jobs = 1;
+int defer_debug, apply_debug;
 int libs_only;
 int dry_run;
 int dereference;
@@ -60,6 +64,7 @@ const char *prelink_conf = PRELINK_CONF;
 const char *prelink_cache = PRELINK_CACHE;
 const char *undo_output;
 char *ld_preload = NULL;
+int ld_trace;
 int noreexecinit;
 time_t initctime;
 
@@ -84,6 +89,11 @@ static char argp_doc[] = PRELINK_PROG " -- program to relocate and prelink ELF s
 #define OPT_LAYOUT_PAGE_SIZE	0x8c
 #define OPT_ALLOW_TEXTREL	0x8d
 #define OPT_LD_PRELOAD		0x8e
+#define OPT_LD_TRACE		0x8f
+#define OPT_DEFER_DEBUG		0x90
+#define OPT_APPLY_DEBUG		0x91
+#define OPT_INCREMENTAL_LAYOUT	0x92
+#define OPT_LAYOUT_SLACK	0x93
 
 static struct argp_option options[] = {
   {"all",		'a', 0, 0,  "Prelink all binaries" },
@@ -92,6 +102,7 @@ static struct argp_option options[] = {
   {"config-file",	'c', "CONF", 0, "Use CONF as configuration file" },
   {"force",		'f', 0, 0,  "Force prelinking" },
   {"dereference",	'h', 0, 0,  "Follow symlinks when processing directory trees from command line" },
+  {"jobs",		'j', "N", 0, "Prelink up to N objects in parallel" },
   {"one-file-system",	'l', 0, 0,  "Stay in local file system when processing directories from command line" },
   {"conserve-memory",	'm', 0, 0,  "Allow libraries to overlap as long as they never appear in the same program" },
   {"no-update-cache",	'N', 0, 0,  "Don't update prelink cache" },
@@ -113,8 +124,11 @@ static struct argp_option options[] = {
   {"ld-library-path",	OPT_LD_LIBRARY_PATH, "PATHLIST",
 				0,  "What LD_LIBRARY_PATH should be used" },
   {"ld-preload",	OPT_LD_PRELOAD, "PATHLIST", 0,  "What LD_PRELOAD should be used" },
+  {"ld-trace",		OPT_LD_TRACE, 0, 0,  "Resolve symbols by running the dynamic linker" },
   {"libs-only",		OPT_LIBS_ONLY, 0, 0, "Prelink only libraries, no binaries" },
   {"layout-page-size",	OPT_LAYOUT_PAGE_SIZE, "SIZE", 0, "Layout start of libraries at given boundary" },
+  {"layout-slack",	OPT_LAYOUT_SLACK, "PERCENT", 0, "Leave PERCENT of each library's size free after it for later growth" },
+  {"incremental-layout", OPT_INCREMENTAL_LAYOUT, 0, 0, "Keep libraries at their previous addresses where possible and report which moved" },
   {"disable-c++-optimizations", OPT_CXX_DISABLE, 0, OPTION_HIDDEN, "" },
   {"mmap-region-start",	OPT_MMAP_REG_START, "BASE_ADDRESS", OPTION_HIDDEN, "" },
   {"mmap-region-end",	OPT_MMAP_REG_END, "BASE_ADDRESS", OPTION_HIDDEN, "" },
@@ -122,6 +136,8 @@ static struct argp_option options[] = {
   {"compute-checksum",	OPT_COMPUTE_CHECKSUM, 0, OPTION_HIDDEN, "" },
   {"init",		'i', 0, 0,  "Do not re-execute init" },
   {"allow-textrel",	OPT_ALLOW_TEXTREL, 0, 0, "Allow text relocations even on architectures where they may not work" },
+  {"defer-debug",	OPT_DEFER_DEBUG, 0, 0, "Don't adjust debugging sections of relocated libraries, just record by how much they should be" },
+  {"apply-debug",	OPT_APPLY_DEBUG, 0, 0, "Adjust debugging sections left behind by --defer-debug" },
   { 0 }
 };
 
@@ -175,6 +191,11 @@ parse_opt (int key, char *arg, struct argp_state *state)
     case 'm':
       conserve_memory = 1;
       break;
+    case 'j':
+      parallel_jobs = strtol (arg, &endarg, 0);
+      if (endarg != strchr (arg, '\0') || parallel_jobs < 1)
+	error (EXIT_FAILURE, 0, "-j option requires positive numeric argument");
+      break;
     case 'N':
       no_update = 1;
       break;
@@ -246,6 +267,24 @@ parse_opt (int key, char *arg, struct argp_state *state)
     case OPT_LD_PRELOAD:
       ld_preload = arg;
       break;
+    case OPT_LD_TRACE:
+      ld_trace = 1;
+      break;
+    case OPT_DEFER_DEBUG:
+      defer_debug = 1;
+      break;
+    case OPT_APPLY_DEBUG:
+      apply_debug = 1;
+      break;
+    case OPT_INCREMENTAL_LAYOUT:
+      incremental_layout = 1;
+      break;
+    case OPT_LAYOUT_SLACK:
+      layout_slack = strtoul (arg, &endarg, 0);
+      if (endarg != strchr (arg, '\0') || layout_slack < 0
+	  || layout_slack > 1000)
+	error (EXIT_FAILURE, 0, "--layout-slack option requires numeric argument between 0 and 1000");
+      break;
     default:
       return ARGP_ERR_UNKNOWN;
     }
@@ -342,6 +381,8 @@ main (int argc, char *argv[])
     error (EXIT_FAILURE, 0, "--dry-run and --verify options are incompatible");
   if ((undo || verify) && quick)
     error (EXIT_FAILURE, 0, "--undo and --quick options are incompatible");
+  if (apply_debug && (all || undo || verify || reloc_only || defer_debug))
+    error (EXIT_FAILURE, 0, "--apply-debug can't be used together with --all, --undo, --verify, --reloc-only or --defer-debug");
 
   /* Set the default for exec_shield.  */
   if (exec_shield == 2)
@@ -390,7 +431,7 @@ main (int argc, char *argv[])
       return prelink_verify (argv[remaining]);
     }
 
-  if (reloc_only || (undo && ! all))
+  if (reloc_only || apply_debug || (undo && ! all))
     {
       while (remaining < argc)
 	{
@@ -413,6 +454,17 @@ main (int argc, char *argv[])
 
 	  if (undo)
 	    ret = prelink_undo (dso);
+	  else if (apply_debug)
+	    {
+	      ret = 0;
+	      if (dso->debug_delta)
+		{
+		  if (verbose)
+		    printf ("Adjusting debugging sections of %s\n",
+			    dso->filename);
+		  ret = reopen_dso (dso, NULL, NULL) || apply_debug_delta (dso);
+		}
+	    }
 	  else
 	    ret = relocate_dso (dso, reloc_base);
 
@@ -79,77 +79,69 @@ resolve_dso (struct prelink_info *info, GElf_Word r_sym,
 }
 
 static int
-prelink_rel (DSO *dso, int n, struct prelink_info *info)
+prelink_relocs (DSO *dso, int n, struct prelink_info *info)
 {
-  Elf_Data *data = NULL;
-  Elf_Scn *scn = dso->scn[n];
-  GElf_Rel rel;
-  int sec;
+  struct reloc_view view;
+  GElf_Addr entsize = dso->shdr[n].sh_entsize;
+  int r, i, ret, changed = 0;
 
-  while ((data = elf_getdata (scn, data)) != NULL)
+  if (read_reloc_view (dso, n, &view))
+    return 1;
+
+  for (r = 0; r < view.nruns; ++r)
     {
-      int ndx, maxndx;
-      GElf_Addr addr = dso->shdr[n].sh_addr + data->d_off;
+      struct reloc_run *run = &view.runs[r];
 
-      maxndx = data->d_size / dso->shdr[n].sh_entsize;
-      for (ndx = 0; ndx < maxndx;
-	   ++ndx, addr += dso->shdr[n].sh_entsize)
+      if (dso->arch->prelink_reloc_batch)
 	{
-	  gelfx_getrel (dso->elf, data, ndx, &rel);
-	  sec = addr_to_sec (dso, rel.r_offset);
-	  if (sec == -1)
+	  ret = dso->arch->prelink_reloc_batch (info, &view, run);
+	  if (ret < 0)
+	    goto error_out;
+	  if (ret)
 	    continue;
-
-	  switch (dso->arch->prelink_rel (info, &rel, addr))
-	    {
-	    case 2:
-	      gelfx_update_rel (dso->elf, data, ndx, &rel);
-	      break;
-	    case 0:
-	      break;
-	    default:
-	      return 1;
-	    }
 	}
-    }
-  return 0;
-}
-
-static int
-prelink_rela (DSO *dso, int n, struct prelink_info *info)
-{
-  Elf_Data *data = NULL;
-  Elf_Scn *scn = dso->scn[n];
-  GElf_Rela rela;
-  int sec;
-
-  while ((data = elf_getdata (scn, data)) != NULL)
-    {
-      int ndx, maxndx;
-      GElf_Addr addr = dso->shdr[n].sh_addr + data->d_off;
 
-      maxndx = data->d_size / dso->shdr[n].sh_entsize;
-      for (ndx = 0; ndx < maxndx;
-	   ++ndx, addr += dso->shdr[n].sh_entsize)
+      for (i = run->first; i < run->first + run->count; ++i)
 	{
-	  gelfx_getrela (dso->elf, data, ndx, &rela);
-	  sec = addr_to_sec (dso, rela.r_offset);
-	  if (sec == -1)
+	  GElf_Addr reladdr = dso->shdr[n].sh_addr + i * entsize;
+
+	  if (reloc_view_sec (&view, view.offset[i]) == -1)
 	    continue;
 
-	  switch (dso->arch->prelink_rela (info, &rela, addr))
+	  if (view.rela)
 	    {
-	    case 2:
-	      gelfx_update_rela (dso->elf, data, ndx, &rela);
-	      break;
-	    case 0:
-	      break;
-	    default:
-	      return 1;
+	      GElf_Rela rela;
+
+	      reloc_view_get_rela (&view, i, &rela);
+	      ret = dso->arch->prelink_rela (info, &rela, reladdr);
+	      if (ret == 2)
+		reloc_view_set_rela (&view, i, &rela);
 	    }
+	  else
+	    {
+	      GElf_Rel rel;
+
+	      reloc_view_get_rel (&view, i, &rel);
+	      ret = dso->arch->prelink_rel (info, &rel, reladdr);
+	      if (ret == 2)
+		reloc_view_set_rel (&view, i, &rel);
+	    }
+
+	  if (ret == 2)
+	    changed = 1;
+	  else if (ret)
+	    goto error_out;
 	}
     }
+
+  if ((changed || view.changed) && write_reloc_view (&view))
+    goto error_out;
+  free_reloc_view (&view);
   return 0;
+
+error_out:
+  free_reloc_view (&view);
+  return 1;
 }
 
 int
@@ -157,6 +149,7 @@ prelink_prepare (DSO *dso)
 {
   struct reloc_info rinfo;
   int liblist = 0, libstr = 0, newlibstr = 0, undo = 0, newundo = 0;
+  int debug = 0, newdebug = 0;
   int i;
 
   for (i = 1; i < dso->ehdr.e_shnum; ++i)
@@ -169,6 +162,8 @@ prelink_prepare (DSO *dso)
 	libstr = i;
       else if (! strcmp (name, ".gnu.prelink_undo"))
 	undo = i;
+      else if (! strcmp (name, ".gnu.prelink_debug"))
+	debug = i;
     }
 
   if (undo == 0)
@@ -296,11 +291,24 @@ prelink_prepare (DSO *dso)
       libstr = -1;
     }
 
-  if (liblist && libstr && undo
+  /* With --defer-debug, add .gnu.prelink_debug section to record
+     by how much the debugging sections should be adjusted.  */
+  if (! debug && defer_debug)
+    {
+      for (i = 1; i < dso->ehdr.e_shnum; ++i)
+	if (debug_section_p (dso, i))
+	  break;
+      if (i == dso->ehdr.e_shnum)
+	debug = -1;
+    }
+  else if (! debug)
+    debug = -1;
+
+  if (liblist && libstr && undo && debug
       && ! rinfo.rel_to_rela && ! rinfo.rel_to_rela_plt)
       return 0;
 
-  if (! liblist || ! libstr || ! undo)
+  if (! liblist || ! libstr || ! undo || ! debug)
     {
       struct section_move *move;
 
@@ -342,6 +350,13 @@ prelink_prepare (DSO *dso)
       else
 	undo = move->old_to_new[undo];
 
+      if (! debug)
+	{
+	  add_section (move, undo + 1);
+	  debug = undo + 1;
+	  newdebug = 1;
+	}
+
       if (reopen_dso (dso, move, NULL))
 	{
 	  free (move);
@@ -404,10 +419,13 @@ prelink_prepare (DSO *dso)
 	  scn = dso->scn[undo];
 	  data = elf_getdata (scn, NULL);
 	  assert (data != NULL && elf_getdata (scn, data) == NULL);
-	  free (data->d_buf);
+	  free_section_data (dso, data->d_buf);
 	  *data = dso->undo;
 	  dso->undo.d_buf = NULL;
 	}
+
+      if (newdebug && init_debug_delta (dso, debug))
+	return 1;
     }
   else if (reopen_dso (dso, NULL, NULL))
     return 1;
@@ -714,7 +732,7 @@ prelink_dso (struct prelink_info *info)
   data->d_off = 0;
   data->d_align = 1;
   data->d_version = EV_CURRENT;
-  data->d_buf = realloc (data->d_buf, strsize);
+  data->d_buf = realloc_section_data (dso, data->d_buf, 0, strsize);
   if (data->d_buf == NULL)
     {
       error (0, ENOMEM, "%s: Could not build .gnu.libstr section",
@@ -760,7 +778,7 @@ prelink_dso (struct prelink_info *info)
   data->d_off = 0;
   data->d_align = sizeof (GElf_Word);
   data->d_version = EV_CURRENT;
-  free (data->d_buf);
+  free_section_data (dso, data->d_buf);
   data->d_buf = list;
   list = NULL;
 
@@ -814,68 +832,14 @@ free_info (struct prelink_info *info)
   free (info->symtab);
   free (info->dynbss);
   free (info->sdynbss);
-  free (info->conflict_rela);
-  if (info->conflicts)
-    {
-      for (i = 0; i < info->ent->ndepends + 1; ++i)
-	{
-	  if (info->conflicts[i].hash == &info->conflicts[i].first)
-	    {
-	      struct prelink_conflict *c = info->conflicts[i].first;
-	      void *f;
-
-	      while (c != NULL)
-		{
-		  f = c;
-		  c = c->next;
-		  free (f);
-		}
-	    }
-	  else
-	    {
-	      int j;
-	      for (j = 0; j < 251; j++)
-	        {
-		  struct prelink_conflict *c = info->conflicts[i].hash[j];
-		  void *f;
-
-		  while (c != NULL)
-		    {
-		      f = c;
-		      c = c->next;
-		      free (f);
-		    }
-		}
-	      free (info->conflicts[i].hash);
-	    }
-	  if (info->conflicts[i].hash2 != NULL)
-	    free (info->conflicts[i].hash2);
-	}
-      free (info->conflicts);
-    }
   if (info->sonames)
     {
       for (i = 0; i < info->ent->ndepends + 1; ++i)
 	free ((char *) info->sonames[i]);
       free (info->sonames);
     }
-  free (info->tls);
-  if (info->symbols)
-    {
-      for (i = 0; i < info->symbol_count; ++i)
-	{
-	  struct prelink_symbol *s = info->symbols[i].next;
-	  void *f;
-
-	  while (s != NULL)
-	    {
-	      f = s;
-	      s = s->next;
-	      free (f);
-	    }
-	}
-      free (info->symbols);
-    }
+  /* Symbols, conflicts, TLS records and .gnu.conflict relocations.  */
+  arena_free (&info->arena);
 }
 
 int
@@ -967,11 +931,8 @@ prelink (DSO *dso, struct prelink_entry *ent)
       switch (dso->shdr[i].sh_type)
 	{
 	case SHT_REL:
-	  if (prelink_rel (dso, i, &info))
-	    goto error_out;
-	  break;
 	case SHT_RELA:
-	  if (prelink_rela (dso, i, &info))
+	  if (prelink_relocs (dso, i, &info))
 	    goto error_out;
 	  break;
 	}
@@ -59,6 +59,18 @@ typedef uint8_t Elf64_Byte;
 #define SHT_GNU_HASH		0x6ffffff6
 #endif
 
+#ifndef DT_RELR
+#define SHT_RELR		19
+#define DT_RELRSZ		35
+#define DT_RELR			36
+#define DT_RELRENT		37
+#endif
+
+#if DT_NUM <= DT_RELRENT
+#undef DT_NUM
+#define DT_NUM			(DT_RELRENT + 1)
+#endif
+
 #ifndef DT_TLSDESC_PLT
 #define DT_TLSDESC_PLT		0x6ffffef6
 #endif
@@ -157,6 +169,7 @@ struct prelink_entry;
 struct prelink_info;
 struct PLArch;
 struct opd_lib;
+struct find_cxx_sym_cache;
 
 struct PLAdjust
 {
@@ -210,18 +223,76 @@ typedef struct
   /* .mdebug has absolute file offsets in it.  */
   GElf_Off mdebug_orig_offset;
   Elf_Data undo;
+  /* Set if the object has .gnu.prelink_debug section.  Addresses in
+     its debugging sections then lag behind by debug_delta.  */
+  int has_debug_delta;
+  GElf_Addr debug_delta;
   int nadjust;
   int permissive;
   struct section_move *move;
+  /* Sections addr_to_sec can return, sorted by address.  naddr_index
+     is -1 if the index needs to be rebuilt and -2 if it can't be used
+     because the sections overlap.  */
+  struct addr_index *addr_index;
+  int naddr_index;
+  /* Per section index of Elf_Data chunks, see sec_offset_to_data.  */
+  struct data_index **data_index;
+  int ndata_index;
+  /* Copy-on-write mapping of the input file, NULL if it has been
+     read instead.  Section data in it is shared by elf and, after
+     reopen_dso, elfro.  */
+  void *map;
+  size_t map_size;
   GElf_Shdr shdr[0];
 } DSO;
 
+struct addr_index
+{
+  GElf_Addr start, end;
+  int sec;
+};
+
+struct data_index
+{
+  /* Number of chunks, -1 if they overlap.  */
+  int n;
+  Elf_Data *data[0];
+};
+
 static inline int
 dynamic_info_is_set (DSO *dso, int bit)
 {
   return ((dso)->info_set_mask & (1ULL << (bit))) != 0;
 }
 
+/* Relocations of one SHT_REL, SHT_RELA or SHT_RELR section, see
+   relview.c.  */
+struct reloc_run
+{
+  int type;
+  int first, count;
+};
+
+struct reloc_view
+{
+  DSO *dso;
+  int sec, rela;
+  /* Set for SHT_RELR, with R_RELATIVE relocations decoded from it.  */
+  int relr;
+  int count;
+  GElf_Addr *offset;
+  GElf_Xword *info;
+  /* All zero for SHT_REL.  */
+  GElf_Sxword *addend;
+  int nruns;
+  struct reloc_run *runs;
+  /* Set by batch hooks if they modified the relocations themselves.  */
+  int changed;
+  /* Section and section data the last relocation applied to.  */
+  int last_sec;
+  Elf_Data *last_data;
+};
+
 struct layout_libs;
 
 struct PLArch
@@ -277,6 +348,15 @@ struct PLArch
   int (*arch_undo_prelink) (DSO *dso);
   int (*undo_prelink_rel) (DSO *dso, GElf_Rel *rel, GElf_Addr reladdr);
   int (*undo_prelink_rela) (DSO *dso, GElf_Rela *rela, GElf_Addr relaaddr);
+  /* Optional, process RUN of relocations in VIEW at once, instead of
+     calling the above hooks for each of them.  Return 1 if the run has
+     been handled, 0 if not, -1 on error.  */
+  int (*adjust_reloc_batch) (struct reloc_view *view, struct reloc_run *run,
+			     GElf_Addr start, GElf_Addr adjust);
+  int (*prelink_reloc_batch) (struct prelink_info *info,
+			      struct reloc_view *view, struct reloc_run *run);
+  int (*undo_prelink_reloc_batch) (struct reloc_view *view,
+				   struct reloc_run *run);
   int (*layout_libs_init) (struct layout_libs *l);
   int (*layout_libs_pre) (struct layout_libs *l);
   int (*layout_libs_post) (struct layout_libs *l);
@@ -298,10 +378,20 @@ int reopen_dso (DSO *dso, struct section_move *move, const char *);
 int adjust_symbol_p (DSO *dso, GElf_Sym *sym);
 int check_dso (DSO *dso);
 int dso_is_rdwr (DSO *dso);
+int dso_is_mapped (DSO *dso, const void *buf);
+void free_section_data (DSO *dso, void *buf);
+void *realloc_section_data (DSO *dso, void *buf, size_t oldsize,
+			    size_t size);
 void read_dynamic (DSO *dso);
 int set_dynamic (DSO *dso, GElf_Word tag, GElf_Addr value, int fatal);
+void build_addr_index (DSO *dso);
 int addr_to_sec (DSO *dso, GElf_Addr addr);
+int addr_in_dso_p (DSO *dso, GElf_Addr addr);
+void invalidate_section_index (DSO *dso);
 int adjust_dso (DSO *dso, GElf_Addr start, GElf_Addr adjust);
+int debug_section_p (DSO *dso, int n);
+int init_debug_delta (DSO *dso, int n);
+int apply_debug_delta (DSO *dso);
 int adjust_nonalloc (DSO *dso, GElf_Ehdr *ehdr, GElf_Shdr *shdr, int first,
 		     GElf_Addr start, GElf_Addr adjust);
 int adjust_dso_nonalloc (DSO *dso, int first, GElf_Addr start,
@@ -347,6 +437,7 @@ struct data_iterator {
 };
 
 unsigned char * get_data (DSO *dso, GElf_Addr addr, int *scnp, Elf_Type *typep);
+Elf_Data * sec_offset_to_data (DSO *dso, int sec, GElf_Addr offset);
 #define READWRITEPROTO(le,nn)					\
 uint##nn##_t buf_read_u##le##nn (unsigned char *data);		\
 uint##nn##_t read_u##le##nn (DSO *dso, GElf_Addr addr);		\
@@ -372,6 +463,21 @@ unsigned char *get_data_from_iterator (struct data_iterator *it,
 				       GElf_Addr size);
 int get_sym_from_iterator (struct data_iterator *it, GElf_Sym *sym);
 
+int read_reloc_view (DSO *dso, int n, struct reloc_view *view);
+int write_reloc_view (struct reloc_view *view);
+void free_reloc_view (struct reloc_view *view);
+void reloc_view_get_rel (struct reloc_view *view, int i, GElf_Rel *rel);
+void reloc_view_get_rela (struct reloc_view *view, int i, GElf_Rela *rela);
+void reloc_view_set_rel (struct reloc_view *view, int i, GElf_Rel *rel);
+void reloc_view_set_rela (struct reloc_view *view, int i, GElf_Rela *rela);
+int reloc_view_sec (struct reloc_view *view, GElf_Addr addr);
+unsigned char *reloc_target (struct reloc_view *view, GElf_Addr addr,
+			     int size);
+void adjust_reloc_words (struct reloc_view *view, struct reloc_run *run,
+			 int size, GElf_Addr start, GElf_Addr adjust);
+void adjust_relative_relocs (struct reloc_view *view, struct reloc_run *run,
+			     GElf_Addr start, GElf_Addr adjust);
+
 #define PL_ARCH(F) \
 static struct PLArch plarch_##F __attribute__((section("pl_arch"),used))
 
@@ -395,21 +501,37 @@ struct prelink_cache_entry
   uint32_t mtime;
   uint64_t base;
   uint64_t end;
+  uint64_t dev;
+  uint64_t ino;
+  /* crc32 of this entry with crc set to 0, its depends up to and
+     including its own index, and its filename.  */
+  uint32_t crc;
+  uint32_t unused;
 };
 
 struct prelink_cache
 {
 #define PRELINK_CACHE_NAME "prelink-ELF"
-#define PRELINK_CACHE_VER "0.3.2"
+#define PRELINK_CACHE_VER "0.4.0"
 #define PRELINK_CACHE_MAGIC PRELINK_CACHE_NAME PRELINK_CACHE_VER
   const char magic [sizeof (PRELINK_CACHE_MAGIC) - 1];
   uint32_t nlibs;
   uint32_t ndeps;
   uint32_t len_strings;
-  uint32_t unused[9];
+  /* Number of slots in each hash index, a power of 2.  */
+  uint32_t nhash;
+  /* File offsets of the filename and dev/ino hash indexes.
+     Slots contain entry index + 1, 0 if empty and
+     PRELINK_CACHE_DELETED if the entry moved elsewhere.  */
+  uint32_t filename_hash;
+  uint32_t devino_hash;
+#define PRELINK_CACHE_DELETED	0xffffffff
+  uint32_t unused[6];
   struct prelink_cache_entry entry[0];
   /* uint32_t depends [ndeps]; */
   /* const char strings [len_strings]; */
+  /* uint32_t filename_hash [nhash]; */
+  /* uint32_t devino_hash [nhash]; */
 };
 
 struct prelink_link
@@ -440,9 +562,13 @@ struct prelink_entry
       int tmp;
     } u;
   uint32_t ctime, mtime;
+  /* Index + 1 of the entry in the prelink cache being saved.  */
+  uint32_t cache_idx;
   struct prelink_entry **depends;
   struct prelink_entry *prev, *next;
   struct opd_lib *opd;
+  /* Sorted C++ vtable and typeinfo symbols, see cxx.c.  */
+  struct find_cxx_sym_cache *cxx_cache;
 };
 
 struct prelink_dir
@@ -474,8 +600,8 @@ struct prelink_symbol
 
 struct prelink_conflict
 {
+  /* Next conflict in prelink_conflicts.first list.  */
   struct prelink_conflict *next;
-  struct prelink_conflict *next2;
   /* Object which it was relocated to.  */
   union
     {
@@ -498,12 +624,33 @@ struct prelink_conflict
 
 struct prelink_conflicts
 {
+  /* All conflicts against one object.  */
   struct prelink_conflict *first;
+  /* Open addressing hash table of them, keyed by symoff and
+     reloc_class, see prelink_conflict_find.  */
   struct prelink_conflict **hash;
+  size_t hash_size;
+  /* Likewise, keyed by lookup value, built by cxx.c.  */
   struct prelink_conflict **hash2;
+  size_t hash2_size;
   size_t count;
 };
 
+/* Return the first slot to probe for KEY in a hash table with SIZE
+   (a power of two) slots.  */
+static inline size_t
+conflict_hash (GElf_Addr key, size_t size)
+{
+  return (size_t) (((uint64_t) key * 0x9e3779b97f4a7c15ULL) >> 32)
+	 & (size - 1);
+}
+
+struct prelink_arena
+{
+  struct prelink_arena_chunk *chunks;
+  char *ptr, *end;
+};
+
 #define conflict_lookup_value(cfl)					  \
   (((cfl)->reloc_class != RTYPE_CLASS_TLS ? (cfl)->lookup.ent->base : 0)  \
    + (cfl)->lookupval)
@@ -530,6 +677,28 @@ struct prelink_info
 			 int reloc_type);
   struct prelink_entry *resolveent;
   struct prelink_tls *resolvetls;
+  struct prelink_arena arena;
+};
+
+struct prelink_trace_dep
+{
+  struct prelink_entry *ent;
+  char *soname;
+  GElf_Addr start;
+  GElf_Addr l_addr;
+  GElf_Addr tls_modid;
+  GElf_Addr tls_offset;
+};
+
+struct prelink_trace
+{
+  struct prelink_info *info;
+  const char *ent_filename;
+  struct prelink_trace_dep *deps;
+  int ndeps;
+  int seen;
+  int undef;
+  int mask_32bit;
 };
 
 int prelink_prepare (DSO *dso);
@@ -541,12 +710,50 @@ int prelink_save_cache (int do_warn);
 struct prelink_entry *
   prelink_find_entry (const char *filename, const struct stat64 *stp,
 		      int insert);
+int prelink_cache_unchanged_p (const struct stat64 *stp);
+GElf_Addr prelink_cache_base (const char *filename);
 struct prelink_conflict *
   prelink_conflict (struct prelink_info *info, GElf_Word r_sym,
 		    int reloc_type);
 GElf_Rela *prelink_conflict_add_rela (struct prelink_info *info);
+struct prelink_conflict *
+  prelink_conflict_find (struct prelink_conflicts *conflicts,
+			 GElf_Addr symoff, int reloc_class);
+int prelink_conflict_insert (struct prelink_info *info,
+			     struct prelink_conflicts *conflicts,
+			     struct prelink_conflict *conflict);
+
+void *arena_alloc (struct prelink_arena *arena, size_t size);
+char *arena_strdup (struct prelink_arena *arena, const char *s);
+void arena_free (struct prelink_arena *arena);
 int prelink_get_relocations (struct prelink_info *info);
+int prelink_trace_init (struct prelink_trace *t, struct prelink_info *info,
+			const char *ent_filename);
+int prelink_trace_dep (struct prelink_trace *t, const char *soname,
+		       const char *filename, GElf_Addr start, GElf_Addr l_addr,
+		       GElf_Addr tls_modid, GElf_Addr tls_offset);
+int prelink_trace_deps_done (struct prelink_trace *t);
+int prelink_trace_lookup (struct prelink_trace *t, int symowner,
+			  GElf_Addr symoff, int valowner, GElf_Addr value,
+			  int reloc_class, int ifunc, const char *symname);
+int prelink_trace_conflict (struct prelink_trace *t, int symowner,
+			    GElf_Addr symoff, int valowner[2],
+			    GElf_Addr value[2], int reloc_class, int ifunc,
+			    const char *symname);
+void prelink_trace_undefined (struct prelink_trace *t);
+int prelink_trace_finish (struct prelink_trace *t);
+void prelink_trace_free (struct prelink_trace *t);
+
+int prelink_resolve_p (DSO *dso);
+int prelink_resolve_deps (struct PLArch *arch, int etype,
+			  const char *ent_filename, char ***dependsp,
+			  int *ndependsp);
+int prelink_resolve_relocations (struct prelink_info *info,
+				 const char *ent_filename);
 int prelink_build_conflicts (struct prelink_info *info);
+DSO *borrow_dso (struct prelink_entry *ent);
+void return_dso (DSO *dso);
+void flush_dso_cache (void);
 int update_dynamic_tags (DSO *dso, GElf_Shdr *shdr, GElf_Shdr *old_shdr,
 			 struct section_move *move);
 int prelink_exec (struct prelink_info *info);
@@ -565,8 +772,14 @@ int gather_check_libs (void);
 int add_to_blacklist (const char *name, int deref, int onefs);
 int blacklist_from_config (void);
 
+struct execve_child;
 FILE *execve_open (const char *path, char *const argv[], char *const envp[]);
 int execve_close (FILE *f);
+struct execve_child *execve_start (const char *path, char *const argv[],
+				   char *const envp[]);
+int execve_collect (struct execve_child **children, int n);
+FILE *execve_output (struct execve_child *child);
+void execve_discard (struct execve_child *child);
 
 int remove_redundant_cxx_conflicts (struct prelink_info *info);
 int get_relocated_mem (struct prelink_info *info, DSO *dso, GElf_Addr addr,
@@ -589,6 +802,10 @@ extern int all;
 extern int force;
 extern int random_base;
 extern int conserve_memory;
+extern int incremental_layout;
+extern int layout_slack;
+extern int parallel_jobs;
+extern int defer_debug;
 extern int verbose;
 extern int dry_run;
 extern int libs_only;
@@ -603,6 +820,7 @@ extern int quick;
 extern long long seed;
 extern GElf_Addr mmap_reg_start, mmap_reg_end, layout_page_size;
 extern char *ld_preload;
+extern int ld_trace;
 
 extern int allow_bad_textrel;
 
@@ -0,0 +1,441 @@
+/* Copyright (C) 2026 Red Hat, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.  */
+
+#include <config.h>
+#include <endian.h>
+#include <stdint.h>
+#include <string.h>
+#include "prelink.h"
+
+/* Bulk adjustment of relative relocations when moving an object.
+   Most dynamic relocations of a big library are RELATIVE ones and
+   they usually apply to consecutive words of .data.rel.ro or .got,
+   so runs of them are split into stretches of consecutive words in
+   one chunk of section data, which are then adjusted by a vector
+   kernel if the object has host byte order.  SSE2 kernels are used on
+   x86 hosts, AVX2 ones if the CPU supports it.
+
+   testsuite/relative1.c includes this file with RELATIVE_KERNELS_ONLY
+   defined, to check the kernels against each other.  */
+
+#if defined __x86_64__ || (defined __i386__ && defined __SSE2__)
+# include <emmintrin.h>
+# define HAVE_SSE2_KERNELS 1
+# if defined __GNUC__ && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#  include <immintrin.h>
+#  define HAVE_AVX2_KERNELS 1
+#  define AVX2 __attribute__ ((target ("avx2")))
+# endif
+#endif
+
+/* Add ADJUST to the N 32-bit words at P not smaller than START.  */
+static void
+adjust_words32_scalar (unsigned char *p, size_t n, uint32_t start,
+		       uint32_t adjust)
+{
+  uint32_t w;
+
+  for (; n; --n, p += 4)
+    {
+      memcpy (&w, p, 4);
+      if (w >= start)
+	{
+	  w += adjust;
+	  memcpy (p, &w, 4);
+	}
+    }
+}
+
+/* Add ADJUST to the N 64-bit words at P not smaller than START.  */
+static void
+adjust_words64_scalar (unsigned char *p, size_t n, uint64_t start,
+		       uint64_t adjust)
+{
+  uint64_t w;
+
+  for (; n; --n, p += 8)
+    {
+      memcpy (&w, p, 8);
+      if (w >= start)
+	{
+	  w += adjust;
+	  memcpy (p, &w, 8);
+	}
+    }
+}
+
+/* For the N 64-bit words at P and addends at ADDEND, if the addend
+   is not smaller than START, add ADJUST to it and to the word if the
+   word is equal to the addend.  */
+static void
+adjust_relative64_scalar (unsigned char *p, GElf_Sxword *addend, size_t n,
+			  uint64_t start, uint64_t adjust)
+{
+  uint64_t w, a;
+
+  for (; n; --n, p += 8, ++addend)
+    {
+      a = *addend;
+      if (a < start)
+	continue;
+      memcpy (&w, p, 8);
+      if (w == a)
+	{
+	  w += adjust;
+	  memcpy (p, &w, 8);
+	}
+      *addend = a + adjust;
+    }
+}
+
+#ifdef HAVE_SSE2_KERNELS
+/* SSE2 has neither 64-bit nor unsigned comparisons, build them from
+   signed 32-bit ones.  */
+static inline __m128i
+sse2_cmpge_epu64 (__m128i a, __m128i b)
+{
+  __m128i bias = _mm_set1_epi32 (0x80000000);
+  __m128i x = _mm_xor_si128 (a, bias), y = _mm_xor_si128 (b, bias);
+  __m128i gt = _mm_cmpgt_epi32 (x, y), eq = _mm_cmpeq_epi32 (x, y);
+  __m128i ge = _mm_xor_si128 (_mm_cmpgt_epi32 (y, x), _mm_set1_epi32 (-1));
+
+  gt = _mm_shuffle_epi32 (gt, _MM_SHUFFLE (3, 3, 1, 1));
+  eq = _mm_shuffle_epi32 (eq, _MM_SHUFFLE (3, 3, 1, 1));
+  ge = _mm_shuffle_epi32 (ge, _MM_SHUFFLE (2, 2, 0, 0));
+  return _mm_or_si128 (gt, _mm_and_si128 (eq, ge));
+}
+
+static inline __m128i
+sse2_cmpeq_epi64 (__m128i a, __m128i b)
+{
+  __m128i eq = _mm_cmpeq_epi32 (a, b);
+
+  return _mm_and_si128 (eq, _mm_shuffle_epi32 (eq, _MM_SHUFFLE (2, 3, 0, 1)));
+}
+
+static void
+adjust_words32_sse2 (unsigned char *p, size_t n, uint32_t start,
+		     uint32_t adjust)
+{
+  __m128i bias = _mm_set1_epi32 (0x80000000);
+  __m128i s = _mm_xor_si128 (_mm_set1_epi32 (start), bias);
+  __m128i adj = _mm_set1_epi32 (adjust), ones = _mm_set1_epi32 (-1);
+
+  for (; n >= 4; n -= 4, p += 16)
+    {
+      __m128i w = _mm_loadu_si128 ((__m128i *) p);
+      __m128i lt = _mm_cmpgt_epi32 (s, _mm_xor_si128 (w, bias));
+
+      w = _mm_add_epi32 (w, _mm_and_si128 (adj, _mm_xor_si128 (lt, ones)));
+      _mm_storeu_si128 ((__m128i *) p, w);
+    }
+  adjust_words32_scalar (p, n, start, adjust);
+}
+
+static void
+adjust_words64_sse2 (unsigned char *p, size_t n, uint64_t start,
+		     uint64_t adjust)
+{
+  __m128i s = _mm_set1_epi64x (start), adj = _mm_set1_epi64x (adjust);
+
+  for (; n >= 2; n -= 2, p += 16)
+    {
+      __m128i w = _mm_loadu_si128 ((__m128i *) p);
+      __m128i ge = sse2_cmpge_epu64 (w, s);
+
+      w = _mm_add_epi64 (w, _mm_and_si128 (adj, ge));
+      _mm_storeu_si128 ((__m128i *) p, w);
+    }
+  adjust_words64_scalar (p, n, start, adjust);
+}
+
+static void
+adjust_relative64_sse2 (unsigned char *p, GElf_Sxword *addend, size_t n,
+			uint64_t start, uint64_t adjust)
+{
+  __m128i s = _mm_set1_epi64x (start), adj = _mm_set1_epi64x (adjust);
+
+  for (; n >= 2; n -= 2, p += 16, addend += 2)
+    {
+      __m128i w = _mm_loadu_si128 ((__m128i *) p);
+      __m128i a = _mm_loadu_si128 ((__m128i *) addend);
+      __m128i ge = sse2_cmpge_epu64 (a, s);
+      __m128i eq = _mm_and_si128 (ge, sse2_cmpeq_epi64 (w, a));
+
+      w = _mm_add_epi64 (w, _mm_and_si128 (adj, eq));
+      a = _mm_add_epi64 (a, _mm_and_si128 (adj, ge));
+      _mm_storeu_si128 ((__m128i *) p, w);
+      _mm_storeu_si128 ((__m128i *) addend, a);
+    }
+  adjust_relative64_scalar (p, addend, n, start, adjust);
+}
+#endif
+
+#ifdef HAVE_AVX2_KERNELS
+static AVX2 void
+adjust_words32_avx2 (unsigned char *p, size_t n, uint32_t start,
+		     uint32_t adjust)
+{
+  __m256i bias = _mm256_set1_epi32 (0x80000000);
+  __m256i s = _mm256_xor_si256 (_mm256_set1_epi32 (start), bias);
+  __m256i adj = _mm256_set1_epi32 (adjust), ones = _mm256_set1_epi32 (-1);
+
+  for (; n >= 8; n -= 8, p += 32)
+    {
+      __m256i w = _mm256_loadu_si256 ((__m256i *) p);
+      __m256i lt = _mm256_cmpgt_epi32 (s, _mm256_xor_si256 (w, bias));
+
+      w = _mm256_add_epi32 (w, _mm256_and_si256 (adj,
+						  _mm256_xor_si256 (lt, ones)));
+      _mm256_storeu_si256 ((__m256i *) p, w);
+    }
+  adjust_words32_scalar (p, n, start, adjust);
+}
+
+static AVX2 void
+adjust_words64_avx2 (unsigned char *p, size_t n, uint64_t start,
+		     uint64_t adjust)
+{
+  __m256i bias = _mm256_set1_epi64x (0x8000000000000000ULL);
+  __m256i s = _mm256_xor_si256 (_mm256_set1_epi64x (start), bias);
+  __m256i adj = _mm256_set1_epi64x (adjust), ones = _mm256_set1_epi64x (-1);
+
+  for (; n >= 4; n -= 4, p += 32)
+    {
+      __m256i w = _mm256_loadu_si256 ((__m256i *) p);
+      __m256i lt = _mm256_cmpgt_epi64 (s, _mm256_xor_si256 (w, bias));
+
+      w = _mm256_add_epi64 (w, _mm256_and_si256 (adj,
+						  _mm256_xor_si256 (lt, ones)));
+      _mm256_storeu_si256 ((__m256i *) p, w);
+    }
+  adjust_words64_scalar (p, n, start, adjust);
+}
+
+static AVX2 void
+adjust_relative64_avx2 (unsigned char *p, GElf_Sxword *addend, size_t n,
+			uint64_t start, uint64_t adjust)
+{
+  __m256i bias = _mm256_set1_epi64x (0x8000000000000000ULL);
+  __m256i s = _mm256_xor_si256 (_mm256_set1_epi64x (start), bias);
+  __m256i adj = _mm256_set1_epi64x (adjust);
+
+  for (; n >= 4; n -= 4, p += 32, addend += 4)
+    {
+      __m256i w = _mm256_loadu_si256 ((__m256i *) p);
+      __m256i a = _mm256_loadu_si256 ((__m256i *) addend);
+      __m256i lt = _mm256_cmpgt_epi64 (s, _mm256_xor_si256 (a, bias));
+      __m256i eq = _mm256_andnot_si256 (lt, _mm256_cmpeq_epi64 (w, a));
+
+      w = _mm256_add_epi64 (w, _mm256_and_si256 (adj, eq));
+      a = _mm256_add_epi64 (a, _mm256_andnot_si256 (lt, adj));
+      _mm256_storeu_si256 ((__m256i *) p, w);
+      _mm256_storeu_si256 ((__m256i *) addend, a);
+    }
+  adjust_relative64_scalar (p, addend, n, start, adjust);
+}
+
+static int
+have_avx2 (void)
+{
+  static int avx2 = -1;
+
+  if (avx2 == -1)
+    avx2 = __builtin_cpu_supports ("avx2") ? 1 : 0;
+  return avx2;
+}
+#endif
+
+#ifndef RELATIVE_KERNELS_ONLY
+static void
+adjust_words32 (unsigned char *p, size_t n, uint32_t start, uint32_t adjust)
+{
+#ifdef HAVE_AVX2_KERNELS
+  if (have_avx2 ())
+    {
+      adjust_words32_avx2 (p, n, start, adjust);
+      return;
+    }
+#endif
+#ifdef HAVE_SSE2_KERNELS
+  adjust_words32_sse2 (p, n, start, adjust);
+#else
+  adjust_words32_scalar (p, n, start, adjust);
+#endif
+}
+
+static void
+adjust_words64 (unsigned char *p, size_t n, uint64_t start, uint64_t adjust)
+{
+#ifdef HAVE_AVX2_KERNELS
+  if (have_avx2 ())
+    {
+      adjust_words64_avx2 (p, n, start, adjust);
+      return;
+    }
+#endif
+#ifdef HAVE_SSE2_KERNELS
+  adjust_words64_sse2 (p, n, start, adjust);
+#else
+  adjust_words64_scalar (p, n, start, adjust);
+#endif
+}
+
+static void
+adjust_relative64 (unsigned char *p, GElf_Sxword *addend, size_t n,
+		   uint64_t start, uint64_t adjust)
+{
+#ifdef HAVE_AVX2_KERNELS
+  if (have_avx2 ())
+    {
+      adjust_relative64_avx2 (p, addend, n, start, adjust);
+      return;
+    }
+#endif
+#ifdef HAVE_SSE2_KERNELS
+  adjust_relative64_sse2 (p, addend, n, start, adjust);
+#else
+  adjust_relative64_scalar (p, addend, n, start, adjust);
+#endif
+}
+
+static int
+host_byte_order_p (DSO *dso)
+{
+  return dso->ehdr.e_ident[EI_DATA]
+	 == (__BYTE_ORDER == __LITTLE_ENDIAN ? ELFDATA2LSB : ELFDATA2MSB);
+}
+
+/* Return the number of relocations from I on in RUN of VIEW, which
+   apply to consecutive SIZE byte words in a single chunk of section
+   data, and store pointer to the first word into *P.  Return 0 if
+   the I-th relocation can't be handled this way.  */
+static int
+reloc_stretch (struct reloc_view *view, struct reloc_run *run, int i,
+	       int size, unsigned char **p)
+{
+  DSO *dso = view->dso;
+  GElf_Addr avail;
+  int j, end = run->first + run->count;
+
+  *p = reloc_target (view, view->offset[i], size);
+  if (*p == NULL)
+    return 0;
+
+  avail = view->last_data->d_off + view->last_data->d_size
+	  - (view->offset[i] - dso->shdr[view->last_sec].sh_addr);
+  for (j = i + 1;
+       j < end && view->offset[j] == view->offset[j - 1] + size
+       && (GElf_Addr) (j - i + 1) * size <= avail;
+       ++j)
+    ;
+  return j - i;
+}
+
+/* Add ADJUST to the SIZE byte words each relocation in RUN of VIEW
+   applies to, if they are not smaller than START.  */
+void
+adjust_reloc_words (struct reloc_view *view, struct reloc_run *run, int size,
+		    GElf_Addr start, GElf_Addr adjust)
+{
+  DSO *dso = view->dso;
+  int i, n, end = run->first + run->count;
+  int native = host_byte_order_p (dso);
+  unsigned char *p;
+  GElf_Addr w;
+
+  if (size == 4 && start > 0xffffffff)
+    return;
+
+  for (i = run->first; i < end; i += n)
+    {
+      /* The vector kernels only work on words in host byte order,
+	 don't look for stretches of them otherwise.  */
+      if (! native)
+	p = reloc_target (view, view->offset[i], size);
+      else if ((n = reloc_stretch (view, run, i, size, &p)) != 0)
+	{
+	  if (size == 4)
+	    adjust_words32 (p, n, start, adjust);
+	  else
+	    adjust_words64 (p, n, start, adjust);
+	  continue;
+	}
+
+      n = 1;
+      if (p == NULL && reloc_view_sec (view, view->offset[i]) == -1)
+	continue;
+      if (size == 4)
+	w = p ? buf_read_une32 (dso, p) : read_une32 (dso, view->offset[i]);
+      else
+	w = p ? buf_read_une64 (dso, p) : read_une64 (dso, view->offset[i]);
+      if (w < start)
+	continue;
+      w += adjust;
+      if (size == 4 && p)
+	buf_write_ne32 (dso, p, w);
+      else if (size == 4)
+	write_ne32 (dso, view->offset[i], w);
+      else if (p)
+	buf_write_ne64 (dso, p, w);
+      else
+	write_ne64 (dso, view->offset[i], w);
+    }
+}
+
+/* Adjust RUN of 64-bit RELA relative relocations in VIEW: if the
+   addend is not smaller than START, add ADJUST to it and, if the word
+   the relocation applies to has been prelinked to the addend, to that
+   word as well.  */
+void
+adjust_relative_relocs (struct reloc_view *view, struct reloc_run *run,
+			GElf_Addr start, GElf_Addr adjust)
+{
+  DSO *dso = view->dso;
+  int i, n, end = run->first + run->count;
+  int native = host_byte_order_p (dso);
+  unsigned char *p;
+  GElf_Addr w, a;
+
+  for (i = run->first; i < end; i += n)
+    {
+      if (! native)
+	p = reloc_target (view, view->offset[i], 8);
+      else if ((n = reloc_stretch (view, run, i, 8, &p)) != 0)
+	{
+	  adjust_relative64 (p, view->addend + i, n, start, adjust);
+	  continue;
+	}
+
+      n = 1;
+      a = view->addend[i];
+      if (a < start)
+	continue;
+      if (p == NULL && reloc_view_sec (view, view->offset[i]) == -1)
+	continue;
+      w = p ? buf_read_une64 (dso, p) : read_une64 (dso, view->offset[i]);
+      if (w == a)
+	{
+	  if (p)
+	    buf_write_ne64 (dso, p, a + adjust);
+	  else
+	    write_ne64 (dso, view->offset[i], a + adjust);
+	}
+      view->addend[i] = a + adjust;
+    }
+  view->changed = 1;
+}
+#endif
@@ -211,7 +211,7 @@ convert_rel_to_rela (DSO *dso, int i)
       *d = d2;
     }
 
-  free (d2.d_buf);
+  free_section_data (dso, d2.d_buf);
   *d = d1;
   dso->shdr[i].sh_entsize
     = gelf_fsize (dso->elf, ELF_T_RELA, 1, EV_CURRENT);
@@ -267,7 +267,7 @@ convert_rela_to_rel (DSO *dso, int i)
       *d = d2;
     }
 
-  free (d2.d_buf);
+  free_section_data (dso, d2.d_buf);
   *d = d1;
   dso->shdr[i].sh_entsize
     = gelf_fsize (dso->elf, ELF_T_REL, 1, EV_CURRENT);
@@ -0,0 +1,496 @@
+/* Copyright (C) 2026 Red Hat, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.  */
+
+#include <config.h>
+#include <errno.h>
+#include <error.h>
+#include <stdlib.h>
+#include <string.h>
+#include "prelink.h"
+
+/* Relocation sections are decoded at once into a reloc_view, which
+   keeps r_offset, r_info and r_addend of all relocations in separate
+   arrays and splits them into runs of consecutive relocations of the
+   same type.  Linkers sort dynamic relocations by type (RELATIVE ones
+   first, .rel{,a}.plt has just JUMP_SLOT ones), so the runs are long
+   and the architecture batch hooks can process them in tight loops.
+   The runs are kept in section order, as relocations of different
+   types may apply to the same word.  */
+
+/* SHT_RELR sections contain just the addresses of words to which
+   the load bias should be added, in a compact encoding.  An even entry
+   is the address of the next such word, an odd entry is a bitmap of
+   which of the following 8 * entsize - 1 words need it as well.
+   They are decoded into a reloc_view with R_RELATIVE relocations
+   without addends, so that they can be adjusted like other relative
+   relocations, and encoded again when written.  */
+
+static GElf_Addr
+read_relr_entry (DSO *dso, Elf_Data *data, int ndx, GElf_Xword entsize)
+{
+  unsigned char *p = (unsigned char *) data->d_buf + ndx * entsize;
+
+  if (data->d_type == ELF_T_BYTE)
+    return entsize == 8 ? buf_read_une64 (dso, p) : buf_read_une32 (dso, p);
+  return entsize == 8 ? ((uint64_t *) data->d_buf)[ndx]
+		      : ((uint32_t *) data->d_buf)[ndx];
+}
+
+static void
+write_relr_entry (DSO *dso, Elf_Data *data, int ndx, GElf_Xword entsize,
+		  GElf_Addr val)
+{
+  unsigned char *p = (unsigned char *) data->d_buf + ndx * entsize;
+
+  if (data->d_type == ELF_T_BYTE)
+    {
+      if (entsize == 8)
+	buf_write_ne64 (dso, p, val);
+      else
+	buf_write_ne32 (dso, p, val);
+    }
+  else if (entsize == 8)
+    ((uint64_t *) data->d_buf)[ndx] = val;
+  else
+    ((uint32_t *) data->d_buf)[ndx] = val;
+}
+
+static int
+read_relr_view (struct reloc_view *view)
+{
+  DSO *dso = view->dso;
+  int n = view->sec;
+  GElf_Xword entsize = dso->shdr[n].sh_entsize;
+  int nbits = 8 * entsize - 1;
+  Elf_Data *data = NULL;
+  GElf_Addr *entries, where = 0;
+  int i, j, nentries, count = 0;
+
+  if (entsize != 4 && entsize != 8)
+    {
+      error (0, 0, "%s: Unexpected sh_entsize of RELR section %s",
+	     dso->filename,
+	     strptr (dso, dso->ehdr.e_shstrndx, dso->shdr[n].sh_name));
+      return 1;
+    }
+
+  nentries = dso->shdr[n].sh_size / entsize;
+  entries = malloc (nentries * sizeof (GElf_Addr) + 1);
+  if (entries == NULL)
+    {
+      error (0, ENOMEM, "%s: Could not read relocations", dso->filename);
+      return 1;
+    }
+
+  while ((data = elf_getdata (dso->scn[n], data)) != NULL)
+    {
+      int first = data->d_off / entsize;
+      int ndx, maxndx = data->d_size / entsize;
+
+      if (data->d_off % entsize || first + maxndx > nentries)
+	{
+	  error (0, 0, "%s: Unexpected layout of relocation section %s",
+		 dso->filename,
+		 strptr (dso, dso->ehdr.e_shstrndx, dso->shdr[n].sh_name));
+	  free (entries);
+	  return 1;
+	}
+      for (ndx = 0; ndx < maxndx; ++ndx)
+	entries[first + ndx] = read_relr_entry (dso, data, ndx, entsize);
+    }
+
+  for (i = 0; i < nentries; ++i)
+    if ((entries[i] & 1) == 0)
+      ++count;
+    else
+      count += __builtin_popcountll (entries[i] >> 1);
+
+  view->offset = malloc (count * (sizeof (GElf_Addr) + sizeof (GElf_Xword)
+				  + sizeof (GElf_Sxword)) + 1);
+  view->runs = malloc (sizeof (struct reloc_run));
+  if (view->offset == NULL || view->runs == NULL)
+    {
+      error (0, ENOMEM, "%s: Could not read relocations", dso->filename);
+      free (entries);
+      free_reloc_view (view);
+      return 1;
+    }
+  view->info = (GElf_Xword *) (view->offset + count);
+  view->addend = (GElf_Sxword *) (view->info + count);
+  memset (view->addend, 0, count * sizeof (GElf_Sxword));
+
+  for (i = 0; i < nentries; ++i)
+    if ((entries[i] & 1) == 0)
+      {
+	view->offset[view->count++] = entries[i];
+	where = entries[i] + entsize;
+      }
+    else
+      {
+	for (j = 0; j < nbits; ++j)
+	  if ((entries[i] >> (j + 1)) & 1)
+	    view->offset[view->count++] = where + j * entsize;
+	where += nbits * entsize;
+      }
+  free (entries);
+
+  for (i = 0; i < count; ++i)
+    view->info[i] = GELF_R_INFO (0, dso->arch->R_RELATIVE);
+  view->runs[0].type = dso->arch->R_RELATIVE;
+  view->runs[0].first = 0;
+  view->runs[0].count = count;
+  view->nruns = count != 0;
+  return 0;
+}
+
+/* Encode relocations from RELR VIEW back into its section.  The
+   encoding can't grow, as long as the addresses were only adjusted
+   by a constant; unused space at the end is filled with empty
+   bitmaps.  */
+static int
+write_relr_view (struct reloc_view *view)
+{
+  DSO *dso = view->dso;
+  int n = view->sec;
+  GElf_Xword entsize = dso->shdr[n].sh_entsize;
+  int nbits = 8 * entsize - 1;
+  int i, nentries, maxentries;
+  GElf_Addr *entries, base, bitmap;
+  Elf_Data *data = NULL;
+
+  maxentries = dso->shdr[n].sh_size / entsize;
+  entries = malloc (maxentries * sizeof (GElf_Addr) + 1);
+  if (entries == NULL)
+    {
+      error (0, ENOMEM, "%s: Could not write relocations", dso->filename);
+      return 1;
+    }
+
+  for (i = 0, nentries = 0; i < view->count; )
+    {
+      if ((view->offset[i] & (entsize - 1))
+	  || (i && view->offset[i] <= view->offset[i - 1])
+	  || nentries == maxentries)
+	goto cant_encode;
+      entries[nentries++] = view->offset[i];
+      base = view->offset[i++] + entsize;
+      for (;;)
+	{
+	  bitmap = 0;
+	  while (i < view->count
+		 && view->offset[i] >= base
+		 && view->offset[i] - base < nbits * entsize
+		 && ((view->offset[i] - base) & (entsize - 1)) == 0)
+	    bitmap |= (GElf_Addr) 1 << ((view->offset[i++] - base) / entsize);
+	  if (bitmap == 0)
+	    break;
+	  if (nentries == maxentries)
+	    goto cant_encode;
+	  entries[nentries++] = (bitmap << 1) | 1;
+	  base += nbits * entsize;
+	}
+    }
+
+  while (nentries < maxentries)
+    entries[nentries++] = 1;
+
+  while ((data = elf_getdata (dso->scn[n], data)) != NULL)
+    {
+      int first = data->d_off / entsize;
+      int ndx, maxndx = data->d_size / entsize;
+
+      for (ndx = 0; ndx < maxndx; ++ndx)
+	write_relr_entry (dso, data, ndx, entsize, entries[first + ndx]);
+    }
+  free (entries);
+
+  elf_flagscn (dso->scn[n], ELF_C_SET, ELF_F_DIRTY);
+  return 0;
+
+cant_encode:
+  error (0, 0, "%s: Could not encode relocations into RELR section %s",
+	 dso->filename,
+	 strptr (dso, dso->ehdr.e_shstrndx, dso->shdr[n].sh_name));
+  free (entries);
+  return 1;
+}
+
+int
+read_reloc_view (DSO *dso, int n, struct reloc_view *view)
+{
+  Elf_Data *data = NULL;
+  GElf_Xword entsize = dso->shdr[n].sh_entsize;
+  int i, count;
+
+  memset (view, 0, sizeof (*view));
+  view->dso = dso;
+  view->sec = n;
+  view->rela = dso->shdr[n].sh_type == SHT_RELA;
+  view->relr = dso->shdr[n].sh_type == SHT_RELR;
+  view->last_sec = -1;
+
+  if (entsize == 0)
+    {
+      error (0, 0, "%s: Relocation section %s has zero sh_entsize",
+	     dso->filename,
+	     strptr (dso, dso->ehdr.e_shstrndx, dso->shdr[n].sh_name));
+      return 1;
+    }
+
+  if (view->relr)
+    return read_relr_view (view);
+
+  count = dso->shdr[n].sh_size / entsize;
+  view->offset = malloc (count * (sizeof (GElf_Addr) + sizeof (GElf_Xword)
+				  + sizeof (GElf_Sxword)) + 1);
+  view->runs = malloc (count * sizeof (struct reloc_run) + 1);
+  if (view->offset == NULL || view->runs == NULL)
+    {
+      error (0, ENOMEM, "%s: Could not read relocations", dso->filename);
+      free_reloc_view (view);
+      return 1;
+    }
+  view->info = (GElf_Xword *) (view->offset + count);
+  view->addend = (GElf_Sxword *) (view->info + count);
+  memset (view->addend, 0, count * sizeof (GElf_Sxword));
+
+  while ((data = elf_getdata (dso->scn[n], data)) != NULL)
+    {
+      int first = data->d_off / entsize;
+      int ndx, maxndx = data->d_size / entsize;
+
+      if (data->d_off % entsize || first + maxndx > count)
+	{
+	  error (0, 0, "%s: Unexpected layout of relocation section %s",
+		 dso->filename,
+		 strptr (dso, dso->ehdr.e_shstrndx, dso->shdr[n].sh_name));
+	  free_reloc_view (view);
+	  return 1;
+	}
+
+      if (gelf_getclass (dso->elf) == ELFCLASS64
+	  && data->d_type == (view->rela ? ELF_T_RELA : ELF_T_REL))
+	{
+	  if (view->rela)
+	    {
+	      Elf64_Rela *r = (Elf64_Rela *) data->d_buf;
+
+	      for (ndx = 0; ndx < maxndx; ++ndx)
+		{
+		  view->offset[first + ndx] = r[ndx].r_offset;
+		  view->info[first + ndx] = r[ndx].r_info;
+		  view->addend[first + ndx] = r[ndx].r_addend;
+		}
+	    }
+	  else
+	    {
+	      Elf64_Rel *r = (Elf64_Rel *) data->d_buf;
+
+	      for (ndx = 0; ndx < maxndx; ++ndx)
+		{
+		  view->offset[first + ndx] = r[ndx].r_offset;
+		  view->info[first + ndx] = r[ndx].r_info;
+		}
+	    }
+	}
+      else if (view->rela)
+	for (ndx = 0; ndx < maxndx; ++ndx)
+	  {
+	    GElf_Rela rela;
+
+	    gelfx_getrela (dso->elf, data, ndx, &rela);
+	    view->offset[first + ndx] = rela.r_offset;
+	    view->info[first + ndx] = rela.r_info;
+	    view->addend[first + ndx] = rela.r_addend;
+	  }
+      else
+	for (ndx = 0; ndx < maxndx; ++ndx)
+	  {
+	    GElf_Rel rel;
+
+	    gelfx_getrel (dso->elf, data, ndx, &rel);
+	    view->offset[first + ndx] = rel.r_offset;
+	    view->info[first + ndx] = rel.r_info;
+	  }
+    }
+  view->count = count;
+
+  for (i = 0; i < count; ++i)
+    if (view->nruns == 0
+	|| view->runs[view->nruns - 1].type != GELF_R_TYPE (view->info[i]))
+      {
+	view->runs[view->nruns].type = GELF_R_TYPE (view->info[i]);
+	view->runs[view->nruns].first = i;
+	view->runs[view->nruns++].count = 1;
+      }
+    else
+      view->runs[view->nruns - 1].count++;
+
+  return 0;
+}
+
+/* Store relocations from VIEW back into their section.  */
+int
+write_reloc_view (struct reloc_view *view)
+{
+  DSO *dso = view->dso;
+  Elf_Data *data = NULL;
+  GElf_Xword entsize = dso->shdr[view->sec].sh_entsize;
+
+  if (view->relr)
+    return write_relr_view (view);
+
+  while ((data = elf_getdata (dso->scn[view->sec], data)) != NULL)
+    {
+      int first = data->d_off / entsize;
+      int ndx, maxndx = data->d_size / entsize;
+
+      if (gelf_getclass (dso->elf) == ELFCLASS64
+	  && data->d_type == (view->rela ? ELF_T_RELA : ELF_T_REL))
+	{
+	  if (view->rela)
+	    {
+	      Elf64_Rela *r = (Elf64_Rela *) data->d_buf;
+
+	      for (ndx = 0; ndx < maxndx; ++ndx)
+		{
+		  r[ndx].r_offset = view->offset[first + ndx];
+		  r[ndx].r_info = view->info[first + ndx];
+		  r[ndx].r_addend = view->addend[first + ndx];
+		}
+	    }
+	  else
+	    {
+	      Elf64_Rel *r = (Elf64_Rel *) data->d_buf;
+
+	      for (ndx = 0; ndx < maxndx; ++ndx)
+		{
+		  r[ndx].r_offset = view->offset[first + ndx];
+		  r[ndx].r_info = view->info[first + ndx];
+		}
+	    }
+	}
+      else
+	for (ndx = 0; ndx < maxndx; ++ndx)
+	  if (view->rela)
+	    {
+	      GElf_Rela rela;
+
+	      reloc_view_get_rela (view, first + ndx, &rela);
+	      gelfx_update_rela (dso->elf, data, ndx, &rela);
+	    }
+	  else
+	    {
+	      GElf_Rel rel;
+
+	      reloc_view_get_rel (view, first + ndx, &rel);
+	      gelfx_update_rel (dso->elf, data, ndx, &rel);
+	    }
+    }
+
+  elf_flagscn (dso->scn[view->sec], ELF_C_SET, ELF_F_DIRTY);
+  return 0;
+}
+
+void
+free_reloc_view (struct reloc_view *view)
+{
+  free (view->offset);
+  free (view->runs);
+  view->offset = NULL;
+  view->runs = NULL;
+}
+
+void
+reloc_view_get_rel (struct reloc_view *view, int i, GElf_Rel *rel)
+{
+  rel->r_offset = view->offset[i];
+  rel->r_info = view->info[i];
+}
+
+void
+reloc_view_get_rela (struct reloc_view *view, int i, GElf_Rela *rela)
+{
+  rela->r_offset = view->offset[i];
+  rela->r_info = view->info[i];
+  rela->r_addend = view->addend[i];
+}
+
+void
+reloc_view_set_rel (struct reloc_view *view, int i, GElf_Rel *rel)
+{
+  view->offset[i] = rel->r_offset;
+  view->info[i] = rel->r_info;
+}
+
+void
+reloc_view_set_rela (struct reloc_view *view, int i, GElf_Rela *rela)
+{
+  view->offset[i] = rela->r_offset;
+  view->info[i] = rela->r_info;
+  view->addend[i] = rela->r_addend;
+}
+
+/* Like addr_to_sec, but first try the section the previous
+   relocation of VIEW applied to.  */
+int
+reloc_view_sec (struct reloc_view *view, GElf_Addr addr)
+{
+  DSO *dso = view->dso;
+  GElf_Shdr *shdr;
+
+  if (view->last_sec != -1 && dso->naddr_index != -2)
+    {
+      shdr = &dso->shdr[view->last_sec];
+      if (addr >= shdr->sh_addr && addr < shdr->sh_addr + shdr->sh_size)
+	return view->last_sec;
+    }
+
+  view->last_sec = addr_to_sec (dso, addr);
+  view->last_data = NULL;
+  return view->last_sec;
+}
+
+/* Return a pointer to SIZE bytes at address ADDR of the object,
+   provided they are in a single ELF_T_BYTE chunk of section data, and
+   mark the section as modified.  Return NULL otherwise, the caller
+   then has to use read_* and write_* routines.  */
+unsigned char *
+reloc_target (struct reloc_view *view, GElf_Addr addr, int size)
+{
+  DSO *dso = view->dso;
+  Elf_Data *data;
+  GElf_Addr off;
+  int sec = reloc_view_sec (view, addr);
+
+  if (sec == -1)
+    return NULL;
+
+  off = addr - dso->shdr[sec].sh_addr;
+  data = view->last_data;
+  if (data == NULL
+      || off < data->d_off || off + size > data->d_off + data->d_size)
+    {
+      data = sec_offset_to_data (dso, sec, off);
+      if (data == NULL || data->d_buf == NULL || data->d_type != ELF_T_BYTE
+	  || off + size > data->d_off + data->d_size)
+	return NULL;
+      view->last_data = data;
+      elf_flagscn (dso->scn[sec], ELF_C_SET, ELF_F_DIRTY);
+    }
+
+  return (unsigned char *) data->d_buf + (off - data->d_off);
+}
@@ -0,0 +1,1692 @@
+/* Copyright (C) 2026 Red Hat, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.  */
+
+/* Built-in emulation of the symbol lookup the dynamic linker performs
+   with LD_TRACE_PRELINKING.  Instead of running the target ld.so for
+   every object, the dependencies are searched for and loaded here and
+   every relocation is resolved the way glibc's _dl_lookup_symbol_x
+   would resolve it.  The results are fed to the prelink_trace_*
+   interface in get.c exactly as the parsed ld.so output would be.  */
+
+#include <config.h>
+#include <errno.h>
+#include <error.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "prelink.h"
+
+#ifndef STT_GNU_IFUNC
+#define STT_GNU_IFUNC		10
+#endif
+#ifndef STB_GNU_UNIQUE
+#define STB_GNU_UNIQUE		10
+#endif
+#ifndef DF_1_NODEFLIB
+#define DF_1_NODEFLIB		0x00000800
+#endif
+#ifndef DT_RUNPATH
+#define DT_RUNPATH		29
+#endif
+#ifndef DT_FLAGS_1
+#define DT_FLAGS_1		0x6ffffffb
+#endif
+
+#define ALLOWED_STT \
+  ((1 << STT_NOTYPE) | (1 << STT_OBJECT) | (1 << STT_FUNC)		\
+   | (1 << STT_COMMON) | (1 << STT_TLS) | (1 << STT_GNU_IFUNC))
+
+/* ld.so's ELF_RTYPE_CLASS_* bits.  */
+#define RTLD_CLASS_PLT		1
+#define RTLD_CLASS_COPY		2
+
+struct rtld_version
+{
+  const char *name;
+  Elf32_Word hash;
+  int hidden;
+};
+
+struct rtld_reloc
+{
+  GElf_Word sym;
+  GElf_Word type;
+};
+
+/* Everything the lookup needs to know about one file.  Objects are
+   cached for the whole prelink run, keyed by the identity of the file,
+   so that e.g. libc.so is only read once.  */
+struct rtld_obj
+{
+  struct rtld_obj *next;
+  dev_t dev;
+  ino64_t ino;
+  time_t mtime, ctime;
+  off_t size;
+  int type;
+  GElf_Addr base;
+  char *soname;
+  char *strtab;
+  size_t strsz;
+  GElf_Sym *syms;
+  size_t nsyms;
+  GElf_Addr symtab_addr;
+  GElf_Addr sym_entsize;
+  Elf32_Word nbucket, nchain, *bucket, *chain;
+  Elf32_Word gnu_nbucket, gnu_symbias, gnu_nwords, gnu_shift, gnu_bits;
+  GElf_Addr *gnu_bitmask;
+  Elf32_Word *gnu_bucket, *gnu_chain;
+  size_t gnu_nchain;
+  uint16_t *versym;
+  struct rtld_version *versions;
+  size_t nversions;
+  const char **needed;
+  int nneeded;
+  const char *rpath, *runpath;
+  int symbolic, nodeflib;
+  int has_tls;
+  GElf_Addr tls_blocksize, tls_align, tls_firstbyte;
+  struct rtld_reloc *relocs;
+  size_t nrelocs;
+};
+
+/* One object in a particular search list.  */
+struct rtld_map
+{
+  struct rtld_obj *obj;
+  char *filename;
+  const char *libname;
+  struct rtld_map *loader;
+  struct rtld_map **deps;
+  struct rtld_map **scope;
+  int nscope;
+  int idx;
+  GElf_Addr tls_modid, tls_offset;
+};
+
+struct rtld
+{
+  struct PLArch *arch;
+  unsigned char ei_class, ei_data;
+  int machine;
+  struct rtld_map **maps;
+  int nmaps, nalloced;
+  struct rtld_map **all;
+  int nall, nallalloced;
+  struct rtld_map *rtld;
+};
+
+static struct rtld_obj *rtld_objs;
+static char **rtld_conf_dirs;
+static int rtld_nconf_dirs = -1;
+
+static uint32_t
+rtld_read32 (DSO *dso, Elf_Data *data, size_t off)
+{
+  if (data->d_type == ELF_T_BYTE)
+    return buf_read_une32 (dso, (unsigned char *) data->d_buf + off);
+  return *(uint32_t *) ((char *) data->d_buf + off);
+}
+
+static uint64_t
+rtld_read64 (DSO *dso, Elf_Data *data, size_t off)
+{
+  if (data->d_type == ELF_T_BYTE)
+    return buf_read_une64 (dso, (unsigned char *) data->d_buf + off);
+  return *(uint64_t *) ((char *) data->d_buf + off);
+}
+
+static uint16_t
+rtld_read16 (DSO *dso, Elf_Data *data, size_t off)
+{
+  if (data->d_type == ELF_T_BYTE)
+    return buf_read_une16 (dso, (unsigned char *) data->d_buf + off);
+  return *(uint16_t *) ((char *) data->d_buf + off);
+}
+
+static Elf_Data *
+rtld_section_data (DSO *dso, int sec)
+{
+  Elf_Data *data = elf_getdata (dso->scn[sec], NULL);
+
+  if (data == NULL || data->d_buf == NULL || data->d_off
+      || data->d_size != dso->shdr[sec].sh_size)
+    return NULL;
+  return data;
+}
+
+static Elf32_Word
+rtld_elf_hash (const char *name)
+{
+  const unsigned char *p = (const unsigned char *) name;
+  Elf32_Word h = 0, g;
+
+  while (*p)
+    {
+      h = (h << 4) + *p++;
+      g = h & 0xf0000000;
+      if (g)
+	h ^= g >> 24;
+      h &= ~g;
+    }
+  return h;
+}
+
+static Elf32_Word
+rtld_gnu_hash (const char *name)
+{
+  const unsigned char *p = (const unsigned char *) name;
+  Elf32_Word h = 5381;
+
+  while (*p)
+    h = h * 33 + *p++;
+  return h;
+}
+
+static const char *
+rtld_string (struct rtld_obj *obj, GElf_Addr off)
+{
+  if (off >= obj->strsz)
+    return NULL;
+  return obj->strtab + off;
+}
+
+static int
+rtld_read_hash (struct rtld_obj *obj, DSO *dso, int sec)
+{
+  Elf_Data *data = rtld_section_data (dso, sec);
+  size_t i, n;
+
+  if (data == NULL || data->d_size < 8)
+    return 1;
+  obj->nbucket = rtld_read32 (dso, data, 0);
+  n = rtld_read32 (dso, data, 4);
+  if (obj->nbucket == 0 || (2 + obj->nbucket + (size_t) n) * 4 > data->d_size)
+    return 1;
+  obj->bucket = malloc ((obj->nbucket + n) * sizeof (Elf32_Word));
+  if (obj->bucket == NULL)
+    return 1;
+  obj->nchain = n;
+  obj->chain = obj->bucket + obj->nbucket;
+  for (i = 0; i < obj->nbucket + n; ++i)
+    obj->bucket[i] = rtld_read32 (dso, data, 8 + 4 * i);
+  return 0;
+}
+
+static int
+rtld_read_gnu_hash (struct rtld_obj *obj, DSO *dso, int sec)
+{
+  Elf_Data *data = rtld_section_data (dso, sec);
+  size_t i, off, wsize;
+
+  if (data == NULL || data->d_size < 16)
+    return 1;
+  wsize = dso->ehdr.e_ident[EI_CLASS] == ELFCLASS64 ? 8 : 4;
+  obj->gnu_bits = wsize * 8;
+  obj->gnu_nbucket = rtld_read32 (dso, data, 0);
+  obj->gnu_symbias = rtld_read32 (dso, data, 4);
+  obj->gnu_nwords = rtld_read32 (dso, data, 8);
+  obj->gnu_shift = rtld_read32 (dso, data, 12);
+  if (obj->gnu_nbucket == 0 || obj->gnu_nwords == 0
+      || (obj->gnu_nwords & (obj->gnu_nwords - 1)) != 0
+      || 16 + obj->gnu_nwords * wsize + obj->gnu_nbucket * 4 > data->d_size
+      || obj->gnu_symbias > obj->nsyms)
+    return 1;
+
+  obj->gnu_bitmask = malloc (obj->gnu_nwords * sizeof (GElf_Addr));
+  obj->gnu_nchain = obj->nsyms - obj->gnu_symbias;
+  obj->gnu_bucket = malloc ((obj->gnu_nbucket + obj->gnu_nchain)
+			    * sizeof (Elf32_Word));
+  if (obj->gnu_bitmask == NULL || obj->gnu_bucket == NULL)
+    return 1;
+  obj->gnu_chain = obj->gnu_bucket + obj->gnu_nbucket;
+
+  off = 16;
+  for (i = 0; i < obj->gnu_nwords; ++i, off += wsize)
+    obj->gnu_bitmask[i] = wsize == 8 ? rtld_read64 (dso, data, off)
+				     : rtld_read32 (dso, data, off);
+  for (i = 0; i < obj->gnu_nbucket; ++i, off += 4)
+    {
+      obj->gnu_bucket[i] = rtld_read32 (dso, data, off);
+      if (obj->gnu_bucket[i]
+	  && (obj->gnu_bucket[i] < obj->gnu_symbias
+	      || obj->gnu_bucket[i] >= obj->nsyms))
+	return 1;
+    }
+  for (i = 0; i < obj->gnu_nchain && off + 4 <= data->d_size; ++i, off += 4)
+    obj->gnu_chain[i] = rtld_read32 (dso, data, off);
+  /* Terminate any chain running off the end of the section.  */
+  for (; i < obj->gnu_nchain; ++i)
+    obj->gnu_chain[i] = 1;
+  if (obj->gnu_nchain)
+    obj->gnu_chain[obj->gnu_nchain - 1] |= 1;
+  return 0;
+}
+
+static int
+rtld_add_version (struct rtld_obj *obj, size_t ndx, const char *name,
+		  Elf32_Word hash, int hidden)
+{
+  if (ndx >= obj->nversions)
+    {
+      struct rtld_version *v;
+      size_t n = ndx + 16;
+
+      v = realloc (obj->versions, n * sizeof (struct rtld_version));
+      if (v == NULL)
+	return 1;
+      memset (v + obj->nversions, 0,
+	      (n - obj->nversions) * sizeof (struct rtld_version));
+      obj->versions = v;
+      obj->nversions = n;
+    }
+  obj->versions[ndx].name = name;
+  obj->versions[ndx].hash = hash;
+  obj->versions[ndx].hidden = hidden;
+  return 0;
+}
+
+/* Fill in obj->versions the way _dl_check_map_versions fills in
+   l_versions.  */
+static int
+rtld_read_versions (struct rtld_obj *obj, DSO *dso, int verdef, int verneed)
+{
+  Elf_Data *data;
+  size_t off, aux;
+  int cnt;
+
+  if (verneed && (data = rtld_section_data (dso, verneed)) != NULL)
+    for (off = 0; off + 16 <= data->d_size; )
+      {
+	uint32_t vn_aux = rtld_read32 (dso, data, off + 8);
+	uint32_t vn_next = rtld_read32 (dso, data, off + 12);
+
+	cnt = rtld_read16 (dso, data, off + 2);
+	for (aux = off + vn_aux; cnt-- > 0 && aux + 16 <= data->d_size; )
+	  {
+	    uint16_t other = rtld_read16 (dso, data, aux + 6);
+	    const char *name = rtld_string (obj, rtld_read32 (dso, data,
+							      aux + 8));
+
+	    if (name
+		&& rtld_add_version (obj, other & 0x7fff, name,
+				     rtld_read32 (dso, data, aux),
+				     (other & 0x8000) != 0))
+	      return 1;
+	    if (rtld_read32 (dso, data, aux + 12) == 0)
+	      break;
+	    aux += rtld_read32 (dso, data, aux + 12);
+	  }
+	if (vn_next == 0)
+	  break;
+	off += vn_next;
+      }
+
+  if (verdef && (data = rtld_section_data (dso, verdef)) != NULL)
+    for (off = 0; off + 20 <= data->d_size; )
+      {
+	uint16_t flags = rtld_read16 (dso, data, off + 2);
+	uint16_t ndx = rtld_read16 (dso, data, off + 4);
+	uint32_t vd_aux = rtld_read32 (dso, data, off + 12);
+	uint32_t vd_next = rtld_read32 (dso, data, off + 16);
+
+	/* The name of the base version should not be available for
+	   matching a versioned symbol.  */
+	if ((flags & VER_FLG_BASE) == 0 && off + vd_aux + 8 <= data->d_size)
+	  {
+	    const char *name
+	      = rtld_string (obj, rtld_read32 (dso, data, off + vd_aux));
+
+	    if (name
+		&& rtld_add_version (obj, ndx & 0x7fff, name,
+				     rtld_read32 (dso, data, off + 8), 0))
+	      return 1;
+	  }
+	if (vd_next == 0)
+	  break;
+	off += vd_next;
+      }
+  return 0;
+}
+
+static int
+rtld_read_relocs (struct rtld_obj *obj, DSO *dso, int dynsym)
+{
+  size_t alloced = 0;
+  int i;
+
+  for (i = 1; i < dso->ehdr.e_shnum; ++i)
+    {
+      GElf_Addr addr = dso->shdr[i].sh_addr;
+      Elf_Data *data;
+      int ndx, maxndx;
+
+      if ((dso->shdr[i].sh_type != SHT_REL && dso->shdr[i].sh_type != SHT_RELA)
+	  || (dso->shdr[i].sh_flags & SHF_ALLOC) == 0
+	  || dso->shdr[i].sh_link != dynsym
+	  || dso->shdr[i].sh_entsize == 0)
+	continue;
+
+      /* Only relocations the dynamic linker processes, not
+	 e.g. .gnu.conflict.  */
+      if (! ((dynamic_info_is_set (dso, DT_REL)
+	      && addr >= dso->info[DT_REL]
+	      && addr < dso->info[DT_REL] + dso->info[DT_RELSZ])
+	     || (dynamic_info_is_set (dso, DT_RELA)
+		 && addr >= dso->info[DT_RELA]
+		 && addr < dso->info[DT_RELA] + dso->info[DT_RELASZ])
+	     || (dynamic_info_is_set (dso, DT_JMPREL)
+		 && addr >= dso->info[DT_JMPREL]
+		 && addr < dso->info[DT_JMPREL] + dso->info[DT_PLTRELSZ])))
+	continue;
+
+      data = NULL;
+      while ((data = elf_getdata (dso->scn[i], data)) != NULL)
+	{
+	  maxndx = data->d_size / dso->shdr[i].sh_entsize;
+	  for (ndx = 0; ndx < maxndx; ++ndx)
+	    {
+	      GElf_Word sym, type;
+
+	      if (dso->shdr[i].sh_type == SHT_REL)
+		{
+		  GElf_Rel rel;
+
+		  gelfx_getrel (dso->elf, data, ndx, &rel);
+		  sym = GELF_R_SYM (rel.r_info);
+		  type = GELF_R_TYPE (rel.r_info);
+		}
+	      else
+		{
+		  GElf_Rela rela;
+
+		  gelfx_getrela (dso->elf, data, ndx, &rela);
+		  sym = GELF_R_SYM (rela.r_info);
+		  type = GELF_R_TYPE (rela.r_info);
+		}
+
+	      if (sym == 0 || sym >= obj->nsyms)
+		continue;
+	      if (obj->nrelocs == alloced)
+		{
+		  struct rtld_reloc *r;
+
+		  alloced = alloced ? 2 * alloced : 64;
+		  r = realloc (obj->relocs, alloced * sizeof (*r));
+		  if (r == NULL)
+		    return 1;
+		  obj->relocs = r;
+		}
+	      obj->relocs[obj->nrelocs].sym = sym;
+	      obj->relocs[obj->nrelocs++].type = type;
+	    }
+	}
+    }
+  return 0;
+}
+
+static void
+rtld_obj_free (struct rtld_obj *obj)
+{
+  free (obj->soname);
+  free (obj->strtab);
+  free (obj->syms);
+  free (obj->bucket);
+  free (obj->gnu_bitmask);
+  free (obj->gnu_bucket);
+  free (obj->versym);
+  free (obj->versions);
+  free (obj->needed);
+  free (obj->relocs);
+  free (obj);
+}
+
+/* Extract from DSO everything symbol lookup needs.  */
+static struct rtld_obj *
+rtld_obj_read (DSO *dso)
+{
+  struct rtld_obj *obj;
+  int i, dynsym = 0, hash = 0, gnu_hash = 0, versym = 0;
+  int verdef = 0, verneed = 0;
+  Elf_Data *data;
+
+  obj = calloc (1, sizeof (struct rtld_obj));
+  if (obj == NULL)
+    return NULL;
+
+  obj->type = dso->ehdr.e_type;
+  obj->base = dso->base;
+  obj->soname = strdup (dso->soname);
+  if (obj->soname == NULL)
+    goto error_out;
+
+  for (i = 1; i < dso->ehdr.e_shnum; ++i)
+    switch (dso->shdr[i].sh_type)
+      {
+      case SHT_DYNSYM: dynsym = i; break;
+      case SHT_HASH: hash = i; break;
+      case SHT_GNU_HASH: gnu_hash = i; break;
+      case SHT_GNU_versym: versym = i; break;
+      case SHT_GNU_verdef: verdef = i; break;
+      case SHT_GNU_verneed: verneed = i; break;
+      }
+
+  for (i = 0; i < dso->ehdr.e_phnum; ++i)
+    if (dso->phdr[i].p_type == PT_TLS && dso->phdr[i].p_memsz)
+      {
+	obj->has_tls = 1;
+	obj->tls_blocksize = dso->phdr[i].p_memsz;
+	obj->tls_align = dso->phdr[i].p_align ?: 1;
+	obj->tls_firstbyte = dso->phdr[i].p_vaddr & (obj->tls_align - 1);
+      }
+
+  if (dynsym == 0 || dso->shdr[dynsym].sh_entsize == 0
+      || dso->shdr[dynsym].sh_link >= dso->ehdr.e_shnum)
+    {
+      error (0, 0, "%s: No .dynsym section", dso->filename);
+      goto error_out;
+    }
+
+  /* Dynamic string table.  */
+  data = rtld_section_data (dso, dso->shdr[dynsym].sh_link);
+  if (data == NULL)
+    goto read_error;
+  obj->strsz = data->d_size;
+  obj->strtab = malloc (obj->strsz + 1);
+  if (obj->strtab == NULL)
+    goto error_out;
+  memcpy (obj->strtab, data->d_buf, obj->strsz);
+  obj->strtab[obj->strsz] = '\0';
+
+  /* Dynamic symbol table.  */
+  obj->symtab_addr = dso->shdr[dynsym].sh_addr;
+  obj->sym_entsize = dso->shdr[dynsym].sh_entsize;
+  obj->nsyms = dso->shdr[dynsym].sh_size / obj->sym_entsize;
+  obj->syms = malloc (obj->nsyms * sizeof (GElf_Sym));
+  if (obj->syms == NULL)
+    goto error_out;
+  data = rtld_section_data (dso, dynsym);
+  if (data == NULL)
+    goto read_error;
+  for (i = 0; i < obj->nsyms; ++i)
+    gelfx_getsym (dso->elf, data, i, &obj->syms[i]);
+
+  if (versym)
+    {
+      data = rtld_section_data (dso, versym);
+      if (data == NULL || data->d_size < obj->nsyms * 2)
+	goto read_error;
+      obj->versym = malloc (obj->nsyms * sizeof (uint16_t));
+      if (obj->versym == NULL)
+	goto error_out;
+      for (i = 0; i < obj->nsyms; ++i)
+	obj->versym[i] = rtld_read16 (dso, data, 2 * i);
+      if (rtld_read_versions (obj, dso, verdef, verneed))
+	goto read_error;
+    }
+
+  /* ld.so prefers DT_GNU_HASH if both are present.  */
+  if (gnu_hash && rtld_read_gnu_hash (obj, dso, gnu_hash) == 0)
+    ;
+  else
+    {
+      free (obj->gnu_bitmask);
+      free (obj->gnu_bucket);
+      obj->gnu_bitmask = NULL;
+      obj->gnu_bucket = NULL;
+      obj->gnu_nbucket = 0;
+      if (hash == 0 || rtld_read_hash (obj, dso, hash))
+	{
+	  error (0, 0, "%s: Could not read symbol hash table", dso->filename);
+	  goto error_out;
+	}
+    }
+
+  /* Dynamic section.  */
+  if (dso->dynamic)
+    {
+      int alloced = 0;
+
+      data = NULL;
+      while ((data = elf_getdata (dso->scn[dso->dynamic], data)) != NULL)
+	{
+	  int ndx, maxndx;
+	  GElf_Dyn dyn;
+
+	  maxndx = data->d_size / dso->shdr[dso->dynamic].sh_entsize;
+	  for (ndx = 0; ndx < maxndx; ++ndx)
+	    {
+	      gelfx_getdyn (dso->elf, data, ndx, &dyn);
+	      if (dyn.d_tag == DT_NULL)
+		break;
+	      switch (dyn.d_tag)
+		{
+		case DT_NEEDED:
+		  if (obj->nneeded == alloced)
+		    {
+		      const char **n;
+
+		      alloced += 8;
+		      n = realloc (obj->needed, alloced * sizeof (char *));
+		      if (n == NULL)
+			goto error_out;
+		      obj->needed = n;
+		    }
+		  obj->needed[obj->nneeded] = rtld_string (obj, dyn.d_un.d_val);
+		  if (obj->needed[obj->nneeded] == NULL)
+		    goto read_error;
+		  ++obj->nneeded;
+		  break;
+		case DT_RPATH:
+		  obj->rpath = rtld_string (obj, dyn.d_un.d_val);
+		  break;
+		case DT_RUNPATH:
+		  obj->runpath = rtld_string (obj, dyn.d_un.d_val);
+		  break;
+		case DT_SYMBOLIC:
+		  obj->symbolic = 1;
+		  break;
+		case DT_FLAGS:
+		  if (dyn.d_un.d_val & DF_SYMBOLIC)
+		    obj->symbolic = 1;
+		  break;
+		case DT_FLAGS_1:
+		  if (dyn.d_un.d_val & DF_1_NODEFLIB)
+		    obj->nodeflib = 1;
+		  break;
+		}
+	    }
+	  if (ndx < maxndx)
+	    break;
+	}
+    }
+
+  if (rtld_read_relocs (obj, dso, dynsym))
+    goto error_out;
+
+  return obj;
+
+read_error:
+  error (0, 0, "%s: Could not read dynamic symbol information",
+	 dso->filename);
+error_out:
+  rtld_obj_free (obj);
+  return NULL;
+}
+
+/* Return the cached object for the file open as FD, reading it if
+   needed.  */
+static struct rtld_obj *
+rtld_obj_get (int fd, const char *filename, struct stat64 *st)
+{
+  struct rtld_obj *obj, **objp;
+  DSO *dso;
+
+  for (objp = &rtld_objs; (obj = *objp) != NULL; objp = &obj->next)
+    if (obj->dev == st->st_dev && obj->ino == st->st_ino)
+      {
+	if (obj->mtime == st->st_mtime && obj->ctime == st->st_ctime
+	    && obj->size == st->st_size)
+	  {
+	    close (fd);
+	    return obj;
+	  }
+	/* The file has been rewritten in place since.  */
+	*objp = obj->next;
+	rtld_obj_free (obj);
+	break;
+      }
+
+  dso = fdopen_dso (fd, filename);
+  if (dso == NULL)
+    return NULL;
+
+  obj = rtld_obj_read (dso);
+  close_dso (dso);
+  if (obj == NULL)
+    return NULL;
+
+  obj->dev = st->st_dev;
+  obj->ino = st->st_ino;
+  obj->mtime = st->st_mtime;
+  obj->ctime = st->st_ctime;
+  obj->size = st->st_size;
+  obj->next = rtld_objs;
+  rtld_objs = obj;
+  return obj;
+}
+
+static struct rtld_map *
+rtld_new_map (struct rtld *r, struct rtld_obj *obj, const char *filename,
+	      const char *libname, struct rtld_map *loader)
+{
+  struct rtld_map *m;
+
+  if (r->nall == r->nallalloced)
+    {
+      struct rtld_map **all;
+
+      r->nallalloced = r->nallalloced ? 2 * r->nallalloced : 16;
+      all = realloc (r->all, r->nallalloced * sizeof (struct rtld_map *));
+      if (all == NULL)
+	{
+	  error (0, ENOMEM, "Could not load %s", filename);
+	  return NULL;
+	}
+      r->all = all;
+    }
+
+  m = calloc (1, sizeof (struct rtld_map)
+		 + obj->nneeded * sizeof (struct rtld_map *));
+  if (m == NULL || (m->filename = strdup (filename)) == NULL)
+    {
+      free (m);
+      error (0, ENOMEM, "Could not load %s", filename);
+      return NULL;
+    }
+  m->obj = obj;
+  m->libname = libname;
+  m->loader = loader;
+  m->deps = (struct rtld_map **) (m + 1);
+  m->idx = -1;
+  r->all[r->nall++] = m;
+  return m;
+}
+
+static int
+rtld_append (struct rtld *r, struct rtld_map *m)
+{
+  if (r->nmaps == r->nalloced)
+    {
+      struct rtld_map **maps;
+
+      r->nalloced = r->nalloced ? 2 * r->nalloced : 16;
+      maps = realloc (r->maps, r->nalloced * sizeof (struct rtld_map *));
+      if (maps == NULL)
+	{
+	  error (0, ENOMEM, "Could not build search list");
+	  return 1;
+	}
+      r->maps = maps;
+    }
+  m->idx = r->nmaps;
+  r->maps[r->nmaps++] = m;
+  return 0;
+}
+
+/* Open FILENAME if it is an ELF object ld.so would accept for R.
+   Return the descriptor, or -1.  */
+static int
+rtld_open_candidate (struct rtld *r, const char *filename, struct stat64 *st)
+{
+  unsigned char e_ident[EI_NIDENT + 4];
+  int fd, machine, i;
+
+  fd = open (filename, O_RDONLY);
+  if (fd < 0)
+    return -1;
+
+  if (fstat64 (fd, st) < 0 || ! S_ISREG (st->st_mode)
+      || pread (fd, e_ident, sizeof (e_ident), 0) != sizeof (e_ident)
+      || memcmp (e_ident, ELFMAG, SELFMAG) != 0
+      || e_ident[EI_CLASS] != r->ei_class
+      || e_ident[EI_DATA] != r->ei_data)
+    {
+      close (fd);
+      return -1;
+    }
+
+  if (r->ei_data == ELFDATA2LSB)
+    machine = buf_read_ule16 (e_ident + EI_NIDENT + 2);
+  else
+    machine = buf_read_ube16 (e_ident + EI_NIDENT + 2);
+  if (machine != r->arch->machine)
+    {
+      for (i = 0; i < 3; ++i)
+	if (r->arch->alternate_machine[i] == machine)
+	  break;
+      if (i == 3 || machine == EM_NONE)
+	{
+	  close (fd);
+	  return -1;
+	}
+    }
+  return fd;
+}
+
+/* Return a malloced copy of the first LEN characters of P with
+   $ORIGIN, $LIB and $PLATFORM substituted, or NULL if a needed
+   substitution is not known.  */
+static char *
+rtld_expand (struct rtld *r, const char *p, size_t len,
+	     struct rtld_map *loader)
+{
+  const char *origin = ".", *lib;
+  size_t originlen = 1, n;
+  char *ret, *q;
+  const char *end = p + len;
+
+  if (loader)
+    {
+      const char *slash = strrchr (loader->filename, '/');
+
+      if (slash)
+	{
+	  origin = loader->filename;
+	  originlen = slash == origin ? 1 : slash - origin;
+	}
+    }
+  lib = (r->ei_class == ELFCLASS64 && r->machine != EM_ALPHA
+	 && r->machine != EM_IA_64) ? "lib64" : "lib";
+
+  ret = malloc (len + 1 + (originlen + 6) * 8);
+  if (ret == NULL)
+    return NULL;
+  for (q = ret, n = 0; p < end; )
+    {
+      const char *name;
+      size_t namelen;
+      int braces = 0;
+
+      if (*p != '$')
+	{
+	  *q++ = *p++;
+	  continue;
+	}
+      name = p + 1;
+      if (name < end && *name == '{')
+	{
+	  braces = 1;
+	  ++name;
+	}
+      for (namelen = 0; name + namelen < end
+			&& (name[namelen] == '_'
+			    || (name[namelen] >= 'A' && name[namelen] <= 'Z'));
+	   ++namelen)
+	;
+      if (braces && (name + namelen >= end || name[namelen] != '}'))
+	break;
+      if (++n > 8)
+	break;
+      if (namelen == 6 && memcmp (name, "ORIGIN", 6) == 0)
+	q = mempcpy (q, origin, originlen);
+      else if (namelen == 3 && memcmp (name, "LIB", 3) == 0)
+	q = stpcpy (q, lib);
+      else
+	break;
+      p = name + namelen + braces;
+    }
+  if (p < end)
+    {
+      free (ret);
+      return NULL;
+    }
+  *q = '\0';
+  return ret;
+}
+
+/* Try to open NAME in each directory of the colon separated PATH.  */
+static int
+rtld_open_path (struct rtld *r, const char *path, const char *name,
+		struct rtld_map *loader, char **filenamep, struct stat64 *st)
+{
+  size_t namelen = strlen (name);
+
+  while (path && *path)
+    {
+      const char *end = strchr (path, ':');
+      char *dir, *filename;
+      size_t len;
+      int fd;
+
+      if (end == NULL)
+	end = path + strlen (path);
+      dir = rtld_expand (r, path, end - path, loader);
+      path = *end ? end + 1 : end;
+      if (dir == NULL)
+	continue;
+      len = strlen (dir);
+      if (len == 0)
+	{
+	  free (dir);
+	  dir = strdup (".");
+	  if (dir == NULL)
+	    return -1;
+	  len = 1;
+	}
+      filename = malloc (len + namelen + 2);
+      if (filename == NULL)
+	{
+	  free (dir);
+	  return -1;
+	}
+      memcpy (filename, dir, len);
+      if (filename[len - 1] != '/')
+	filename[len++] = '/';
+      memcpy (filename + len, name, namelen + 1);
+      free (dir);
+
+      fd = rtld_open_candidate (r, filename, st);
+      if (fd >= 0)
+	{
+	  *filenamep = filename;
+	  return fd;
+	}
+      free (filename);
+    }
+  return -1;
+}
+
+static int
+rtld_read_conf (const char *conf, int depth)
+{
+  FILE *f;
+  char *line = NULL;
+  size_t len = 0;
+
+  if (depth > 8 || (f = fopen (conf, "r")) == NULL)
+    return 0;
+
+  while (getline (&line, &len, f) > 0)
+    {
+      char *p = line, *q, **dirs;
+
+      q = strchr (p, '#');
+      if (q)
+	*q = '\0';
+      p += strspn (p, " \t\n");
+      q = p + strcspn (p, " \t\n=");
+      if (*p == '\0')
+	continue;
+
+      if (q - p == 7 && memcmp (p, "include", 7) == 0)
+	{
+	  glob_t g;
+	  size_t i;
+
+	  p = q + strspn (q, " \t");
+	  p[strcspn (p, " \t\n")] = '\0';
+	  if (*p != '/')
+	    {
+	      const char *slash = strrchr (conf, '/');
+	      char *pattern = alloca ((slash ? slash - conf + 1 : 0)
+				      + strlen (p) + 1);
+
+	      memcpy (pattern, conf, slash ? slash - conf + 1 : 0);
+	      strcpy (pattern + (slash ? slash - conf + 1 : 0), p);
+	      p = pattern;
+	    }
+	  if (glob (p, 0, NULL, &g) == 0)
+	    {
+	      for (i = 0; i < g.gl_pathc; ++i)
+		rtld_read_conf (g.gl_pathv[i], depth + 1);
+	      globfree (&g);
+	    }
+	  continue;
+	}
+      if (q - p == 5 && memcmp (p, "hwcap", 5) == 0)
+	continue;
+
+      *q = '\0';
+      dirs = realloc (rtld_conf_dirs, (rtld_nconf_dirs + 1) * sizeof (char *));
+      if (dirs == NULL)
+	break;
+      rtld_conf_dirs = dirs;
+      rtld_conf_dirs[rtld_nconf_dirs] = strdup (p);
+      if (rtld_conf_dirs[rtld_nconf_dirs] != NULL)
+	++rtld_nconf_dirs;
+    }
+  free (line);
+  fclose (f);
+  return 0;
+}
+
+/* Search NAME the way _dl_map_object does for dependencies of
+   LOADER.  */
+static int
+rtld_search (struct rtld *r, const char *name, struct rtld_map *loader,
+	     char **filenamep, struct stat64 *st)
+{
+  struct rtld_map *l;
+  int fd = -1, i;
+
+  if (strchr (name, '/') != NULL)
+    {
+      char *filename = rtld_expand (r, name, strlen (name), loader);
+
+      if (filename == NULL)
+	return -1;
+      fd = rtld_open_candidate (r, filename, st);
+      if (fd < 0)
+	free (filename);
+      else
+	*filenamep = filename;
+      return fd;
+    }
+
+  /* DT_RPATH of the loader, its loader and so on up to the
+     executable, unless the loader has DT_RUNPATH.  */
+  if (loader == NULL || loader->obj->runpath == NULL)
+    for (l = loader; l && fd < 0; l = l->loader)
+      if (l->obj->rpath && l->obj->runpath == NULL)
+	fd = rtld_open_path (r, l->obj->rpath, name, l, filenamep, st);
+
+  if (fd < 0 && ld_library_path)
+    fd = rtld_open_path (r, ld_library_path, name, NULL, filenamep, st);
+
+  if (fd < 0 && loader && loader->obj->runpath)
+    fd = rtld_open_path (r, loader->obj->runpath, name, loader,
+			 filenamep, st);
+
+  /* The target's ld.so.cache is not available, use the directories
+     it would have been built from.  */
+  if (fd < 0)
+    {
+      if (rtld_nconf_dirs == -1)
+	{
+	  rtld_nconf_dirs = 0;
+	  rtld_read_conf ("/etc/ld.so.conf", 0);
+	}
+      for (i = 0; i < rtld_nconf_dirs && fd < 0; ++i)
+	fd = rtld_open_path (r, rtld_conf_dirs[i], name, NULL, filenamep, st);
+    }
+
+  if (fd < 0 && (loader == NULL || ! loader->obj->nodeflib))
+    {
+      if (r->ei_class == ELFCLASS64 && r->machine != EM_ALPHA
+	  && r->machine != EM_IA_64)
+	fd = rtld_open_path (r, "/lib64:/usr/lib64", name, NULL,
+			     filenamep, st);
+      else
+	fd = rtld_open_path (r, "/lib:/usr/lib", name, NULL, filenamep, st);
+    }
+
+  return fd;
+}
+
+/* Return the map for NAME needed by LOADER, loading it if needed.  */
+static struct rtld_map *
+rtld_map_object (struct rtld *r, const char *name, struct rtld_map *loader,
+		 const char *ent_filename)
+{
+  struct rtld_map *m;
+  struct rtld_obj *obj;
+  struct stat64 st;
+  char *filename;
+  int i, fd;
+
+  for (i = 0; i < r->nall; ++i)
+    {
+      m = r->all[i];
+      if (strcmp (name, m->filename) == 0
+	  || (m->libname && strcmp (name, m->libname) == 0)
+	  || (m->obj->type == ET_DYN && strcmp (name, m->obj->soname) == 0))
+	return m;
+    }
+
+  fd = rtld_search (r, name, loader, &filename, &st);
+  if (fd < 0)
+    {
+      error (0, 0, "%s: Could not find one of the dependencies: %s",
+	     ent_filename, name);
+      return NULL;
+    }
+
+  for (i = 0; i < r->nall; ++i)
+    {
+      m = r->all[i];
+      if (m->obj->dev == st.st_dev && m->obj->ino == st.st_ino)
+	{
+	  close (fd);
+	  free (filename);
+	  return m;
+	}
+    }
+
+  obj = rtld_obj_get (fd, filename, &st);
+  if (obj == NULL)
+    m = NULL;
+  else if (obj->type != ET_DYN)
+    {
+      error (0, 0, "%s is not a shared library", filename);
+      m = NULL;
+    }
+  else
+    m = rtld_new_map (r, obj, filename, name, loader);
+  free (filename);
+  return m;
+}
+
+static void
+rtld_free (struct rtld *r)
+{
+  int i;
+
+  for (i = 0; i < r->nall; ++i)
+    {
+      free (r->all[i]->filename);
+      free (r->all[i]->scope);
+      free (r->all[i]);
+    }
+  free (r->all);
+  free (r->maps);
+}
+
+/* Assign TLS module ids and static TLS offsets like init_tls and
+   _dl_determine_tlsoffset.  */
+static void
+rtld_tls (struct rtld *r)
+{
+  GElf_Addr offset, freetop = 0, freebottom = 0;
+  struct rtld_map **order;
+  int tcb_at_tp = 0, modid = 0, i;
+
+  switch (r->machine)
+    {
+    case EM_386:
+    case EM_X86_64:
+    case EM_S390:
+    case EM_SPARC:
+    case EM_SPARC32PLUS:
+    case EM_SPARCV9:
+      tcb_at_tp = 1;
+      offset = 0;
+      break;
+    case EM_ARM:
+    case EM_SH:
+      offset = 8;
+      break;
+    case EM_ALPHA:
+    case EM_IA_64:
+#ifdef EM_AARCH64
+    case EM_AARCH64:
+#endif
+      offset = 16;
+      break;
+    default:
+      offset = 0;
+      break;
+    }
+
+  /* The executable gets module id 1, the dynamic linker is registered
+     before the dependencies are loaded.  Static TLS offsets are handed
+     out in the same order, walking the slotinfo list.  */
+  order = alloca (r->nmaps * sizeof (struct rtld_map *));
+  if (r->maps[0]->obj->has_tls)
+    order[modid++] = r->maps[0];
+  if (r->rtld && r->rtld->idx > 0 && r->rtld->obj->has_tls)
+    order[modid++] = r->rtld;
+  for (i = 1; i < r->nmaps; ++i)
+    if (r->maps[i]->obj->has_tls && r->maps[i] != r->rtld)
+      order[modid++] = r->maps[i];
+
+  for (i = 0; i < modid; ++i)
+    {
+      struct rtld_map *map = order[i];
+      struct rtld_obj *obj = map->obj;
+      GElf_Addr firstbyte, off, align = obj->tls_align;
+
+      map->tls_modid = i + 1;
+      firstbyte = (-obj->tls_firstbyte) & (align - 1);
+      if (tcb_at_tp)
+	{
+	  if (freebottom - freetop >= obj->tls_blocksize)
+	    {
+	      off = (freetop + obj->tls_blocksize - firstbyte + align - 1)
+		    / align * align + firstbyte;
+	      if (off <= freebottom)
+		{
+		  freetop = off;
+		  map->tls_offset = off;
+		  continue;
+		}
+	    }
+
+	  off = (offset + obj->tls_blocksize - firstbyte + align - 1)
+		/ align * align + firstbyte;
+	  if (off > offset + obj->tls_blocksize + (freebottom - freetop))
+	    {
+	      freetop = offset;
+	      freebottom = off - obj->tls_blocksize;
+	    }
+	  offset = off;
+	  map->tls_offset = off;
+	}
+      else
+	{
+	  if (obj->tls_blocksize <= freetop - freebottom)
+	    {
+	      off = (freebottom + align - 1) / align * align;
+	      if (off - freebottom < firstbyte)
+		off += align;
+	      if (off + obj->tls_blocksize - firstbyte <= freetop)
+		{
+		  map->tls_offset = off - firstbyte;
+		  freebottom = off + obj->tls_blocksize - firstbyte;
+		  continue;
+		}
+	    }
+
+	  off = (offset + align - 1) / align * align;
+	  if (off - offset < firstbyte)
+	    off += align;
+	  map->tls_offset = off - firstbyte;
+	  if (off - firstbyte - offset > freetop - freebottom)
+	    {
+	      freebottom = offset;
+	      freetop = off - firstbyte;
+	    }
+	  offset = off + obj->tls_blocksize - firstbyte;
+	}
+    }
+}
+
+/* Load ENT_FILENAME and all its dependencies in the order ld.so would
+   search them.  */
+static int
+rtld_load (struct rtld *r, struct PLArch *arch, const char *ent_filename,
+	   int etype)
+{
+  struct rtld_map *main_map, *m;
+  struct rtld_obj *obj;
+  struct stat64 st;
+  unsigned char e_ident[EI_NIDENT];
+  const char *dl = dynamic_linker ?: arch->dynamic_linker;
+  int fd, i, j;
+
+  memset (r, 0, sizeof (*r));
+  r->arch = arch;
+  r->machine = arch->machine;
+
+  fd = open (ent_filename, O_RDONLY);
+  if (fd < 0)
+    {
+      error (0, errno, "cannot open \"%s\"", ent_filename);
+      return 1;
+    }
+  if (fstat64 (fd, &st) < 0
+      || pread (fd, e_ident, EI_NIDENT, 0) != EI_NIDENT)
+    {
+      error (0, errno, "cannot read \"%s\"", ent_filename);
+      close (fd);
+      return 1;
+    }
+  r->ei_class = e_ident[EI_CLASS];
+  r->ei_data = e_ident[EI_DATA];
+  obj = rtld_obj_get (fd, ent_filename, &st);
+  if (obj == NULL)
+    return 1;
+
+  main_map = rtld_new_map (r, obj, ent_filename, NULL, NULL);
+  if (main_map == NULL || rtld_append (r, main_map))
+    goto error_out;
+
+  /* The dynamic linker is always loaded, but only becomes part of
+     the search list if something depends on it.  */
+  fd = rtld_open_candidate (r, dl, &st);
+  if (fd >= 0)
+    {
+      obj = rtld_obj_get (fd, dl, &st);
+      if (obj == NULL)
+	goto error_out;
+      r->rtld = rtld_new_map (r, obj, dl, NULL, NULL);
+      if (r->rtld == NULL)
+	goto error_out;
+    }
+
+  if (etype == ET_EXEC && ld_preload)
+    {
+      char *preload = strdupa (ld_preload), *p, *saveptr;
+
+      for (p = strtok_r (preload, " :", &saveptr); p;
+	   p = strtok_r (NULL, " :", &saveptr))
+	{
+	  m = rtld_map_object (r, p, main_map, ent_filename);
+	  if (m == NULL)
+	    goto error_out;
+	  if (m->idx < 0 && rtld_append (r, m))
+	    goto error_out;
+	}
+    }
+
+  /* Breadth first search over DT_NEEDED, like _dl_map_object_deps.  */
+  for (i = 0; i < r->nmaps; ++i)
+    {
+      m = r->maps[i];
+      for (j = 0; j < m->obj->nneeded; ++j)
+	{
+	  struct rtld_map *dep;
+
+	  dep = rtld_map_object (r, m->obj->needed[j], m, ent_filename);
+	  if (dep == NULL)
+	    goto error_out;
+	  m->deps[j] = dep;
+	  if (dep->idx < 0 && rtld_append (r, dep))
+	    goto error_out;
+	}
+    }
+
+  rtld_tls (r);
+  return 0;
+
+error_out:
+  rtld_free (r);
+  return 1;
+}
+
+/* Build M's local search list, M and its dependencies breadth
+   first.  */
+static int
+rtld_local_scope (struct rtld *r, struct rtld_map *m)
+{
+  char *seen;
+  int i, j, n;
+
+  if (m->scope)
+    return 0;
+
+  m->scope = malloc (r->nmaps * sizeof (struct rtld_map *));
+  seen = calloc (r->nmaps, 1);
+  if (m->scope == NULL || seen == NULL)
+    {
+      free (seen);
+      free (m->scope);
+      m->scope = NULL;
+      error (0, ENOMEM, "Could not build search list");
+      return 1;
+    }
+
+  n = 0;
+  m->scope[n++] = m;
+  seen[m->idx] = 1;
+  for (i = 0; i < n; ++i)
+    for (j = 0; j < m->scope[i]->obj->nneeded; ++j)
+      {
+	struct rtld_map *dep = m->scope[i]->deps[j];
+
+	if (! seen[dep->idx])
+	  {
+	    seen[dep->idx] = 1;
+	    m->scope[n++] = dep;
+	  }
+      }
+  m->nscope = n;
+  free (seen);
+  return 0;
+}
+
+struct rtld_lookup
+{
+  const char *name;
+  Elf32_Word hash, gnu_hash;
+  const struct rtld_version *version;
+  int type_class;
+};
+
+/* Look NAME up in OBJ, like do_lookup_x does for one object.  Return
+   the symbol index or 0.  */
+static size_t
+rtld_lookup_obj (struct rtld_obj *obj, struct rtld_lookup *l)
+{
+  size_t symidx, versioned_sym = 0;
+  int num_versions = 0;
+
+#define CHECK_MATCH() \
+  do									\
+    {									\
+      GElf_Sym *sym = &obj->syms[symidx];				\
+      int stt = GELF_ST_TYPE (sym->st_info);				\
+      int stb = GELF_ST_BIND (sym->st_info);				\
+      const char *name;							\
+									\
+      if ((sym->st_value == 0 && sym->st_shndx != SHN_ABS		\
+	   && stt != STT_TLS)						\
+	  || ((l->type_class & RTLD_CLASS_PLT)				\
+	      && sym->st_shndx == SHN_UNDEF)				\
+	  || ((1 << stt) & ALLOWED_STT) == 0)				\
+	break;								\
+      name = rtld_string (obj, sym->st_name);				\
+      if (name == NULL || strcmp (name, l->name) != 0)			\
+	break;								\
+      if (l->version != NULL)						\
+	{								\
+	  if (obj->versym != NULL)					\
+	    {								\
+	      size_t ndx = obj->versym[symidx] & 0x7fff;		\
+	      const struct rtld_version *v = NULL;			\
+									\
+	      if (ndx < obj->nversions)					\
+		v = &obj->versions[ndx];				\
+	      if ((v == NULL || v->hash != l->version->hash		\
+		   || v->name == NULL					\
+		   || strcmp (v->name, l->version->name) != 0)		\
+		  && (l->version->hidden || (v && v->hash)		\
+		      || (obj->versym[symidx] & 0x8000)))		\
+		break;							\
+	    }								\
+	}								\
+      else if (obj->versym != NULL					\
+	       && (obj->versym[symidx] & 0x7fff) >= 3)			\
+	{								\
+	  /* Don't accept hidden symbols.  */				\
+	  if ((obj->versym[symidx] & 0x8000) == 0			\
+	      && num_versions++ == 0)					\
+	    versioned_sym = symidx;					\
+	  break;							\
+	}								\
+      if (stb == STB_GLOBAL || stb == STB_WEAK || stb == STB_GNU_UNIQUE)	\
+	return symidx;							\
+    }									\
+  while (0)
+
+  if (obj->gnu_bitmask)
+    {
+      unsigned int bits = obj->gnu_bits;
+      GElf_Addr word = obj->gnu_bitmask[(l->gnu_hash / bits)
+					& (obj->gnu_nwords - 1)];
+      unsigned int bit1 = l->gnu_hash & (bits - 1);
+      unsigned int bit2 = (l->gnu_hash >> obj->gnu_shift) & (bits - 1);
+
+      if ((word >> bit1) & (word >> bit2) & 1)
+	{
+	  symidx = obj->gnu_bucket[l->gnu_hash % obj->gnu_nbucket];
+	  if (symidx != 0)
+	    for (; symidx < obj->nsyms; ++symidx)
+	      {
+		Elf32_Word h = obj->gnu_chain[symidx - obj->gnu_symbias];
+
+		if (((h ^ l->gnu_hash) >> 1) == 0)
+		  CHECK_MATCH ();
+		if (h & 1)
+		  break;
+	      }
+	}
+    }
+  else
+    for (symidx = obj->bucket[l->hash % obj->nbucket];
+	 symidx != STN_UNDEF && symidx < obj->nchain && symidx < obj->nsyms;
+	 symidx = obj->chain[symidx])
+      CHECK_MATCH ();
+
+#undef CHECK_MATCH
+
+  /* If we have seen exactly one versioned symbol while we are looking
+     for an unversioned symbol and the version is not the default
+     version we still accept this symbol since there are no possible
+     ambiguities.  */
+  return num_versions == 1 ? versioned_sym : 0;
+}
+
+static size_t
+rtld_lookup_scope (struct rtld_map **scope, int nscope, struct rtld_map *skip,
+		   struct rtld_lookup *l, struct rtld_map **mapp)
+{
+  size_t symidx;
+  int i;
+
+  for (i = 0; i < nscope; ++i)
+    {
+      if (scope[i] == skip)
+	continue;
+      symidx = rtld_lookup_obj (scope[i]->obj, l);
+      if (symidx)
+	{
+	  *mapp = scope[i];
+	  return symidx;
+	}
+    }
+  *mapp = NULL;
+  return 0;
+}
+
+/* The lookup _dl_lookup_symbol_x does in the global scope for a
+   reference from UNDEF to its symbol REF.  */
+static size_t
+rtld_lookup_global (struct rtld *r, struct rtld_map *undef, size_t ref,
+		    struct rtld_lookup *l, struct rtld_map **mapp)
+{
+  struct rtld_map *skip = NULL;
+  GElf_Sym *refsym = &undef->obj->syms[ref];
+  size_t symidx = 0;
+
+  if (l->type_class & RTLD_CLASS_COPY)
+    skip = undef;
+
+  *mapp = NULL;
+  if (undef->obj->symbolic && skip != undef)
+    symidx = rtld_lookup_scope (&undef, 1, NULL, l, mapp);
+  if (symidx == 0)
+    symidx = rtld_lookup_scope (r->maps, r->nmaps, skip, l, mapp);
+
+  /* A protected definition in UNDEF wins over the found one, unless
+     the definition found is a copy of it.  */
+  if (symidx && GELF_ST_VISIBILITY (refsym->st_other) == STV_PROTECTED
+      && *mapp != undef)
+    {
+      if (l->type_class == RTLD_CLASS_PLT)
+	{
+	  *mapp = undef;
+	  symidx = ref;
+	}
+      else
+	{
+	  struct rtld_lookup pl = *l;
+	  struct rtld_map *pmap;
+
+	  pl.type_class = RTLD_CLASS_PLT;
+	  if (rtld_lookup_scope (r->maps, r->nmaps, skip, &pl, &pmap)
+	      && pmap != undef)
+	    {
+	      *mapp = undef;
+	      symidx = ref;
+	    }
+	}
+    }
+  return symidx;
+}
+
+static int
+rtld_relocate (struct rtld *r, struct prelink_trace *t, struct rtld_map *m)
+{
+  struct rtld_obj *obj = m->obj;
+  struct PLArch *arch = r->arch;
+  size_t i;
+
+  if (m->idx && rtld_local_scope (r, m))
+    return 1;
+
+  for (i = 0; i < obj->nrelocs; ++i)
+    {
+      GElf_Word ref = obj->relocs[i].sym;
+      GElf_Sym *refsym = &obj->syms[ref];
+      struct rtld_lookup l;
+      struct rtld_map *defmap, *localmap = NULL;
+      size_t symidx, localidx = 0;
+      GElf_Addr symoff;
+      int rclass, reloc_class, ifunc = 0, conflict = 0, stt;
+
+      if (GELF_ST_BIND (refsym->st_info) == STB_LOCAL
+	  || GELF_ST_VISIBILITY (refsym->st_other) == STV_HIDDEN
+	  || GELF_ST_VISIBILITY (refsym->st_other) == STV_INTERNAL)
+	continue;
+
+      rclass = arch->reloc_class (obj->relocs[i].type);
+      l.name = rtld_string (obj, refsym->st_name);
+      if (l.name == NULL)
+	continue;
+      l.hash = rtld_elf_hash (l.name);
+      l.gnu_hash = rtld_gnu_hash (l.name);
+      l.type_class = rclass == RTYPE_CLASS_TLS ? 0 : rclass & 3;
+      l.version = NULL;
+      if (obj->versym)
+	{
+	  size_t ndx = obj->versym[ref] & 0x7fff;
+
+	  if (ndx < obj->nversions && obj->versions[ndx].hash != 0)
+	    l.version = &obj->versions[ndx];
+	}
+
+      symidx = rtld_lookup_global (r, m, ref, &l, &defmap);
+      if (symidx == 0)
+	{
+	  if (GELF_ST_BIND (refsym->st_info) != STB_WEAK)
+	    prelink_trace_undefined (t);
+	  continue;
+	}
+
+      if (m->idx)
+	{
+	  localidx = rtld_lookup_scope (m->scope, m->nscope, NULL, &l,
+					&localmap);
+	  if (localidx != symidx || localmap != defmap)
+	    conflict = 1;
+	}
+
+      stt = GELF_ST_TYPE (defmap->obj->syms[symidx].st_info);
+      if (stt == STT_TLS)
+	reloc_class = RTYPE_CLASS_TLS;
+      else
+	{
+	  if (stt == STT_GNU_IFUNC)
+	    ifunc = 1;
+	  reloc_class = (l.type_class | arch->rtype_class_valid);
+	}
+
+      symoff = obj->symtab_addr + ref * obj->sym_entsize - obj->base;
+      if (conflict)
+	{
+	  int valowner[2];
+	  GElf_Addr value[2];
+
+	  valowner[0] = defmap->idx;
+	  value[0] = defmap->obj->syms[symidx].st_value;
+	  valowner[1] = localmap ? localmap->idx : -1;
+	  value[1] = localmap ? localmap->obj->syms[localidx].st_value : 0;
+	  if (prelink_trace_conflict (t, m->idx, symoff, valowner, value,
+				      reloc_class, ifunc, l.name))
+	    return 1;
+	}
+      else if (m->idx == 0 || reloc_class == RTYPE_CLASS_TLS || ifunc)
+	{
+	  if (prelink_trace_lookup (t, m->idx, symoff, defmap->idx,
+				    defmap->obj->syms[symidx].st_value,
+				    reloc_class, ifunc, l.name))
+	    return 1;
+	}
+    }
+  return 0;
+}
+
+/* Return nonzero if symbol lookup for DSO can be done by prelink itself
+   rather than by running the dynamic linker.  */
+int
+prelink_resolve_p (DSO *dso)
+{
+  if (ld_trace)
+    return 0;
+  /* MIPS resolves symbols through the GOT rather than through
+     relocations.  */
+  if (dso->ehdr.e_machine == EM_MIPS)
+    return 0;
+  return 1;
+}
+
+/* Store into *DEPENDSP the malloced list of dependencies of
+   ENT_FILENAME, in search list order.  */
+int
+prelink_resolve_deps (struct PLArch *arch, int etype, const char *ent_filename,
+		      char ***dependsp, int *ndependsp)
+{
+  struct rtld r;
+  char **depends;
+  int i;
+
+  if (rtld_load (&r, arch, ent_filename, etype))
+    return 1;
+
+  depends = malloc (r.nmaps * sizeof (char *));
+  if (depends == NULL)
+    {
+      error (0, ENOMEM, "%s: Could not record dependencies", ent_filename);
+      rtld_free (&r);
+      return 1;
+    }
+  for (i = 1; i < r.nmaps; ++i)
+    {
+      depends[i - 1] = strdup (r.maps[i]->filename);
+      if (depends[i - 1] == NULL)
+	{
+	  error (0, ENOMEM, "%s: Could not record dependencies",
+		 ent_filename);
+	  while (--i > 0)
+	    free (depends[i - 1]);
+	  free (depends);
+	  rtld_free (&r);
+	  return 1;
+	}
+    }
+  *dependsp = depends;
+  *ndependsp = r.nmaps - 1;
+  rtld_free (&r);
+  return 0;
+}
+
+/* Resolve all symbol references of INFO->dso and, if conflicts are
+   recorded, of its dependencies.  */
+int
+prelink_resolve_relocations (struct prelink_info *info,
+			     const char *ent_filename)
+{
+  struct prelink_trace t;
+  struct rtld r;
+  int i;
+
+  if (rtld_load (&r, info->dso->arch, ent_filename,
+		 info->dso->ehdr.e_type))
+    return 1;
+
+  if (prelink_trace_init (&t, info, ent_filename))
+    goto error_out;
+
+  for (i = 0; i < r.nmaps; ++i)
+    {
+      struct rtld_map *m = r.maps[i];
+
+      /* Like ld.so, report the name the object was asked for by.  */
+      if (prelink_trace_dep (&t, m->libname ?: m->filename, m->filename,
+			     m->obj->base, 0, m->tls_modid, m->tls_offset))
+	goto error_out;
+    }
+
+  if (prelink_trace_deps_done (&t))
+    goto error_out;
+
+  for (i = 0; i < (info->conflicts ? r.nmaps : 1); ++i)
+    if (rtld_relocate (&r, &t, r.maps[i]))
+      goto error_out;
+
+  rtld_free (&r);
+  return prelink_trace_finish (&t);
+
+error_out:
+  prelink_trace_free (&t);
+  rtld_free (&r);
+  return 1;
+}
@@ -29,81 +29,74 @@
 #include "reloc.h"
 
 static int
-undo_prelink_rel (DSO *dso, int n)
+undo_prelink_relocs (DSO *dso, int n)
 {
-  Elf_Data *data = NULL;
-  Elf_Scn *scn = dso->scn[n];
-  GElf_Rel rel;
-  int sec;
+  struct reloc_view view;
+  GElf_Addr entsize = dso->shdr[n].sh_entsize;
+  int r, i, ret, changed = 0;
 
-  if (dso->arch->undo_prelink_rel == NULL)
+  if (dso->shdr[n].sh_type == SHT_RELA
+      ? dso->arch->undo_prelink_rela == NULL
+      : dso->arch->undo_prelink_rel == NULL)
     return 0;
-  while ((data = elf_getdata (scn, data)) != NULL)
+
+  if (read_reloc_view (dso, n, &view))
+    return 1;
+
+  for (r = 0; r < view.nruns; ++r)
     {
-      int ndx, maxndx;
-      GElf_Addr addr = dso->shdr[n].sh_addr + data->d_off;
+      struct reloc_run *run = &view.runs[r];
 
-      maxndx = data->d_size / dso->shdr[n].sh_entsize;
-      for (ndx = 0; ndx < maxndx;
-	   ++ndx, addr += dso->shdr[n].sh_entsize)
+      if (dso->arch->undo_prelink_reloc_batch)
 	{
-	  gelfx_getrel (dso->elf, data, ndx, &rel);
-	  sec = addr_to_sec (dso, rel.r_offset);
-	  if (sec == -1)
+	  ret = dso->arch->undo_prelink_reloc_batch (&view, run);
+	  if (ret < 0)
+	    goto error_out;
+	  if (ret)
 	    continue;
-
-	  switch (dso->arch->undo_prelink_rel (dso, &rel, addr))
-	    {
-	    case 2:
-	      gelfx_update_rel (dso->elf, data, ndx, &rel);
-	      break;
-	    case 0:
-	      break;
-	    default:
-	      return 1;
-	    }
 	}
-    }
-  return 0;
-}
-
-static int
-undo_prelink_rela (DSO *dso, int n)
-{
-  Elf_Data *data = NULL;
-  Elf_Scn *scn = dso->scn[n];
-  GElf_Rela rela;
-  int sec;
-
-  if (dso->arch->undo_prelink_rela == NULL)
-    return 0;
-  while ((data = elf_getdata (scn, data)) != NULL)
-    {
-      int ndx, maxndx;
-      GElf_Addr addr = dso->shdr[n].sh_addr + data->d_off;
 
-      maxndx = data->d_size / dso->shdr[n].sh_entsize;
-      for (ndx = 0; ndx < maxndx;
-	   ++ndx, addr += dso->shdr[n].sh_entsize)
+      for (i = run->first; i < run->first + run->count; ++i)
 	{
-	  gelfx_getrela (dso->elf, data, ndx, &rela);
-	  sec = addr_to_sec (dso, rela.r_offset);
-	  if (sec == -1)
+	  GElf_Addr reladdr = dso->shdr[n].sh_addr + i * entsize;
+
+	  if (reloc_view_sec (&view, view.offset[i]) == -1)
 	    continue;
 
-	  switch (dso->arch->undo_prelink_rela (dso, &rela, addr))
+	  if (view.rela)
+	    {
+	      GElf_Rela rela;
+
+	      reloc_view_get_rela (&view, i, &rela);
+	      ret = dso->arch->undo_prelink_rela (dso, &rela, reladdr);
+	      if (ret == 2)
+		reloc_view_set_rela (&view, i, &rela);
+	    }
+	  else
 	    {
-	    case 2:
-	      gelfx_update_rela (dso->elf, data, ndx, &rela);
-	      break;
-	    case 0:
-	      break;
-	    default:
-	      return 1;
+	      GElf_Rel rel;
+
+	      reloc_view_get_rel (&view, i, &rel);
+	      ret = dso->arch->undo_prelink_rel (dso, &rel, reladdr);
+	      if (ret == 2)
+		reloc_view_set_rel (&view, i, &rel);
 	    }
+
+	  if (ret == 2)
+	    changed = 1;
+	  else if (ret)
+	    goto error_out;
 	}
     }
+
+  if ((changed || view.changed) && write_reloc_view (&view))
+    goto error_out;
+  free_reloc_view (&view);
   return 0;
+
+error_out:
+  free_reloc_view (&view);
+  return 1;
 }
 
 static int
@@ -355,6 +348,7 @@ undo_sections (DSO *dso, int undo, struct section_move *move,
 				   dso->shdr[i].sh_name);
 
 	if (! strcmp (name, ".gnu.prelink_undo")
+	    || ! strcmp (name, ".gnu.prelink_debug")
 	    || ! strcmp (name, ".gnu.conflict")
 	    || ! strcmp (name, ".gnu.liblist")
 	    || ! strcmp (name, ".gnu.libstr")
@@ -534,11 +528,8 @@ prelink_undo (DSO *dso)
       switch (dso->shdr[i].sh_type)
 	{
 	case SHT_REL:
-	  if (undo_prelink_rel (dso, i))
-	    goto error_out;
-	  break;
 	case SHT_RELA:
-	  if (undo_prelink_rela (dso, i))
+	  if (undo_prelink_relocs (dso, i))
 	    goto error_out;
 	  break;
 	}
@@ -629,7 +620,7 @@ prelink_undo (DSO *dso)
 	      assert (d != NULL && elf_getdata (scn, d) == NULL);
 	      assert (d->d_size == 0 || d->d_buf != NULL);
 	      assert (d->d_size == dso->shdr[i].sh_size);
-	      free (d->d_buf);
+	      free_section_data (dso, d->d_buf);
 	      d->d_buf = NULL;
 	      dso->shdr[i].sh_type = SHT_NOBITS;
 	    }
@@ -185,10 +185,10 @@ int
 prelink_verify (const char *filename)
 {
   DSO *dso = NULL, *dso2 = NULL;
-  int fd = -1, fdorig = -1, fdundone = -1, undo, ret;
+  int fd = -1, fdorig = -1, fdundone = -1, undo, ret, has_debug_delta;
   struct stat64 st, st2;
   struct prelink_entry *ent;
-  GElf_Addr base;
+  GElf_Addr base, debug_delta;
   char buffer[32768], buffer2[32768];
   size_t count;
   char *p, *q;
@@ -252,6 +252,8 @@ prelink_verify (const char *filename)
 
   base = dso->base;
   ent->base = base;
+  has_debug_delta = dso->has_debug_delta;
+  debug_delta = dso->debug_delta;
 
   ret = prelink_undo (dso);
   if (ret)
@@ -295,11 +297,22 @@ prelink_verify (const char *filename)
     goto failure_unlink;
   fd = -1;
 
+  /* Redo the debugging section adjustments the same way.  They lag
+     behind the allocated sections by DEBUG_DELTA, so move them only
+     as far as BASE - DEBUG_DELTA and defer the rest.  */
+  defer_debug = has_debug_delta;
   if (prelink_prepare (dso2))
     goto failure_unlink;
 
-  if (ent->type == ET_DYN && relocate_dso (dso2, base))
-    goto failure_unlink;
+  if (ent->type == ET_DYN)
+    {
+      defer_debug = 0;
+      if (relocate_dso (dso2, (base - debug_delta) & dso2->mask))
+	goto failure_unlink;
+      defer_debug = has_debug_delta;
+      if (relocate_dso (dso2, base))
+	goto failure_unlink;
+    }
 
   if (prelink (dso2, ent))
     goto failure_unlink;
@@ -0,0 +1,767 @@
+/* Copyright (C) 2026 Red Hat, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.  */
+
+#include <config.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+
+#include "hashtab.h"
+#include "walk.h"
+
+/* Number of directory entries classified by one job.  */
+#define WALK_CHUNK	32
+/* Number of directories the workers may list ahead of the caller.
+   Each of them may keep its directory open until classified.  */
+#define WALK_AHEAD	128
+
+/* struct walk_node state.  */
+enum { NODE_NEW, NODE_QUEUED, NODE_LISTING, NODE_LISTED };
+/* struct walk_node chunk_state.  */
+enum { CHUNK_QUEUED, CHUNK_RUNNING, CHUNK_DONE };
+
+struct walk_entry
+{
+  size_t name;			/* Offset into the node's names.  */
+  struct stat64 st;
+  struct walk_node *child;	/* Node for a directory.  */
+  int class;
+  int valid;			/* Zero if ST could not be read.  */
+};
+
+struct walk_node
+{
+  struct walk_node *next;	/* Chain of all nodes.  */
+  char *path;
+  DIR *dir;			/* Open until all chunks are classified.  */
+  int state;
+  int err;			/* errno if the directory can't be read.  */
+  int cancelled;		/* Set if the caller skips the subtree.  */
+  struct walk_entry *entries;
+  size_t nentries;
+  char *names;
+  int chunks_left;
+  unsigned char *chunk_state;
+};
+
+struct walk_job
+{
+  struct walk_job *next;
+  struct walk_node *node;
+  int chunk;			/* -1 to list NODE.  */
+};
+
+struct walk_devino
+{
+  dev_t dev;
+  ino64_t ino;
+};
+
+struct walk
+{
+  int flags;
+  dev_t dev;
+  walk_classify_fn classify;
+  walk_fn func;
+  pthread_mutex_t lock;
+  pthread_cond_t work_cond;	/* New work or room to list ahead.  */
+  pthread_cond_t done_cond;	/* A job has completed.  */
+  struct walk_job *list_jobs;
+  struct walk_job *chunk_jobs, **chunk_tail;
+  struct walk_node *nodes;
+  htab_t queued;		/* Directories queued for listing.  */
+  htab_t visited;		/* Directories visited, unless WALK_PHYS.  */
+  int ahead;
+  int finish;
+  char *buf;
+  size_t buf_size;
+};
+
+static hashval_t
+devino_hash (const void *p)
+{
+  const struct walk_devino *d = (const struct walk_devino *) p;
+
+  return (d->ino ^ (d->ino >> 32) ^ d->dev) * 0x9e3779b1;
+}
+
+static int
+devino_eq (const void *p, const void *q)
+{
+  const struct walk_devino *a = (const struct walk_devino *) p;
+  const struct walk_devino *b = (const struct walk_devino *) q;
+
+  return a->dev == b->dev && a->ino == b->ino;
+}
+
+/* Add directory ST to HTAB.  Return 1 if it was already there,
+   0 if it has been added and -1 on failure.  */
+static int
+walk_seen (htab_t htab, const struct stat64 *st)
+{
+  struct walk_devino d, *p;
+  void **slot;
+
+  d.dev = st->st_dev;
+  d.ino = st->st_ino;
+  slot = htab_find_slot (htab, &d, INSERT);
+  if (slot == NULL)
+    return -1;
+  if (*slot != NULL)
+    return 1;
+  p = malloc (sizeof (*p));
+  if (p == NULL)
+    {
+      htab_clear_slot (htab, slot);
+      return -1;
+    }
+  *p = d;
+  *slot = p;
+  return 0;
+}
+
+static int
+walk_stat (int dirfd, const char *name, struct stat64 *st, int phys)
+{
+#ifdef HAVE_STATX
+  struct statx stx;
+
+  if (statx (dirfd, name, phys ? AT_SYMLINK_NOFOLLOW : 0,
+	     STATX_BASIC_STATS, &stx) == 0)
+    {
+      memset (st, 0, sizeof (*st));
+      st->st_dev = makedev (stx.stx_dev_major, stx.stx_dev_minor);
+      st->st_ino = stx.stx_ino;
+      st->st_mode = stx.stx_mode;
+      st->st_nlink = stx.stx_nlink;
+      st->st_uid = stx.stx_uid;
+      st->st_gid = stx.stx_gid;
+      st->st_rdev = makedev (stx.stx_rdev_major, stx.stx_rdev_minor);
+      st->st_size = stx.stx_size;
+      st->st_blksize = stx.stx_blksize;
+      st->st_blocks = stx.stx_blocks;
+      st->st_atim.tv_sec = stx.stx_atime.tv_sec;
+      st->st_atim.tv_nsec = stx.stx_atime.tv_nsec;
+      st->st_mtim.tv_sec = stx.stx_mtime.tv_sec;
+      st->st_mtim.tv_nsec = stx.stx_mtime.tv_nsec;
+      st->st_ctim.tv_sec = stx.stx_ctime.tv_sec;
+      st->st_ctim.tv_nsec = stx.stx_ctime.tv_nsec;
+      return 0;
+    }
+  if (errno != ENOSYS)
+    return -1;
+#endif
+  return fstatat64 (dirfd, name, st, phys ? AT_SYMLINK_NOFOLLOW : 0);
+}
+
+/* Return PATH/NAME in malloced memory or, if BUF is non-NULL,
+   in *BUF.  */
+static char *
+walk_join (const char *path, const char *name, char **buf, size_t *size)
+{
+  size_t plen = strlen (path), nlen = strlen (name) + 1;
+  int slash = plen == 0 || path[plen - 1] != '/';
+  char *p;
+
+  if (buf == NULL)
+    p = malloc (plen + slash + nlen);
+  else
+    {
+      if (*size < plen + slash + nlen)
+	{
+	  p = realloc (*buf, 2 * (plen + slash + nlen));
+	  if (p == NULL)
+	    return NULL;
+	  *buf = p;
+	  *size = 2 * (plen + slash + nlen);
+	}
+      p = *buf;
+    }
+  if (p == NULL)
+    return NULL;
+  memcpy (p, path, plen);
+  if (slash)
+    p[plen] = '/';
+  memcpy (p + plen + slash, name, nlen);
+  return p;
+}
+
+/* Read the entries of NODE and stat them.  */
+static void
+walk_list (struct walk *w, struct walk_node *node)
+{
+  struct dirent64 *d;
+  size_t names_size = 0, names_alloced = 0, alloced = 0;
+  int fd;
+
+  fd = open (node->path, O_RDONLY | O_DIRECTORY | O_NONBLOCK | O_CLOEXEC);
+  if (fd == -1)
+    {
+      node->err = errno;
+      return;
+    }
+  node->dir = fdopendir (fd);
+  if (node->dir == NULL)
+    {
+      node->err = errno;
+      close (fd);
+      return;
+    }
+
+  for (;;)
+    {
+      struct walk_entry *e;
+      size_t len;
+
+      errno = 0;
+      d = readdir64 (node->dir);
+      if (d == NULL)
+	{
+	  node->err = errno;
+	  break;
+	}
+      if (d->d_name[0] == '.'
+	  && (d->d_name[1] == '\0'
+	      || (d->d_name[1] == '.' && d->d_name[2] == '\0')))
+	continue;
+
+      len = strlen (d->d_name) + 1;
+      if (names_size + len > names_alloced)
+	{
+	  char *names = realloc (node->names, 2 * names_alloced + len + 256);
+
+	  if (names == NULL)
+	    {
+	      node->err = ENOMEM;
+	      break;
+	    }
+	  node->names = names;
+	  names_alloced = 2 * names_alloced + len + 256;
+	}
+      if (node->nentries == alloced)
+	{
+	  e = realloc (node->entries, (2 * alloced + 16) * sizeof (*e));
+	  if (e == NULL)
+	    {
+	      node->err = ENOMEM;
+	      break;
+	    }
+	  node->entries = e;
+	  alloced = 2 * alloced + 16;
+	}
+
+      e = &node->entries[node->nentries++];
+      memset (e, 0, sizeof (*e));
+      e->name = names_size;
+      memcpy (node->names + names_size, d->d_name, len);
+      names_size += len;
+      e->valid = walk_stat (fd, d->d_name, &e->st,
+			    w->flags & WALK_PHYS) == 0;
+    }
+}
+
+/* Classify the non-directory entries in CHUNK of NODE.  */
+static void
+walk_classify (struct walk *w, struct walk_node *node, int chunk)
+{
+  size_t i = (size_t) chunk * WALK_CHUNK, end = i + WALK_CHUNK;
+  int fd = dirfd (node->dir);
+
+  if (end > node->nentries)
+    end = node->nentries;
+  for (; i < end; ++i)
+    {
+      struct walk_entry *e = &node->entries[i];
+
+      if (e->valid && ! S_ISDIR (e->st.st_mode)
+	  && (! (w->flags & WALK_MOUNT) || e->st.st_dev == w->dev))
+	e->class = w->classify (fd, node->names + e->name, &e->st);
+    }
+}
+
+/* Create the node for directory entry E of NODE and queue it for
+   listing unless that directory is already queued.  Called with
+   W->lock held.  */
+static struct walk_node *
+walk_child (struct walk *w, struct walk_node *node, struct walk_entry *e,
+	    struct walk_job ***tailp)
+{
+  struct walk_node *child;
+  struct walk_job *job;
+
+  child = calloc (1, sizeof (*child));
+  if (child == NULL)
+    return NULL;
+  child->path = walk_join (node->path, node->names + e->name, NULL, NULL);
+  if (child->path == NULL)
+    {
+      free (child);
+      return NULL;
+    }
+  child->next = w->nodes;
+  w->nodes = child;
+  e->child = child;
+
+  if (tailp != NULL && walk_seen (w->queued, &e->st) == 0)
+    {
+      job = malloc (sizeof (*job));
+      if (job != NULL)
+	{
+	  job->node = child;
+	  job->chunk = -1;
+	  job->next = **tailp;
+	  **tailp = job;
+	  *tailp = &job->next;
+	  child->state = NODE_QUEUED;
+	}
+    }
+  return child;
+}
+
+/* NODE has been listed.  Queue its classification and the listing of
+   its subdirectories.  Called with W->lock held.  */
+static void
+walk_listed (struct walk *w, struct walk_node *node)
+{
+  struct walk_job *job, **tail = &w->list_jobs;
+  size_t i;
+  int nchunks;
+
+  node->state = NODE_LISTED;
+  if (node->err == 0 && ! node->cancelled)
+    {
+      nchunks = (node->nentries + WALK_CHUNK - 1) / WALK_CHUNK;
+      node->chunk_state = calloc (nchunks + 1, 1);
+      if (node->chunk_state == NULL)
+	node->err = ENOMEM;
+      else
+	node->chunks_left = nchunks;
+    }
+  if (node->err || node->cancelled || node->chunks_left == 0)
+    {
+      if (node->dir != NULL)
+	closedir (node->dir);
+      node->dir = NULL;
+      if (node->err || node->cancelled)
+	return;
+    }
+
+  ++w->ahead;
+  for (i = 0; i < node->chunks_left; ++i)
+    {
+      job = malloc (sizeof (*job));
+      if (job == NULL)
+	break;
+      job->next = NULL;
+      job->node = node;
+      job->chunk = i;
+      *w->chunk_tail = job;
+      w->chunk_tail = &job->next;
+    }
+
+  /* Subdirectories are listed before anything queued earlier, which
+     roughly follows the order in which the caller will want them.  */
+  for (i = 0; i < node->nentries; ++i)
+    {
+      struct walk_entry *e = &node->entries[i];
+
+      if (e->valid && S_ISDIR (e->st.st_mode)
+	  && (! (w->flags & WALK_MOUNT) || e->st.st_dev == w->dev))
+	walk_child (w, node, e, &tail);
+    }
+  pthread_cond_broadcast (&w->work_cond);
+}
+
+/* Run the listing (CHUNK -1) or classification job CHUNK of NODE,
+   unless it has been started already.  Called with W->lock held,
+   which is dropped while doing the work.  */
+static void
+walk_run (struct walk *w, struct walk_node *node, int chunk)
+{
+  if (chunk == -1)
+    {
+      if (node->state != NODE_NEW && node->state != NODE_QUEUED)
+	return;
+      node->state = NODE_LISTING;
+      if (! node->cancelled)
+	{
+	  pthread_mutex_unlock (&w->lock);
+	  walk_list (w, node);
+	  pthread_mutex_lock (&w->lock);
+	}
+      walk_listed (w, node);
+    }
+  else
+    {
+      if (node->chunk_state[chunk] != CHUNK_QUEUED)
+	return;
+      node->chunk_state[chunk] = CHUNK_RUNNING;
+      if (! node->cancelled)
+	{
+	  pthread_mutex_unlock (&w->lock);
+	  walk_classify (w, node, chunk);
+	  pthread_mutex_lock (&w->lock);
+	}
+      node->chunk_state[chunk] = CHUNK_DONE;
+      if (--node->chunks_left == 0)
+	{
+	  closedir (node->dir);
+	  node->dir = NULL;
+	}
+    }
+  pthread_cond_broadcast (&w->done_cond);
+}
+
+static void *
+walk_worker (void *arg)
+{
+  struct walk *w = (struct walk *) arg;
+  struct walk_job *job;
+
+  pthread_mutex_lock (&w->lock);
+  while (! w->finish)
+    {
+      if (w->chunk_jobs != NULL)
+	{
+	  job = w->chunk_jobs;
+	  w->chunk_jobs = job->next;
+	  if (w->chunk_jobs == NULL)
+	    w->chunk_tail = &w->chunk_jobs;
+	}
+      else if (w->list_jobs != NULL && w->ahead < WALK_AHEAD)
+	{
+	  job = w->list_jobs;
+	  w->list_jobs = job->next;
+	}
+      else
+	{
+	  pthread_cond_wait (&w->work_cond, &w->lock);
+	  continue;
+	}
+      walk_run (w, job->node, job->chunk);
+      free (job);
+    }
+  pthread_mutex_unlock (&w->lock);
+  return NULL;
+}
+
+/* Wait until NODE is listed, listing it here if no worker has
+   started on it yet.  */
+static void
+walk_wait_listed (struct walk *w, struct walk_node *node)
+{
+  pthread_mutex_lock (&w->lock);
+  walk_run (w, node, -1);
+  while (node->state != NODE_LISTED)
+    pthread_cond_wait (&w->done_cond, &w->lock);
+  pthread_mutex_unlock (&w->lock);
+}
+
+/* Likewise for classification CHUNK of NODE.  */
+static void
+walk_wait_chunk (struct walk *w, struct walk_node *node, int chunk)
+{
+  pthread_mutex_lock (&w->lock);
+  walk_run (w, node, chunk);
+  while (node->chunk_state[chunk] != CHUNK_DONE)
+    pthread_cond_wait (&w->done_cond, &w->lock);
+  pthread_mutex_unlock (&w->lock);
+}
+
+/* The caller skips NODE and everything below it.  Called with
+   W->lock held.  */
+static void
+walk_cancel (struct walk *w, struct walk_node *node)
+{
+  size_t i;
+
+  node->cancelled = 1;
+  if (node->state != NODE_LISTED || node->err)
+    return;
+  --w->ahead;
+  for (i = 0; i < node->nentries; ++i)
+    if (node->entries[i].child != NULL)
+      walk_cancel (w, node->entries[i].child);
+  pthread_cond_broadcast (&w->work_cond);
+}
+
+/* The caller is done with NODE.  If COMPLETE, all its chunks have
+   been classified and the entries can be freed.  */
+static void
+walk_release (struct walk *w, struct walk_node *node, int complete)
+{
+  pthread_mutex_lock (&w->lock);
+  --w->ahead;
+  if (complete)
+    {
+      free (node->entries);
+      free (node->names);
+      node->entries = NULL;
+      node->names = NULL;
+      node->nentries = 0;
+    }
+  pthread_cond_broadcast (&w->work_cond);
+  pthread_mutex_unlock (&w->lock);
+}
+
+static int
+walk_dir (struct walk *w, struct walk_node *node)
+{
+  size_t i;
+  int ret = WALK_CONTINUE;
+
+  for (i = 0; i < node->nentries; ++i)
+    {
+      struct walk_entry *e = &node->entries[i];
+      struct walk_node *child;
+      const char *name;
+
+      if (i % WALK_CHUNK == 0)
+	walk_wait_chunk (w, node, i / WALK_CHUNK);
+      if (! e->valid
+	  || ((w->flags & WALK_MOUNT) && e->st.st_dev != w->dev))
+	continue;
+
+      name = walk_join (node->path, node->names + e->name,
+			&w->buf, &w->buf_size);
+      if (name == NULL)
+	{
+	  errno = ENOMEM;
+	  ret = -1;
+	  break;
+	}
+
+      if (! S_ISDIR (e->st.st_mode))
+	{
+	  ret = w->func (name, &e->st, WALK_F, e->class);
+	  if (ret == WALK_SKIP_SUBTREE)
+	    ret = WALK_CONTINUE;
+	  if (ret != WALK_CONTINUE)
+	    break;
+	  continue;
+	}
+
+      if (! (w->flags & WALK_PHYS))
+	{
+	  int seen = walk_seen (w->visited, &e->st);
+
+	  if (seen < 0)
+	    {
+	      errno = ENOMEM;
+	      ret = -1;
+	      break;
+	    }
+	  if (seen)
+	    {
+	      if (e->child != NULL)
+		{
+		  pthread_mutex_lock (&w->lock);
+		  walk_cancel (w, e->child);
+		  pthread_mutex_unlock (&w->lock);
+		}
+	      continue;
+	    }
+	}
+
+      child = e->child;
+      if (child == NULL)
+	{
+	  pthread_mutex_lock (&w->lock);
+	  child = walk_child (w, node, e, NULL);
+	  pthread_mutex_unlock (&w->lock);
+	  if (child == NULL)
+	    {
+	      errno = ENOMEM;
+	      ret = -1;
+	      break;
+	    }
+	}
+
+      walk_wait_listed (w, child);
+      if (child->err == EACCES)
+	continue;
+      if (child->err)
+	{
+	  errno = child->err;
+	  ret = -1;
+	  break;
+	}
+
+      ret = w->func (name, &e->st, WALK_D, 0);
+      if (ret == WALK_SKIP_SUBTREE)
+	{
+	  pthread_mutex_lock (&w->lock);
+	  walk_cancel (w, child);
+	  pthread_mutex_unlock (&w->lock);
+	  ret = WALK_CONTINUE;
+	  continue;
+	}
+      if (ret != WALK_CONTINUE)
+	break;
+
+      ret = walk_dir (w, child);
+      if (ret != WALK_CONTINUE)
+	break;
+    }
+
+  walk_release (w, node, ret == WALK_CONTINUE);
+  return ret;
+}
+
+/* Walk the tree rooted at DIR using up to NTHREADS worker threads.
+   Return 0, the first FUNC return value other than WALK_CONTINUE
+   and WALK_SKIP_SUBTREE, or -1 with errno set on failure.  */
+int
+walk_tree (const char *dir, int flags, int nthreads,
+	   walk_classify_fn classify, walk_fn func)
+{
+  struct walk w;
+  struct walk_node *root, *node;
+  struct walk_job *job;
+  struct stat64 st;
+  pthread_t *threads = NULL;
+  size_t len;
+  int i, nstarted = 0, ret, err;
+  char *path;
+
+  len = strlen (dir);
+  while (len > 1 && dir[len - 1] == '/')
+    --len;
+  path = strndup (dir, len);
+  if (path == NULL)
+    {
+      errno = ENOMEM;
+      return -1;
+    }
+
+  if (((flags & WALK_PHYS) ? lstat64 (path, &st) : stat64 (path, &st)) < 0)
+    {
+      err = errno;
+      free (path);
+      errno = err;
+      return -1;
+    }
+
+  if (! S_ISDIR (st.st_mode))
+    {
+      ret = func (path, &st, WALK_F, classify (AT_FDCWD, path, &st));
+      free (path);
+      return ret == WALK_SKIP_SUBTREE ? WALK_CONTINUE : ret;
+    }
+
+  memset (&w, 0, sizeof (w));
+  w.flags = flags;
+  w.dev = st.st_dev;
+  w.classify = classify;
+  w.func = func;
+  w.chunk_tail = &w.chunk_jobs;
+  w.queued = htab_try_create (64, devino_hash, devino_eq, free);
+  w.visited = htab_try_create (64, devino_hash, devino_eq, free);
+  root = calloc (1, sizeof (*root));
+  if (w.queued == NULL || w.visited == NULL || root == NULL
+      || walk_seen (w.queued, &st) < 0
+      || (! (flags & WALK_PHYS) && walk_seen (w.visited, &st) < 0))
+    {
+      if (w.queued != NULL)
+	htab_delete (w.queued);
+      if (w.visited != NULL)
+	htab_delete (w.visited);
+      free (root);
+      free (path);
+      errno = ENOMEM;
+      return -1;
+    }
+  root->path = path;
+  w.nodes = root;
+  pthread_mutex_init (&w.lock, NULL);
+  pthread_cond_init (&w.work_cond, NULL);
+  pthread_cond_init (&w.done_cond, NULL);
+
+  if (nthreads > 0)
+    threads = malloc (nthreads * sizeof (pthread_t));
+  if (threads != NULL)
+    for (; nstarted < nthreads; ++nstarted)
+      if (pthread_create (&threads[nstarted], NULL, walk_worker, &w))
+	break;
+
+  walk_wait_listed (&w, root);
+  if (root->err == EACCES)
+    ret = WALK_CONTINUE;
+  else if (root->err)
+    {
+      errno = root->err;
+      ret = -1;
+    }
+  else
+    {
+      ret = func (root->path, &st, WALK_D, 0);
+      if (ret == WALK_SKIP_SUBTREE)
+	{
+	  pthread_mutex_lock (&w.lock);
+	  walk_cancel (&w, root);
+	  pthread_mutex_unlock (&w.lock);
+	  ret = WALK_CONTINUE;
+	}
+      else if (ret == WALK_CONTINUE)
+	ret = walk_dir (&w, root);
+    }
+  err = errno;
+
+  pthread_mutex_lock (&w.lock);
+  w.finish = 1;
+  pthread_cond_broadcast (&w.work_cond);
+  pthread_mutex_unlock (&w.lock);
+  for (i = 0; i < nstarted; ++i)
+    pthread_join (threads[i], NULL);
+  free (threads);
+
+  while ((job = w.list_jobs) != NULL)
+    {
+      w.list_jobs = job->next;
+      free (job);
+    }
+  while ((job = w.chunk_jobs) != NULL)
+    {
+      w.chunk_jobs = job->next;
+      free (job);
+    }
+  while ((node = w.nodes) != NULL)
+    {
+      w.nodes = node->next;
+      if (node->dir != NULL)
+	closedir (node->dir);
+      free (node->entries);
+      free (node->names);
+      free (node->chunk_state);
+      free (node->path);
+      free (node);
+    }
+  htab_delete (w.queued);
+  htab_delete (w.visited);
+  free (w.buf);
+  pthread_cond_destroy (&w.work_cond);
+  pthread_cond_destroy (&w.done_cond);
+  pthread_mutex_destroy (&w.lock);
+
+  errno = err;
+  return ret;
+}
@@ -0,0 +1,55 @@
+/* Copyright (C) 2026 Red Hat, Inc.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.  */
+
+#ifndef WALK_H
+#define WALK_H
+
+#include <sys/stat.h>
+
+/* Parallel directory tree walker.
+
+   walk_tree visits the tree in the same order as nftw would (each
+   directory before its entries, entries in readdir order), calling
+   FUNC from the calling thread only.  Listing directories, stat'ing
+   their entries and calling CLASSIFY on each non-directory is done
+   ahead of time by a pool of worker threads, so on high latency
+   filesystems many of those requests are in flight at once.
+   CLASSIFY must therefore be thread-safe; its return value is passed
+   to FUNC as CLASS.  Entries which cannot be stat'ed and unreadable
+   directories are skipped.  */
+
+/* walk_tree FLAGS.  */
+#define WALK_PHYS		1	/* Don't follow symbolic links.  */
+#define WALK_MOUNT		2	/* Stay within the same filesystem.  */
+
+/* FUNC TYPE.  */
+#define WALK_F			0	/* Anything but a directory.  */
+#define WALK_D			1	/* A directory, before its entries.  */
+
+/* FUNC return values.  */
+#define WALK_CONTINUE		0
+#define WALK_STOP		1
+#define WALK_SKIP_SUBTREE	2
+
+typedef int (*walk_classify_fn) (int dirfd, const char *name,
+				 const struct stat64 *st);
+typedef int (*walk_fn) (const char *name, const struct stat64 *st,
+			int type, int class);
+
+int walk_tree (const char *dir, int flags, int nthreads,
+	       walk_classify_fn classify, walk_fn func);
+
+#endif /* WALK_H */
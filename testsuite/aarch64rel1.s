@@ -0,0 +1,11 @@
+/* Program for aarch64rel1.sh using aarch64rel1lib1.so, whose TLSDESC
+   relocation can't be expressed as a conflict.
+   crossobj.sh builds aarch64rel1.elf from it.  */
+	.text
+	.globl	_start
+_start:
+	bl	f
+	.globl	_init
+	.globl	_fini
+_init:
+_fini:	ret
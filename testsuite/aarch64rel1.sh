@@ -0,0 +1,55 @@
+#!/bin/bash
+. `dirname $0`/functions.sh
+# Prelink the checked-in AArch64 libraries built by crossobj.sh, relocate
+# the library with -r and check .got[0], .got.plt[1], the TLSDESC and
+# IRELATIVE entries, then undo it.  A program using the library must
+# be left alone, its TLSDESC relocation can't be expressed as a conflict.
+readelf -h $srcdir/aarch64rel1lib1.elf 2>&1 | grep -q AArch64 || exit 77
+rm -rf aarch64rel1.tree aarch64rel1.log
+mkdir aarch64rel1.tree
+T=aarch64rel1.tree
+cp $srcdir/aarch64rel1ld.elf $T/ld-linux-aarch64.so.1
+cp $srcdir/aarch64rel1libc.elf $T/libc.so.6
+cp $srcdir/aarch64rel1lib1.elf $T/aarch64rel1lib1.so
+cp -a $T/aarch64rel1lib1.so $T/aarch64rel1lib1.so.orig
+PRELINK="$PRELINK --ld-library-path=$T --dynamic-linker=$T/ld-linux-aarch64.so.1"
+# Check that the words prelink adjusts are consistent in $1.
+check() {
+  local dynamic plt pltgot tlsdesc irel
+  dynamic=`elfsecaddr $1 .dynamic`
+  plt=`elfsecaddr $1 .plt`
+  pltgot=`elfdyntag $1 PLTGOT`
+  tlsdesc=`elfreloc $1 R_AARCH64_TLSDESC`
+  irel=`elfreloc $1 R_AARCH64_IRELATIVE`
+  [ $((0x`elfword $1 $(elfsecaddr $1 .got)`)) = $(($dynamic)) ] || return 1
+  [ $((0x`elfword $1 $(($pltgot + 8))`)) = $(($plt)) ] || return 2
+  [ $((0x`elfword $1 ${tlsdesc% *}`)) = $((`elfdyntag $1 TLSDESC_PLT`)) ] || return 3
+  [ $((${irel#* })) -ge $((`elfsecaddr $1 .text`)) ] || return 4
+  [ $((${irel#* })) -lt $(($plt)) ] || return 5
+  echo `elfdyntag $1 TLSDESC_PLT` ${irel#* } `elfword $1 ${irel% *}`
+}
+echo $PRELINK -v $T/ld-linux-aarch64.so.1 $T/libc.so.6 $T/aarch64rel1lib1.so > aarch64rel1.log
+$PRELINK -v $T/ld-linux-aarch64.so.1 $T/libc.so.6 $T/aarch64rel1lib1.so >> aarch64rel1.log 2>&1 || exit 1
+grep -q ^`echo $PRELINK | sed 's/ .*$/: /'` aarch64rel1.log && exit 2
+readelf -d $T/aarch64rel1lib1.so 2>&1 | grep -q GNU_PRELINKED || exit 3
+$PRELINK -y $T/aarch64rel1lib1.so | cmp - $T/aarch64rel1lib1.so.orig >> aarch64rel1.log 2>&1 || exit 4
+V1=`check $T/aarch64rel1lib1.so` || exit 5
+B1=`readelf -lW $T/aarch64rel1lib1.so | sed -n 's/^ *LOAD *0x0* *\(0x[0-9a-f]*\) .*$/\1/p' | head -1`
+echo $PRELINK -r 0x4000000000 $T/aarch64rel1lib1.so >> aarch64rel1.log
+$PRELINK -r 0x4000000000 $T/aarch64rel1lib1.so >> aarch64rel1.log 2>&1 || exit 6
+V2=`check $T/aarch64rel1lib1.so` || exit 7
+# The TLSDESC trampoline, IRELATIVE addend and its .got.plt entry moved
+# along with the library.
+set -- $V1 $V2
+D=$((0x4000000000 - $B1))
+[ $(($4)) = $(($1 + $D)) -a $((0x$6)) = $((0x$3 + $D)) ] || exit 8
+[ $(($5)) = $(($2 + $D)) ] || exit 9
+$PRELINK -u $T/aarch64rel1lib1.so >> aarch64rel1.log 2>&1 || exit 10
+cmp $T/aarch64rel1lib1.so $T/aarch64rel1lib1.so.orig >> aarch64rel1.log 2>&1 || exit 11
+cp $srcdir/aarch64rel1.elf $T/aarch64rel1
+cp -a $T/aarch64rel1 $T/aarch64rel1.orig
+echo $PRELINK -v $T/aarch64rel1 >> aarch64rel1.log
+$PRELINK -v $T/aarch64rel1 >> aarch64rel1.log 2>&1
+grep -q "R_AARCH64_TLSDESC relocations can't be prelinked" aarch64rel1.log || exit 12
+cmp $T/aarch64rel1 $T/aarch64rel1.orig >> aarch64rel1.log 2>&1 || exit 13
+exit 0
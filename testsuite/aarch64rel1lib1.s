@@ -0,0 +1,47 @@
+/* Library for aarch64rel1.sh with a TLSDESC relocation resolved lazily
+   through DT_TLSDESC_PLT, an IRELATIVE relocation, a PLT call and
+   .got[0] holding _DYNAMIC, laid out the way GNU ld would.
+   crossobj.sh builds aarch64rel1lib1.elf from it.  */
+	.text
+	.globl	f
+	.type	f, %function
+f:
+	adrp	x0, :tlsdesc:tv
+	ldr	x1, [x0, :tlsdesc_lo12:tv]
+	add	x0, x0, :tlsdesc_lo12:tv
+	.tlsdesccall tv
+	blr	x1
+	bl	g
+	ret
+	.type	impl, %function
+impl:	ret
+	.type	ifn, %gnu_indirect_function
+ifn:
+	adr	x0, impl
+	ret
+	.globl	_init
+	.globl	_fini
+_init:
+_fini:	ret
+_tlsdesc_plt:
+	stp	x2, x3, [sp, #-16]!
+	adrp	x2, _DYNAMIC
+	adrp	x3, _tlsdesc_got
+	ldr	x2, [x2, #8]
+	add	x3, x3, :lo12:_tlsdesc_got
+	dmb	ishld
+	br	x2
+	.section .got, "aw", %progbits
+	.xword	_DYNAMIC
+_tlsdesc_got:
+	.xword	0
+	.section .tbss, "awT", %nobits
+	.globl	tv
+	.type	tv, %object
+tv:	.zero	8
+	.data
+	.globl	ptrs
+ptrs:	.xword	ptrs
+	.xword	ifn
+	.xword	f
+	.xword	ptrs + 8
@@ -0,0 +1,9 @@
+/* Stand-in libc.so.6 for aarch64rel1.sh.  */
+	.text
+	.globl	g
+	.type	g, %function
+g:	ret
+	.globl	_init
+	.globl	_fini
+_init:
+_fini:	ret
@@ -0,0 +1,23 @@
+/* Program for aarch64rel2.sh overriding dup and g, copying obj from
+   aarch64rel2lib1.so and accessing tv from libc.so.6 with an initial
+   exec TLS access.  crossobj.sh builds aarch64rel2.elf from it.  */
+	.text
+	.globl	_start
+_start:
+	adrp	x0, obj
+	add	x0, x0, :lo12:obj
+	adrp	x1, :gottprel:tv
+	ldr	x1, [x1, :gottprel_lo12:tv]
+	bl	f
+	.globl	g
+	.type	g, %function
+g:	ret
+	.globl	_init
+	.globl	_fini
+_init:
+_fini:	ret
+	.data
+	.globl	dup
+	.type	dup, %object
+	.size	dup, 8
+dup:	.xword	0
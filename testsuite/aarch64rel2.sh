@@ -0,0 +1,49 @@
+#!/bin/bash
+. `dirname $0`/functions.sh
+# Prelink the checked-in AArch64 program built by crossobj.sh, which
+# overrides symbols of its libraries and copies an object from one of
+# them, and check its .gnu.conflict section, the copied object and its
+# own TLS_TPREL64 and JUMP_SLOT entries, then undo it.
+readelf -h $srcdir/aarch64rel2.elf 2>&1 | grep -q AArch64 || exit 77
+rm -rf aarch64rel2.tree aarch64rel2.log
+mkdir aarch64rel2.tree
+T=aarch64rel2.tree
+cp $srcdir/aarch64rel2ld.elf $T/ld-linux-aarch64.so.1
+cp $srcdir/aarch64rel2libc.elf $T/libc.so.6
+cp $srcdir/aarch64rel2lib1.elf $T/aarch64rel2lib1.so
+cp $srcdir/aarch64rel2.elf $T/aarch64rel2
+cp -a $T/aarch64rel2 $T/aarch64rel2.orig
+PRELINK="$PRELINK --ld-library-path=$T --dynamic-linker=$T/ld-linux-aarch64.so.1"
+# Print the value of dynamic symbol $2 in $1.
+sym() {
+  readelf -W --dyn-syms $1 | sed -n "s/^ *[0-9]*: *\([0-9a-f]*\) .* [0-9]* $2$/0x\1/p"
+}
+echo $PRELINK -v $T/aarch64rel2 > aarch64rel2.log
+$PRELINK -v $T/aarch64rel2 >> aarch64rel2.log 2>&1 || exit 1
+grep -q ^`echo $PRELINK | sed 's/ .*$/: /'` aarch64rel2.log && exit 2
+readelf -d $T/aarch64rel2 2>&1 | grep -q GNU_CONFLICT || exit 3
+L=$T/aarch64rel2lib1.so
+DUP=`sym $T/aarch64rel2 dup`
+G=`sym $T/aarch64rel2 g`
+set -- `elfreloc $L R_AARCH64_GLOB_DAT` `elfreloc $L R_AARCH64_ABS64` \
+  `elfreloc $L R_AARCH64_TLS_TPREL64` `elfreloc $L R_AARCH64_JUMP_SLOT` \
+  `elfreloc $L R_AARCH64_IRELATIVE`
+# dup and g resolve to the program rather than libc.so.6, tv is at
+# offset 8 of the only TLS block, which follows the 16 byte TCB, and
+# the IRELATIVE relocation is always a conflict.
+printf "%x R_AARCH64_ABS64 %x\n" $1 $DUP $3 $DUP $5 0x18 > $T/expected
+printf "%x R_AARCH64_JUMP_SLOT %x\n" $7 $G >> $T/expected
+printf "%x R_AARCH64_IRELATIVE %x\n" $9 ${10} >> $T/expected
+readelf -rW $T/aarch64rel2 | sed -n '/.gnu.conflict/,/^$/s/^0*\([0-9a-f]*\) *[0-9a-f]* *\(R_[A-Z0-9_]*\) *\([0-9a-f]*\)$/\1 \2 \3/p' \
+  | sort | diff - <(sort $T/expected) >> aarch64rel2.log 2>&1 || exit 4
+# The copy of obj has the conflict for dup applied.
+OBJ=`sym $T/aarch64rel2 obj`
+[ $((0x`elfword $T/aarch64rel2 $OBJ`)) = $(($DUP)) ] || exit 5
+[ `elfword $T/aarch64rel2 $(($OBJ + 8))` = `elfword $L $((\`sym $L obj\` + 8))` ] || exit 6
+set -- `elfreloc $T/aarch64rel2 R_AARCH64_TLS_TPREL64` `elfreloc $T/aarch64rel2 R_AARCH64_JUMP_SLOT`
+[ $((0x`elfword $T/aarch64rel2 $1`)) = $((0x18)) ] || exit 7
+[ $((0x`elfword $T/aarch64rel2 $3`)) = $((`sym $L f`)) ] || exit 8
+$PRELINK -y $T/aarch64rel2 | cmp - $T/aarch64rel2.orig >> aarch64rel2.log 2>&1 || exit 9
+$PRELINK -u $T/aarch64rel2 >> aarch64rel2.log 2>&1 || exit 10
+cmp $T/aarch64rel2 $T/aarch64rel2.orig >> aarch64rel2.log 2>&1 || exit 11
+exit 0
@@ -0,0 +1,8 @@
+/* Stand-in ld-linux-aarch64.so.1 for aarch64rel2.sh.  */
+	.text
+	.globl	_dl_start
+_dl_start:
+	.globl	_init
+	.globl	_fini
+_init:
+_fini:	ret
@@ -0,0 +1,33 @@
+/* Library for aarch64rel2.sh whose GLOB_DAT, ABS64 and JUMP_SLOT
+   relocations against dup and g resolve to libc.so.6 when the library
+   is prelinked, but to the program when it is, plus an initial exec
+   TLS access to tv and an IRELATIVE relocation.  The program copies
+   obj with a COPY relocation.
+   crossobj.sh builds aarch64rel2lib1.elf from it.  */
+	.text
+	.globl	f
+	.type	f, %function
+f:
+	adrp	x0, :got:dup
+	ldr	x0, [x0, :got_lo12:dup]
+	adrp	x1, :gottprel:tv
+	ldr	x1, [x1, :gottprel_lo12:tv]
+	b	g
+	.type	impl, %function
+impl:	ret
+	.type	ifn, %gnu_indirect_function
+ifn:
+	adr	x0, impl
+	ret
+	.globl	_init
+	.globl	_fini
+_init:
+_fini:	ret
+	.section .got, "aw", %progbits
+	.xword	_DYNAMIC
+	.data
+	.globl	obj
+	.type	obj, %object
+	.size	obj, 16
+obj:	.xword	dup
+	.xword	ifn
@@ -0,0 +1,22 @@
+/* Stand-in libc.so.6 for aarch64rel2.sh, defining dup and g which the
+   program overrides, and tv at offset 8 of its TLS block.  */
+	.text
+	.globl	g
+	.type	g, %function
+g:	ret
+	.globl	_init
+	.globl	_fini
+_init:
+_fini:	ret
+	.data
+	.globl	dup
+	.type	dup, %object
+	.size	dup, 8
+dup:	.xword	0
+	.section .tbss, "awT", %nobits
+	.globl	tv0
+	.type	tv0, %object
+tv0:	.zero	8
+	.globl	tv
+	.type	tv, %object
+tv:	.zero	8
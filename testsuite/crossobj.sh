@@ -0,0 +1,122 @@
+#!/bin/bash
+# Rebuild the checked-in cross libraries $1ld.elf, $1libc.elf and
+# $1lib1.elf, and the program $1.elf linked against them if there is
+# $1.s, with $1.tree/$3 as its interpreter the way the tests invoke
+# prelink, from their assembly with llvm-mc for target triple $2
+# and ld.lld, $3 being the soname of the dynamic linker.
+# ld.lld leaves no spare .dynamic entries, may relocate .got[0] and doesn't
+# store addends of relative relocations, so the objects are touched
+# up afterwards to look like GNU ld output: DT_INIT, DT_FINI, DT_RUNPATH,
+# DT_FLAGS and DT_FLAGS_1, asked for only to reserve room, become spare
+# DT_NULL entries, .got[0] holding _DYNAMIC is written directly, and
+# _tlsdesc_plt and _tlsdesc_got give DT_TLSDESC_PLT and DT_TLSDESC_GOT.
+# Usage: crossobj.sh aarch64rel1 aarch64-linux-gnu ld-linux-aarch64.so.1
+LLVM_MC=${LLVM_MC:-llvm-mc}
+LD_LLD=${LD_LLD:-ld.lld}
+srcdir=`dirname $0`
+LDFLAGS="--hash-style=both -z now -rpath / -init _init -fini _fini"
+OBJS="ld libc lib1"
+[ -f $srcdir/$1.s ] && OBJS="$OBJS exe"
+for i in $OBJS; do
+  [ $i = exe ] && i=
+  $LLVM_MC -triple=$2 -filetype=obj -o $1$i.o $srcdir/$1$i.s || exit 1
+done
+$LD_LLD $LDFLAGS -shared -soname $3 -o $srcdir/$1ld.elf $1ld.o || exit 1
+$LD_LLD $LDFLAGS -shared -soname libc.so.6 -o $srcdir/$1libc.elf $1libc.o \
+  $srcdir/$1ld.elf || exit 1
+$LD_LLD $LDFLAGS -shared -soname $1lib1.so -o $srcdir/$1lib1.elf $1lib1.o \
+  $srcdir/$1libc.elf || exit 1
+# ld.lld packs the program's segments back to back in the file and puts
+# a .relro_padding NOBITS section in front of .data, neither leaving
+# prelink room to grow the read-only segment, so give each segment its
+# own (small) pages instead.  The dynamic linker's own symbols are
+# found through libc.so.6.
+if [ -f $srcdir/$1.s ]; then
+  $LD_LLD $LDFLAGS -z norelro -z separate-loadable-segments \
+    -z max-page-size=0x1000 --allow-shlib-undefined \
+    -dynamic-linker $1.tree/$3 -o $srcdir/$1.elf $1.o \
+    $srcdir/$1lib1.elf $srcdir/$1libc.elf || exit 1
+fi
+rm -f $1ld.o $1libc.o $1lib1.o $1.o
+for i in $OBJS; do
+  [ $i = exe ] && i=
+  python3 - $srcdir/$1$i.elf <<\EOP || exit 1
+import struct, sys
+
+DT_NULL, DT_INIT, DT_FINI, DT_RELA, DT_RELASZ = 0, 12, 13, 7, 8
+DT_RUNPATH, DT_FLAGS, DT_FLAGS_1, DT_RELACOUNT = 29, 30, 0x6ffffffb, 0x6ffffff9
+DT_TLSDESC_PLT, DT_TLSDESC_GOT = 0x6ffffef6, 0x6ffffef7
+SPARE = (DT_INIT, DT_FINI, DT_RUNPATH, DT_FLAGS, DT_FLAGS_1)
+RELATIVE = {183: 1027, 243: 3}
+
+f = sys.argv[1]
+b = bytearray(open(f, 'rb').read())
+machine, = struct.unpack_from('<H', b, 18)
+shoff, = struct.unpack_from('<Q', b, 40)
+shentsize, shnum, shstrndx = struct.unpack_from('<HHH', b, 58)
+shdrs = [list(struct.unpack_from('<IIQQQQIIQQ', b, shoff + i * shentsize))
+         for i in range(shnum)]
+stroff = shdrs[shstrndx][4]
+def name(s):
+  return bytes(b[stroff + s[0]:b.index(0, stroff + s[0])]).decode()
+sec = dict((name(s), i) for i, s in enumerate(shdrs))
+
+dyn = shdrs[sec['.dynamic']]
+ents = [struct.unpack_from('<qQ', b, dyn[4] + i * 16)
+        for i in range(dyn[5] // 16)]
+ents = [e for e in ents if e[0] not in SPARE and e[0] != DT_NULL]
+def getdyn(tag):
+  return [e[1] for e in ents if e[0] == tag][0]
+def setdyn(tag, val):
+  ents[[e[0] for e in ents].index(tag)] = (tag, val)
+
+symtab = shdrs[sec['.symtab']]
+symstr = shdrs[symtab[6]][4]
+syms = {}
+for i in range(symtab[5] // 24):
+  st_name, st_info, st_other, st_shndx, st_value, st_size \
+    = struct.unpack_from('<IBBHQQ', b, symtab[4] + i * 24)
+  syms[bytes(b[symstr + st_name:b.index(0, symstr + st_name)]).decode()] \
+    = st_value
+if '_tlsdesc_plt' in syms:
+  ents.append((DT_TLSDESC_PLT, syms['_tlsdesc_plt']))
+  ents.append((DT_TLSDESC_GOT, syms['_tlsdesc_got']))
+
+got = shdrs[sec['.got']] if '.got' in sec else None
+if got is not None and '.rela.dyn' in sec:
+  rela = shdrs[sec['.rela.dyn']]
+  relas = [struct.unpack_from('<QQq', b, rela[4] + i * 24)
+           for i in range(rela[5] // 24)]
+  r = [x for x in relas if x[0] == got[3]
+       and x[1] == RELATIVE[machine] and x[2] == dyn[3]]
+  if r:
+    relas.remove(r[0])
+    struct.pack_into('<Q', b, got[4], dyn[3])
+    struct.pack_into('<QQq', b, rela[4], 0, 0, 0)
+    rela[3] += 24
+    rela[4] += 24
+    rela[5] -= 24
+    for i, x in enumerate(relas):
+      struct.pack_into('<QQq', b, rela[4] + i * 24, *x)
+    setdyn(DT_RELA, rela[3])
+    setdyn(DT_RELASZ, rela[5])
+    setdyn(DT_RELACOUNT, getdyn(DT_RELACOUNT) - 1)
+    struct.pack_into('<IIQQQQIIQQ', b, shoff + sec['.rela.dyn'] * shentsize,
+                     *rela)
+
+for i in range(dyn[5] // 16):
+  struct.pack_into('<qQ', b, dyn[4] + i * 16,
+                   *(ents[i] if i < len(ents) else (DT_NULL, 0)))
+if '.rela.dyn' in sec:
+  rela = shdrs[sec['.rela.dyn']]
+  for i in range(rela[5] // 24):
+    r_offset, r_info, r_addend = struct.unpack_from('<QQq', b, rela[4] + i * 24)
+    if r_info == RELATIVE[machine]:
+      for s in shdrs:
+        if s[1] == 1 and s[3] <= r_offset < s[3] + s[5]:
+          struct.pack_into('<q', b, s[4] + r_offset - s[3], r_addend)
+
+open(f, 'wb').write(b)
+EOP
+done
+exit 0
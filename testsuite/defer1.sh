@@ -0,0 +1,39 @@
+#!/bin/bash
+. `dirname $0`/functions.sh
+# Relocate a library with -r --defer-debug, then bring the debugging
+# sections up to date with --apply-debug, verify and undo it.
+rm -f defer1lib1.so defer1lib1.so.* defer1.log
+$CC -shared -fpic -g -o defer1lib1.so $srcdir/defer1lib1.c
+cp -a defer1lib1.so defer1lib1.so.orig
+SECS=".debug_info .debug_line .debug_aranges .debug_ranges .debug_rnglists .debug_loclists"
+dumpdebug () {
+  for s in $SECS; do readelf -x $s $1 2>&1 | sed 1d; done
+}
+echo $PRELINK -v ./defer1lib1.so > defer1.log
+$PRELINK -v ./defer1lib1.so >> defer1.log 2>&1 || exit 1
+grep -q ^`echo $PRELINK | sed 's/ .*$/: /'` defer1.log && exit 2
+cp -a defer1lib1.so defer1lib1.so.prel
+cp -a defer1lib1.so defer1lib1.so.nodefer
+echo $PRELINK --defer-debug -r 0x40000000 ./defer1lib1.so >> defer1.log
+$PRELINK --defer-debug -r 0x40000000 ./defer1lib1.so >> defer1.log 2>&1 || exit 3
+readelf -SW defer1lib1.so | grep -q '\.gnu\.prelink_debug' || exit 4
+# The debugging sections must not have been touched.
+dumpdebug defer1lib1.so > defer1lib1.so.dbg1
+dumpdebug defer1lib1.so.prel > defer1lib1.so.dbg0
+cmp defer1lib1.so.dbg1 defer1lib1.so.dbg0 >> defer1.log 2>&1 || exit 5
+$PRELINK -y ./defer1lib1.so 2>> defer1.log \
+  | cmp - defer1lib1.so.orig >> defer1.log 2>&1 || exit 6
+$PRELINK -r 0x40000000 ./defer1lib1.so.nodefer >> defer1.log 2>&1 || exit 7
+echo $PRELINK --apply-debug ./defer1lib1.so >> defer1.log
+$PRELINK --apply-debug ./defer1lib1.so >> defer1.log 2>&1 || exit 8
+# Now they must be the same as if they were adjusted right away.
+dumpdebug defer1lib1.so > defer1lib1.so.dbg1
+dumpdebug defer1lib1.so.nodefer > defer1lib1.so.dbg2
+cmp defer1lib1.so.dbg1 defer1lib1.so.dbg2 >> defer1.log 2>&1 || exit 9
+cmp -s defer1lib1.so.dbg1 defer1lib1.so.dbg0 && exit 10
+$PRELINK -y ./defer1lib1.so 2>> defer1.log \
+  | cmp - defer1lib1.so.orig >> defer1.log 2>&1 || exit 11
+$PRELINK -u ./defer1lib1.so >> defer1.log 2>&1 || exit 12
+cmp defer1lib1.so defer1lib1.so.orig >> defer1.log 2>&1 || exit 13
+readelf -SW defer1lib1.so | grep -q '\.gnu\.prelink_debug' && exit 14
+exit 0
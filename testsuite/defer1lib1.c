@@ -0,0 +1,18 @@
+static int data[4] = { 1, 2, 3, 4 };
+int *ptr = &data[2];
+
+static int
+bar (int x)
+{
+  return data[x & 3] + x;
+}
+
+int
+foo (int x)
+{
+  int i, ret = 0;
+
+  for (i = 0; i < x; i++)
+    ret += bar (i);
+  return ret;
+}
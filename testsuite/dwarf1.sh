@@ -0,0 +1,44 @@
+#!/bin/bash
+. `dirname $0`/functions.sh
+# Relocate DWARF 5 libraries with -r and check their debug info against
+# the same libraries linked at the new address.
+rm -f dwarf1lib*.so dwarf1lib*.so.orig dwarf1lib*.o dwarf1lib*.dwo
+rm -f dwarf1.a dwarf1.b dwarf1.log
+BASE=0x5000000
+# Link $1 from objects compiled with $2, and $1r at $BASE.
+link() {
+  local f="-O2 -gdwarf-5 $2 -fpic -ffunction-sections"
+  $CC $f -c -o $1a.o $srcdir/dwarf1lib1.c || return
+  $CC $f -c -o $1b.o $srcdir/dwarf1lib2.c || return
+  $CC -shared -o $1.so $1a.o $1b.o || return
+  $CC -shared -Wl,-Ttext-segment=$BASE -o $1r.so $1a.o $1b.o
+}
+link dwarf1lib1 || exit 77
+link dwarf1lib2 -gsplit-dwarf || exit 77
+readelf -S dwarf1lib1.so | grep -q '\.debug_loclists' || exit 77
+readelf -S dwarf1lib1.so | grep -q '\.debug_rnglists' || exit 77
+readelf -S dwarf1lib2.so | grep -q '\.debug_addr' || exit 77
+LIBS="dwarf1lib1.so dwarf1lib2.so"
+savelibs
+echo $PRELINK -r $BASE $LIBS > dwarf1.log
+$PRELINK -r $BASE $LIBS >> dwarf1.log 2>&1 || exit 1
+grep -q ^`echo $PRELINK | sed 's/ .*$/: /'` dwarf1.log && exit 2
+for i in $LIBS; do
+  set -- `elfrange $i`
+  [ $(($1)) = $(($BASE)) ] || exit 3
+  for s in .debug_info .debug_addr .debug_line .debug_aranges \
+	   .debug_rnglists .debug_loclists; do
+    readelf -S ${i%.so}r.so | grep -q "$s " || continue
+    readelf -x $s $i > dwarf1.a 2>&1
+    readelf -x $s ${i%.so}r.so > dwarf1.b 2>&1
+    cmp dwarf1.a dwarf1.b >> dwarf1.log 2>&1 || exit 4
+  done
+done
+# And moving them back must restore them exactly.
+echo $PRELINK -r 0 $LIBS >> dwarf1.log
+$PRELINK -r 0 $LIBS >> dwarf1.log 2>&1 || exit 5
+for i in $LIBS; do
+  cmp $i $i.orig >> dwarf1.log 2>&1 || exit 6
+done
+rm -f dwarf1.a dwarf1.b dwarf1lib*.o dwarf1lib*.dwo
+exit 0
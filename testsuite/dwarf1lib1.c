@@ -0,0 +1,36 @@
+/* Enough code for gcc -O2 -gdwarf-5 to describe it with location and
+   range lists.  */
+
+extern int dwarf1_ext (int);
+int dwarf1_var = 8;
+
+static int __attribute__ ((noinline))
+dwarf1_helper (int x, int y)
+{
+  int i, s = 0;
+
+  for (i = 0; i < x; i++)
+    s += dwarf1_ext (i * y);
+  return s;
+}
+
+int
+dwarf1_f1 (int x)
+{
+  int a = x * 3, b = x - 1;
+
+  if (__builtin_expect (x > 100, 0))
+    return dwarf1_helper (a, b) + dwarf1_ext (a);
+  a = dwarf1_helper (b, a);
+  return a + dwarf1_var;
+}
+
+int
+dwarf1_f2 (int x)
+{
+  int r = dwarf1_f1 (x);
+
+  while (r > 10)
+    r = dwarf1_ext (r) - x;
+  return r;
+}
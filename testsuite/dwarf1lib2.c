@@ -0,0 +1,5 @@
+int
+dwarf1_ext (int x)
+{
+  return x / 2;
+}
@@ -0,0 +1,35 @@
+#!/bin/bash
+. `dirname $0`/functions.sh
+# Relocate DWARF 4 and DWARF 5 libraries with -r, adjusting their debug
+# info with one and with several threads, and check the results match.
+rm -f dwarf2lib*.so dwarf2lib*.so.orig dwarf2lib*.so.first dwarf2lib*.o
+rm -f dwarf2.log
+BASE=0x5000000
+# Link $1 from objects compiled with $2.
+link() {
+  local f="-O2 $2 -fpic -ffunction-sections"
+  $CC $f -c -o $1a.o $srcdir/dwarf1lib1.c || return
+  $CC $f -c -o $1b.o $srcdir/dwarf1lib2.c || return
+  $CC -shared -o $1.so $1a.o $1b.o
+}
+link dwarf2lib1 -gdwarf-4 || exit 77
+link dwarf2lib2 -gdwarf-5 || exit 77
+LIBS="dwarf2lib1.so dwarf2lib2.so"
+savelibs
+echo PRELINK_DWARF2_THREADS=1 $PRELINK -r $BASE $LIBS > dwarf2.log
+PRELINK_DWARF2_THREADS=1 $PRELINK -r $BASE $LIBS >> dwarf2.log 2>&1 || exit 1
+grep -q ^`echo $PRELINK | sed 's/ .*$/: /'` dwarf2.log && exit 2
+for i in $LIBS; do
+  set -- `elfrange $i`
+  [ $(($1)) = $(($BASE)) ] || exit 3
+  mv -f $i $i.first
+  cp -p $i.orig $i
+done
+echo PRELINK_DWARF2_THREADS=4 $PRELINK -r $BASE $LIBS >> dwarf2.log
+PRELINK_DWARF2_THREADS=4 $PRELINK -r $BASE $LIBS >> dwarf2.log 2>&1 || exit 4
+grep -q ^`echo $PRELINK | sed 's/ .*$/: /'` dwarf2.log && exit 5
+for i in $LIBS; do
+  cmp $i $i.first >> dwarf2.log 2>&1 || exit 6
+done
+rm -f dwarf2lib*.o
+exit 0
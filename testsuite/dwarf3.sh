@@ -0,0 +1,26 @@
+#!/bin/bash
+. `dirname $0`/functions.sh
+# Relocate a DWARF 5 library with -r and check that only the address
+# entries of .debug_addr move, not the one used by DW_OP_constx.
+rm -f dwarf3lib1.so dwarf3.log
+BASE=0x5000000
+$CC -shared -nostdlib -o dwarf3lib1.so $srcdir/dwarf3lib1.s || exit 77
+LIBS=dwarf3lib1.so
+# Print the .debug_addr entries of $1.
+addrs() {
+  set -- $1 `readelf -SW $1 | sed -n 's/^ *\[ *[0-9]*\] *\.debug_addr *[A-Z_]* *[0-9a-f]* \([0-9a-f]*\) \([0-9a-f]*\) .*$/0x\1 0x\2/p'`
+  od -A n -t x8 --endian=little -j $(($2 + 8)) -N $(($3 - 8)) $1
+}
+set -- `addrs dwarf3lib1.so`
+[ $# = 3 -a $2 = $3 ] || exit 77
+echo $PRELINK -r $BASE $LIBS > dwarf3.log
+$PRELINK -r $BASE $LIBS >> dwarf3.log 2>&1 || exit 1
+grep -q ^`echo $PRELINK | sed 's/ .*$/: /'` dwarf3.log && exit 2
+addrs dwarf3lib1.so >> dwarf3.log
+[ "`echo \`addrs dwarf3lib1.so\``" = \
+  "`printf '%016x %016x %016x' $((0x$1 + $BASE)) $((0x$2 + $BASE)) 0x$3`" ] \
+  || exit 3
+echo $PRELINK -r 0 $LIBS >> dwarf3.log
+$PRELINK -r 0 $LIBS >> dwarf3.log 2>&1 || exit 4
+[ "`echo \`addrs dwarf3lib1.so\``" = "$*" ] || exit 5
+exit 0
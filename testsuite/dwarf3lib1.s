@@ -0,0 +1,66 @@
+/* DWARF 5 library for dwarf3.sh.  Its .debug_addr has an entry for
+   DW_OP_constx which holds the same value as an address entry.  */
+	.text
+	.globl	dwarf3_func
+	.type	dwarf3_func, @function
+dwarf3_func:
+	ret
+.Lfunc_end:
+	.size	dwarf3_func, .Lfunc_end - dwarf3_func
+
+	.data
+	.globl	dwarf3_var
+	.type	dwarf3_var, @object
+dwarf3_var:
+	.quad	1
+	.size	dwarf3_var, 8
+
+	.section .debug_abbrev,"",@progbits
+.Labbrev:
+	.uleb128 1		/* Abbrev 1.  */
+	.uleb128 0x11		/* DW_TAG_compile_unit.  */
+	.byte	1		/* DW_CHILDREN_yes.  */
+	.uleb128 0x11, 0x1b	/* DW_AT_low_pc, DW_FORM_addrx.  */
+	.uleb128 0x12, 0x06	/* DW_AT_high_pc, DW_FORM_data4.  */
+	.uleb128 0x73, 0x17	/* DW_AT_addr_base, DW_FORM_sec_offset.  */
+	.uleb128 0, 0
+	.uleb128 2		/* Abbrev 2.  */
+	.uleb128 0x34		/* DW_TAG_variable.  */
+	.byte	0		/* DW_CHILDREN_no.  */
+	.uleb128 0x03, 0x08	/* DW_AT_name, DW_FORM_string.  */
+	.uleb128 0x02, 0x18	/* DW_AT_location, DW_FORM_exprloc.  */
+	.uleb128 0, 0
+	.uleb128 0
+
+	.section .debug_info,"",@progbits
+	.long	.Linfo_end - .Linfo_start
+.Linfo_start:
+	.short	5
+	.byte	1		/* DW_UT_compile.  */
+	.byte	8
+	.long	.Labbrev
+	.uleb128 1
+	.uleb128 0		/* DW_AT_low_pc: dwarf3_func.  */
+	.long	.Lfunc_end - dwarf3_func
+	.long	.Laddr_base
+	.uleb128 2
+	.string	"dwarf3_var"
+	.uleb128 2
+	.byte	0xa1, 1		/* DW_OP_addrx 1.  */
+	.uleb128 2
+	.string	"dwarf3_const"
+	.uleb128 3
+	.byte	0xa2, 2, 0x9b	/* DW_OP_constx 2, DW_OP_form_tls_address.  */
+	.byte	0
+.Linfo_end:
+
+	.section .debug_addr,"",@progbits
+	.long	.Laddr_end - .Laddr_start
+.Laddr_start:
+	.short	5
+	.byte	8, 0
+.Laddr_base:
+	.quad	dwarf3_func
+	.quad	dwarf3_var
+	.quad	dwarf3_var
+.Laddr_end:
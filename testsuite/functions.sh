@@ -21,3 +21,58 @@ comparelibs() {
     rm -f $i.new
   done
 }
+# Print the 64-bit little endian word at address $2 of $1.
+elfword() {
+  readelf -SW $1 | sed -n 's/^ *\[ *[0-9]*\] *[^ ]* *[A-Z_]* *\([0-9a-f]*\) \([0-9a-f]*\) \([0-9a-f]*\) .*$/\1 \2 \3/p' \
+  | while read addr off size; do
+    if [ $(( 0x$addr <= $2 && $2 < 0x$addr + 0x$size )) = 1 ]; then
+      od -A n -t x8 --endian=little -j $(( 0x$off + $2 - 0x$addr )) -N 8 $1 \
+      | sed 's/ //g'
+    fi
+  done
+}
+# Print the address of section $2 of $1.
+elfsecaddr() {
+  readelf -SW $1 | sed -n "s/^ *\[ *[0-9]*\] *$2 *[A-Z_]* *\([0-9a-f]*\) .*$/0x\1/p"
+}
+# Print the value of dynamic tag $2 of $1.
+elfdyntag() {
+  readelf -dW $1 | sed -n "s/^.*($2) *\(0x[0-9a-f]*\).*$/\1/p"
+}
+# Print the offset and addend of the first $2 relocation in $1.
+elfreloc() {
+  readelf -rW $1 | sed -n "s/^\([0-9a-f]*\) *[0-9a-f]* *$2 .* \([0-9a-f]*\)$/0x\1 0x\2/p" \
+  | head -1
+}
+# Print the start address and the end address minus the size of the
+# last loadable segment of $1, followed by that size.
+elfrange() {
+  readelf -lW $1 | awk '$1 == "LOAD" { if (!n++) s = $3; e = $3 " " $6 }
+			END { print s, e }'
+}
+# Print binary $1 and the objects it needs, as found in the current
+# directory.
+elfdeps() {
+  local objs= new=$1 i
+  while [ -n "$new" ]; do
+    set -- $new
+    new=
+    for i; do
+      case " $objs " in *" $i "*) continue ;; esac
+      objs="$objs $i"
+      new="$new `readelf -dW $i | sed -n 's/^.*Shared library: \[\(.*\)\]$/\1/p'`"
+    done
+  done
+  echo $objs
+}
+# Check that none of the objects binary $1 needs, as found in the
+# current directory, overlap each other or the binary.
+nooverlap() {
+  local i
+  for i in `elfdeps $1`; do
+    set -- `elfrange $i`
+    echo $(($1)) $(($2 + $3)) $i
+  done | sort -n | awk 'NR > 1 && $1 < e { print l " overlaps " $3; bad = 1 }
+			{ if ($2 > e) { e = $2; l = $3 } }
+			END { exit bad }'
+}
@@ -0,0 +1,62 @@
+#!/bin/bash
+. `dirname $0`/functions.sh
+# Gather binaries from a nested directory tree with symlinks to files,
+# to directories outside of the tree and back up the tree, with and
+# without -h, skipping blacklisted files and directories.
+rm -f prelink.cache
+rm -rf gather1.tree gather1ext.tree
+rm -f gather1 gather1.c gather1.conf gather1.list gather1.log
+PRELINK=`echo $PRELINK | sed 's, \./prelink\.conf, ./gather1.conf,'`
+T=gather1.tree
+(cat prelink.conf; echo '-b *.bak') > gather1.conf
+echo 'int main (void) { return 0; }' > gather1.c
+$CCLINK -o gather1 gather1.c
+mkdir -p $T/a/b/c/d/x/y/z $T/a/b/c/d/skip $T/wide gather1ext.tree
+cp -p gather1 $T/bin1
+cp -p gather1 $T/a/bin2
+cp -p gather1 $T/a/b/c/d/bin3
+cp -p gather1 $T/a/b/c/d/x/y/z/bin4
+cp -p gather1 gather1ext.tree/bin5
+cp -p gather1 $T/a/b/c/d/skip/bin6
+cp -p gather1 $T/a/b/bin7.bak
+for i in 0 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15; do
+  cp -p gather1 $T/wide/bin$i
+done
+cp -p gather1 $T/a/b/noexec
+chmod -x $T/a/b/noexec
+printf '#!/bin/sh\nexit 0\n' > $T/a/script
+chmod +x $T/a/script
+ln -s .. $T/a/b/loop
+ln -s ../.. $T/a/b/c/up
+ln -s ../../gather1ext.tree $T/a/out
+ln -s ../out $T/a/b/out2
+ln -s ../bin2 $T/a/b/bin2link
+D=`pwd -P`
+# Print the binaries in $T prelink -n -v $@ would prelink.
+gather() {
+  echo $PRELINK -n -v -b $T/a/b/c/d/skip "$@" $T >> gather1.log
+  $PRELINK -n -v -b $T/a/b/c/d/skip "$@" $T > gather1.list 2>&1 || return 1
+  cat gather1.list >> gather1.log
+  grep -q ^`echo $PRELINK | sed 's/ .*$/: /'` gather1.list && return 2
+  sed -n "s,^Would prelink $D/,,p" gather1.list | grep -v '^lib\|^ld' | LC_ALL=C sort
+}
+EXP="$T/a/b/c/d/bin3 $T/a/b/c/d/x/y/z/bin4 $T/a/bin2 $T/bin1"
+for i in 0 1 10 11 12 13 14 15 2 3 4 5 6 7 8 9; do
+  EXP="$EXP $T/wide/bin$i"
+done
+L=`gather` || exit 1
+[ "`echo $L`" = "$EXP" ] || exit 2
+L=`gather -h` || exit 3
+[ "`echo $L`" = "$EXP gather1ext.tree/bin5" ] || exit 4
+rm -f prelink.cache
+echo $PRELINK -v -h -b $T/a/b/c/d/skip $T >> gather1.log
+$PRELINK -v -h -b $T/a/b/c/d/skip $T >> gather1.log 2>&1 || exit 5
+for i in $EXP gather1ext.tree/bin5; do
+  readelf -WS $i 2>&1 | grep -q .gnu.liblist || exit 6
+done
+for i in $T/a/b/c/d/skip/bin6 $T/a/b/bin7.bak $T/a/b/noexec; do
+  cmp -s gather1 $i || exit 7
+done
+rm -rf gather1.tree gather1ext.tree
+rm -f gather1.list gather1.c gather1.conf
+exit 0
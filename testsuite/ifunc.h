@@ -51,6 +51,11 @@ asm (".text\n"						\
     "\t.align 4\n"					\
   "2:\t.long " fn "@GOTOFF\n"				\
   "3:\t.long _GLOBAL_OFFSET_TABLE_-1b\n"
+#elif defined __aarch64__
+# define IFUNC_ASM(fn) "\tadrp x0, " fn "\n"		\
+    "\tadd x0, x0, :lo12:" fn "\n\tret\n"
+#elif defined __riscv && __riscv_xlen == 64
+# define IFUNC_ASM(fn) "\tlla a0, " fn "\n\tret\n"
 #elif defined __arm__
 # ifdef __thumb__
 #  define PIPE_OFFSET "4"
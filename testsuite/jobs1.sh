@@ -0,0 +1,47 @@
+#!/bin/bash
+. `dirname $0`/functions.sh
+# Prelink a tree of several binaries with -j 1 and with -j 4 and check
+# that both give the same files.
+rm -f jobs1r1 jobs1r10 jobs1c jobs1*.so jobs1*.orig jobs1*.first jobs1.log
+rm -f prelink.cache
+$CC -shared -O2 -fpic -o jobs1r1lib1.so $srcdir/reloc1lib1.c
+$CC -shared -O2 -fpic -o jobs1r1lib2.so $srcdir/reloc1lib2.c jobs1r1lib1.so
+$CCLINK -o jobs1r1 $srcdir/reloc1.c -Wl,--rpath-link,. jobs1r1lib2.so \
+  -lc jobs1r1lib1.so
+$CC -shared -O2 -fpic -o jobs1r10lib1.so $srcdir/reloc10lib1.c
+for i in 2 3 4; do
+  $CC -shared -O2 -nostdlib -fpic -o jobs1r10lib$i.so \
+    $srcdir/reloc10lib$i.c jobs1r10lib1.so
+done
+$CC -shared -O2 -fpic -o jobs1r10lib5.so $srcdir/reloc10lib5.c \
+  -Wl,--rpath-link,. jobs1r10lib2.so jobs1r10lib3.so jobs1r10lib4.so
+$CCLINK -o jobs1r10 $srcdir/reloc10.c -Wl,--rpath-link,. jobs1r10lib5.so \
+  -lc jobs1r10lib{2,3,4}.so
+# A binary using libraries of both trees.
+$CCLINK -o jobs1c $srcdir/reloc1.c -Wl,--rpath-link,. jobs1r1lib2.so \
+  -lc jobs1r1lib1.so jobs1r10lib5.so
+BINS="jobs1r1 jobs1r10 jobs1c"
+LIBS="jobs1r1lib1.so jobs1r1lib2.so jobs1r10lib1.so jobs1r10lib2.so"
+LIBS="$LIBS jobs1r10lib3.so jobs1r10lib4.so jobs1r10lib5.so"
+savelibs
+export PRELINK_TIMESTAMP=1
+# The first run prelinks whatever else the tree needs, so that the
+# runs compared start from the same tree.
+for j in 1 1 4; do
+  rm -f prelink.cache
+  echo $PRELINK -j $j -v $BINS >> jobs1.log
+  $PRELINK -j $j -v $BINS >> jobs1.log 2>&1 || exit 1
+  grep -q ^`echo $PRELINK | sed 's/ .*$/: /'` jobs1.log && exit 2
+  for i in $BINS; do
+    readelf -d $i 2>&1 | grep -q GNU_CONFLICT || exit 3
+  done
+  for i in $LIBS $BINS; do
+    if [ $j = 1 ]; then
+      mv -f $i $i.first
+    else
+      cmp $i $i.first >> jobs1.log 2>&1 || exit 4
+    fi
+    cp -p $i.orig $i
+  done
+done
+exit 0
@@ -0,0 +1,93 @@
+#!/bin/bash
+. `dirname $0`/functions.sh
+# --incremental-layout must put a replaced library back at its old
+# slot even when a lower slot is free, move one which no longer fits
+# there, and with --layout-slack leave room for a library to grow.
+rm -f prelink.cache
+rm -f layout3 layout3lib*.so layout3lib*.so.orig layout3pad.c layout3.log
+# Print the base address of $1.
+base() {
+  readelf -Wl $1 | awk '/LOAD/ { print $3; exit }'
+}
+# Print the end address of $1.
+end() {
+  set -- `readelf -Wl $1 | awk '/LOAD/ { a = $3; s = $6 } END { print a, s }'`
+  printf "0x%x\n" $(($1 + $2))
+}
+# Print the lowest slot start above $2 assigned in log $1.
+next() {
+  sed -n 's/^[^ ]* *\([0-9a-f]*\)-[0-9a-f]*$/0x\1/p' $1 \
+  | while read b; do [ $(($b > $2)) = 1 ] && echo $b; done | sort | head -1
+}
+echo 'char layout3pad[PAD];' > layout3pad.c
+i=1
+BINS="layout3"
+LIBS=
+while [ $i -lt 6 ]; do
+  $CXX -shared -fpic -o layout3lib$i.so $srcdir/layoutlib.C
+  LIBS="$LIBS layout3lib$i.so"
+  i=`expr $i + 1`
+done
+$CXXLINK -o layout3 $srcdir/layout.C layout3lib*.so
+echo $PRELINK -v ./layout3 > layout3.log
+$PRELINK -v ./layout3 >> layout3.log 2>&1 || exit 1
+# Grow the lowest of the libraries so that it no longer fits into its
+# slot and replace the highest one with a copy which is not prelinked.
+set -- `for i in $LIBS; do echo $(base $i) $i; done | sort | sed -n '1p;$p'`
+LOBASE=$1 LO=$2 HIBASE=$3 HI=$4
+$CXX -shared -fpic -DPAD=0x1000000 -o $LO $srcdir/layoutlib.C layout3pad.c
+rm -f $HI
+$CXX -shared -fpic -o $HI $srcdir/layoutlib.C
+$CXXLINK -o layout3 $srcdir/layout.C layout3lib*.so
+# Without --incremental-layout the replaced library takes the slot
+# freed below it.
+echo $PRELINK -n -v ./layout3 >> layout3.log
+$PRELINK -n -v ./layout3 > layout3.n 2>&1 || exit 2
+cat layout3.n >> layout3.log
+grep -q "^\./$HI  *${LOBASE#0x}-" layout3.n || exit 3
+echo $PRELINK -v --incremental-layout ./layout3 >> layout3.log
+$PRELINK -v --incremental-layout ./layout3 > layout3.n 2>&1 || exit 4
+cat layout3.n >> layout3.log
+grep -q ^`echo $PRELINK | sed 's/ .*$/: /'` layout3.n && exit 5
+[ "`base $HI`" = "$HIBASE" ] || exit 6
+[ "`base $LO`" = "$LOBASE" ] && exit 7
+grep -q "^Moved \./$LO  *${LOBASE#0x} -> `base $LO | sed 's/^0x//'`$" layout3.n || exit 8
+[ `grep -c '^Moved ' layout3.n` = 1 ] || exit 9
+grep -q '^[0-9]* libraries kept their address, 1 moved, 0 new$' layout3.n || exit 10
+# Start over with a big library.  With --layout-slack a copy which grew
+# by less than the slack still fits in front of its neighbor.
+rm -f prelink.cache layout3lib*.so
+for i in $LIBS; do
+  $CXX -shared -fpic -o $i $srcdir/layoutlib.C
+done
+$CXX -shared -fpic -DPAD=0x300000 -o layout3lib3.so $srcdir/layoutlib.C layout3pad.c
+$CXXLINK -o layout3 $srcdir/layout.C layout3lib*.so
+savelibs
+echo $PRELINK -n -v ./layout3 >> layout3.log
+$PRELINK -n -v ./layout3 > layout3.n 2>&1 || exit 11
+cat layout3.n >> layout3.log
+BASE=`sed -n 's/^\.\/layout3lib3.so  *\([0-9a-f]*\)-.*$/0x\1/p' layout3.n`
+NEXT0=`next layout3.n $BASE`
+echo $PRELINK -v --layout-slack=50 ./layout3 >> layout3.log
+$PRELINK -v --layout-slack=50 ./layout3 > layout3.n 2>&1 || exit 12
+cat layout3.n >> layout3.log
+BASE=`base layout3lib3.so`
+NEXT=`next layout3.n $BASE`
+[ $(($NEXT > $NEXT0)) = 1 ] || exit 13
+$CXX -shared -fpic -DPAD=0x400000 -o layout3lib3.so $srcdir/layoutlib.C layout3pad.c
+cp -p layout3lib3.so layout3lib3.so.orig
+# Without the slack its neighbor would be in the way.
+[ $((`end layout3lib3.so` - `base layout3lib3.so` + $BASE > $NEXT0)) = 1 ] || exit 14
+echo $PRELINK -v --incremental-layout --layout-slack=50 ./layout3 >> layout3.log
+$PRELINK -v --incremental-layout --layout-slack=50 ./layout3 > layout3.n 2>&1 || exit 15
+cat layout3.n >> layout3.log
+grep -q ^`echo $PRELINK | sed 's/ .*$/: /'` layout3.n && exit 16
+[ "`base layout3lib3.so`" = "$BASE" ] || exit 17
+grep -q '^Moved ' layout3.n && exit 18
+grep -q '^[0-9]* libraries kept their address, 0 moved, 0 new$' layout3.n || exit 19
+rm -f layout3.n layout3pad.c
+LD_LIBRARY_PATH=. ./layout3 || exit 20
+readelf -a ./layout3 >> layout3.log 2>&1 || exit 21
+# So that it is not prelinked again
+chmod -x ./layout3
+comparelibs >> layout3.log 2>&1 || exit 22
@@ -0,0 +1,51 @@
+#!/bin/bash
+. `dirname $0`/functions.sh
+# Prelink with -m two binaries using disjoint sets of libraries and
+# a third one using a library from each set.  No binary may end up
+# with overlapping libraries, but libraries never used together
+# should share addresses.
+rm -f prelink.cache
+rm -f layout4a layout4b layout4c layout4lib*.so layout4.log
+BINS="layout4a layout4b layout4c"
+LIBS=
+for i in a1 a2 a3 a4 b1 b2 b3 b4; do
+  $CXX -shared -fpic -o layout4lib$i.so $srcdir/layoutlib.C
+  LIBS="$LIBS layout4lib$i.so"
+done
+$CXXLINK -o layout4a $srcdir/layout.C layout4liba*.so
+$CXXLINK -o layout4b $srcdir/layout.C layout4libb*.so
+$CXXLINK -o layout4c $srcdir/layout.C layout4liba1.so layout4libb1.so
+savelibs
+echo $PRELINK ${PRELINK_OPTS--v} -m ./layout4a ./layout4b ./layout4c > layout4.log
+$PRELINK ${PRELINK_OPTS--v} -m ./layout4a ./layout4b ./layout4c >> layout4.log 2>&1 || exit 1
+grep -q ^`echo $PRELINK | sed 's/ .*$/: /'` layout4.log && exit 2
+for i in $BINS; do
+  readelf -WS $i 2>&1 | grep -q .gnu.liblist || exit 3
+done
+for i in $LIBS; do
+  readelf -d $i 2>&1 | grep -q GNU_PRELINKED || exit 3
+done
+for i in $BINS; do
+  nooverlap $i >> layout4.log 2>&1 || exit 4
+done
+# Some library from the second set reuses the slot of one from the
+# first set.
+for i in layout4libb*.so; do
+  set -- `elfrange $i`
+  echo $(($1)) $(($2 + $3)) $i
+done > layout4.n
+for i in layout4liba*.so; do
+  set -- `elfrange $i`
+  echo $(($1)) $(($2 + $3)) $i
+done | while read s e i; do
+  awk -v s=$s -v e=$e '$1 < e && s < $2 { found = 1 } END { exit !found }' layout4.n \
+  && echo $i
+done | grep -q . || exit 5
+rm -f layout4.n
+for i in $BINS; do
+  LD_LIBRARY_PATH=. ./$i || exit 6
+  readelf -a ./$i >> layout4.log 2>&1 || exit 7
+done
+# So that it is not prelinked again
+chmod -x $BINS
+comparelibs >> layout4.log 2>&1 || exit 8
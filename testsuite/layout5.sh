@@ -0,0 +1,90 @@
+#!/bin/bash
+. `dirname $0`/functions.sh
+# Prelink one binary with --layout-page-size, then with and without -m
+# and another --layout-page-size the rest of the tree around the
+# libraries which are already prelinked.
+rm -f prelink.cache
+rm -f layout5a layout5b layout5c layout5lib*.so layout5.log
+BINS="layout5a layout5b layout5c"
+LIBS=
+for i in 1 2 3 4 5 6 7 8; do
+  $CXX -shared -fpic -o layout5lib$i.so $srcdir/layoutlib.C
+  LIBS="$LIBS layout5lib$i.so"
+done
+$CXXLINK -o layout5a $srcdir/layout.C layout5lib[1234].so
+$CXXLINK -o layout5b $srcdir/layout.C layout5lib[5678].so
+$CXXLINK -o layout5c $srcdir/layout.C layout5lib3.so layout5lib6.so
+savelibs
+echo $PRELINK -v --layout-page-size=0x1000000 ./layout5a > layout5.log
+$PRELINK -v --layout-page-size=0x1000000 ./layout5a >> layout5.log 2>&1 || exit 1
+OLD=
+for i in 1 2 3 4; do
+  set -- `elfrange layout5lib$i.so`
+  [ $(($1 & 0xffffff)) = 0 ] || exit 2
+  OLD="$OLD $1"
+done
+echo $PRELINK -v -m --layout-page-size=0x400000 $BINS >> layout5.log
+$PRELINK -v -m --layout-page-size=0x400000 ./layout5a ./layout5b ./layout5c >> layout5.log 2>&1 || exit 3
+grep -q ^`echo $PRELINK | sed 's/ .*$/: /'` layout5.log && exit 4
+for i in $BINS; do
+  readelf -WS $i 2>&1 | grep -q .gnu.liblist || exit 5
+  nooverlap $i >> layout5.log 2>&1 || exit 6
+done
+# The libraries prelinked before stay where they were, the others
+# are aligned to the new page size and fill the gaps below the highest
+# old one instead of being appended after it.
+NEW=
+for i in $LIBS; do
+  set -- `elfrange $i`
+  NEW="$NEW $1"
+  readelf -d $i 2>&1 | grep -q GNU_PRELINKED || exit 7
+  [ $(($1 & 0x3fffff)) = 0 ] || exit 8
+done
+set -- $NEW
+[ "$1 $2 $3 $4" = "`echo $OLD`" ] || exit 9
+shift 4
+HI=`echo $OLD | tr ' ' '\n' | sort | tail -1`
+for i; do
+  [ $(($i < $HI)) = 1 ] || exit 10
+done
+for i in $BINS; do
+  LD_LIBRARY_PATH=. ./$i || exit 11
+  readelf -a ./$i >> layout5.log 2>&1 || exit 12
+done
+# So that it is not prelinked again
+chmod -x $BINS
+comparelibs >> layout5.log 2>&1 || exit 13
+# Without -m the libraries not prelinked before go to the lowest free
+# slots of the new page size.
+for i in $LIBS $BINS; do cp -p $i.orig $i; done
+rm -f prelink.cache
+echo $PRELINK -v --layout-page-size=0x1000000 ./layout5a >> layout5.log
+$PRELINK -v --layout-page-size=0x1000000 ./layout5a >> layout5.log 2>&1 || exit 14
+echo $PRELINK -v --layout-page-size=0x400000 $BINS >> layout5.log
+$PRELINK -v --layout-page-size=0x400000 ./layout5a ./layout5b ./layout5c >> layout5.log 2>&1 || exit 15
+grep -q ^`echo $PRELINK | sed 's/ .*$/: /'` layout5.log && exit 16
+KEEP=`for i in $BINS; do elfdeps $i; done | tr ' ' '\n' | sort -u \
+      | grep -v '^layout5\([abc]\|lib[5678]\.so\)$'`
+RANGES=`for i in $KEEP; do
+	  set -- \`elfrange $i\`
+	  echo $(($1)) $(($2 + $3))
+	done | sort -n`
+SLOT=`echo "$RANGES" | head -1 | cut -d' ' -f1`
+EXP=
+for i in 5 6 7 8; do
+  set -- `elfrange layout5lib$i.so`
+  [ $(($2 + $3 - $1 <= 0x400000)) = 1 ] || exit 77
+  while echo "$RANGES" \
+	| awk -v s=$SLOT '$1 < s + 4194304 && s < $2 { f = 1 } END { exit !f }'; do
+    SLOT=$(($SLOT + 0x400000))
+  done
+  EXP="$EXP $SLOT"
+  SLOT=$(($SLOT + 0x400000))
+done
+NEW=`for i in 5 6 7 8; do set -- \`elfrange layout5lib$i.so\`; echo $(($1)); done | sort -n`
+echo $NEW vs $EXP >> layout5.log
+[ "`echo $NEW`" = "`echo $EXP`" ] || exit 17
+for i in 1 2 3 4; do
+  set -- `elfrange layout5lib$i.so`
+  case " $OLD " in *" $1 "*) ;; *) exit 18 ;; esac
+done
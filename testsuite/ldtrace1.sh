@@ -0,0 +1,25 @@
+#!/bin/bash
+. `dirname $0`/functions.sh
+# Feed the checked-in binary trace ldtrace1.trace through --ld-trace.
+rm -f ldtrace1lib1.so ldtrace1lib1.so.orig ldtrace1*.rtld ldtrace1.log
+$CC -static -DTRACE="\"$srcdir/ldtrace1.trace\"" -DLIMIT=65536 \
+  -o ldtrace1.rtld $srcdir/ldtrace1rtld.c || exit 77
+$CC -static -DTRACE="\"$srcdir/ldtrace1.trace\"" -DLIMIT=200 \
+  -o ldtrace1t.rtld $srcdir/ldtrace1rtld.c || exit 77
+$CC -shared -fpic -nostdlib -o ldtrace1lib1.so $srcdir/ldtrace1lib1.c
+cp -a ldtrace1lib1.so ldtrace1lib1.so.orig
+PRELINK="$PRELINK --ld-trace"
+echo $PRELINK --dynamic-linker=./ldtrace1.rtld -v ./ldtrace1lib1.so > ldtrace1.log
+$PRELINK --dynamic-linker=./ldtrace1.rtld -v ./ldtrace1lib1.so >> ldtrace1.log 2>&1 || exit 1
+grep -q ^`echo $PRELINK | sed 's/ .*$/: /'` ldtrace1.log && exit 2
+readelf -d ldtrace1lib1.so 2>&1 | grep -q GNU_PRELINKED || exit 3
+$PRELINK --dynamic-linker=./ldtrace1.rtld -y ./ldtrace1lib1.so \
+  | cmp - ldtrace1lib1.so.orig >> ldtrace1.log 2>&1 || exit 4
+$PRELINK -u ./ldtrace1lib1.so >> ldtrace1.log 2>&1 || exit 5
+cmp ldtrace1lib1.so ldtrace1lib1.so.orig >> ldtrace1.log 2>&1 || exit 6
+# A trace cut short must make prelink fail and leave the library alone.
+echo $PRELINK --dynamic-linker=./ldtrace1t.rtld -v ./ldtrace1lib1.so >> ldtrace1.log
+$PRELINK --dynamic-linker=./ldtrace1t.rtld -v ./ldtrace1lib1.so >> ldtrace1.log 2>&1 && exit 7
+grep -q 'Binary trace truncated' ldtrace1.log || exit 8
+cmp ldtrace1lib1.so ldtrace1lib1.so.orig >> ldtrace1.log 2>&1 || exit 9
+exit 0
@@ -0,0 +1,2 @@
+static int foo = 1;
+int *bar = &foo;
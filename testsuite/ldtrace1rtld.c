@@ -0,0 +1,32 @@
+#include <stdio.h>
+#include <string.h>
+
+/* Stand-in dynamic linker for ldtrace1.sh.  Write TRACE to stdout with
+   the last argument, the file being traced, stored into the
+   placeholder at the start of the string table, and cut the output
+   after LIMIT bytes.  It has to be linked statically, so that the
+   LD_TRACE_LOADED_OBJECTS prelink sets is not seen by ld.so.  */
+
+#define STRTAB_OFF 80
+#define PLACEHOLDER_LEN 256
+
+int
+main (int argc, char **argv)
+{
+  static char buf[65536];
+  FILE *f = fopen (TRACE, "r");
+  size_t len, n;
+
+  if (f == NULL)
+    return 1;
+  len = fread (buf, 1, sizeof buf, f);
+  fclose (f);
+  n = strlen (argv[argc - 1]);
+  if (len < STRTAB_OFF + PLACEHOLDER_LEN || n >= PLACEHOLDER_LEN)
+    return 1;
+  memcpy (buf + STRTAB_OFF, argv[argc - 1], n + 1);
+  if (len > LIMIT)
+    len = LIMIT;
+  fwrite (buf, 1, len, stdout);
+  return 0;
+}
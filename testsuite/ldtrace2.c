@@ -0,0 +1,3 @@
+extern int baz (void);
+int dup (void) { return 2; }
+void _start (void) { baz (); for (;;); }
@@ -0,0 +1,65 @@
+#!/bin/bash
+. `dirname $0`/functions.sh
+# Prelink a program with a conflict from a text trace and from the
+# same trace in the binary format, and check both give what prelink's
+# own resolver gives.
+rm -f ldtrace2 ldtrace2lib1.so ldtrace2*.orig ldtrace2*.resolve
+rm -f ldtrace2*.trace ldtrace2*.rtld ldtrace2.log prelink.cache
+$CC -static -I$srcdir/../src -o ldtrace2b.rtld $srcdir/ldtrace2rtld.c || exit 77
+$CC -static -I$srcdir/../src -DTEXT -o ldtrace2t.rtld $srcdir/ldtrace2rtld.c \
+  || exit 77
+$CC -shared -fpic -nostdlib -Wl,-soname,ldtrace2lib1.so \
+  -o ldtrace2lib1.so $srcdir/ldtrace2lib1.c
+# prelink insists on the program's PT_INTERP, so the real dynamic
+# linker and the stand-ins take turns as ldtrace2.rtld.
+$CC -Wl,--dynamic-linker=./ldtrace2.rtld -nostdlib \
+  -o ldtrace2 $srcdir/ldtrace2.c ldtrace2lib1.so
+cp -p `echo ./ld*.so.*[0-9]` ldtrace2.rtld
+PRELINK="$PRELINK --dynamic-linker=./ldtrace2.rtld"
+BINS="ldtrace2"
+LIBS="ldtrace2lib1.so"
+savelibs
+export PRELINK_TIMESTAMP=1
+echo $PRELINK -v ./ldtrace2 > ldtrace2.log
+$PRELINK -v ./ldtrace2 >> ldtrace2.log 2>&1 || exit 1
+grep -q ^`echo $PRELINK | sed 's/ .*$/: /'` ldtrace2.log && exit 2
+readelf -d ldtrace2 2>&1 | grep -q GNU_CONFLICT || exit 3
+for i in $LIBS $BINS; do mv -f $i $i.resolve; cp -p $i.orig $i; done
+# Print the offset of the first .dynsym entry for $2 in $1 from the
+# start of $1 and the value of the definition, as ld.so prints them.
+sym() {
+  readelf -W --dyn-syms $1 | awk -v n=$2 '$8 == n { print $1 + 0, $2, $7 }' \
+  | while read idx val ndx; do
+    [ -z "$off" ] && off=1 && printf '0x%x' $((`elfsecaddr $1 .dynsym` \
+      - `elfrange $1 | cut -d' ' -f1` + idx * 24))
+    [ $ndx != UND ] && printf ' 0x%x' 0x$val
+  done
+  echo
+}
+B=`elfrange ldtrace2lib1.so.resolve | cut -d' ' -f1`
+E=`elfrange ldtrace2 | cut -d' ' -f1`
+S=0x7f0000000000
+{ printf '\t@ => @ (%s, %s)\n' $S $S
+  set -- `sym ldtrace2lib1.so dup`
+  echo lookup $S $1 -\> $S $2 /1 dup
+} > ldtrace2lib1.so.trace
+{ printf '\t@ => @ (%s, 0x0)\n' $E
+  printf '\tldtrace2lib1.so => ./ldtrace2lib1.so (%s, 0x0)\n' $B
+  set -- `sym ldtrace2 baz` `sym ldtrace2lib1.so.resolve baz`
+  echo lookup $E $1 -\> $B $3 /1 baz
+  set -- `sym ldtrace2lib1.so.resolve dup` `sym ldtrace2 dup`
+  echo conflict $B $1 -\> $E $4 x $B $2 /1 dup
+} > ldtrace2.trace
+cat ldtrace2*.trace >> ldtrace2.log
+for rtld in ldtrace2t ldtrace2b; do
+  rm -f prelink.cache
+  cp -p $rtld.rtld ldtrace2.rtld
+  echo $PRELINK --ld-trace -v ./ldtrace2 >> ldtrace2.log
+  $PRELINK --ld-trace -v ./ldtrace2 >> ldtrace2.log 2>&1 || exit 4
+  grep -q ^`echo $PRELINK | sed 's/ .*$/: /'` ldtrace2.log && exit 5
+  for i in $LIBS $BINS; do
+    cmp $i $i.resolve >> ldtrace2.log 2>&1 || exit 6
+    cp -p $i.orig $i
+  done
+done
+exit 0
@@ -0,0 +1,2 @@
+int dup (void) { return 1; }
+int baz (void) { return dup () + 1; }
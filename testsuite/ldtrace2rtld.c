@@ -0,0 +1,129 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ldtrace.h"
+
+/* Stand-in dynamic linker for ldtrace2.sh.  Read the text
+   LD_TRACE_PRELINKING output from the file named by the last
+   argument, the file being traced, with ".trace" appended, and
+   replace each @ in it with that argument.  If prelink asked for
+   the binary format and TEXT is not defined, convert the dependency,
+   lookup and conflict lines to ldtrace.h records, otherwise print
+   them unchanged.  Like ld.so, print lookups and conflicts only if
+   LD_TRACE_PRELINKING names the traced object rather than being 1.
+   They must use the /class form.  */
+
+static uint32_t strtab_size;
+
+static void
+put_record (struct ldtrace_record *rec)
+{
+  fwrite (rec, sizeof (*rec), 1, stdout);
+}
+
+static uint32_t
+put_string (const char *s)
+{
+  struct ldtrace_record rec;
+  uint32_t off = strtab_size;
+
+  memset (&rec, 0, sizeof (rec));
+  rec.r_type = LDTRACE_STRTAB;
+  rec.r_name = strlen (s) + 1;
+  put_record (&rec);
+  fwrite (s, rec.r_name, 1, stdout);
+  strtab_size += rec.r_name;
+  return off;
+}
+
+int
+main (int argc, char **argv)
+{
+  char name[4096], line[4096], out[8192], soname[4096], filename[4096];
+  const char *fmt = getenv ("LD_TRACE_PRELINKING_FORMAT");
+  const char *obj = getenv ("LD_TRACE_PRELINKING");
+  int lookups = obj != NULL && strcmp (obj, "1") != 0;
+#ifdef TEXT
+  int binary = 0;
+#else
+  int binary = fmt != NULL && strcmp (fmt, "binary") == 0;
+#endif
+  struct ldtrace_header h;
+  struct ldtrace_record rec;
+  unsigned long long a[6];
+  unsigned int cls;
+  FILE *f;
+
+  snprintf (name, sizeof name, "%s.trace", argv[argc - 1]);
+  f = fopen (name, "r");
+  if (f == NULL)
+    return 1;
+
+  if (binary)
+    {
+      memset (&h, 0, sizeof (h));
+      memcpy (h.h_magic, LDTRACE_MAGIC, LDTRACE_MAGIC_LEN);
+      h.h_data = *(unsigned char *) &(uint16_t) { 1 } ? 1 : 2;
+      h.h_version = LDTRACE_VERSION;
+      h.h_recsize = sizeof (rec);
+      fwrite (&h, sizeof (h), 1, stdout);
+    }
+
+  while (fgets (line, sizeof line, f) != NULL)
+    {
+      char *p, *q = out;
+
+      for (p = line; *p; ++p)
+	if (*p == '@')
+	  q = stpcpy (q, argv[argc - 1]);
+	else
+	  *q++ = *p;
+      *q = '\0';
+
+      if (out[0] != '\t' && ! lookups)
+	continue;
+      if (! binary)
+	{
+	  fputs (out, stdout);
+	  continue;
+	}
+
+      memset (&rec, 0, sizeof (rec));
+      memset (a, 0, sizeof (a));
+      if (sscanf (out, "\t%4095s => %4095s (0x%llx, 0x%llx) TLS(0x%llx, 0x%llx)",
+		  soname, filename, &a[0], &a[1], &a[2], &a[3]) >= 4)
+	{
+	  rec.r_type = LDTRACE_DEP;
+	  rec.r_name = put_string (soname);
+	  rec.r_name2 = put_string (filename);
+	}
+      else if (sscanf (out, "lookup 0x%llx 0x%llx -> 0x%llx 0x%llx /%x %4095s",
+		       &a[0], &a[1], &a[2], &a[3], &cls, soname) == 6)
+	rec.r_type = LDTRACE_LOOKUP;
+      else if (sscanf (out, "conflict 0x%llx 0x%llx -> 0x%llx 0x%llx x 0x%llx 0x%llx /%x %4095s",
+		       &a[0], &a[1], &a[2], &a[3], &a[4], &a[5], &cls,
+		       soname) == 8)
+	rec.r_type = LDTRACE_CONFLICT;
+      else
+	return 1;
+
+      if (rec.r_type != LDTRACE_DEP)
+	{
+	  rec.r_flags = LDTRACE_F_TYPE_CLASS;
+	  rec.r_class = cls;
+	  rec.r_name = put_string (soname);
+	}
+      memcpy (rec.r_addr, a, sizeof (a));
+      put_record (&rec);
+    }
+  fclose (f);
+
+  if (binary)
+    {
+      memset (&rec, 0, sizeof (rec));
+      rec.r_type = LDTRACE_END;
+      put_record (&rec);
+    }
+  return 0;
+}
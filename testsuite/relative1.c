@@ -0,0 +1,184 @@
+#define RELATIVE_KERNELS_ONLY 1
+#include "relative.c"
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Check the vector kernels in relative.c against the scalar ones on
+   random words and addends clustered around START, with and without
+   the top bit set, and at all lengths up to a few vectors.  */
+
+#define MAXN 67
+
+static uint64_t rnd_state = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t
+rnd (void)
+{
+  rnd_state ^= rnd_state << 13;
+  rnd_state ^= rnd_state >> 7;
+  rnd_state ^= rnd_state << 17;
+  return rnd_state;
+}
+
+/* Return a random value near START, or a random one.  */
+static uint64_t
+near (uint64_t start)
+{
+  switch (rnd () % 6)
+    {
+    case 0: return start;
+    case 1: return start - 1 - rnd () % 4;
+    case 2: return start + 1 + rnd () % 4;
+    case 3: return start ^ 0x8000000000000000ULL;
+    case 4: return start ^ (1ULL << (rnd () % 64));
+    default: return rnd ();
+    }
+}
+
+static uint64_t
+random_start (void)
+{
+  switch (rnd () % 4)
+    {
+    case 0: return rnd () | 0x8000000000000000ULL;
+    case 1: return rnd () & 0x7fffffffffffffffULL;
+    case 2: return (rnd () & 0xffffffff) | 0x80000000;
+    default: return rnd () & 0xffffffff;
+    }
+}
+
+static int failures;
+
+static void
+fail (const char *kernel, size_t n)
+{
+  if (failures++ < 10)
+    printf ("%s differs from scalar kernel with n = %d\n", kernel, (int) n);
+}
+
+static void
+check32 (size_t n)
+{
+  uint32_t ref[MAXN], w[MAXN], start = random_start (), adjust = rnd ();
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    ref[i] = near (start);
+  memcpy (w, ref, n * sizeof (w[0]));
+  adjust_words32_scalar ((unsigned char *) ref, n, start, adjust);
+#ifdef HAVE_SSE2_KERNELS
+  {
+    uint32_t v[MAXN];
+
+    memcpy (v, w, n * sizeof (v[0]));
+    adjust_words32_sse2 ((unsigned char *) v, n, start, adjust);
+    if (memcmp (v, ref, n * 4))
+      fail ("adjust_words32_sse2", n);
+  }
+#endif
+#ifdef HAVE_AVX2_KERNELS
+  if (have_avx2 ())
+    {
+      uint32_t v[MAXN];
+
+      memcpy (v, w, n * sizeof (v[0]));
+      adjust_words32_avx2 ((unsigned char *) v, n, start, adjust);
+      if (memcmp (v, ref, n * 4))
+	fail ("adjust_words32_avx2", n);
+    }
+#endif
+}
+
+static void
+check64 (size_t n)
+{
+  uint64_t ref[MAXN], w[MAXN], start = random_start (), adjust = rnd ();
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    ref[i] = near (start);
+  memcpy (w, ref, n * sizeof (w[0]));
+  adjust_words64_scalar ((unsigned char *) ref, n, start, adjust);
+#ifdef HAVE_SSE2_KERNELS
+  {
+    uint64_t v[MAXN];
+
+    memcpy (v, w, n * sizeof (v[0]));
+    adjust_words64_sse2 ((unsigned char *) v, n, start, adjust);
+    if (memcmp (v, ref, n * 8))
+      fail ("adjust_words64_sse2", n);
+  }
+#endif
+#ifdef HAVE_AVX2_KERNELS
+  if (have_avx2 ())
+    {
+      uint64_t v[MAXN];
+
+      memcpy (v, w, n * sizeof (v[0]));
+      adjust_words64_avx2 ((unsigned char *) v, n, start, adjust);
+      if (memcmp (v, ref, n * 8))
+	fail ("adjust_words64_avx2", n);
+    }
+#endif
+}
+
+static void
+check_relative64 (size_t n)
+{
+  uint64_t ref[MAXN], w[MAXN], start = random_start (), adjust = rnd ();
+  GElf_Sxword refa[MAXN], a[MAXN];
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    {
+      refa[i] = near (start);
+      /* Mostly words prelinked to the addend.  */
+      ref[i] = (rnd () % 4) ? (uint64_t) refa[i] : near (refa[i]);
+    }
+  memcpy (w, ref, n * sizeof (w[0]));
+  memcpy (a, refa, n * sizeof (a[0]));
+  adjust_relative64_scalar ((unsigned char *) ref, refa, n, start, adjust);
+#ifdef HAVE_SSE2_KERNELS
+  {
+    uint64_t v[MAXN];
+    GElf_Sxword va[MAXN];
+
+    memcpy (v, w, n * sizeof (v[0]));
+    memcpy (va, a, n * sizeof (va[0]));
+    adjust_relative64_sse2 ((unsigned char *) v, va, n, start, adjust);
+    if (memcmp (v, ref, n * 8) || memcmp (va, refa, n * 8))
+      fail ("adjust_relative64_sse2", n);
+  }
+#endif
+#ifdef HAVE_AVX2_KERNELS
+  if (have_avx2 ())
+    {
+      uint64_t v[MAXN];
+      GElf_Sxword va[MAXN];
+
+      memcpy (v, w, n * sizeof (v[0]));
+      memcpy (va, a, n * sizeof (va[0]));
+      adjust_relative64_avx2 ((unsigned char *) v, va, n, start, adjust);
+      if (memcmp (v, ref, n * 8) || memcmp (va, refa, n * 8))
+	fail ("adjust_relative64_avx2", n);
+    }
+#endif
+}
+
+int
+main (void)
+{
+  int iter;
+  size_t n;
+
+  for (iter = 0; iter < 2000; iter++)
+    for (n = 0; n <= MAXN; n++)
+      {
+	check32 (n);
+	check64 (n);
+	check_relative64 (n);
+      }
+  if (failures)
+    printf ("%d failures\n", failures);
+  return failures != 0;
+}
@@ -0,0 +1,7 @@
+#!/bin/bash
+. `dirname $0`/functions.sh
+# Compare the relative relocation kernels of prelink with each other.
+rm -f relative1 relative1.log
+$CC -O2 -D_GNU_SOURCE -I.. -I$srcdir/../src -I$srcdir/../gelf -I$srcdir/../gelfx \
+  -o relative1 $srcdir/relative1.c > relative1.log 2>&1 || exit 1
+./relative1 >> relative1.log 2>&1 || exit 2
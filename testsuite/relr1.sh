@@ -0,0 +1,73 @@
+#!/bin/bash
+. `dirname $0`/functions.sh
+# Prelink, relocate, verify and undo a library with packed relative
+# relocations, checking that DT_RELR, the addresses .relr.dyn decodes to
+# and the words at them all move with the library.
+rm -f relr1lib1.so relr1lib1.so.* relr1.log
+$CC -shared -fpic -Wl,-z,pack-relative-relocs -o relr1lib1.so \
+  $srcdir/relr1lib1.c > /dev/null 2>&1 || exit 77
+readelf -SW relr1lib1.so | grep -q ' RELR ' || exit 77
+cp -a relr1lib1.so relr1lib1.so.orig
+cp -a relr1lib1.so relr1lib1.so.r
+# Print the addresses the .relr.dyn section of $1 relocates.
+relraddrs() {
+  local addr=0 w i
+  set -- $1 `readelf -SW $1 | sed -n 's/^ *\[ *[0-9]*\] *\.relr\.dyn *[A-Z_]* *[0-9a-f]* \([0-9a-f]*\) \([0-9a-f]*\) .*$/\1 \2/p'`
+  for w in `od -A n -t x8 --endian=little -j $((0x$2)) -N $((0x$3)) $1`; do
+    w=$((0x$w))
+    if [ $(($w & 1)) = 0 ]; then
+      echo $w
+      addr=$(($w + 8))
+    else
+      for ((i = 1; i < 64; i++)); do
+	[ $((($w >> $i) & 1)) = 1 ] && echo $(($addr + ($i - 1) * 8))
+      done
+      addr=$(($addr + 63 * 8))
+    fi
+  done
+}
+# Print the words at the addresses read from stdin in $1.
+words() {
+  local secs=`readelf -SW $1 | grep -v NOBITS | sed -n 's/^ *\[ *[0-9]*\] *[^ ]* *[A-Z_]* *\([0-9a-f]*\) \([0-9a-f]*\) \([0-9a-f]*\) .*$/\1 \2 \3/p'`
+  local a addr off size
+  while read a; do
+    echo "$secs" | while read addr off size; do
+      [ $(($a >= 0x$addr && $a < 0x$addr + 0x$size)) = 1 ] || continue
+      echo $((0x`od -A n -t x8 --endian=little -j $((0x$off + $a - 0x$addr)) -N 8 $1 | sed 's/ //g'`))
+    done
+  done
+}
+# Check that $2 is $1 moved by $3: DT_RELR, the addresses
+# .relr.dyn decodes to and the words at them.
+relrmoved() {
+  [ $((`elfdyntag $2 RELR`)) = $((`elfdyntag $1 RELR` + $3)) ] || return 1
+  relraddrs $1 | while read a; do echo $(($a + $3)); done > $2.a0
+  relraddrs $2 > $2.a1
+  [ -s $2.a1 ] || return 2
+  cmp $2.a0 $2.a1 || return 3
+  relraddrs $1 | words $1 | while read w; do echo $(($w + $3)); done > $2.w0
+  words $2 < $2.a1 > $2.w1
+  [ `wc -l < $2.w1` = `wc -l < $2.a1` ] || return 4
+  cmp $2.w0 $2.w1 || return 5
+}
+set -- `elfrange relr1lib1.so.orig`
+B0=$1
+echo $PRELINK -v ./relr1lib1.so > relr1.log
+$PRELINK -v ./relr1lib1.so >> relr1.log 2>&1 || exit 1
+grep -q ^`echo $PRELINK | sed 's/ .*$/: /'` relr1.log && exit 2
+$PRELINK -y ./relr1lib1.so 2>> relr1.log \
+  | cmp - relr1lib1.so.orig >> relr1.log 2>&1 || exit 3
+set -- `elfrange relr1lib1.so`
+relrmoved relr1lib1.so.orig relr1lib1.so $(($1 - $B0)) >> relr1.log 2>&1 || exit 4
+# Relocating must give the same result whether the library was
+# prelinked before or not.
+echo $PRELINK -r 0x40000000 ./relr1lib1.so >> relr1.log
+$PRELINK -r 0x40000000 ./relr1lib1.so >> relr1.log 2>&1 || exit 5
+$PRELINK -r 0x40000000 ./relr1lib1.so.r >> relr1.log 2>&1 || exit 6
+relrmoved relr1lib1.so.orig relr1lib1.so $((0x40000000 - $B0)) >> relr1.log 2>&1 || exit 7
+relrmoved relr1lib1.so.orig relr1lib1.so.r $((0x40000000 - $B0)) >> relr1.log 2>&1 || exit 8
+$PRELINK -y ./relr1lib1.so 2>> relr1.log \
+  | cmp - relr1lib1.so.orig >> relr1.log 2>&1 || exit 9
+$PRELINK -u ./relr1lib1.so >> relr1.log 2>&1 || exit 10
+cmp relr1lib1.so relr1lib1.so.orig >> relr1.log 2>&1 || exit 11
+exit 0
@@ -0,0 +1,27 @@
+static int a[16];
+static const char *names[] = { "a", "b", "c", "d", "e" };
+
+/* Enough pointers for several RELR bitmap words, with holes.  */
+#define P4(n) &a[n], &a[n + 1], 0, &a[n + 3]
+#define P16(n) P4 (n), P4 (n + 4), P4 (n + 8), P4 (n + 12)
+static int *tab[] = { P16 (0), P16 (0), P16 (0), P16 (0),
+		      P16 (0), P16 (0), P16 (0) };
+static int *const ctab[] = { P16 (0), 0, 0, 0, P16 (0) };
+static int **ptab = &tab[3];
+
+const char *
+name (int i)
+{
+  return names[i];
+}
+
+int
+sum (void)
+{
+  int i, ret = 0;
+
+  for (i = 0; i < sizeof (tab) / sizeof (tab[0]); i++)
+    if (tab[i])
+      ret += *tab[i];
+  return ret + **ptab + *ctab[1];
+}
@@ -0,0 +1,64 @@
+#!/bin/bash
+. `dirname $0`/functions.sh
+# Prelink the reloc1, reloc10, tls1 and tls4 trees with prelink's own
+# resolver and with the dependencies, lookups and TLS offsets the
+# dynamic linker prints for --ld-trace, and check the results match.
+rm -f resolve1r1 resolve1r10 resolve1t1 resolve1t4 resolve1*.so resolve1.log
+rm -f resolve1*.orig resolve1*.resolve prelink.cache
+$CC -shared -O2 -fpic -o resolve1r1lib1.so $srcdir/reloc1lib1.c
+$CC -shared -O2 -fpic -o resolve1r1lib2.so $srcdir/reloc1lib2.c resolve1r1lib1.so
+$CCLINK -o resolve1r1 $srcdir/reloc1.c -Wl,--rpath-link,. resolve1r1lib2.so \
+  -lc resolve1r1lib1.so
+$CC -shared -O2 -fpic -o resolve1r10lib1.so $srcdir/reloc10lib1.c
+for i in 2 3 4; do
+  $CC -shared -O2 -nostdlib -fpic -o resolve1r10lib$i.so \
+    $srcdir/reloc10lib$i.c resolve1r10lib1.so
+done
+$CC -shared -O2 -fpic -o resolve1r10lib5.so $srcdir/reloc10lib5.c \
+  -Wl,--rpath-link,. resolve1r10lib2.so resolve1r10lib3.so resolve1r10lib4.so
+$CCLINK -o resolve1r10 $srcdir/reloc10.c -Wl,--rpath-link,. resolve1r10lib5.so \
+  -lc resolve1r10lib{2,3,4}.so
+BINS="resolve1r1 resolve1r10"
+LIBS="resolve1r1lib1.so resolve1r1lib2.so resolve1r10lib1.so resolve1r10lib2.so"
+LIBS="$LIBS resolve1r10lib3.so resolve1r10lib4.so resolve1r10lib5.so"
+echo '__thread int a; int main (void) { return a; }' \
+  | $CC -xc - -o tlstest > /dev/null 2>&1
+if ( ./tlstest ) 2>/dev/null; then
+  $CC -shared -O2 -fpic -o resolve1t1lib1.so $srcdir/tls1lib1.c
+  $CC -shared -O2 -fpic -o resolve1t1lib2.so $srcdir/tls1lib2.c resolve1t1lib1.so
+  $CCLINK -o resolve1t1 $srcdir/tls1.c -Wl,--rpath-link,. resolve1t1lib2.so \
+    -lc resolve1t1lib1.so
+  $CC -shared -O2 -fpic -o resolve1t4lib1.so $srcdir/tls4lib1.c
+  $CC -shared -O2 -fpic -o resolve1t4lib2.so $srcdir/tls4lib2.c \
+    resolve1t4lib1.so 2>/dev/null
+  $CCLINK -o resolve1t4 $srcdir/tls4.c -Wl,--rpath-link,. resolve1t4lib2.so \
+    -lc resolve1t4lib1.so
+  BINS="$BINS resolve1t1 resolve1t4"
+  LIBS="$LIBS resolve1t1lib1.so resolve1t1lib2.so resolve1t4lib1.so"
+  LIBS="$LIBS resolve1t4lib2.so"
+fi
+rm -f tlstest
+# Only a dynamic linker which still supports LD_TRACE_PRELINKING
+# prints the lookups.
+LD_TRACE_LOADED_OBJECTS=1 LD_TRACE_PRELINKING=./resolve1r1 \
+  `echo ./ld*.so.*[0-9]` --library-path . ./resolve1r1 2>/dev/null \
+  | grep -q '^lookup ' || exit 77
+savelibs
+export PRELINK_TIMESTAMP=1
+# The first run prelinks whatever else the tree needs, so that the
+# runs compared start from the same tree.
+for opt in "" "" --ld-trace; do
+  rm -f prelink.cache
+  echo $PRELINK $opt -v $BINS >> resolve1.log
+  $PRELINK $opt -v $BINS >> resolve1.log 2>&1 || exit 1
+  grep -q ^`echo $PRELINK | sed 's/ .*$/: /'` resolve1.log && exit 2
+  for i in $LIBS $BINS; do
+    if [ -z "$opt" ]; then
+      mv -f $i $i.resolve
+    else
+      cmp $i $i.resolve >> resolve1.log 2>&1 || exit 3
+    fi
+    cp -p $i.orig $i
+  done
+done
+exit 0
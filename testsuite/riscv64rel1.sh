@@ -0,0 +1,50 @@
+#!/bin/bash
+. `dirname $0`/functions.sh
+# Prelink the checked-in RISC-V 64 libraries built by crossobj.sh,
+# relocate the library with -r and check .got[0], .got.plt[1], the
+# TLS_DTPREL64 and IRELATIVE entries, then undo it.
+readelf -h $srcdir/riscv64rel1lib1.elf 2>&1 | grep -q RISC-V || exit 77
+rm -rf riscv64rel1.tree riscv64rel1.log
+mkdir riscv64rel1.tree
+T=riscv64rel1.tree
+cp $srcdir/riscv64rel1ld.elf $T/ld-linux-riscv64-lp64d.so.1
+cp $srcdir/riscv64rel1libc.elf $T/libc.so.6
+cp $srcdir/riscv64rel1lib1.elf $T/riscv64rel1lib1.so
+cp -a $T/riscv64rel1lib1.so $T/riscv64rel1lib1.so.orig
+PRELINK="$PRELINK --ld-library-path=$T --dynamic-linker=$T/ld-linux-riscv64-lp64d.so.1"
+# tv's DTPREL64 is stored with the 0x800 TLS_DTV_OFFSET bias.
+TV=`readelf -sW $T/libc.so.6 | sed -n 's/^ *[0-9]*: *\([0-9a-f]*\) .* tv$/0x\1/p' | head -1`
+DTPREL=`printf %016x $(($TV - 0x800))`
+# Check that the words prelink adjusts are consistent in $1.
+check() {
+  local dynamic plt pltgot dtprel irel
+  dynamic=`elfsecaddr $1 .dynamic`
+  plt=`elfsecaddr $1 .plt`
+  pltgot=`elfdyntag $1 PLTGOT`
+  dtprel=`elfreloc $1 R_RISCV_TLS_DTPREL64`
+  irel=`elfreloc $1 R_RISCV_IRELATIVE`
+  [ $((0x`elfword $1 $(elfsecaddr $1 .got)`)) = $(($dynamic)) ] || return 1
+  [ $((0x`elfword $1 $(($pltgot + 8))`)) = $(($plt)) ] || return 2
+  [ `elfword $1 ${dtprel% *}` = $DTPREL ] || return 3
+  [ $((${irel#* })) -ge $((`elfsecaddr $1 .text`)) ] || return 4
+  [ $((${irel#* })) -lt $(($plt)) ] || return 5
+  echo ${irel#* } `elfword $1 ${irel% *}`
+}
+echo $PRELINK -v $T/ld-linux-riscv64-lp64d.so.1 $T/libc.so.6 $T/riscv64rel1lib1.so > riscv64rel1.log
+$PRELINK -v $T/ld-linux-riscv64-lp64d.so.1 $T/libc.so.6 $T/riscv64rel1lib1.so >> riscv64rel1.log 2>&1 || exit 1
+grep -q ^`echo $PRELINK | sed 's/ .*$/: /'` riscv64rel1.log && exit 2
+readelf -d $T/riscv64rel1lib1.so 2>&1 | grep -q GNU_PRELINKED || exit 3
+$PRELINK -y $T/riscv64rel1lib1.so | cmp - $T/riscv64rel1lib1.so.orig >> riscv64rel1.log 2>&1 || exit 4
+V1=`check $T/riscv64rel1lib1.so` || exit 5
+B1=`readelf -lW $T/riscv64rel1lib1.so | sed -n 's/^ *LOAD *0x0* *\(0x[0-9a-f]*\) .*$/\1/p' | head -1`
+echo $PRELINK -r 0x4000000000 $T/riscv64rel1lib1.so >> riscv64rel1.log
+$PRELINK -r 0x4000000000 $T/riscv64rel1lib1.so >> riscv64rel1.log 2>&1 || exit 6
+V2=`check $T/riscv64rel1lib1.so` || exit 7
+# The IRELATIVE addend and its .got.plt entry moved along with the
+# library, the DTPREL64 value did not.
+set -- $V1 $V2
+D=$((0x4000000000 - $B1))
+[ $(($3)) = $(($1 + $D)) -a $((0x$4)) = $((0x$2 + $D)) ] || exit 8
+$PRELINK -u $T/riscv64rel1lib1.so >> riscv64rel1.log 2>&1 || exit 9
+cmp $T/riscv64rel1lib1.so $T/riscv64rel1lib1.so.orig >> riscv64rel1.log 2>&1 || exit 10
+exit 0
@@ -0,0 +1,32 @@
+/* Library for riscv64rel1.sh with a general dynamic TLS access to tv
+   from libc.so.6, giving a biased R_RISCV_TLS_DTPREL64, an IRELATIVE
+   relocation, PLT calls and .got[0] holding _DYNAMIC.
+   crossobj.sh builds riscv64rel1lib1.elf from it.  */
+	.text
+	.globl	f
+	.type	f, @function
+f:
+	addi	sp, sp, -16
+	sd	ra, 8(sp)
+	la.tls.gd	a0, tv
+	call	__tls_get_addr
+	call	g
+	ld	ra, 8(sp)
+	addi	sp, sp, 16
+	ret
+	.type	impl, @function
+impl:	ret
+	.type	ifn, @gnu_indirect_function
+ifn:
+	lla	a0, impl
+	ret
+	.globl	_init
+	.globl	_fini
+_init:
+_fini:	ret
+	.data
+	.globl	ptrs
+ptrs:	.dword	ptrs
+	.dword	ifn
+	.dword	f
+	.dword	ptrs + 8
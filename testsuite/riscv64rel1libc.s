@@ -0,0 +1,17 @@
+/* Stand-in libc.so.6 for riscv64rel1.sh, tv is at offset 8 of its
+   TLS block.  */
+	.text
+	.globl	g
+	.type	g, @function
+g:	ret
+	.globl	_init
+	.globl	_fini
+_init:
+_fini:	ret
+	.section .tbss, "awT", @nobits
+	.globl	tv0
+	.type	tv0, @object
+tv0:	.zero	8
+	.globl	tv
+	.type	tv, @object
+tv:	.zero	8
@@ -0,0 +1,29 @@
+/* Program for riscv64rel2.sh overriding dup, g and tv, copying obj
+   from riscv64rel2lib1.so and accessing tw from libc.so.6 with an
+   initial exec TLS access.  crossobj.sh builds riscv64rel2.elf
+   from it.  */
+	.text
+	.globl	_start
+_start:
+	lui	a0, %hi(obj)
+	addi	a0, a0, %lo(obj)
+	la.tls.ie	a1, tw
+	call	f
+	.globl	g
+	.type	g, @function
+g:	ret
+	.globl	_init
+	.globl	_fini
+_init:
+_fini:	ret
+	.data
+	.globl	dup
+	.type	dup, @object
+	.size	dup, 8
+dup:	.dword	0
+	.section .tbss, "awT", @nobits
+	.p2align 3
+tx:	.zero	16
+	.globl	tv
+	.type	tv, @object
+tv:	.zero	8
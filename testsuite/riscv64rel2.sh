@@ -0,0 +1,55 @@
+#!/bin/bash
+. `dirname $0`/functions.sh
+# Prelink the checked-in RISC-V 64 program built by crossobj.sh, which
+# overrides symbols of its libraries, including the TLS variable tv,
+# and copies an object from one of them, and check its .gnu.conflict
+# section, the copied object and its own TLS_TPREL64 and JUMP_SLOT
+# entries, then undo it.
+readelf -h $srcdir/riscv64rel2.elf 2>&1 | grep -q RISC-V || exit 77
+rm -rf riscv64rel2.tree riscv64rel2.log
+mkdir riscv64rel2.tree
+T=riscv64rel2.tree
+cp $srcdir/riscv64rel2ld.elf $T/ld-linux-riscv64-lp64d.so.1
+cp $srcdir/riscv64rel2libc.elf $T/libc.so.6
+cp $srcdir/riscv64rel2lib1.elf $T/riscv64rel2lib1.so
+cp $srcdir/riscv64rel2.elf $T/riscv64rel2
+cp -a $T/riscv64rel2 $T/riscv64rel2.orig
+PRELINK="$PRELINK --ld-library-path=$T --dynamic-linker=$T/ld-linux-riscv64-lp64d.so.1"
+# Print the value of dynamic symbol $2 in $1.
+sym() {
+  readelf -W --dyn-syms $1 | sed -n "s/^ *[0-9]*: *\([0-9a-f]*\) .* [0-9]* $2$/0x\1/p"
+}
+echo $PRELINK -v $T/riscv64rel2 > riscv64rel2.log
+$PRELINK -v $T/riscv64rel2 >> riscv64rel2.log 2>&1 || exit 1
+grep -q ^`echo $PRELINK | sed 's/ .*$/: /'` riscv64rel2.log && exit 2
+readelf -d $T/riscv64rel2 2>&1 | grep -q GNU_CONFLICT || exit 3
+L=$T/riscv64rel2lib1.so
+DUP=`sym $T/riscv64rel2 dup`
+G=`sym $T/riscv64rel2 g`
+set -- `readelf -rW $L | sed -n 's/^\([0-9a-f]*\) .* R_RISCV_64 .* dup + 0$/0x\1/p'` \
+  `elfreloc $L R_RISCV_TLS_TPREL64` `elfreloc $L R_RISCV_TLS_DTPMOD64` \
+  `elfreloc $L R_RISCV_TLS_DTPREL64` \
+  `readelf -rW $L | sed -n 's/^\([0-9a-f]*\) .* R_RISCV_JUMP_SLOT .* g + 0$/0x\1/p'` \
+  `elfreloc $L R_RISCV_IRELATIVE`
+# dup, g and tv resolve to the program rather than libc.so.6.  TLS
+# blocks start right at the thread pointer, the program's 24 byte one
+# is module 1 and has tv at offset 16, the DTPREL64 being biased by
+# 0x800, and libc.so.6's follows with tw at offset 16.  The IRELATIVE
+# relocation is always a conflict.
+printf "%x R_RISCV_64 %x\n" $1 $DUP $2 $DUP $3 40 $5 1 > $T/expected
+printf "%x R_RISCV_64 -%x\n" $7 $((0x800 - 16)) >> $T/expected
+printf "%x R_RISCV_JUMP_SLOT %x\n" $9 $G >> $T/expected
+printf "%x R_RISCV_IRELATIVE %x\n" ${10} ${11} >> $T/expected
+readelf -rW $T/riscv64rel2 | sed -n '/.gnu.conflict/,/^$/s/^0*\([0-9a-f]*\) *[0-9a-f]* *\(R_[A-Z0-9_]*\) *\(-*[0-9a-f]*\)$/\1 \2 \3/p' \
+  | sort | diff - <(sort $T/expected) >> riscv64rel2.log 2>&1 || exit 4
+# The copy of obj has the conflict for dup applied.
+OBJ=`sym $T/riscv64rel2 obj`
+[ $((0x`elfword $T/riscv64rel2 $OBJ`)) = $(($DUP)) ] || exit 5
+[ `elfword $T/riscv64rel2 $(($OBJ + 8))` = `elfword $L $((\`sym $L obj\` + 8))` ] || exit 6
+set -- `elfreloc $T/riscv64rel2 R_RISCV_TLS_TPREL64` `elfreloc $T/riscv64rel2 R_RISCV_JUMP_SLOT`
+[ $((0x`elfword $T/riscv64rel2 $1`)) = 40 ] || exit 7
+[ $((0x`elfword $T/riscv64rel2 $3`)) = $((`sym $L f`)) ] || exit 8
+$PRELINK -y $T/riscv64rel2 | cmp - $T/riscv64rel2.orig >> riscv64rel2.log 2>&1 || exit 9
+$PRELINK -u $T/riscv64rel2 >> riscv64rel2.log 2>&1 || exit 10
+cmp $T/riscv64rel2 $T/riscv64rel2.orig >> riscv64rel2.log 2>&1 || exit 11
+exit 0
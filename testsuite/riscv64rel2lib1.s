@@ -0,0 +1,37 @@
+/* Library for riscv64rel2.sh whose R_RISCV_64, JUMP_SLOT and general
+   dynamic TLS relocations against dup, g and tv resolve to libc.so.6
+   when the library is prelinked, but to the program when it is, plus
+   an initial exec TLS access to tw and an IRELATIVE relocation.  The
+   program copies obj with a COPY relocation.
+   crossobj.sh builds riscv64rel2lib1.elf from it.  */
+	.option	pic
+	.text
+	.globl	f
+	.type	f, @function
+f:
+	addi	sp, sp, -16
+	sd	ra, 8(sp)
+	la	a0, dup
+	la.tls.ie	a1, tw
+	la.tls.gd	a0, tv
+	call	__tls_get_addr
+	call	g
+	ld	ra, 8(sp)
+	addi	sp, sp, 16
+	ret
+	.type	impl, @function
+impl:	ret
+	.type	ifn, @gnu_indirect_function
+ifn:
+	lla	a0, impl
+	ret
+	.globl	_init
+	.globl	_fini
+_init:
+_fini:	ret
+	.data
+	.globl	obj
+	.type	obj, @object
+	.size	obj, 16
+obj:	.dword	dup
+	.dword	ifn
@@ -0,0 +1,26 @@
+/* Stand-in libc.so.6 for riscv64rel2.sh, defining dup, g and tv which
+   the program overrides, and tw at offset 16 of its TLS block.  */
+	.text
+	.globl	g
+	.type	g, @function
+g:	ret
+	.globl	_init
+	.globl	_fini
+_init:
+_fini:	ret
+	.data
+	.globl	dup
+	.type	dup, @object
+	.size	dup, 8
+dup:	.dword	0
+	.section .tbss, "awT", @nobits
+	.p2align 3
+	.globl	tv0
+	.type	tv0, @object
+tv0:	.zero	8
+	.globl	tv
+	.type	tv, @object
+tv:	.zero	8
+	.globl	tw
+	.type	tw, @object
+tw:	.zero	8
@@ -0,0 +1,49 @@
+#!/bin/bash
+. `dirname $0`/functions.sh
+# Libraries with lots of debug info must be written the same whether
+# write_dso copies the unchanged ranges with copy_file_range, writes
+# them itself or leaves it all to elf_update.
+rm -rf write1*.tree
+rm -f write1*.so write1*.so.orig write1*.hit write1.log
+$CC -shared -fpic -DHIT='"write1nocfr.hit"' -DNO_COPY_FILE_RANGE \
+  -o write1nocfr.so $srcdir/write1shim.c -ldl || exit 77
+$CC -shared -fpic -DHIT='"write1nomap.hit"' -DNO_PAGEMAP \
+  -o write1nomap.so $srcdir/write1shim.c -ldl || exit 77
+$CC -shared -O2 -g3 -fpic -nostdlib -o write1lib1.so $srcdir/reloc1lib1.c
+$CC -shared -O2 -g3 -fpic -nostdlib -o write1lib2.so $srcdir/reloc1lib2.c write1lib1.so
+LIBS="write1lib1.so write1lib2.so"
+savelibs
+: > write1.log
+for m in copy nocfr nomap; do
+  T=write1$m.tree
+  rm -f prelink.cache
+  mkdir $T
+  cp -p $LIBS $T/
+  cp -p write1lib1.so $T/write1lib3.so
+  P="$PRELINK --ld-library-path=$T"
+  [ $m = copy ] || P="env LD_PRELOAD=./write1$m.so $P"
+  echo $P -v $T/write1lib1.so $T/write1lib2.so >> write1.log
+  $P -v $T/write1lib1.so $T/write1lib2.so >> write1.log 2>&1 || exit 1
+  echo $P -r 0x5000000 $T/write1lib3.so >> write1.log
+  $P -r 0x5000000 $T/write1lib3.so >> write1.log 2>&1 || exit 2
+  [ $m = copy -o -f write1$m.hit ] || exit 3
+done
+grep -q ^`echo $PRELINK | sed 's/ .*$/: /'` write1.log && exit 4
+for i in $LIBS; do
+  readelf -d write1copy.tree/$i 2>&1 | grep -q GNU_PRELINKED || exit 5
+done
+set -- `elfrange write1copy.tree/write1lib3.so`
+[ $(($1)) = $((0x5000000)) ] || exit 5
+for i in $LIBS write1lib3.so; do
+  cmp write1copy.tree/$i write1nocfr.tree/$i >> write1.log 2>&1 || exit 6
+  cmp write1copy.tree/$i write1nomap.tree/$i >> write1.log 2>&1 || exit 7
+done
+for m in copy nocfr nomap; do
+  T=write1$m.tree
+  for i in $LIBS; do
+    $PRELINK -u $T/$i >> write1.log 2>&1 || exit 8
+    cmp $T/$i $i.orig >> write1.log 2>&1 || exit 9
+  done
+done
+rm -rf write1*.tree
+exit 0
@@ -0,0 +1,79 @@
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+
+/* LD_PRELOAD shim for write1.sh.  With NO_COPY_FILE_RANGE defined
+   copy_file_range fails, so write_dso has to write the unchanged
+   ranges itself, with NO_PAGEMAP /proc/self/pagemap can't be opened,
+   so it falls back to elf_update.  Either way HIT is created the first
+   time the fallback is forced.  */
+
+static void
+hit (void)
+{
+  static int done;
+  int (*real_open) (const char *, int, ...);
+  int fd;
+
+  if (done++)
+    return;
+  real_open = dlsym (RTLD_NEXT, "open");
+  fd = real_open (HIT, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd != -1)
+    close (fd);
+}
+
+#ifdef NO_COPY_FILE_RANGE
+ssize_t
+copy_file_range (int fd_in, off_t *off_in, int fd_out, off_t *off_out,
+		 size_t len, unsigned int flags)
+{
+  hit ();
+  errno = ENOSYS;
+  return -1;
+}
+#endif
+
+#ifdef NO_PAGEMAP
+static int
+shim_open (const char *name, int flags, va_list ap, const char *real)
+{
+  int (*real_open) (const char *, int, ...) = dlsym (RTLD_NEXT, real);
+  mode_t mode = (flags & O_CREAT) ? va_arg (ap, mode_t) : 0;
+
+  if (strcmp (name, "/proc/self/pagemap") == 0)
+    {
+      hit ();
+      errno = ENOENT;
+      return -1;
+    }
+  return real_open (name, flags, mode);
+}
+
+int
+open (const char *name, int flags, ...)
+{
+  va_list ap;
+  int ret;
+
+  va_start (ap, flags);
+  ret = shim_open (name, flags, ap, "open");
+  va_end (ap);
+  return ret;
+}
+
+int
+open64 (const char *name, int flags, ...)
+{
+  va_list ap;
+  int ret;
+
+  va_start (ap, flags);
+  ret = shim_open (name, flags, ap, "open64");
+  va_end (ap);
+  return ret;
+}
+#endif